@@ -17,6 +17,8 @@ MODEL_NAME = "ArcFace"
 # Nhận một danh sách các ảnh (Batch 3 frames)
 class BatchImageRequest(BaseModel):
     images: List[str] 
+    # Kiosk đã căn mặt theo 2 mắt về ảnh vuông (112x112) -> bỏ detect/align của DeepFace
+    aligned: bool = False
 
 def base64_to_cv2(base64_string):
     try:
@@ -75,6 +77,7 @@ async def extract_vector_batch(req: BatchImageRequest):
     # Node.js đã đảm bảo gửi đủ số lượng (3 hoặc 5)
     images = req.images 
     vectors = []
+    detector = "skip" if req.aligned else "opencv"
 
     # 1. Extract Vector từng ảnh
     deepface_start = time.time()
@@ -84,7 +87,8 @@ async def extract_vector_batch(req: BatchImageRequest):
         try:
             
             # DeepFace detect & align & embed
-            emb = DeepFace.represent(img, model_name="ArcFace", enforce_detection=False)
+            emb = DeepFace.represent(img, model_name="ArcFace", enforce_detection=False,
+                                     detector_backend=detector)
             vectors.append(np.array(emb[0]["embedding"]))
         except:
             continue
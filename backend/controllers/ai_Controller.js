@@ -19,18 +19,22 @@ function calculateCosineDistance(vec1, vec2) {
     return 1.0 - (dotProduct / (Math.sqrt(normA) * Math.sqrt(normB)));
 }
 
-// 2. Hàm lưu ảnh Base64
-const saveBase64Image = (base64String, folderName, prefix, customTime) => {
+// 2. Hàm lưu ảnh (Base64 từ JSON hoặc Buffer JPEG thô)
+const saveBase64Image = (image, folderName, prefix, customTime) => {
     try {
         const dirPath = path.join(process.cwd(), 'public', folderName);
         if (!fs.existsSync(dirPath)) fs.mkdirSync(dirPath, { recursive: true });
 
-        const matches = base64String.match(/^data:([A-Za-z-+\/]+);base64,(.+)$/);
         let imageBuffer = null;
-        if (matches && matches.length === 3) {
-            imageBuffer = Buffer.from(matches[2], 'base64');
+        if (Buffer.isBuffer(image)) {
+            imageBuffer = image;
         } else {
-            imageBuffer = Buffer.from(base64String, 'base64');
+            const matches = image.match(/^data:([A-Za-z-+\/]+);base64,(.+)$/);
+            if (matches && matches.length === 3) {
+                imageBuffer = Buffer.from(matches[2], 'base64');
+            } else {
+                imageBuffer = Buffer.from(image, 'base64');
+            }
         }
 
         const timePart = customTime ? new Date(customTime).getTime() : Date.now();
@@ -47,30 +51,291 @@ const saveBase64Image = (base64String, folderName, prefix, customTime) => {
     }
 };
 
+// 3. Đọc ảnh + metadata từ request, hỗ trợ 2 định dạng:
+//    - JSON: { image: "<base64>", timestamp, is_offline, employee_id, aligned }
+//    - JPEG thô (Content-Type: image/jpeg): metadata trong header X-Timestamp, X-Offline, X-Employee-Id, X-Face-Aligned
+// aligned: kiosk đã căn mặt theo 2 mắt về ảnh vuông cố định (vd 112x112) -> Python bỏ bước detect/resize
+const readImageRequest = (req) => {
+    if (Buffer.isBuffer(req.body)) {
+        return {
+            image: req.body,
+            timestamp: req.get('X-Timestamp'),
+            is_offline: req.get('X-Offline') === '1',
+            employee_id: req.get('X-Employee-Id'),
+            aligned: Number(req.get('X-Face-Aligned')) > 0
+        };
+    }
+    if (!req.body || typeof req.body !== 'object') return null;
+    const { image, timestamp, is_offline, employee_id, aligned } = req.body;
+    return { image, timestamp, is_offline, employee_id, aligned: Number(aligned) > 0 };
+};
+
+// 4. Đọc batch ảnh burst (nhiều frame trong 1 request):
+//    - JSON: { images: ["<base64>", ...], timestamp }
+//    - Nhị phân (application/octet-stream): các JPEG nối liền nhau,
+//      độ dài từng ảnh trong header X-Image-Lengths (vd "5120,4980,5301")
+const readBatchRequest = (req) => {
+    const aligned = Number(Buffer.isBuffer(req.body) ? req.get('X-Face-Aligned') : req.body?.aligned) > 0;
+    if (Buffer.isBuffer(req.body)) {
+        const lengths = (req.get('X-Image-Lengths') || '').split(',').map(Number).filter(n => n > 0);
+        const images = [];
+        let offset = 0;
+        for (const len of lengths) {
+            if (offset + len > req.body.length) return null;
+            images.push(req.body.subarray(offset, offset + len));
+            offset += len;
+        }
+        return { images, timestamp: req.get('X-Timestamp'), aligned };
+    }
+    if (!req.body || !Array.isArray(req.body.images)) return null;
+    return { images: req.body.images, timestamp: req.body.timestamp, aligned };
+};
+
+// Python service chỉ nhận base64 -> chỉ chuyển đổi ngay trước khi gọi
+const toBase64 = (image) => Buffer.isBuffer(image) ? image.toString('base64') : image;
+
 // Biến lưu Session tạm trong RAM
 const recogSessions = {}; 
 const enrollSessions = {}; 
 
+// Mốc thời gian ca làm (phút trong ngày)
+const START_DAY      = 7 * 60;        // 07:00
+const LATE_MORNING   = 8 * 60 + 15;   // 08:15 (Trễ sáng)
+
+const MORNING_END    = 11 * 60;       // 11:00 (Bắt đầu nghỉ trưa)
+const LUNCH_BUFFER   = 12 * 60 + 30;  // 12:30 (Ranh giới giữa Ra Trưa và Vào Chiều)
+
+const AFTERNOON_START = 13 * 60;      // 13:00 (Giờ làm chiều chuẩn)
+const LATE_AFTERNOON  = 13 * 60 + 15; // 13:15 (Trễ chiều)  
+const MAX_LATE_AFTERNOON = 13 * 60 + 30; // 13:30 (Quá giờ này tính là Vắng)
+const AFTERNOON_SCAN_LIMIT = 14 * 60; // 14:00 (Sau giờ này ko tính là vào chiều nữa mà là về sớm/muộn)
+
+const WORK_END       = 17 * 60;       // 17:00 (Được về)
+const OVERTIME_START = 18 * 60;       // 18:00 (OT)
+
+// Gọi Python trích vector (kèm liveness) từ batch ảnh
+const extractVector = async (batchImages, aligned = false) => {
+    const pyRes = await axios.post(PYTHON_API_BATCH, { images: batchImages.map(toBase64), aligned });
+    return pyRes.data;
+};
+
+// Trích vector từ batch ảnh, so khớp với nhân viên đã enroll và ghi log chấm công.
+// Trả về object kết quả để gửi lại thiết bị ({ match, name, ... }).
+const identifyAndLog = async (batchImages, logTime, aligned = false) => {
+    return matchAndLog(await extractVector(batchImages, aligned), batchImages, logTime);
+};
+
+// So khớp kết quả Python với nhân viên đã enroll và ghi log chấm công
+const matchAndLog = async (pyData, batchImages, logTime) => {
+    const currentH = logTime.getHours();
+    const currentM = logTime.getMinutes();
+    const totalM = currentH * 60 + currentM;
+
+    const { success, vector, liveness, message, debug_score } = pyData;
+    if (debug_score !== undefined) {
+    console.log(`📊 Liveness Score từ Python: ${debug_score.toFixed(4)}`);
+    }
+    const RELAXED_THRESHOLD = 3.5;
+
+    const isAcceptable = liveness || (debug_score < RELAXED_THRESHOLD);
+    if (!success || !isAcceptable) 
+    {
+        console.log(`❌ Bị chặn bởi AI: ${message}`);
+        return { match: false, name: "Spoof/NoFace", message };
+    }
+
+    console.log("🔹 Vector nhận được (5 số đầu):", vector.slice(0, 5));
+
+    const users = await User.find({ is_enrolled: true });
+    let bestMatch = { label: 'unknown', distance: 1.0, user: null };
+    
+    for (const user of users) {
+        if (user.face_vector && user.face_vector.length > 0) {
+            
+            let bestDistForUser = 1.0;
+            
+            for (const dbVec of user.face_vector) {
+                const dist = calculateCosineDistance(vector, dbVec.embedding);
+                if (dist < bestDistForUser) bestDistForUser = dist;
+            }
+
+            if (bestDistForUser < 0.80) {
+                console.log(`🔍 So với [${user.name}]: Dist = ${bestDistForUser.toFixed(4)} ${bestDistForUser < 0.68 ? "✅ MATCH" : "❌"}`);
+            } else {
+            }
+
+            if (bestDistForUser < bestMatch.distance) {
+                bestMatch = { label: user.name, distance: bestDistForUser, user: user };
+            }
+        }
+    }
+    console.log("-----------------------");
+
+    if (bestMatch.distance < 0.72 && bestMatch.user) {
+        console.log(`🎯 KẾT QUẢ: ${bestMatch.label} (Độ tin cậy: ${((1 - bestMatch.distance)*100).toFixed(1)}%)`);
+        const user = bestMatch.user;
+        
+        const savedPath = saveBase64Image(batchImages[0], 'attendance_imgs', `LOG_${user.employee_id}`, logTime);
+        
+        const startOfDay = new Date(logTime); startOfDay.setHours(0,0,0,0);
+        const endOfDay = new Date(logTime); endOfDay.setHours(23,59,59,999);
+        
+        let log = await AttendanceLog.findOne({ 
+                        employee_id: user.employee_id, 
+                        date: { $gte: startOfDay, $lte: endOfDay } 
+                    });            
+        let statusLog = "Đúng giờ";
+        let logNote = "";
+        let action = "";
+
+        if (!log) {
+            // A. Check-in Buổi Sáng
+            if (totalM < MORNING_END) {
+                if (totalM <= LATE_MORNING) {
+                    statusLog = "Đúng giờ";
+                    logNote = `Vào Sáng ${currentH}:${currentM}`;
+                } else {
+                    statusLog = "Đi trễ";
+                    logNote = `Trễ Sáng ${totalM - START_DAY} phút`;
+                }
+                
+                // Tạo log buổi sáng bình thường
+                log = new AttendanceLog({ 
+                    name: user.name, 
+                    employee_id: user.employee_id, 
+                    date: startOfDay, 
+                    checkInTime: logTime, // <--- Cột Sáng
+                    checkInImage: savedPath,
+                    status: statusLog,
+                    note: logNote
+                });
+                
+                await log.save();
+                action = "CHECK-IN";
+            } 
+            // B. Check-in Buổi Chiều (Bỏ sáng)
+            else {
+                // --- LOGIC MỚI: CHẶN CHECK-IN QUÁ MUỘN ---
+                if (totalM > MAX_LATE_AFTERNOON) {
+                    // Nếu đã quá 13:30 mà mới đến -> Từ chối và coi như Vắng
+                    console.log(`❌ ${user.name} đến quá trễ (${currentH}:${currentM}), tính là VẮNG.`);
+                    
+                    // Bạn có thể trả về lỗi để thiết bị báo đỏ
+                    return { 
+                        match: false, 
+                        name: "Vang mat", 
+                        message: "Đã quá giờ điểm danh chiều. Tính vắng." 
+                    };
+                    
+                    // Hoặc nếu muốn lưu log "Vắng" vào DB để hiện đỏ trên web thì uncomment đoạn dưới:
+                    /*
+                    log = new AttendanceLog({
+                         name: user.name, employee_id: user.employee_id, date: startOfDay,
+                         status: "Vắng", note: "Vắng (Đến quá trễ chiều)"
+                    });
+                    await log.save();
+                    */
+                }
+
+                statusLog = "Vắng mặt buổi sáng";
+                logNote = "Vắng Sáng - Vào Chiều";
+
+                log = new AttendanceLog({ 
+                    name: user.name, 
+                    employee_id: user.employee_id, 
+                    date: startOfDay, 
+                    
+                    checkInTime: null,      // <--- QUAN TRỌNG: Để null để cột Sáng trống
+                    checkInImage: null,     // Không có ảnh sáng
+                    
+                    // Chỉ điền thông tin chiều
+                    checkInTimeAfternoon: logTime, 
+                    checkInImageAfternoon: savedPath,
+
+                    status: statusLog,
+                    note: logNote
+                });
+
+                await log.save();
+                action = "CHECK-IN";
+            }
+        }
+        else {
+            const lastUpdate = log.checkOutTime || log.checkInTimeAfternoon || log.checkOutTimeMorning || log.checkInTime;
+            
+            // Chỉ cập nhật nếu bản ghi trước đó không null và thời gian cách nhau > 1 phút
+            if (lastUpdate && (logTime.getTime() - new Date(lastUpdate).getTime() > 60000)) {
+
+                if (totalM >= MORNING_END && totalM < LUNCH_BUFFER && !log.checkOutTimeMorning) {
+                    log.checkOutTimeMorning = logTime;
+                    log.checkOutImageMorning = savedPath;
+                    if (!log.note.includes("Nghỉ trưa")) log.note += " | Ra nghỉ trưa";
+                    action = "RA NGHỈ TRƯA";
+                }
+
+                else if (totalM >= LUNCH_BUFFER && totalM < AFTERNOON_SCAN_LIMIT && !log.checkInTimeAfternoon) {
+                    log.checkInTimeAfternoon = logTime;
+                    log.checkInImageAfternoon = savedPath;
+                    
+                    if (totalM > LATE_AFTERNOON) {
+                        const latePm = totalM - AFTERNOON_START;
+                        log.note += ` | Trễ Chiều ${latePm}p`;
+                        if (log.status === "Đúng giờ") log.status = "Đi trễ chiều";
+                    } else {
+                        log.note += ` | Vào Chiều ${currentH}:${currentM}`;
+                    }
+                    action = "VÀO LÀM CHIỀU";
+                }
+
+                else if (totalM >= WORK_END) {
+                    log.checkOutTime = logTime;
+                    log.checkOutImage = savedPath;
+                    
+                    const timeStr = `${currentH.toString().padStart(2, '0')}:${currentM.toString().padStart(2, '0')}`;
+                    let leaveMsg = ` | Ra về ${timeStr}`;
+                    
+                    if (totalM >= OVERTIME_START) {
+                        leaveMsg = ` | OT đến ${timeStr}`;
+                    }
+                    
+                    // [LOGIC MỚI] Ghi đè giờ về cũ nếu có
+                    if (log.note.includes("Ra về") || log.note.includes("OT")) {
+                        // Xóa đoạn cũ đi
+                        log.note = log.note.replace(/ \| Ra về \d{1,2}:\d{1,2}/g, "")
+                                           .replace(/ \| OT đến \d{1,2}:\d{1,2}/g, "");
+                    }
+                    log.note += leaveMsg;
+                    action = "RA VỀ (CẬP NHẬT)";
+                }
+                else {
+                    action = "QUÉT LẶP (BỎ QUA)";
+                }
+
+                await log.save();
+            } else {
+                action = "SPAM LOG";
+            }
+        }
+        console.log(`✅ ${action}: ${user.name} -> ${logNote || log.note}`);          
+        return { match: true, name: user.name, employee_id: user.employee_id };
+    }
+
+    console.log(`⚠️ Unknown: Gần nhất ${bestMatch.label} (${bestMatch.distance.toFixed(2)})`);
+    
+    return { match: false, name: "unknown" };
+};
+
 // --- API RECOGNIZE ---
 export const recognizeFace = async (req, res) => {
     const timerLabel = `⏱️ Xử lý [${Date.now()}]`; 
     console.time(timerLabel);
     try {
-        const { image, timestamp, is_offline } = req.body;
-
-        const START_DAY      = 7 * 60;        // 07:00
-        const LATE_MORNING   = 8 * 60 + 15;   // 08:15 (Trễ sáng)
-        
-        const MORNING_END    = 11 * 60;       // 11:00 (Bắt đầu nghỉ trưa)
-        const LUNCH_BUFFER   = 12 * 60 + 30;  // 12:30 (Ranh giới giữa Ra Trưa và Vào Chiều)
-        
-        const AFTERNOON_START = 13 * 60;      // 13:00 (Giờ làm chiều chuẩn)
-        const LATE_AFTERNOON  = 13 * 60 + 15; // 13:15 (Trễ chiều)  
-        const MAX_LATE_AFTERNOON = 13 * 60 + 30; // 13:30 (Quá giờ này tính là Vắng)
-        const AFTERNOON_SCAN_LIMIT = 14 * 60; // 14:00 (Sau giờ này ko tính là vào chiều nữa mà là về sớm/muộn)
-        
-        const WORK_END       = 17 * 60;       // 17:00 (Được về)
-        const OVERTIME_START = 18 * 60;       // 18:00 (OT)
+        const payload = readImageRequest(req);
+        if (!payload) {
+            console.timeEnd(timerLabel);
+            return res.status(415).json({ error: "Unsupported image format" });
+        }
+        const { image, timestamp, is_offline, employee_id, aligned } = payload;
 
         const serverTime = new Date();
         const deviceTime = new Date(timestamp);
@@ -87,9 +352,6 @@ export const recognizeFace = async (req, res) => {
         }
         console.log("------------------------------------------------");
         const logTime = timestamp ? new Date(timestamp) : new Date();
-        const currentH = logTime.getHours();
-        const currentM = logTime.getMinutes();
-        const totalM = currentH * 60 + currentM;
         const clientIP = req.ip || "device_1";
         console.log("🔍 DEBUG BODY:", { 
             timestamp: timestamp, 
@@ -97,6 +359,7 @@ export const recognizeFace = async (req, res) => {
             type_of_offline: typeof is_offline 
         });
         let batchImages = [];
+        let batchAligned = aligned;
         if (is_offline === true || is_offline === "true") {
             console.log(`📥 Nhận dữ liệu OFFLINE lúc ${timestamp} -> Xử lý ngay!`);
             
@@ -109,6 +372,9 @@ export const recognizeFace = async (req, res) => {
             if (Date.now() - recogSessions[clientIP].lastUpdate > 5000) recogSessions[clientIP].images = [];
 
             if (image) {
+                // Chỉ bỏ bước detect khi mọi ảnh trong phiên đều đã căn
+                const session = recogSessions[clientIP];
+                session.aligned = (session.images.length === 0 ? true : session.aligned) && aligned;
                 recogSessions[clientIP].images.push(image);
                 recogSessions[clientIP].lastUpdate = Date.now();
             }
@@ -120,259 +386,114 @@ export const recognizeFace = async (req, res) => {
             }
 
             batchImages = recogSessions[clientIP].images;
+            batchAligned = recogSessions[clientIP].aligned;
             recogSessions[clientIP].images = []; // Reset bộ đệm
         }
 
-
-        const pyRes = await axios.post(PYTHON_API_BATCH, { images: batchImages });
-
-        const { success, vector, liveness, message, debug_score } = pyRes.data;
-        if (debug_score !== undefined) {
-        console.log(`📊 Liveness Score từ Python: ${debug_score.toFixed(4)}`);
+        const result = await identifyAndLog(batchImages, logTime, batchAligned);
+        if (employee_id) {
+            // Kiosk đã nhận diện tại chỗ bằng gallery offline -> chỉ đối chiếu, server vẫn quyết định
+            console.log(`📱 Kiosk nhận diện offline: ${employee_id} | Server: ${result.name}`);
         }
-        const RELAXED_THRESHOLD = 3.5;
-
-        const isAcceptable = liveness || (debug_score < RELAXED_THRESHOLD);
-        if (!success || !isAcceptable) 
-        {
-            console.timeEnd(timerLabel);
-            console.log(`❌ Bị chặn bởi AI: ${message}`);
-            return  res.json({ match: false, name: "Spoof/NoFace", message });
-        }
-
-        console.log("🔹 Vector nhận được (5 số đầu):", vector.slice(0, 5));
-
+        console.timeEnd(timerLabel);
+        if (!res.headersSent) return res.json(result);
 
-        const users = await User.find({ is_enrolled: true });
-        let bestMatch = { label: 'unknown', distance: 1.0, user: null };
+    } catch (error) {
+        try { console.timeEnd(timerLabel); } catch(e){}
         
-        for (const user of users) {
-            if (user.face_vector && user.face_vector.length > 0) {
-                
-                let bestDistForUser = 1.0;
-                
-                for (const dbVec of user.face_vector) {
-                    const dist = calculateCosineDistance(vector, dbVec.embedding);
-                    if (dist < bestDistForUser) bestDistForUser = dist;
-                }
-
-                if (bestDistForUser < 0.80) {
-                    console.log(`🔍 So với [${user.name}]: Dist = ${bestDistForUser.toFixed(4)} ${bestDistForUser < 0.68 ? "✅ MATCH" : "❌"}`);
-                } else {
-                }
-
-                if (bestDistForUser < bestMatch.distance) {
-                    bestMatch = { label: user.name, distance: bestDistForUser, user: user };
-                }
-            }
-        }
-        console.log("-----------------------");
-
-
-        if (bestMatch.distance < 0.72 && bestMatch.user) {
-            console.log(`🎯 KẾT QUẢ: ${bestMatch.label} (Độ tin cậy: ${((1 - bestMatch.distance)*100).toFixed(1)}%)`);
-            const user = bestMatch.user;
-            
-            const savedPath = saveBase64Image(batchImages[0], 'attendance_imgs', `LOG_${user.employee_id}`, logTime);
-            
-            const startOfDay = new Date(logTime); startOfDay.setHours(0,0,0,0);
-            const endOfDay = new Date(logTime); endOfDay.setHours(23,59,59,999);
-            
-            let log = await AttendanceLog.findOne({ 
-                            employee_id: user.employee_id, 
-                            date: { $gte: startOfDay, $lte: endOfDay } 
-                        });            
-            let statusLog = "Đúng giờ";
-            let logNote = "";
-            let action = "";
-
-            if (!log) {
-                // A. Check-in Buổi Sáng
-                if (totalM < MORNING_END) {
-                    if (totalM <= LATE_MORNING) {
-                        statusLog = "Đúng giờ";
-                        logNote = `Vào Sáng ${currentH}:${currentM}`;
-                    } else {
-                        statusLog = "Đi trễ";
-                        logNote = `Trễ Sáng ${totalM - START_DAY} phút`;
-                    }
-                    
-                    // Tạo log buổi sáng bình thường
-                    log = new AttendanceLog({ 
-                        name: user.name, 
-                        employee_id: user.employee_id, 
-                        date: startOfDay, 
-                        checkInTime: logTime, // <--- Cột Sáng
-                        checkInImage: savedPath,
-                        status: statusLog,
-                        note: logNote
-                    });
-                    
-                    await log.save();
-                    action = "CHECK-IN";
-                } 
-                // B. Check-in Buổi Chiều (Bỏ sáng)
-                else {
-                    // --- LOGIC MỚI: CHẶN CHECK-IN QUÁ MUỘN ---
-                    if (totalM > MAX_LATE_AFTERNOON) {
-                        // Nếu đã quá 13:30 mà mới đến -> Từ chối và coi như Vắng
-                        console.log(`❌ ${user.name} đến quá trễ (${currentH}:${currentM}), tính là VẮNG.`);
-                        
-                        // Bạn có thể trả về lỗi để thiết bị báo đỏ
-                        console.timeEnd(timerLabel);
-                        return res.json({ 
-                            match: false, 
-                            name: "Vang mat", 
-                            message: "Đã quá giờ điểm danh chiều. Tính vắng." 
-                        });
-                        
-                        // Hoặc nếu muốn lưu log "Vắng" vào DB để hiện đỏ trên web thì uncomment đoạn dưới:
-                        /*
-                        log = new AttendanceLog({
-                             name: user.name, employee_id: user.employee_id, date: startOfDay,
-                             status: "Vắng", note: "Vắng (Đến quá trễ chiều)"
-                        });
-                        await log.save();
-                        */
-                    }
-
-                    statusLog = "Vắng mặt buổi sáng";
-                    logNote = "Vắng Sáng - Vào Chiều";
-
-                    log = new AttendanceLog({ 
-                        name: user.name, 
-                        employee_id: user.employee_id, 
-                        date: startOfDay, 
-                        
-                        checkInTime: null,      // <--- QUAN TRỌNG: Để null để cột Sáng trống
-                        checkInImage: null,     // Không có ảnh sáng
-                        
-                        // Chỉ điền thông tin chiều
-                        checkInTimeAfternoon: logTime, 
-                        checkInImageAfternoon: savedPath,
-
-                        status: statusLog,
-                        note: logNote
-                    });
-
-                    await log.save();
-                    action = "CHECK-IN";
-                }
-            }
-            else {
-                const lastUpdate = log.checkOutTime || log.checkInTimeAfternoon || log.checkOutTimeMorning || log.checkInTime;
-                
-                // Chỉ cập nhật nếu bản ghi trước đó không null và thời gian cách nhau > 1 phút
-                if (lastUpdate && (logTime.getTime() - new Date(lastUpdate).getTime() > 60000)) {
-
-                    if (totalM >= MORNING_END && totalM < LUNCH_BUFFER && !log.checkOutTimeMorning) {
-                        log.checkOutTimeMorning = logTime;
-                        log.checkOutImageMorning = savedPath;
-                        if (!log.note.includes("Nghỉ trưa")) log.note += " | Ra nghỉ trưa";
-                        action = "RA NGHỈ TRƯA";
-                    }
-
-                    else if (totalM >= LUNCH_BUFFER && totalM < AFTERNOON_SCAN_LIMIT && !log.checkInTimeAfternoon) {
-                        log.checkInTimeAfternoon = logTime;
-                        log.checkInImageAfternoon = savedPath;
-                        
-                        if (totalM > LATE_AFTERNOON) {
-                            const latePm = totalM - AFTERNOON_START;
-                            log.note += ` | Trễ Chiều ${latePm}p`;
-                            if (log.status === "Đúng giờ") log.status = "Đi trễ chiều";
-                        } else {
-                            log.note += ` | Vào Chiều ${currentH}:${currentM}`;
-                        }
-                        action = "VÀO LÀM CHIỀU";
-                    }
-
-                    else if (totalM >= WORK_END) {
-                        log.checkOutTime = logTime;
-                        log.checkOutImage = savedPath;
-                        
-                        const timeStr = `${currentH.toString().padStart(2, '0')}:${currentM.toString().padStart(2, '0')}`;
-                        let leaveMsg = ` | Ra về ${timeStr}`;
-                        
-                        if (totalM >= OVERTIME_START) {
-                            leaveMsg = ` | OT đến ${timeStr}`;
-                        }
-                        
-                        // [LOGIC MỚI] Ghi đè giờ về cũ nếu có
-                        if (log.note.includes("Ra về") || log.note.includes("OT")) {
-                            // Xóa đoạn cũ đi
-                            log.note = log.note.replace(/ \| Ra về \d{1,2}:\d{1,2}/g, "")
-                                               .replace(/ \| OT đến \d{1,2}:\d{1,2}/g, "");
-                        }
-                        log.note += leaveMsg;
-                        action = "RA VỀ (CẬP NHẬT)";
-                    }
-                    else {
-                        action = "QUÉT LẶP (BỎ QUA)";
-                    }
-
-                    await log.save();
-                } else {
-                    action = "SPAM LOG";
-                }
-            }
-            console.log(`✅ ${action}: ${user.name} -> ${logNote || log.note}`);          
+        console.error("Server Error:", error.message);
+        
+        if (!res.headersSent) return res.status(500).json({ error: error.message });
+    }
+};
+// --- API RECOGNIZE BATCH ---
+// Thiết bị gửi đủ các frame burst trong 1 request -> trả quyết định ngay,
+// không qua recogSessions và không có vòng "collecting"
+export const recognizeBatch = async (req, res) => {
+    const timerLabel = `⏱️ Xử lý batch [${Date.now()}]`; 
+    console.time(timerLabel);
+    try {
+        const payload = readBatchRequest(req);
+        if (!payload || payload.images.length === 0) {
             console.timeEnd(timerLabel);
-            if (!res.headersSent) return res.json({ match: true, name: user.name });
-            return;
+            return res.status(415).json({ error: "Unsupported image format" });
         }
+        const { images, timestamp, aligned } = payload;
+        const logTime = timestamp ? new Date(timestamp) : new Date();
+        console.log(`📥 Nhận batch ${images.length} ảnh lúc ${timestamp}${aligned ? ' (đã căn mặt)' : ''}`);
 
-        console.log(`⚠️ Unknown: Gần nhất ${bestMatch.label} (${bestMatch.distance.toFixed(2)})`);
+        const result = await identifyAndLog(images, logTime, aligned);
         console.timeEnd(timerLabel);
-        
-        if (!res.headersSent) return res.json({ match: false, name: "unknown" });
+        if (!res.headersSent) return res.json(result);
 
     } catch (error) {
         try { console.timeEnd(timerLabel); } catch(e){}
-        
         console.error("Server Error:", error.message);
-        
         if (!res.headersSent) return res.status(500).json({ error: error.message });
     }
 };
-// --- API ENROLL ---
-export const enrollFace = async (req, res) => {
-    try {
-        const { image, employee_id } = req.body;
-        
-        if (!enrollSessions[employee_id]) enrollSessions[employee_id] = [];
-        enrollSessions[employee_id].push(image);
-        
-        const count = enrollSessions[employee_id].length;
-        console.log(`📥 Enroll ${employee_id}: ${count}/5`);
 
-        if (count < 5) return res.json({ status: "collecting", count });
+// Thêm 1 ảnh vào phiên enroll của nhân viên; đủ 5 ảnh thì trích vector và lưu.
+// Trả về object kết quả để gửi lại thiết bị.
+const enrollAligned = {};
+const processEnrollImage = async (image, employee_id, aligned = false) => {
+    if (!enrollSessions[employee_id] || enrollSessions[employee_id].length === 0) {
+        enrollSessions[employee_id] = [];
+        enrollAligned[employee_id] = true;
+    }
+    enrollAligned[employee_id] = enrollAligned[employee_id] && aligned;
+    enrollSessions[employee_id].push(image);
+    
+    const count = enrollSessions[employee_id].length;
+    console.log(`📥 Enroll ${employee_id}: ${count}/5`);
 
-        const batchImages = enrollSessions[employee_id];
-        enrollSessions[employee_id] = []; 
+    if (count < 5) return { status: "collecting", count };
 
-        const pyRes = await axios.post(PYTHON_API_BATCH, { images: batchImages });
-        
-        if (!pyRes.data.success) return res.json({ success: false, message: "No face detected" });
+    const batchImages = enrollSessions[employee_id];
+    enrollSessions[employee_id] = []; 
 
-        deleteOldEnrollImages(employee_id);
+    const pyData = await extractVector(batchImages, enrollAligned[employee_id]);
+    
+    if (!pyData.success) return { success: false, message: "No face detected" };
 
+    deleteOldEnrollImages(employee_id);
 
-        saveBase64Image(batchImages[0], 'faces', `ENROLL_${employee_id}`);
 
-        // Cập nhật User
-        const user = await User.findOne({ employee_id });
-        if (user) {
-            user.face_vector.push({ 
-                embedding: pyRes.data.vector, 
-                quality: pyRes.data.debug_score,
-                source: "esp32_batch"
-            });
-            user.is_enrolled = true;
-            await user.save();
-            console.log(`✅ Đã cập nhật dữ liệu Enroll mới cho: ${user.name}`);
-        }
+    saveBase64Image(batchImages[0], 'faces', `ENROLL_${employee_id}`);
+
+    // Cập nhật User
+    const user = await User.findOne({ employee_id });
+    if (user) {
+        user.face_vector.push({ 
+            embedding: pyData.vector, 
+            quality: pyData.debug_score,
+            source: "esp32_batch"
+        });
+        user.is_enrolled = true;
+        await user.save();
+        console.log(`✅ Đã cập nhật dữ liệu Enroll mới cho: ${user.name}`);
+    }
+
+    return { success: true, message: "Enrollment Complete & Old Data Cleared" };
+};
 
-        return res.json({ success: true, message: "Enrollment Complete & Old Data Cleared" });
+// Bỏ các ảnh đã gom của phiên enroll (bắt đầu enroll mới / kiosk chụp lại cả bộ ảnh).
+// Server chỉ kết luận khi đủ 5 ảnh, nên ảnh lượt cũ không được lẫn vào bộ ảnh mới.
+export const resetEnrollSession = (employee_id) => {
+    if (!employee_id) return;
+    delete enrollSessions[employee_id];
+    delete enrollAligned[employee_id];
+    console.log(`🔄 Enroll ${employee_id}: reset phiên`);
+};
+
+// --- API ENROLL ---
+export const enrollFace = async (req, res) => {
+    try {
+        const payload = readImageRequest(req);
+        if (!payload) return res.status(415).json({ success: false, message: "Unsupported image format" });
+        const { image, employee_id, aligned } = payload;
+
+        return res.json(await processEnrollImage(image, employee_id, aligned));
 
     } catch (error) {
         if (!res.headersSent) res.status(500).json({ success: false });
@@ -396,4 +517,324 @@ const deleteOldEnrollImages = (employee_id) => {
     } catch (error) {
         console.error("⚠️ Lỗi xóa ảnh cũ:", error.message);
     }
-};
\ No newline at end of file
+};
+
+// --- API INGEST BATCH (ĐỒNG BỘ OFFLINE HÀNG LOẠT) ---
+// Body là các record journal của kiosk nối liền nhau, đúng byte như trên thẻ SD
+// (định dạng trong doan/lib/OfflineJournal/offline_journal.h): header 52 byte + JPEG.
+// aligned (u16 ở byte 6): kiosk đã căn mặt -> Python bỏ bước detect/resize như X-Face-Aligned.
+const JOURNAL_HEADER_LEN = 52;
+const JOURNAL_MAGIC = 0x4C524E4A; // "JNRL"
+const JOURNAL_RECOGNIZE = 1;
+const JOURNAL_ENROLL = 2;
+const INGEST_CONCURRENCY = 4;     // số ảnh gửi Python cùng lúc
+const INGEST_SEEN_MAX = 5000;     // số record đã xử lý được nhớ để bỏ bản gửi lại
+
+// Kiosk mất phản hồi (hết giờ, mất mạng) thì gửi lại cả batch dù server đã xử lý xong:
+// nhớ các record đã "ok" theo (loại, nhân viên, giờ chụp, CRC) để không chấm công /
+// đếm ảnh enroll 2 lần. Map giữ thứ tự chèn -> xoá phần tử cũ nhất khi đầy.
+const ingestSeen = new Map();
+const ingestKey = (r) => `${r.type}:${r.employee_id}:${r.timestamp}:${r.crc}`;
+const markIngested = (r) => {
+    ingestSeen.set(ingestKey(r), Date.now());
+    if (ingestSeen.size > INGEST_SEEN_MAX) ingestSeen.delete(ingestSeen.keys().next().value);
+};
+
+const CRC32_TABLE = (() => {
+    const table = new Uint32Array(256);
+    for (let n = 0; n < 256; n++) {
+        let c = n;
+        for (let k = 0; k < 8; k++) c = (c & 1) ? (0xEDB88320 ^ (c >>> 1)) : (c >>> 1);
+        table[n] = c >>> 0;
+    }
+    return table;
+})();
+
+const crc32 = (buffers) => {
+    let crc = 0xFFFFFFFF;
+    for (const buf of buffers) {
+        for (let i = 0; i < buf.length; i++) crc = CRC32_TABLE[(crc ^ buf[i]) & 0xFF] ^ (crc >>> 8);
+    }
+    return (crc ^ 0xFFFFFFFF) >>> 0;
+};
+
+// Tách các record; null nếu body không đúng định dạng
+const parseJournalRecords = (buf) => {
+    const records = [];
+    let off = 0;
+    while (off < buf.length) {
+        if (off + JOURNAL_HEADER_LEN > buf.length || buf.readUInt32LE(off) !== JOURNAL_MAGIC) return null;
+        const length = buf.readUInt32LE(off + 44);
+        const end = off + JOURNAL_HEADER_LEN + length;
+        if (end > buf.length) return null;
+        const header = buf.subarray(off, off + JOURNAL_HEADER_LEN);
+        const image = buf.subarray(off + JOURNAL_HEADER_LEN, end);
+        const crc = buf.readUInt32LE(off + 48);
+        records.push({
+            type: buf.readUInt8(off + 4),
+            aligned: buf.readUInt16LE(off + 6) > 0,
+            timestamp: buf.readUInt32LE(off + 8),
+            employee_id: buf.toString('utf8', off + 12, off + 44).split('\0')[0],
+            image,
+            crc,
+            crcOk: crc32([header.subarray(0, 48), image]) === crc
+        });
+        off = end;
+    }
+    return records;
+};
+
+// Timestamp của kiosk là giờ đồng hồ RTC (giờ địa phương) tính như UTC ->
+// đổi lại thành chuỗi không múi giờ để Date hiểu là giờ địa phương, giống timestamp ISO cũ
+const journalTime = (ts) => new Date(new Date(ts * 1000).toISOString().slice(0, 19));
+
+// Trả về trạng thái từng record theo đúng thứ tự gửi:
+//   "ok"     : đã xử lý xong (kể cả khi không nhận ra ai) -> kiosk xoá khỏi journal
+//   "reject" : hỏng/không hợp lệ, gửi lại cũng vô ích -> kiosk bỏ
+//   "retry"  : chưa xử lý (Python/DB lỗi) -> kiosk gửi lại từ record này
+export const ingestBatch = async (req, res) => {
+    const timerLabel = `⏱️ Ingest batch [${Date.now()}]`;
+    console.time(timerLabel);
+    const records = Buffer.isBuffer(req.body) ? parseJournalRecords(req.body) : null;
+    if (!records) {
+        console.timeEnd(timerLabel);
+        return res.status(400).json({ error: "Invalid journal batch" });
+    }
+
+    // 0. Record đã xử lý ở lần gửi trước -> trả "ok" luôn, không xử lý lại
+    const duplicate = records.map((r) => r.crcOk && ingestSeen.has(ingestKey(r)));
+
+    // 1. Trích vector song song (chỉ ảnh nhận diện), giữ thứ tự theo chỉ số
+    const vectors = new Array(records.length).fill(null);
+    let next = 0;
+    const worker = async () => {
+        while (next < records.length) {
+            const i = next++;
+            const r = records[i];
+            if (!r.crcOk || duplicate[i] || r.type !== JOURNAL_RECOGNIZE) continue;
+            try {
+                vectors[i] = await extractVector([r.image], r.aligned);
+            } catch (error) {
+                console.error(`❌ Python lỗi ở record ${i}:`, error.message);
+            }
+        }
+    };
+    await Promise.all(Array.from({ length: INGEST_CONCURRENCY }, worker));
+
+    // 2. Ghi log tuần tự theo thứ tự chụp; lỗi đầu tiên -> phần còn lại để kiosk gửi lại
+    const results = new Array(records.length).fill("retry");
+    for (let i = 0; i < records.length; i++) {
+        const r = records[i];
+        if (!r.crcOk) {
+            console.log(`⚠️ Record ${i} sai CRC -> bỏ`);
+            results[i] = "reject";
+            continue;
+        }
+        if (duplicate[i]) {
+            console.log(`♻️ Record ${i} đã xử lý ở lần gửi trước -> bỏ qua`);
+            results[i] = "ok";
+            continue;
+        }
+        try {
+            if (r.type === JOURNAL_RECOGNIZE) {
+                if (!vectors[i]) break;
+                const result = await matchAndLog(vectors[i], [r.image], journalTime(r.timestamp));
+                if (r.employee_id) {
+                    console.log(`📱 Kiosk nhận diện offline: ${r.employee_id} | Server: ${result.name}`);
+                }
+            } else if (r.type === JOURNAL_ENROLL) {
+                await processEnrollImage(r.image, r.employee_id, r.aligned);
+            } else {
+                results[i] = "reject";
+                continue;
+            }
+            markIngested(r);
+            results[i] = "ok";
+        } catch (error) {
+            console.error(`❌ Lỗi xử lý record ${i}:`, error.message);
+            break;
+        }
+    }
+
+    const okCount = results.filter(s => s === "ok").length;
+    console.log(`📦 Ingest ${records.length} record (${req.body.length} bytes): ${okCount} ok`);
+    console.timeEnd(timerLabel);
+    return res.json({ results });
+};
+
+// --- NHẬN ẢNH QUA WEBSOCKET ---
+// Kiosk gửi mỗi lượt 1 message nhị phân trên /ws thay cho 1 HTTP POST (doan/lib/UplinkFrame):
+//   "UPLK" | version u8 | type u8 | count u8 | flags u8 | request_id u32 | timestamp u32 (như journal)
+//   | aligned u16 | reserved u16 | employee_id char[32] | length u32 x count | các JPEG nối liền
+// Phản hồi: "UPRS" | request_id u32 | JSON giống phản hồi HTTP. Các message được xử lý song song,
+// kiosk ghép kết quả theo request_id.
+const UPLINK_MAGIC = 0x4B4C5055;          // "UPLK"
+const UPLINK_REPLY_MAGIC = 0x53525055;    // "UPRS"
+export const UPLINK_VERSION = 1;
+const UPLINK_FIXED_LEN = 52;
+const UPLINK_RECOGNIZE = 1;
+const UPLINK_ENROLL = 2;
+
+// null nếu message không đúng định dạng
+const parseUplinkFrame = (buf) => {
+    if (buf.length < UPLINK_FIXED_LEN || buf[4] !== UPLINK_VERSION) return null;
+    const count = buf[6];
+    let off = UPLINK_FIXED_LEN + 4 * count;
+    if (count === 0 || off > buf.length) return null;
+    const images = [];
+    for (let i = 0; i < count; i++) {
+        const len = buf.readUInt32LE(UPLINK_FIXED_LEN + 4 * i);
+        if (off + len > buf.length) return null;
+        images.push(buf.subarray(off, off + len));
+        off += len;
+    }
+    if (off !== buf.length) return null;
+    return {
+        type: buf[5],
+        timestamp: buf.readUInt32LE(12),
+        aligned: buf.readUInt16LE(16) > 0,
+        employee_id: buf.toString('utf8', 20, 52).split('\0')[0],
+        images
+    };
+};
+
+// code: status tương đương HTTP của cùng request, kiosk dựa vào đó để lưu offline khi >= 400
+// (như đường HTTP) thay vì coi {error} là kết quả
+const uplinkReply = (requestId, body, code = 200) => {
+    const head = Buffer.alloc(8);
+    head.writeUInt32LE(UPLINK_REPLY_MAGIC, 0);
+    head.writeUInt32LE(requestId >>> 0, 4);
+    return Buffer.concat([head, Buffer.from(JSON.stringify({ ...body, code }))]);
+};
+
+// Xử lý 1 message nhị phân từ kiosk -> Buffer phản hồi, null nếu không phải khung uplink
+export const handleUplinkFrame = async (buf) => {
+    if (buf.length < 12 || buf.readUInt32LE(0) !== UPLINK_MAGIC) return null;
+    const requestId = buf.readUInt32LE(8);
+    const frame = parseUplinkFrame(buf);
+    if (!frame) return uplinkReply(requestId, { error: "Invalid uplink frame" }, 400);
+
+    const timerLabel = `⏱️ WS uplink #${requestId} [${Date.now()}]`;
+    console.time(timerLabel);
+    try {
+        if (frame.type === UPLINK_RECOGNIZE) {
+            console.log(`📥 [WS] Nhận ${frame.images.length} ảnh #${requestId}${frame.aligned ? ' (đã căn mặt)' : ''}`);
+            return uplinkReply(requestId, await identifyAndLog(frame.images, journalTime(frame.timestamp), frame.aligned));
+        }
+        if (frame.type === UPLINK_ENROLL) {
+            return uplinkReply(requestId, await processEnrollImage(frame.images[0], frame.employee_id, frame.aligned));
+        }
+        return uplinkReply(requestId, { error: "Unknown uplink type" }, 400);
+    } catch (error) {
+        console.error("WS uplink error:", error.message);
+        return uplinkReply(requestId, { error: error.message }, 500);
+    } finally {
+        console.timeEnd(timerLabel);
+    }
+};
+
+// --- GALLERY OFFLINE CHO KIOSK ---
+const GALLERY_ID_LEN = 16;
+const GALLERY_NAME_LEN = 32;
+const GALLERY_FLAG_FULL = 0x01;
+const GALLERY_OP_UPSERT = 1;
+const GALLERY_OP_REMOVE = 2;
+
+// Chuẩn hoá L2 rồi lượng tử int8 (giống FaceGallery::quantize trên kiosk)
+const quantizeEmbedding = (vec) => {
+    let norm = 0, maxAbs = 0;
+    for (const v of vec) {
+        norm += v * v;
+        maxAbs = Math.max(maxAbs, Math.abs(v));
+    }
+    if (norm <= 0 || maxAbs <= 0) return null;
+    const q = Buffer.alloc(vec.length);
+    for (let i = 0; i < vec.length; i++) {
+        q.writeInt8(Math.max(-127, Math.min(127, Math.round(vec[i] * 127 / maxAbs))), i);
+    }
+    return { scale: maxAbs / Math.sqrt(norm) / 127, q };
+};
+
+// Chuỗi UTF-8 cố định len byte, luôn còn byte 0 kết thúc (không cắt giữa ký tự)
+const fixedString = (str, len) => {
+    const buf = Buffer.alloc(len);
+    buf.write(String(str || ''), 0, len - 1, 'utf8');
+    return buf;
+};
+
+// GET /api/ai/gallery?since=<version>&dim=512
+// Trả gói nhị phân delta (định dạng trong doan/lib/FaceGallery/face_gallery.h):
+// các nhân viên thay đổi từ version "since" (updatedAt, ms). since=0 -> gói FULL.
+// Nhân viên bị xoá hẳn không xuất hiện trong delta; kiosk thấy total lệch thì xin lại FULL.
+export const getGallery = async (req, res) => {
+    try {
+        const since = Number(req.query.since) || 0;
+        const dim = Number(req.query.dim) || 512;
+        const full = since === 0;
+
+        const filter = full ? { is_enrolled: true } : { updatedAt: { $gte: new Date(since) } };
+        const users = await User.find(filter).select('employee_id name is_enrolled device_vector updatedAt');
+        const total = await User.countDocuments({ is_enrolled: true, [`device_vector.${dim - 1}`]: { $exists: true } });
+
+        let version = since;
+        let nrec = 0;
+        const records = [];
+        for (const user of users) {
+            version = Math.max(version, user.updatedAt.getTime());
+            const vec = user.device_vector || [];
+            const head = Buffer.concat([
+                Buffer.alloc(1),
+                fixedString(user.employee_id, GALLERY_ID_LEN),
+                fixedString(user.name, GALLERY_NAME_LEN)
+            ]);
+            const quant = (user.is_enrolled && vec.length === dim) ? quantizeEmbedding(vec) : null;
+            if (quant) {
+                head.writeUInt8(GALLERY_OP_UPSERT, 0);
+                const scale = Buffer.alloc(4);
+                scale.writeFloatLE(quant.scale, 0);
+                records.push(head, scale, quant.q);
+                nrec++;
+            } else if (!full) {
+                head.writeUInt8(GALLERY_OP_REMOVE, 0);
+                records.push(head);
+                nrec++;
+            }
+        }
+
+        const header = Buffer.alloc(23);
+        header.write('FGD1', 0, 'ascii');
+        header.writeUInt8(full ? GALLERY_FLAG_FULL : 0, 4);
+        header.writeUInt16LE(dim, 5);
+        header.writeUInt32LE(total, 7);
+        header.writeBigUInt64LE(BigInt(version), 11);
+        header.writeUInt32LE(nrec, 19);
+
+        const body = Buffer.concat([header, ...records]);
+        console.log(`🗂️ Gallery ${full ? 'FULL' : 'delta'} since=${since}: ${nrec} bản ghi, ${body.length} bytes`);
+        res.set('Content-Type', 'application/octet-stream');
+        return res.send(body);
+    } catch (error) {
+        console.error("❌ Lỗi tạo gallery:", error.message);
+        if (!res.headersSent) res.status(500).json({ error: error.message });
+    }
+};
+
+// POST /api/ai/device_embedding { employee_id, embedding: [512 số] }
+// Kiosk gửi embedding trung bình các bước enroll do model trên thiết bị tính
+export const saveDeviceEmbedding = async (req, res) => {
+    try {
+        const { employee_id, embedding } = req.body || {};
+        if (!employee_id || !Array.isArray(embedding) || embedding.length === 0) {
+            return res.status(400).json({ success: false, message: "Thiếu employee_id hoặc embedding" });
+        }
+        const user = await User.findOne({ employee_id });
+        if (!user) return res.status(404).json({ success: false, message: "Nhân viên không tồn tại" });
+
+        user.device_vector = embedding.map(Number);
+        await user.save();
+        console.log(`🧬 Đã lưu embedding kiosk cho ${user.name} (${embedding.length} chiều)`);
+        return res.json({ success: true });
+    } catch (error) {
+        if (!res.headersSent) res.status(500).json({ success: false });
+    }
+};
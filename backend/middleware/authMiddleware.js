@@ -1,4 +1,5 @@
 import jwt from 'jsonwebtoken';
+import crypto from 'crypto';
 import User from '../models/User.js';
 
 const protect = async (req, res, next) =>{
@@ -43,4 +44,25 @@ const authorize = (...roles) => {
     };
 };
 
-export { protect, authorize };
+// Kiosk (ESP32) không có tài khoản đăng nhập: xác thực bằng khoá chung DEVICE_KEY (.env)
+// gửi trong header X-Device-Key. Server chưa cấu hình DEVICE_KEY thì từ chối tất cả.
+const deviceAuth = (req, res, next) => {
+    const expected = process.env.DEVICE_KEY;
+    if (!expected) {
+        return res.status(503).json({
+            success: false,
+            message: "Server chưa cấu hình DEVICE_KEY"
+        });
+    }
+    const key = Buffer.from(req.get('X-Device-Key') || '');
+    const want = Buffer.from(expected);
+    if (key.length !== want.length || !crypto.timingSafeEqual(key, want)) {
+        return res.status(401).json({
+            success: false,
+            message: "Khoá thiết bị không hợp lệ"
+        });
+    }
+    next();
+};
+
+export { protect, authorize, deviceAuth };
@@ -23,7 +23,9 @@ const userSchema = new mongoose.Schema({
 
 
   is_enrolled: { type: Boolean, default: false },
-  face_vector: { type: [FaceVectorSchema], default: [] }
+  face_vector: { type: [FaceVectorSchema], default: [] },
+  // Embedding do model trên kiosk (esp-dl) tính lúc enroll -> đồng bộ xuống gallery offline của kiosk
+  device_vector: { type: [Number], default: [] }
 }, {timestamps: true});
 
 
@@ -1,14 +1,38 @@
 import express from "express";
 // Chú ý: Đảm bảo tên file controller trùng khớp với file bạn đang có (ai_Controller.js hay ai_controller.js)
-import { recognizeFace, enrollFace } from "../controllers/ai_Controller.js"; 
+import { recognizeFace, recognizeBatch, enrollFace, ingestBatch, getGallery, saveDeviceEmbedding } from "../controllers/ai_Controller.js"; 
+import { deviceAuth } from "../middleware/authMiddleware.js";
 
 const router = express.Router();
 
+// Thiết bị có thể gửi JPEG thô (Content-Type: image/jpeg), metadata nằm trong header X-*;
+// batch burst gửi dạng application/octet-stream (nhiều JPEG nối liền)
+router.use(express.raw({ type: ['image/jpeg', 'application/octet-stream'], limit: '10mb' }));
+
+// Báo cho ESP32 biết server nhận được JPEG nhị phân -> thiết bị tự bỏ base64
+router.use((req, res, next) => {
+    res.set('X-Image-Upload', 'jpeg');
+    next();
+});
+
 // Định nghĩa đường dẫn
 // ESP32 gọi: /api/ai/recognize -> chạy hàm recognizeFace
 router.post("/recognize", recognizeFace);
 
+// ESP32 gọi: /api/ai/recognize_batch -> cả burst trong 1 request, trả kết quả ngay
+router.post("/recognize_batch", recognizeBatch);
+
 // ESP32 gọi: /api/ai/enroll -> chạy hàm enrollFace
 router.post("/enroll", enrollFace);
 
-export default router;
\ No newline at end of file
+// ESP32 gọi: /api/ai/ingest_batch -> đồng bộ nhiều bản ghi offline (record journal thô) trong 1 request
+router.post("/ingest_batch", ingestBatch);
+
+// ESP32 gọi: /api/ai/gallery?since=<version> -> delta gallery embedding cho nhận diện offline
+// (embedding của mọi nhân viên -> chỉ kiosk có khoá X-Device-Key)
+router.get("/gallery", deviceAuth, getGallery);
+
+// ESP32 gọi: /api/ai/device_embedding -> lưu embedding do model trên kiosk tính lúc enroll
+router.post("/device_embedding", deviceAuth, saveDeviceEmbedding);
+
+export default router;
@@ -10,6 +10,7 @@ import http from 'http';
 import { WebSocketServer, WebSocket } from 'ws'; 
 import jwt from 'jsonwebtoken';
 import aiRoutes from './routes/ai.routes.js';
+import { handleUplinkFrame, resetEnrollSession, UPLINK_VERSION } from './controllers/ai_Controller.js';
 
 //Cấu hình
 const app = express();
@@ -93,8 +94,16 @@ wss.on('connection', (ws, req) => {
 
     ws.on('pong', () => { ws.isAlive = true; });
 
-    ws.on('message', (message) => {
+    ws.on('message', (message, isBinary) => {
         ws.isAlive = true;
+        // Ảnh chấm công / enroll từ kiosk (khung nhị phân, xem handleUplinkFrame)
+        if (isBinary) {
+            if (ws.role !== 'device') return;
+            handleUplinkFrame(message).then((reply) => {
+                if (reply && ws.readyState === WebSocket.OPEN) ws.send(reply);
+            });
+            return;
+        }
         try {
             const raw = message.toString();
             const txt = raw.trim();
@@ -151,6 +160,8 @@ wss.on('connection', (ws, req) => {
                 ws.role = 'device';
                 devices.add(ws);
                 broadcastDeviceStatus();
+                // Báo kiosk gửi ảnh qua chính kết nối này thay cho HTTP POST
+                ws.send(JSON.stringify({ type: 'uplink', version: UPLINK_VERSION }));
                 return;
             }
        
@@ -167,8 +178,8 @@ wss.on('connection', (ws, req) => {
                 if (txt.startsWith('{')) {
                     try {
                         const jsonData = JSON.parse(txt);
-                        // Nếu là lệnh config_time -> Gửi cho Device
-                        if (jsonData.type === 'config_time') {
+                        // Lệnh cấu hình -> Gửi cho Device
+                        if (jsonData.type === 'config_time' || jsonData.type === 'config_liveness') {
                             console.log(`WS: JSON Config from ${ws.role} -> forwarding to devices`);
                             devices.forEach(d => {
                                 if (d.readyState === WebSocket.OPEN) d.send(txt);
@@ -177,6 +188,13 @@ wss.on('connection', (ws, req) => {
                             ws.send(JSON.stringify({ type: 'config_success' }));
                             return; 
                         }
+                        // Xin số liệu đo đạc; Device trả {"type":"metrics",...} và được forward lại ở mục 5
+                        if (jsonData.type === 'get_metrics') {
+                            devices.forEach(d => {
+                                if (d.readyState === WebSocket.OPEN) d.send(txt);
+                            });
+                            return;
+                        }
                     } catch (err) {
                         console.log("WS: Received invalid JSON from admin, treating as text");
                     }
@@ -186,6 +204,8 @@ wss.on('connection', (ws, req) => {
                 // [CŨ] Xử lý lệnh Text (Enroll, Delete, Restart)
                 if (txt.startsWith('enroll:') || txt === 'restart') {
                     console.log(`WS: Command '${txt}' from ${ws.role} -> forwarding to devices`);
+                    // Enroll mới: bỏ ảnh còn sót của phiên trước
+                    if (txt.startsWith('enroll:')) resetEnrollSession(txt.substring(7));
                     devices.forEach(d => {
                         if (d.readyState === WebSocket.OPEN) d.send(txt);
                     });
@@ -195,6 +215,11 @@ wss.on('connection', (ws, req) => {
 
             // 5. Tin nhắn từ Device gửi lên (Forward cho Admin/Manager xem)
             if (ws.role === 'device') {
+                // Kiosk chụp lại cả bộ ảnh enroll -> phiên gom ảnh bắt đầu lại từ 0
+                if (txt.startsWith('enroll_reset:')) {
+                    resetEnrollSession(txt.substring(13));
+                    return;
+                }
                 activeConnections.forEach((conWs) => {
                     // Gửi cho cả Manager và Admin
                     if ((conWs.role === 'manager' || conWs.role === 'admin') && conWs.readyState === WebSocket.OPEN) {
@@ -235,6 +260,10 @@ setInterval(() => {
     });
 }, 30000);
 
+// Giữ kết nối keep-alive lâu hơn mặc định (5s) để kiosk dùng lại socket giữa các lượt chấm công
+server.keepAliveTimeout = 65000;
+server.headersTimeout = 66000;
+
 server.listen(PORT, '0.0.0.0', ()=>{
     console.log(`Server running on port ${PORT}`);
 });
\ No newline at end of file
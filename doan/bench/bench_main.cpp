@@ -0,0 +1,1052 @@
+// Benchmark phát lại frame trên máy tính (env:native trong platformio.ini): chạy cùng chuỗi
+// xử lý như CameraAppTask trên kiosk
+//   capture -> detect/track -> liveness -> chấm điểm burst -> cắt + nén JPEG -> upload / journal SD
+// bằng đúng các thư viện trong lib/, phần cứng thay bằng shim (camera đọc frame RGB565 ghi lại,
+// SD là thư mục máy tính, TFT dump PPM, HTTP tới server thật hoặc bench/mock_server.mjs).
+// In độ trễ từng tầng + thông lượng; so với baseline JSON để bắt hồi quy trước khi nạp kiosk.
+//
+//   pio run -e native
+//   .pio/build/native/program                               # 300 frame mặt tổng hợp, không mạng
+//   .pio/build/native/program --frames rec/ --server 127.0.0.1:3100 --json now.json --baseline base.json
+//   .pio/build/native/program --kernels                     # đo các kernel (dot/SSD/Laplacian/JPEG...)
+//   .pio/build/native/program --uplink 200 --server 127.0.0.1:3100   # gửi ảnh: JPEG thô vs base64 JSON, HTTP POST vs WebSocket
+//   .pio/build/native/program --sync 2000 --server 127.0.0.1:3100     # đổ journal offline lên /ingest_batch
+//
+// Detector ESP-DL không chạy được trên máy tính: kết quả detect lấy từ faces.csv (hoặc toạ độ
+// mặt tổng hợp), --detect-us thêm thời gian chờ bận để mô phỏng chi phí detector của kiosk.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include <thread>
+
+#include "shim_camera.h"
+#include "shim_clock.h"
+#include "shim_http.h"
+#include "shim_ws.h"
+#include "shim_tft.h"
+#include "bench_stats.h"
+
+#include "face_tracker.h"
+#include "liveness.h"
+#include "motion_gate.h"
+#include "head_pose.h"
+#include "buffer_pool.h"
+#include "frame_quality.h"
+#include "roi_jpeg.h"
+#include "link_control.h"
+#include "offline_journal.h"
+#include "face_gallery.h"
+#include "vec_kernels.h"
+#include "async_log.h"
+#include "server_reply.h"
+#include "uplink_frame.h"
+
+// Giống main.cpp
+#define BURST_FRAMES        3
+#define BURST_CANDIDATES    5
+#define BURST_MIN_QUALITY   0.3f
+#define FACE_PAD            30
+#define FACE_MIN_WIDTH      55
+#define FACE_MAX_WIDTH      110
+#define LINK_QUALITY_MIN    60
+#define LINK_QUALITY_MAX    90
+#define LINK_CROP_MIN       112
+#define WS_UPLINK_INFLIGHT  4
+#define SYNC_BATCH_RECORDS  8
+#define SYNC_BATCH_BYTES    (256 * 1024)
+#define CAPTURE_IDLE_PERIOD_MS 200
+#define BENCH_CAMERA_FPS    25           // đồng hồ ảo của cổng chuyển động khi không có --fps
+
+struct BenchOptions {
+    const char* framesDir = nullptr;
+    uint16_t width = 240, height = 240;
+    uint32_t synthetic = 300;
+    uint32_t empty = 0;                  // số frame tổng hợp không có ai, đặt trước chuỗi có mặt
+    const char* server = nullptr;        // "host:port"
+    const char* sdDir = "bench_sd";
+    const char* dumpDir = nullptr;
+    uint32_t dumpEvery = 10;
+    uint32_t detectUs = 0;
+    uint32_t fps = 0;                    // 0 = chạy nhanh nhất có thể
+    uint16_t align = 0;                  // FACE_CROP_SIZE
+    uint32_t cooldown = 15;              // frame nghỉ giữa 2 lượt chấm công
+    const char* jsonPath = nullptr;
+    const char* baselinePath = nullptr;
+    float tolerance = 0.2f;
+    bool kernels = false;
+    uint32_t uplink = 0;                 // > 0: chỉ so đường gửi ảnh HTTP / WebSocket, số request
+    uint32_t uplinkBytes = 8000;         // cỡ mỗi ảnh giả
+    uint32_t sync = 0;                   // > 0: ghi N record vào journal rồi đồng bộ qua /ingest_batch
+};
+
+struct Burst {
+    bool active;
+    uint64_t startedAt;                  // us
+    uint8_t candidates, frames, target, quality;
+    uint16_t cropSize;
+    uint16_t aligned;
+    float score[BURST_FRAMES];
+    uint8_t seq[BURST_FRAMES];           // thứ tự chụp, gửi theo thứ tự này như sortBurstByCapture()
+    std::vector<uint8_t> jpg[BURST_FRAMES];
+};
+
+struct BenchCounters {
+    uint32_t frames, detects, faces;
+    uint32_t bursts, sent, offline, dropped, httpErrors;
+    uint32_t matched, badReplies;
+    uint32_t idleFrames, idleSkipped;    // chế độ chờ: frame chỉ so chuyển động / camera không lấy
+    int64_t firstFace, wokeAt;           // frame đầu tiên có mặt, frame vào ACTIVE đầu tiên sau đó
+    uint64_t jpegBytes;
+    uint32_t jpegs;
+};
+
+static bool jpegToVector(void* ctx, const uint8_t* data, size_t len) {
+    std::vector<uint8_t>* v = (std::vector<uint8_t>*)ctx;
+    v->insert(v->end(), data, data + len);
+    return true;
+}
+
+// Như cropFaceFromRGB565(): căn mặt theo 2 mắt nếu cropSize > 0, không thì cắt khung mặt + PAD
+static bool encodeFace(const Rgb565Frame& frame, const BenchFace& f, uint8_t quality, uint16_t cropSize,
+                       std::vector<uint8_t>& out, uint16_t& aligned) {
+    out.clear();
+    aligned = 0;
+    if (cropSize) {
+        bool swap = f.lm.leftEyeX > f.lm.rightEyeX;
+        FaceEyes eyes = {
+            swap ? f.lm.rightEyeX : f.lm.leftEyeX, swap ? f.lm.rightEyeY : f.lm.leftEyeY,
+            swap ? f.lm.leftEyeX : f.lm.rightEyeX, swap ? f.lm.leftEyeY : f.lm.rightEyeY
+        };
+        if (jpegEncodeAligned(frame, eyes, cropSize, quality, jpegToVector, &out)) {
+            aligned = cropSize;
+            return true;
+        }
+        out.clear();
+    }
+    return jpegEncodeRoi(frame, f.box.x - FACE_PAD, f.box.y - FACE_PAD, f.box.w + FACE_PAD * 2,
+                         f.box.h + FACE_PAD * 2, quality, jpegToVector, &out);
+}
+
+static bool parseArgs(int argc, char** argv, BenchOptions& o) {
+    for (int i = 1; i < argc; i++) {
+        const char* a = argv[i];
+        const char* v = (i + 1 < argc) ? argv[i + 1] : nullptr;
+        bool used = true;
+        if (!strcmp(a, "--kernels")) { o.kernels = true; continue; }
+        if (!v) return false;
+        if (!strcmp(a, "--frames")) o.framesDir = v;
+        else if (!strcmp(a, "--size")) { if (sscanf(v, "%hux%hu", &o.width, &o.height) != 2) return false; }
+        else if (!strcmp(a, "--synthetic")) o.synthetic = atoi(v);
+        else if (!strcmp(a, "--empty")) o.empty = atoi(v);
+        else if (!strcmp(a, "--server")) o.server = v;
+        else if (!strcmp(a, "--sd")) o.sdDir = v;
+        else if (!strcmp(a, "--dump")) o.dumpDir = v;
+        else if (!strcmp(a, "--dump-every")) o.dumpEvery = atoi(v);
+        else if (!strcmp(a, "--detect-us")) o.detectUs = atoi(v);
+        else if (!strcmp(a, "--fps")) o.fps = atoi(v);
+        else if (!strcmp(a, "--align")) o.align = atoi(v);
+        else if (!strcmp(a, "--cooldown")) o.cooldown = atoi(v);
+        else if (!strcmp(a, "--json")) o.jsonPath = v;
+        else if (!strcmp(a, "--baseline")) o.baselinePath = v;
+        else if (!strcmp(a, "--tolerance")) o.tolerance = atof(v);
+        else if (!strcmp(a, "--uplink")) o.uplink = atoi(v);
+        else if (!strcmp(a, "--uplink-bytes")) o.uplinkBytes = atoi(v);
+        else if (!strcmp(a, "--sync")) o.sync = atoi(v);
+        else used = false;
+        if (!used) return false;
+        i++;
+    }
+    return true;
+}
+
+static void usage() {
+    fprintf(stderr,
+            "Dùng: program [--frames DIR --size 240x240 | --synthetic N] [--server HOST:PORT] [--sd DIR]\n"
+            "               [--dump DIR --dump-every N] [--detect-us US] [--fps N] [--align 112] [--cooldown N]\n"
+            "               [--json FILE] [--baseline FILE --tolerance 0.2]\n"
+            "       program --kernels [--json FILE] [--baseline FILE]\n"
+            "       program --uplink N --server HOST:PORT [--uplink-bytes 8000]\n"
+            "       program --sync N --server HOST:PORT [--uplink-bytes 8000]\n");
+}
+
+// ---------------------------------------------------------------------------
+// Kernel: đo riêng từng hàm nặng với dữ liệu cố định
+// ---------------------------------------------------------------------------
+template <typename F>
+static double nsPerCall(F fn, uint32_t iters) {
+    uint64_t t0 = hostMicros64();
+    for (uint32_t i = 0; i < iters; i++) fn();
+    return (hostMicros64() - t0) * 1000.0 / iters;
+}
+
+// Landmark cho head_pose: mô hình mặt 3D (mm, gốc giữa 2 mắt, z hướng về camera) xoay yaw /
+// pitch / roll đã biết rồi chiếu phối cảnh, khoảng cách 2 mắt ~40 px như mặt rộng ~80 px trên
+// kiosk, lệch ngẫu nhiên dưới 1 px rồi làm tròn như toạ độ nguyên của detector.
+static PoseLandmarks projectPose(float yawDeg, float pitchDeg, float rollDeg, bool mirrored, uint32_t& seed) {
+    static const float model[5][3] = {{-31, 0, 0}, {31, 0, 0}, {0, 38, 28}, {-25, 72, 8}, {25, 72, 8}};
+    const float k = 3.14159265f / 180;
+    float cy = cosf(yawDeg * k), sy = sinf(yawDeg * k), cp = cosf(pitchDeg * k), sp = sinf(pitchDeg * k);
+    float cr = cosf(rollDeg * k), sr = sinf(rollDeg * k);
+    float out[5][2];
+    for (int i = 0; i < 5; i++) {
+        // Người quay sang trái của họ = bên phải ảnh (x tăng); ngẩng lên = mũi đi lên (y giảm)
+        float x = model[i][0], y = model[i][1] - 36, z = model[i][2];
+        float x1 = x * cy + z * sy, z1 = -x * sy + z * cy;
+        float y2 = y * cp - z1 * sp, z2 = y * sp + z1 * cp;
+        float x3 = x1 * cr - y2 * sr, y3 = x1 * sr + y2 * cr;
+        float s = 600.0f / (600 - z2) * 0.65f;
+        seed = seed * 1664525u + 1013904223u;
+        float jx = ((seed >> 16) & 255) / 256.0f - 0.5f, jy = ((seed >> 24) & 255) / 256.0f - 0.5f;
+        out[i][0] = roundf(120 + (mirrored ? -x3 : x3) * s + jx);
+        out[i][1] = roundf(110 + y3 * s + jy);
+    }
+    return {out[0][0], out[0][1], out[1][0], out[1][1], out[2][0], out[2][1],
+            out[3][0], out[3][1], out[4][0], out[4][1]};
+}
+
+// Xoá thư mục journal tạm (chỉ có file, không có thư mục con)
+static void removeDir(const char* dir) {
+    DIR* d = opendir(dir);
+    if (d) {
+        char path[300];
+        struct dirent* e;
+        while ((e = readdir(d)) != nullptr) {
+            if (e->d_name[0] == '.') continue;
+            snprintf(path, sizeof(path), "%s/%s", dir, e->d_name);
+            ::remove(path);
+        }
+        closedir(d);
+    }
+    rmdir(dir);
+}
+
+// Cắt + nén theo cỡ mặt trong khoảng enroll / nhận diện chấp nhận (FACE_MIN_WIDTH..FACE_MAX_WIDTH):
+// mặt tổng hợp rộng ~0.38 khung nên khung được chọn theo cỡ mặt cần đo.
+static void printCropByWidth() {
+    printf("\n%-8s %12s %10s %12s %10s\n", "mặt px", "roi ns", "roi byte", "112 ns", "112 byte");
+    for (int w = FACE_MIN_WIDTH; w <= FACE_MAX_WIDTH; w += 11) {
+        uint16_t side = (uint16_t)ceilf(w / 0.38f);
+        FrameSource src;
+        src.openSynthetic(1, side, side);
+        Rgb565Frame frame;
+        BenchFace face;
+        src.next(frame);
+        src.faces(&face, 1);
+        std::vector<uint8_t> jpg;
+        uint16_t aligned;
+        double roiNs = nsPerCall([&] { encodeFace(frame, face, 90, 0, jpg, aligned); }, 300);
+        size_t roiBytes = jpg.size();
+        double alignNs = nsPerCall([&] { encodeFace(frame, face, 90, 112, jpg, aligned); }, 300);
+        printf("%-7d %12.0f %10zu %12.0f %10zu\n", face.box.w, roiNs, roiBytes, alignNs, jpg.size());
+    }
+}
+
+static int runKernels(const BenchOptions& o) {
+    alignas(VK_ALIGN) static int8_t a8[512], b8[512];
+    alignas(VK_ALIGN) static int16_t a16[QUALITY_GRID], b16[QUALITY_GRID];
+    uint32_t seed = 12345;
+    auto rnd = [&]() { seed = seed * 1664525u + 1013904223u; return seed >> 16; };
+    for (int i = 0; i < 512; i++) { a8[i] = (int8_t)rnd(); b8[i] = (int8_t)rnd(); }
+    for (int i = 0; i < QUALITY_GRID; i++) { a16[i] = (int16_t)(rnd() % 2041) - 1020; b16[i] = (int16_t)(rnd() % 2041) - 1020; }
+
+    int mismatches = 0;
+    if (vk_dot_s8(a8, b8, 512) != vk_dot_s8_scalar(a8, b8, 512)) mismatches++;
+    if (vk_dot_s16(a16, b16, QUALITY_GRID) != vk_dot_s16_scalar(a16, b16, QUALITY_GRID)) mismatches++;
+    int32_t aa8 = vk_dot_s8_scalar(a8, a8, 480), bb8 = vk_dot_s8_scalar(b8, b8, 480);
+    if (vk_ssd_s8(a8, b8, 480) != vk_ssd_s8_norms(a8, aa8, b8, bb8, 480)) mismatches++;
+
+
+    FrameSource src;
+    src.openSynthetic(2, o.width, o.height);
+    Rgb565Frame f0, f1;
+    src.next(f0);
+    std::vector<uint8_t> frame0(f0.buf, f0.buf + (size_t)f0.width * f0.height * 2);
+    f0.buf = frame0.data();
+    src.next(f1);
+    BenchFace face;
+    src.faces(&face, 1);
+
+    static uint8_t luma[QUALITY_GRID * QUALITY_GRID];
+    for (size_t i = 0; i < sizeof(luma); i++) luma[i] = (uint8_t)rnd();
+
+    // Gallery cỡ nhỏ / như kiosk (GALLERY_CAPACITY) / công ty lớn: match quét tuyến tính
+    struct GallerySize { uint32_t people; uint32_t iters; const char* name; };
+    static const GallerySize gallerySizes[] = {
+        {500, 400, "gallery.match/500x512"},
+        {2000, 100, "gallery.match/2000x512"},
+        {10000, 20, "gallery.match/10000x512"},
+    };
+    FaceGallery galleries[3];
+    std::vector<float> emb(512);
+    for (int g = 0; g < 3; g++) {
+        galleries[g].begin(512, gallerySizes[g].people);
+        for (uint32_t p = 0; p < gallerySizes[g].people; p++) {
+            for (float& x : emb) x = (int16_t)rnd() / 32768.0f;
+            char id[GALLERY_ID_LEN];
+            snprintf(id, sizeof(id), "NV%05u", p);
+            galleries[g].upsertFloat(id, id, emb.data());
+        }
+    }
+
+    FaceTracker tracker;
+    tracker.correct(f0, &face.box, nullptr, 1);
+    LivenessEngine live;
+    MotionGate gate;
+    uint32_t gateMs = 0;
+    std::vector<uint8_t> jpg;
+    uint16_t aligned;
+    volatile int32_t sink = 0;
+    // Ghi + rút ring (định dạng) sau mỗi 32 dòng: tổng chi phí 1 dòng log, phần trên task
+    // gọi log chỉ là write (xem log ring trong async_log.h)
+    static LogRing logRing;
+    char logLine[LOG_LINE_MAX];
+    uint32_t logCount = 0;
+    std::string logName = "NV0001";
+    // Phản hồi kiểu server thật + trường thừa mà filter phải bỏ qua
+    const std::string replyJson =
+        "{\"debug\":{\"distances\":[0.41,0.52,0.63,0.38],\"model\":\"arcface\"},\"match\":true,"
+        "\"message\":\"Check-in buoi sang\",\"name\":\"Nguyen Van A\",\"employee_id\":\"NV0001\"}";
+    ServerReply reply;
+    uint32_t poseSeed = 99;
+    PoseLandmarks poseLm = projectPose(25, 5, 3, false, poseSeed);
+    PoseConfig poseCfg;
+    // Cấp phát của 1 lượt burst 3 ảnh + khung gửi WS: kiểu cũ (ps_malloc ước lượng, realloc khi
+    // JPEG tràn, malloc khung rồi free hết) so với pool + arena. Chạm 1 byte mỗi 4 KB như khi ghi.
+    BufferPool imgPool, framePool;
+    imgPool.begin(16 * 1024, 24);
+    framePool.begin(3 * 16 * 1024 + 1024, 1);
+    const size_t estimate = 7200, jpegLen = 14400, frameLen = 3 * jpegLen + 64;
+    auto touch = [&](uint8_t* p, size_t n) { for (size_t k = 0; k < n; k += 4096) p[k] = (uint8_t)k; sink += p[0]; };
+
+    struct Row { const char* name; double ns; };
+    std::vector<Row> rows = {
+        {"vk_dot_s8/512", nsPerCall([&] { sink += vk_dot_s8(a8, b8, 512); }, 200000)},
+        {"vk_dot_s8_scalar/512", nsPerCall([&] { sink += vk_dot_s8_scalar(a8, b8, 512); }, 200000)},
+        {"vk_ssd_s8/480", nsPerCall([&] { sink += vk_ssd_s8(a8, b8, 480); }, 200000)},
+        {"vk_ssd_s8_norms/480", nsPerCall([&] { sink += vk_ssd_s8_norms(a8, aa8, b8, bb8, 480); }, 200000)},
+        {"vk_dot_s16/64", nsPerCall([&] { sink += vk_dot_s16(a16, b16, QUALITY_GRID); }, 500000)},
+        {"laplacianVariance/64x64", nsPerCall([&] { sink += (int32_t)laplacianVariance(luma, QUALITY_GRID, QUALITY_GRID); }, 5000)},
+        {"scoreFaceQuality", nsPerCall([&] { sink += (int32_t)(100 * scoreFaceQuality(f1, face.box, &face.lm).score); }, 2000)},
+        {"tracker.correct+track", nsPerCall([&] { tracker.correct(f0, &face.box, nullptr, 1); sink += tracker.track(f1); }, 2000)},
+        {"motionGate.update", nsPerCall([&] { sink += gate.update((gateMs & 40) ? f0 : f1, gateMs += 40); }, 20000)},
+        {"estimateHeadPose+check", nsPerCall([&] { sink += checkPose(estimateHeadPose(poseLm, poseCfg), POSE_LEFT, poseCfg); }, 500000)},
+        {"liveness.update", nsPerCall([&] { sink += (int32_t)live.update(1, f1, face.box, &face.lm).frames; }, 2000)},
+        {"jpegEncodeRoi/Q90", nsPerCall([&] { encodeFace(f1, face, 90, 0, jpg, aligned); }, 300)},
+        {"jpegEncodeAligned/112", nsPerCall([&] { encodeFace(f1, face, 90, 112, jpg, aligned); }, 300)},
+        {"log.write+pop/3 args", nsPerCall([&] {
+             logRing.write(LOG_LEVEL_INFO, logCount, "✅ [REC] %s score %.3f (%lu ms)", logName, 0.873f, 42UL);
+             if (++logCount % 32 == 0) while (logRing.pop(logLine, sizeof(logLine), nullptr, nullptr)) {}
+         }, 200000)},
+        {"decodeServerReply", nsPerCall([&] { sink += decodeServerReply(replyJson, reply); }, 100000)},
+        {"alloc burst/heap", nsPerCall([&] {
+             uint8_t* img[BURST_FRAMES];
+             for (int i = 0; i < BURST_FRAMES; i++) {
+                 img[i] = (uint8_t*)malloc(estimate);
+                 touch(img[i], estimate);
+                 img[i] = (uint8_t*)realloc(img[i], jpegLen);
+                 touch(img[i], jpegLen);
+             }
+             uint8_t* frame = (uint8_t*)malloc(frameLen);
+             touch(frame, frameLen);
+             free(frame);
+             for (int i = 0; i < BURST_FRAMES; i++) free(img[i]);
+         }, 100000)},
+        {"alloc burst/pool", nsPerCall([&] {
+             uint8_t* img[BURST_FRAMES];
+             for (int i = 0; i < BURST_FRAMES; i++) {
+                 img[i] = imgPool.acquire(estimate);
+                 touch(img[i], jpegLen);
+             }
+             {
+                 ScratchArena arena(framePool);
+                 uint8_t* frame = (uint8_t*)arena.alloc(frameLen, 1);
+                 touch(frame, frameLen);
+             }
+             for (int i = 0; i < BURST_FRAMES; i++) imgPool.release(img[i]);
+         }, 100000)},
+    };
+    for (int g = 0; g < 3; g++) {
+        FaceGallery& gallery = galleries[g];
+        rows.push_back({gallerySizes[g].name, nsPerCall([&] { sink += gallery.match(emb.data()).index; }, gallerySizes[g].iters)});
+    }
+    (void)sink;
+
+    printf("%-26s %12s\n", "kernel", "ns/call");
+    for (const Row& r : rows) printf("%-26s %12.0f\n", r.name, r.ns);
+    printCropByWidth();
+    printf("scalar == dispatch: %s\n", mismatches ? "SAI" : "OK");
+
+    if (o.jsonPath) {
+        FILE* f = fopen(o.jsonPath, "w");
+        if (f) {
+            fprintf(f, "{\"kernels\":{");
+            for (size_t i = 0; i < rows.size(); i++) fprintf(f, "%s\"%s\":%.0f", i ? "," : "", rows[i].name, rows[i].ns);
+            fprintf(f, "}}\n");
+            fclose(f);
+        }
+    }
+    int regressions = 0;
+    if (o.baselinePath) {
+        FILE* f = fopen(o.baselinePath, "r");
+        if (!f) {
+            fprintf(stderr, "❌ Không đọc được baseline %s\n", o.baselinePath);
+            return 2;
+        }
+        std::string json;
+        char buf[512];
+        size_t n;
+        while ((n = fread(buf, 1, sizeof(buf), f)) > 0) json.append(buf, n);
+        fclose(f);
+        for (const Row& r : rows) {
+            std::string key = std::string("\"") + r.name + "\":";
+            size_t pos = json.find(key);
+            double base;
+            if (pos == std::string::npos || sscanf(json.c_str() + pos + key.size(), "%lf", &base) != 1) continue;
+            bool slow = r.ns > base * (1 + o.tolerance);
+            if (slow) regressions++;
+            printf("%-26s %+6.1f%%%s\n", r.name, base ? (r.ns - base) * 100 / base : 0.0, slow ? "  <-- CHẬM HƠN" : "");
+        }
+    }
+    return mismatches ? 2 : (regressions ? 1 : 0);
+}
+
+// ---------------------------------------------------------------------------
+// Phát lại frame qua toàn bộ chuỗi xử lý
+// ---------------------------------------------------------------------------
+static void endBurst(Burst& b) {
+    b.active = false;
+    for (auto& j : b.jpg) j.clear();
+}
+
+static void submitBurst(Burst& b, const BenchOptions& o, BenchStats& stats, BenchCounters& c, HttpShim& http,
+                        LinkController& link, OfflineJournal& journal) {
+    LinkParams p = link.next(hostMillis());
+    bool sent = false;
+    if (o.server && !p.offlineFirst) {
+        char ts[24];
+        rtcIsoTime(ts, sizeof(ts));
+        std::string lengths;
+        std::vector<HttpShim::Part> parts;
+        size_t bytes = 0;
+        for (uint8_t i = 0; i < b.target; i++) {
+            if (i) lengths += ",";
+            lengths += std::to_string(b.jpg[i].size());
+            parts.push_back({b.jpg[i].data(), b.jpg[i].size()});
+            bytes += b.jpg[i].size();
+        }
+        std::vector<std::string> headers = {
+            "Content-Type: application/octet-stream",
+            std::string("X-Timestamp: ") + ts,
+            "X-Image-Lengths: " + lengths,
+        };
+        if (b.aligned) headers.push_back("X-Face-Aligned: " + std::to_string(b.aligned));
+
+        uint32_t t0 = hostMillis();
+        int code;
+        std::string body;
+        {
+            BenchTimer timer(stats, B_HTTP);
+            code = http.post("/api/ai/recognize_batch", headers, parts, p.timeoutMs, &body);
+        }
+        if (code > 0) {
+            BenchTimer timer(stats, B_PARSE);
+            ServerReply reply;
+            reply.httpCode = code;
+            if (!decodeServerReply(body, reply)) c.badReplies++;
+            else if (reply.kind == REPLY_MATCH) c.matched++;
+        }
+        // Như linkReport(): 4xx là lỗi của request, không phải của đường mạng
+        link.report(hostMillis(), hostMillis() - t0, bytes, code > 0 && code < 500);
+        sent = code > 0 && code < 400;
+        if (!sent) c.httpErrors++;
+    }
+    if (sent) {
+        c.sent++;
+    } else {
+        BenchTimer timer(stats, B_SD_WRITE);
+        if (journal.append(JOURNAL_RECOGNIZE, rtcUnixTime(), "", b.jpg[0].data(), b.jpg[0].size())) c.offline++;
+    }
+    stats.record(B_CHECKIN, (uint32_t)(hostMicros64() - b.startedAt));
+}
+
+static int runPipeline(const BenchOptions& o) {
+    FrameSource src;
+    if (o.framesDir) {
+        if (!src.openDir(o.framesDir, o.width, o.height)) {
+            fprintf(stderr, "❌ Không có frame *.rgb565 trong %s\n", o.framesDir);
+            return 2;
+        }
+    } else {
+        src.openSynthetic(o.synthetic, o.width, o.height, o.empty);
+    }
+
+    mkdir(o.sdDir, 0755);
+    OfflineJournal journal;
+    if (!journal.begin(o.sdDir)) {
+        fprintf(stderr, "❌ Không mở được journal ở %s\n", o.sdDir);
+        return 2;
+    }
+    HttpShim http;
+    if (o.server && !http.begin(o.server)) {
+        fprintf(stderr, "❌ --server phải có dạng HOST:PORT\n");
+        return 2;
+    }
+    TftShim tft;
+    if (o.dumpDir) {
+        mkdir(o.dumpDir, 0755);
+        tft.begin(o.dumpDir, o.dumpEvery);
+    }
+
+    // Cấu hình như setup() trên kiosk
+    LinkControlConfig lc;
+    lc.qualityMin = LINK_QUALITY_MIN;
+    lc.qualityMax = LINK_QUALITY_MAX;
+    lc.cropMax = o.align;
+    lc.cropMin = (o.align && o.align > LINK_CROP_MIN) ? LINK_CROP_MIN : o.align;
+    LinkController link(lc);
+    FaceTracker tracker;
+    LivenessEngine liveness;
+    MotionGate gate;
+    const uint32_t cameraFps = o.fps ? o.fps : BENCH_CAMERA_FPS;
+    uint32_t lastIdleMs = 0;
+
+    BenchStats stats;
+    BenchCounters c = {};
+    c.firstFace = c.wokeAt = -1;
+    Burst burst = {};
+    bool armed = false;
+    int64_t lastCapture = -(int64_t)o.cooldown;
+    uint64_t busyUs = 0;                 // thời gian CPU của chuỗi xử lý (không tính chờ --fps)
+    const uint64_t start = hostMicros64();
+
+    for (;;) {
+        if (o.fps) {
+            uint64_t due = start + (uint64_t)c.frames * 1000000 / o.fps;
+            uint64_t now = hostMicros64();
+            if (now < due) std::this_thread::sleep_for(std::chrono::microseconds(due - now));
+        }
+        const uint64_t frameStart = hostMicros64();
+        Rgb565Frame frame;
+        if (!src.next(frame)) break;
+        c.frames++;
+        const uint32_t idx = src.index();
+        // Đồng hồ ảo theo số frame camera -> quietMs / chu kỳ chế độ chờ không phụ thuộc tốc độ máy
+        const uint32_t frameMs = (uint32_t)((uint64_t)idx * 1000 / cameraFps);
+        BenchFace probe;
+        if (c.firstFace < 0 && src.faces(&probe, 1)) c.firstFace = idx;
+        if (gate.tier() == MOTION_IDLE && frameMs - lastIdleMs < CAPTURE_IDLE_PERIOD_MS) {
+            c.idleSkipped++;             // CaptureTask đang nghỉ giữa 2 frame chế độ chờ
+            continue;
+        }
+        stats.record(B_CAPTURE, (uint32_t)(hostMicros64() - frameStart));
+
+        // Như CameraAppTask: chế độ chờ chỉ so chuyển động, frame thấy chuyển động đi tiếp ngay
+        if (burst.active) gate.hold(frameMs);
+        MotionTier tier;
+        {
+            BenchTimer timer(stats, B_MOTION);
+            tier = gate.update(frame, frameMs);
+        }
+        if (tier == MOTION_IDLE) {
+            lastIdleMs = frameMs;
+            c.idleFrames++;
+            armed = false;
+            tracker.reset();
+            busyUs += hostMicros64() - frameStart;
+            continue;
+        }
+        if (c.firstFace >= 0 && c.wokeAt < 0) c.wokeAt = idx;
+
+        // Trong burst luôn detect để mọi ứng viên có landmark thật (như locateFace(forceDetect))
+        if (burst.active) tracker.requestDetection();
+        BenchFace faces[CAMERA_MAX_FACES];
+        uint8_t nFaces = 0;
+        bool fresh = tracker.needsDetection();
+        if (fresh) {
+            BenchTimer timer(stats, B_DETECT);
+            nFaces = src.faces(faces, CAMERA_MAX_FACES);
+            if (o.detectUs) busyWaitUs(o.detectUs);
+            TrackBox boxes[CAMERA_MAX_FACES];
+            float scores[CAMERA_MAX_FACES];
+            for (uint8_t i = 0; i < nFaces; i++) { boxes[i] = faces[i].box; scores[i] = 0.9f; }
+            tracker.correct(frame, boxes, scores, nFaces);
+            c.detects++;
+        } else {
+            BenchTimer timer(stats, B_TRACK);
+            tracker.track(frame);
+        }
+
+        const Track* t = tracker.primary();
+        // Landmark của track: mặt detect được khớp nhất với khung track
+        const BenchFace* face = nullptr;
+        float bestIoU = 0;
+        for (uint8_t i = 0; t && fresh && i < nFaces; i++) {
+            float iou = trackIoU(faces[i].box, t->box);
+            if (iou > bestIoU) { bestIoU = iou; face = &faces[i]; }
+        }
+
+        if (tft.enabled()) {
+            BenchTimer timer(stats, B_TFT_PUSH);
+            tft.push(frame, t ? &t->box : nullptr);
+        }
+
+        LivenessResult live = {};
+        if (t) {
+            gate.hold(frameMs);
+            c.faces++;
+            BenchTimer timer(stats, B_LIVENESS);
+            live = liveness.update(t->id, frame, t->box, face ? &face->lm : nullptr);
+        } else {
+            armed = false;
+        }
+
+        if (!burst.active && t && t->box.w >= FACE_MIN_WIDTH && t->box.w <= FACE_MAX_WIDTH) {
+            if (!armed && live.live && (int64_t)idx - lastCapture > (int64_t)o.cooldown) armed = true;
+            // Crop cần landmark thật -> frame chỉ có tracker thì xin detect ở frame sau
+            if (armed && !fresh) {
+                tracker.requestDetection();
+            } else if (armed && face) {
+                armed = false;
+                LinkParams p = link.params();
+                burst = Burst();
+                burst.active = true;
+                burst.startedAt = hostMicros64();
+                burst.target = p.burst < BURST_FRAMES ? p.burst : BURST_FRAMES;
+                burst.quality = p.quality;
+                burst.cropSize = burst.aligned = p.cropSize;
+                c.bursts++;
+            }
+        }
+        if (burst.active) {
+            if (!t) {
+                endBurst(burst);               // mất dấu -> huỷ burst
+            } else if (face) {
+                // Như collectBurstFrame(): chỉ frame lọt top burst.target mới được nén
+                burst.candidates++;
+                FaceQuality q;
+                {
+                    BenchTimer timer(stats, B_QUALITY);
+                    q = scoreFaceQuality(frame, face->box, &face->lm);
+                }
+                int slot = -1;
+                if (burst.frames < burst.target) {
+                    slot = burst.frames;
+                } else {
+                    int worst = 0;
+                    for (uint8_t i = 1; i < burst.frames; i++) if (burst.score[i] < burst.score[worst]) worst = i;
+                    if (q.score > burst.score[worst]) slot = worst;
+                }
+                if (slot >= 0) {
+                    std::vector<uint8_t> jpg;
+                    uint16_t aligned;
+                    bool ok;
+                    {
+                        BenchTimer timer(stats, B_ENCODE);
+                        ok = encodeFace(frame, *face, burst.quality, burst.cropSize, jpg, aligned);
+                    }
+                    if (ok) {
+                        if (slot == burst.frames) burst.frames++;
+                        burst.jpg[slot].swap(jpg);
+                        burst.score[slot] = q.score;
+                        burst.seq[slot] = burst.candidates;
+                        if (aligned != burst.cropSize) burst.aligned = 0;
+                        c.jpegs++;
+                        c.jpegBytes += burst.jpg[slot].size();
+                    }
+                }
+                if (burst.candidates == BURST_CANDIDATES) {
+                    float best = 0;
+                    for (uint8_t i = 0; i < burst.frames; i++) if (burst.score[i] > best) best = burst.score[i];
+                    if (burst.frames == 0 || best < BURST_MIN_QUALITY) {
+                        c.dropped++;
+                    } else {
+                        if (burst.frames < burst.target) burst.target = burst.frames;
+                        for (uint8_t i = 1; i < burst.frames; i++) {
+                            for (uint8_t j = i; j > 0 && burst.seq[j - 1] > burst.seq[j]; j--) {
+                                std::swap(burst.jpg[j - 1], burst.jpg[j]);
+                                std::swap(burst.score[j - 1], burst.score[j]);
+                                std::swap(burst.seq[j - 1], burst.seq[j]);
+                            }
+                        }
+                        submitBurst(burst, o, stats, c, http, link, journal);
+                    }
+                    lastCapture = idx;
+                    endBurst(burst);
+                }
+            }
+        }
+        busyUs += hostMicros64() - frameStart;
+    }
+
+    const double wallS = (hostMicros64() - start) / 1e6;
+    stats.print(stdout);
+    printf("\n");
+    printf("frames      %u (%s), detect %u (%.0f%%), có mặt %u\n", c.frames,
+           src.synthetic() ? "tổng hợp" : (o.framesDir ? o.framesDir : ""), c.detects,
+           c.frames ? 100.0 * c.detects / c.frames : 0.0, c.faces);
+    printf("throughput  %.1f fps (wall %.2f s), %.1f fps chỉ tính xử lý\n", c.frames / wallS, wallS,
+           busyUs ? c.frames * 1e6 / busyUs : 0.0);
+    printf("burst       %u bắt đầu, %u gửi, %u lưu offline, %u huỷ (ảnh kém), %u lỗi HTTP\n", c.bursts, c.sent,
+           c.offline, c.dropped, c.httpErrors);
+    printf("phản hồi    %u match, %u không đọc được\n", c.matched, c.badReplies);
+    printf("jpeg        %u ảnh, trung bình %.0f byte\n", c.jpegs, c.jpegs ? (double)c.jpegBytes / c.jpegs : 0.0);
+    MotionGateStats ms = gate.stats();
+    uint64_t gateMs = ms.idleMs + ms.activeMs;
+    printf("chờ/hoạt động %.0f%% / %.0f%% thời gian | %u frame chỉ so chuyển động, %u frame camera nghỉ | "
+           "%u lần thức",
+           gateMs ? 100.0 * ms.idleMs / gateMs : 0.0, gateMs ? 100.0 * ms.activeMs / gateMs : 0.0, c.idleFrames,
+           c.idleSkipped, ms.wakeups);
+    if (c.firstFace >= 0 && c.wokeAt >= 0) printf(", thức sau %lld frame kể từ lúc có mặt", (long long)(c.wokeAt - c.firstFace));
+    printf("\n");
+    TrackerStats ts = tracker.stats();
+    printf("tracker     detect %u | track %u | tạo %u | mất %u\n", ts.detects, ts.tracked, ts.created, ts.lost);
+    if (o.server) {
+        HttpShim::Stats hs = http.stats();
+        LinkStats ls = link.stats();
+        printf("http        %u request, %u dùng lại kết nối, %u bắt tay, %u kết nối lại | srtt %u ms\n", hs.requests,
+               hs.reused, hs.handshakes, hs.reconnects, ls.srttMs);
+    }
+    printf("journal     %u record chờ gửi trong %s\n", journal.pending(), o.sdDir);
+
+    if (o.jsonPath) {
+        char extra[160];
+        snprintf(extra, sizeof(extra), "\"frames\":%u,\"fps\":%.1f,\"cpu_fps\":%.1f,\"jpeg_avg\":%.0f", c.frames,
+                 c.frames / wallS, busyUs ? c.frames * 1e6 / busyUs : 0.0,
+                 c.jpegs ? (double)c.jpegBytes / c.jpegs : 0.0);
+        if (!stats.saveJson(o.jsonPath, extra)) fprintf(stderr, "⚠️ Không ghi được %s\n", o.jsonPath);
+    }
+    if (o.baselinePath) {
+        printf("\nSo với baseline %s (ngưỡng +%.0f%%):\n", o.baselinePath, o.tolerance * 100);
+        int r = stats.compare(o.baselinePath, o.tolerance, stdout);
+        if (r < 0) {
+            fprintf(stderr, "❌ Không đọc được baseline %s\n", o.baselinePath);
+            return 2;
+        }
+        if (r > 0) return 1;
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Uplink: cùng 1 burst BURST_FRAMES ảnh gửi N lần qua HTTP POST (tuần tự, như HttpSession) và
+// qua khung nhị phân trên /ws (như ws_uplink), 1 request/lượt rồi WS_UPLINK_INFLIGHT cùng bay
+// ---------------------------------------------------------------------------
+struct UplinkRun {
+    BenchStats stats;
+    double wallS;
+    uint32_t ok, bad;
+    size_t bodyBytes;                    // byte body mỗi request
+};
+
+static void uplinkRecord(UplinkRun& run, BenchStage stage, uint64_t t0, int code, const char* json, size_t len) {
+    run.stats.record(stage, (uint32_t)(hostMicros64() - t0));
+    ServerReply reply;
+    reply.httpCode = code;
+    if (code > 0 && code < 400 && decodeServerReply(json, len, reply) && reply.httpCode < 400) run.ok++;
+    else run.bad++;
+}
+
+static bool uplinkHttp(const BenchOptions& o, const std::vector<uint8_t>& img, UplinkRun& run) {
+    HttpShim http;
+    if (!http.begin(o.server)) return false;
+    std::string lengths;
+    std::vector<HttpShim::Part> parts;
+    for (int i = 0; i < BURST_FRAMES; i++) {
+        lengths += (i ? "," : "") + std::to_string(img.size());
+        parts.push_back({img.data(), img.size()});
+    }
+    char ts[32];
+    rtcIsoTime(ts, sizeof(ts));
+    std::vector<std::string> headers = {
+        "Content-Type: application/octet-stream",
+        std::string("X-Timestamp: ") + ts,
+        "X-Image-Lengths: " + lengths,
+    };
+    uint64_t start = hostMicros64();
+    std::string body;
+    for (uint32_t n = 0; n < o.uplink; n++) {
+        uint64_t t0 = hostMicros64();
+        int code = http.post("/api/ai/recognize_batch", headers, parts, 5000, &body);
+        uplinkRecord(run, B_HTTP, t0, code, body.data(), body.size());
+    }
+    run.wallS = (hostMicros64() - start) / 1e6;
+    return true;
+}
+
+// Base64 như Base64JsonStream trên kiosk (chuẩn RFC 4648, có '=' đệm)
+static void base64Append(std::string& out, const uint8_t* p, size_t n) {
+    static const char T[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    for (size_t i = 0; i < n; i += 3) {
+        uint32_t v = p[i] << 16 | (i + 1 < n ? p[i + 1] << 8 : 0) | (i + 2 < n ? p[i + 2] : 0);
+        out += T[v >> 18];
+        out += T[(v >> 12) & 63];
+        out += i + 1 < n ? T[(v >> 6) & 63] : '=';
+        out += i + 2 < n ? T[v & 63] : '=';
+    }
+}
+
+// 1 ảnh lên /api/ai/recognize như postImage(): JPEG thô (metadata trong header X-*) hoặc body
+// JSON {"image":"<base64>",...} như server cũ. Bản JSON mã hoá lại mỗi request (kiosk mã hoá
+// theo khối lúc gửi), nên độ trễ gồm cả chi phí base64.
+static bool uplinkSingle(const BenchOptions& o, const std::vector<uint8_t>& img, bool raw, UplinkRun& run) {
+    HttpShim http;
+    if (!http.begin(o.server)) return false;
+    char ts[32];
+    rtcIsoTime(ts, sizeof(ts));
+    std::vector<std::string> headers;
+    if (raw) headers = {"Content-Type: image/jpeg", std::string("X-Timestamp: ") + ts};
+    else headers = {"Content-Type: application/json"};
+    uint64_t start = hostMicros64();
+    std::string json, body;
+    for (uint32_t n = 0; n < o.uplink; n++) {
+        uint64_t t0 = hostMicros64();
+        std::vector<HttpShim::Part> parts;
+        if (raw) {
+            parts.push_back({img.data(), img.size()});
+        } else {
+            json.assign("{\"image\":\"");
+            base64Append(json, img.data(), img.size());
+            json += std::string("\",\"timestamp\":\"") + ts + "\"}";
+            parts.push_back({(const uint8_t*)json.data(), json.size()});
+        }
+        run.bodyBytes = parts[0].len;
+        int code = http.post("/api/ai/recognize", headers, parts, 5000, &body);
+        uplinkRecord(run, B_HTTP, t0, code, body.data(), body.size());
+    }
+    run.wallS = (hostMicros64() - start) / 1e6;
+    return true;
+}
+
+static bool uplinkWs(const BenchOptions& o, const std::vector<uint8_t>& img, uint32_t window, UplinkRun& run) {
+    WsShim ws;
+    if (!ws.connect(o.server, "/ws", 3000)) return false;
+    std::string msg;
+    if (ws.receive(msg, 2000) != WsShim::WS_TEXT || msg.find("\"uplink\"") == std::string::npos) {
+        fprintf(stderr, "⚠️ Server không báo hỗ trợ uplink qua /ws\n");
+        return false;
+    }
+
+    UplinkHeader h = {};
+    h.type = UPLINK_RECOGNIZE;
+    h.count = BURST_FRAMES;
+    h.timestamp = rtcUnixTime();
+    for (int i = 0; i < BURST_FRAMES; i++) h.lengths[i] = img.size();
+    std::vector<uint8_t> frame(uplinkHeaderLen(h.count) + BURST_FRAMES * img.size());
+    std::vector<std::pair<uint32_t, uint64_t>> inFlight;     // request id, lúc gửi
+
+    uint64_t start = hostMicros64();
+    uint32_t next = 1, done = 0;
+    while (done < o.uplink) {
+        while (inFlight.size() < window && next <= o.uplink) {
+            // Dựng khung như wsUplinkSend: header + chép các JPEG
+            uint64_t t0 = hostMicros64();
+            h.requestId = next++;
+            size_t off = uplinkEncodeHeader(h, frame.data(), frame.size());
+            for (int i = 0; i < BURST_FRAMES; i++, off += img.size()) memcpy(&frame[off], img.data(), img.size());
+            if (!ws.sendBinary(frame.data(), frame.size())) return false;
+            inFlight.push_back({h.requestId, t0});
+        }
+        int op = ws.receive(msg, 5000);
+        if (op <= 0) {
+            fprintf(stderr, "⚠️ WS hết giờ / mất kết nối, còn %zu request chờ\n", inFlight.size());
+            run.bad += o.uplink - done;
+            break;
+        }
+        uint32_t id;
+        const char* json;
+        size_t jsonLen;
+        if (op != WsShim::WS_BINARY || !uplinkDecodeReply((const uint8_t*)msg.data(), msg.size(), &id, &json, &jsonLen)) {
+            continue;
+        }
+        for (size_t i = 0; i < inFlight.size(); i++) {
+            if (inFlight[i].first != id) continue;
+            uplinkRecord(run, B_WS, inFlight[i].second, 200, json, jsonLen);
+            inFlight.erase(inFlight.begin() + i);
+            done++;
+            break;
+        }
+    }
+    run.wallS = (hostMicros64() - start) / 1e6;
+    return true;
+}
+
+static int runUplink(const BenchOptions& o) {
+    if (!o.server) {
+        fprintf(stderr, "❌ --uplink cần --server HOST:PORT (server thật hoặc bench/mock_server.mjs)\n");
+        return 2;
+    }
+    std::vector<uint8_t> img(o.uplinkBytes);
+    for (size_t i = 0; i < img.size(); i++) img[i] = (uint8_t)(i * 131 + 7);
+
+    UplinkRun raw = {}, b64 = {}, http = {}, ws1 = {}, wsN = {};
+    bool singleOk = uplinkSingle(o, img, true, raw) && uplinkSingle(o, img, false, b64);
+    if (!singleOk) fprintf(stderr, "❌ Không gửi được ảnh đơn tới %s\n", o.server);
+    if (!uplinkHttp(o, img, http)) fprintf(stderr, "❌ Không gửi được HTTP tới %s\n", o.server);
+    bool wsOk = uplinkWs(o, img, 1, ws1) && uplinkWs(o, img, WS_UPLINK_INFLIGHT, wsN);
+    if (!wsOk) fprintf(stderr, "❌ Không gửi được qua ws://%s/ws\n", o.server);
+
+    printf("%u request x 1 ảnh x %u byte -> %s/api/ai/recognize\n\n", o.uplink, o.uplinkBytes, o.server);
+    printf("%-18s %8s %8s %10s %10s %6s %6s\n", "body", "byte", "req/s", "p50 ms", "p99 ms", "ok", "lỗi");
+    const std::pair<const char*, const UplinkRun*> single[] = {{"jpeg raw", &raw}, {"base64 json", &b64}};
+    for (const auto& r : single) {
+        StageSummary s = r.second->stats.summary(B_HTTP);
+        printf("%-18s %8zu %8.1f %10.2f %10.2f %6u %6u\n", r.first, r.second->bodyBytes,
+               r.second->wallS > 0 ? s.count / r.second->wallS : 0.0, s.p50 / 1000.0, s.p99 / 1000.0,
+               r.second->ok, r.second->bad);
+    }
+    if (raw.bodyBytes) printf("base64 json: %+.1f%% byte\n", (b64.bodyBytes - (double)raw.bodyBytes) * 100 / raw.bodyBytes);
+
+    printf("\n%u request x %d ảnh x %u byte -> %s\n\n", o.uplink, BURST_FRAMES, o.uplinkBytes, o.server);
+    printf("%-18s %8s %10s %10s %6s %6s\n", "đường gửi", "req/s", "p50 ms", "p99 ms", "ok", "lỗi");
+    struct Row { const char* name; const UplinkRun& run; BenchStage stage; };
+    char wsName[32];
+    snprintf(wsName, sizeof(wsName), "ws (%d cùng bay)", WS_UPLINK_INFLIGHT);
+    const Row rows[] = {{"http (tuần tự)", http, B_HTTP}, {"ws (1 request)", ws1, B_WS}, {wsName, wsN, B_WS}};
+    for (const Row& r : rows) {
+        StageSummary s = r.run.stats.summary(r.stage);
+        printf("%-18s %8.1f %10.2f %10.2f %6u %6u\n", r.name, r.run.wallS > 0 ? s.count / r.run.wallS : 0.0,
+               s.p50 / 1000.0, s.p99 / 1000.0, r.run.ok, r.run.bad);
+    }
+    return (raw.bad || b64.bad || http.bad || ws1.bad || wsN.bad || !singleOk || !wsOk) ? 1 : 0;
+}
+
+// ---------------------------------------------------------------------------
+// Sync: ghi N record vào journal (như khi mất mạng) rồi đổ lên /api/ai/ingest_batch như
+// syncOfflineBatch: peek + next gom batch, ack theo trạng thái từng record server trả về.
+// Batch lỗi (--fail của mock) gửi lại nguyên batch; batch xử lý dở (--partial) chỉ ack phần
+// đầu "ok"/"reject", phần "retry" gửi lại ở batch sau. Kiểm tra thứ tự ack và pending về 0.
+// ---------------------------------------------------------------------------
+
+// Trạng thái từng record trong {"results":["ok","retry",...]}
+static std::vector<std::string> syncResults(const std::string& json) {
+    std::vector<std::string> out;
+    size_t pos = json.find("\"results\"");
+    if (pos == std::string::npos) return out;
+    size_t end = json.find(']', pos);
+    for (pos = json.find('[', pos); pos != std::string::npos && pos < end;) {
+        size_t a = json.find('"', pos + 1);
+        if (a == std::string::npos || a > end) break;
+        size_t b = json.find('"', a + 1);
+        if (b == std::string::npos) break;
+        out.push_back(json.substr(a + 1, b - a - 1));
+        pos = b;
+    }
+    return out;
+}
+
+static int runSync(const BenchOptions& o) {
+    if (!o.server) {
+        fprintf(stderr, "❌ --sync cần --server HOST:PORT (server thật hoặc bench/mock_server.mjs)\n");
+        return 2;
+    }
+    char dir[] = "/tmp/jsync_XXXXXX";
+    if (!mkdtemp(dir)) return 2;
+    OfflineJournal journal;
+    if (!journal.begin(dir)) {
+        fprintf(stderr, "❌ Không mở được journal ở %s\n", dir);
+        return 2;
+    }
+    std::vector<uint8_t> img(o.uplinkBytes);
+    uint64_t t0 = hostMicros64();
+    for (uint32_t i = 0; i < o.sync; i++) {
+        for (size_t k = 0; k < img.size(); k++) img[k] = (uint8_t)(i * 7 + k * 131);
+        char id[JOURNAL_ID_LEN];
+        snprintf(id, sizeof(id), "NV%04u", i % 1000);
+        if (!journal.append(i % 10 ? JOURNAL_RECOGNIZE : JOURNAL_ENROLL, i, id, img.data(), img.size())) {
+            fprintf(stderr, "❌ Ghi journal lỗi ở record %u\n", i);
+            return 2;
+        }
+    }
+    double fillS = (hostMicros64() - t0) / 1e6;
+
+    HttpShim http;
+    if (!http.begin(o.server)) {
+        fprintf(stderr, "❌ Không kết nối được %s\n", o.server);
+        return 2;
+    }
+    BenchStats stats;
+    uint32_t batches = 0, failed = 0, partial = 0, resent = 0, rejected = 0, acked = 0, outOfOrder = 0;
+    uint32_t failStreak = 0;
+    uint64_t bytes = 0;
+    std::vector<uint8_t> body;
+    std::vector<JournalRecord> recs;
+    std::string res;
+    std::vector<std::string> headers = {"Content-Type: application/octet-stream"};
+    t0 = hostMicros64();
+    JournalRecord rec;
+    while (journal.peek(rec)) {
+        // Gom batch như syncOfflineBatch (trên kiosk body stream thẳng từ thẻ SD)
+        recs.assign(1, rec);
+        size_t size = JOURNAL_HEADER_LEN + rec.length;
+        while (recs.size() < SYNC_BATCH_RECORDS && journal.next(rec, rec)) {
+            if (size + JOURNAL_HEADER_LEN + rec.length > SYNC_BATCH_BYTES) break;
+            recs.push_back(rec);
+            size += JOURNAL_HEADER_LEN + rec.length;
+        }
+        body.resize(size);
+        size_t off = 0;
+        for (const JournalRecord& r : recs) off += journal.readRecord(r, 0, &body[off], JOURNAL_HEADER_LEN + r.length);
+
+        uint64_t b0 = hostMicros64();
+        int code = http.post("/api/ai/ingest_batch", headers, {{body.data(), off}}, 30000, &res);
+        stats.record(B_HTTP, (uint32_t)(hostMicros64() - b0));
+        batches++;
+        bytes += off;
+        std::vector<std::string> results = code == 200 ? syncResults(res) : std::vector<std::string>();
+        if (code != 200 || results.empty()) {
+            failed++;
+            resent += recs.size();
+            if (++failStreak > 20) {
+                fprintf(stderr, "❌ %u batch lỗi liên tiếp (%d), dừng\n", failStreak, code);
+                break;
+            }
+            continue;
+        }
+        failStreak = 0;
+        size_t done = 0;
+        for (; done < recs.size() && done < results.size(); done++) {
+            if (results[done] == "retry") break;
+            if (results[done] == "reject") rejected++;
+            if (recs[done].timestamp != acked) outOfOrder++;
+            if (!journal.ack(recs[done])) break;
+            acked++;
+        }
+        if (done < recs.size()) {
+            partial++;
+            resent += recs.size() - done;
+        }
+    }
+    double wallS = (hostMicros64() - t0) / 1e6;
+    uint32_t left = journal.pending();
+    journal.end();
+    removeDir(dir);
+
+    StageSummary s = stats.summary(B_HTTP);
+    printf("%u record x %u byte -> %s/api/ai/ingest_batch (%u record/batch)\n\n", o.sync, o.uplinkBytes, o.server,
+           SYNC_BATCH_RECORDS);
+    printf("ghi journal   %8.0f record/s\n", fillS > 0 ? o.sync / fillS : 0.0);
+    printf("đồng bộ       %8.0f record/s  %8.1f KB/s  (%.2f s)\n", wallS > 0 ? acked / wallS : 0.0,
+           wallS > 0 ? bytes / 1024.0 / wallS : 0.0, wallS);
+    printf("batch         %8u  p50 %.2f ms  p99 %.2f ms\n", batches, s.p50 / 1000.0, s.p99 / 1000.0);
+    printf("batch lỗi     %8u  xử lý dở %u, gửi lại %u record\n", failed, partial, resent);
+    printf("ack           %8u  (server từ chối %u, sai thứ tự %u), còn chờ %u\n", acked, rejected, outOfOrder, left);
+    return (acked != o.sync || left || outOfOrder) ? 1 : 0;
+}
+
+int main(int argc, char** argv) {
+    BenchOptions o;
+    if (!parseArgs(argc, argv, o)) {
+        usage();
+        return 2;
+    }
+    if (o.uplink) return runUplink(o);
+    if (o.sync) return runSync(o);
+    return o.kernels ? runKernels(o) : runPipeline(o);
+}
@@ -0,0 +1,81 @@
+#include "bench_stats.h"
+#include "shim_clock.h"
+#include <string.h>
+#include <algorithm>
+#include <string>
+
+#define BENCH_SLACK_US 20     // chênh lệch tuyệt đối bỏ qua khi so baseline (tầng rất nhanh nhiễu nhiều)
+
+static const char* STAGE_NAMES[B_STAGE_COUNT] = {
+    "capture", "motion", "detect", "track", "liveness", "quality", "encode", "http", "parse", "ws", "sd_write", "tft_push", "checkin"
+};
+
+const char* BenchStats::name(BenchStage stage) { return STAGE_NAMES[stage]; }
+
+StageSummary BenchStats::summary(BenchStage stage) const {
+    StageSummary s = {};
+    std::vector<uint32_t> v = _samples[stage];
+    if (v.empty()) return s;
+    std::sort(v.begin(), v.end());
+    s.count = v.size();
+    s.p50 = v[(v.size() - 1) * 50 / 100];
+    s.p99 = v[(v.size() - 1) * 99 / 100];
+    s.max = v.back();
+    double sum = 0;
+    for (uint32_t us : v) sum += us;
+    s.mean = sum / v.size();
+    return s;
+}
+
+void BenchStats::print(FILE* out) const {
+    fprintf(out, "%-10s %8s %10s %10s %10s %10s\n", "stage", "count", "mean_us", "p50_us", "p99_us", "max_us");
+    for (int i = 0; i < B_STAGE_COUNT; i++) {
+        StageSummary s = summary((BenchStage)i);
+        if (!s.count) continue;
+        fprintf(out, "%-10s %8u %10.1f %10u %10u %10u\n", STAGE_NAMES[i], s.count, s.mean, s.p50, s.p99, s.max);
+    }
+}
+
+bool BenchStats::saveJson(const char* path, const char* extra) const {
+    FILE* f = fopen(path, "w");
+    if (!f) return false;
+    fprintf(f, "{\"stages\":{");
+    bool first = true;
+    for (int i = 0; i < B_STAGE_COUNT; i++) {
+        StageSummary s = summary((BenchStage)i);
+        if (!s.count) continue;
+        fprintf(f, "%s\"%s\":[%u,%u,%u,%u]", first ? "" : ",", STAGE_NAMES[i], s.count, s.p50, s.p99, s.max);
+        first = false;
+    }
+    fprintf(f, "}%s%s}\n", (extra && *extra) ? "," : "", extra ? extra : "");
+    return fclose(f) == 0;
+}
+
+int BenchStats::compare(const char* baselinePath, float tolerance, FILE* out) const {
+    FILE* f = fopen(baselinePath, "r");
+    if (!f) return -1;
+    std::string json;
+    char buf[512];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) json.append(buf, n);
+    fclose(f);
+
+    int regressions = 0;
+    for (int i = 0; i < B_STAGE_COUNT; i++) {
+        std::string key = std::string("\"") + STAGE_NAMES[i] + "\":[";
+        size_t pos = json.find(key);
+        StageSummary s = summary((BenchStage)i);
+        if (pos == std::string::npos || !s.count) continue;
+        unsigned count, p50, p99, mx;
+        if (sscanf(json.c_str() + pos + key.size(), "%u,%u,%u,%u", &count, &p50, &p99, &mx) != 4) continue;
+        float limit = p50 * (1 + tolerance) + BENCH_SLACK_US;
+        bool slow = s.p50 > limit;
+        if (slow) regressions++;
+        fprintf(out, "%-10s p50 %8u us (baseline %8u) %+6.1f%%%s\n", STAGE_NAMES[i], s.p50, p50,
+                p50 ? (s.p50 - (float)p50) * 100 / p50 : 0.0f, slow ? "  <-- CHẬM HƠN" : "");
+    }
+    return regressions;
+}
+
+BenchTimer::BenchTimer(BenchStats& stats, BenchStage stage) : _stats(stats), _stage(stage), _t0(hostMicros()) {}
+BenchTimer::~BenchTimer() { _stats.record(_stage, hostMicros() - _t0); }
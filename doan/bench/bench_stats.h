@@ -0,0 +1,60 @@
+#pragma once
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+// Thống kê độ trễ từng tầng khi chạy benchmark trên máy tính. Tên tầng và định dạng JSON
+// ("stages": {"detect": [count, p50_us, p99_us, max_us]}) giống lệnh get_metrics trên kiosk,
+// nên so được số đo trên máy tính với snapshot lấy từ thiết bị.
+
+enum BenchStage {
+    B_CAPTURE,
+    B_MOTION,
+    B_DETECT,
+    B_TRACK,
+    B_LIVENESS,
+    B_QUALITY,
+    B_ENCODE,
+    B_HTTP,
+    B_PARSE,
+    B_WS,
+    B_SD_WRITE,
+    B_TFT_PUSH,
+    B_CHECKIN,
+    B_STAGE_COUNT
+};
+
+struct StageSummary {
+    uint32_t count;
+    uint32_t p50, p99, max;       // us
+    double mean;
+};
+
+class BenchStats {
+public:
+    void record(BenchStage stage, uint32_t us) { _samples[stage].push_back(us); }
+    StageSummary summary(BenchStage stage) const;
+    static const char* name(BenchStage stage);
+
+    void print(FILE* out) const;
+    // extra: các trường JSON thêm vào cuối (vd "\"fps\":12.3"), có thể rỗng
+    bool saveJson(const char* path, const char* extra) const;
+    // So p50 từng tầng với file JSON baseline (do saveJson ghi). Trả về số tầng chậm hơn
+    // baseline quá tolerance (0.2 = 20%), -1 nếu không đọc được baseline.
+    int compare(const char* baselinePath, float tolerance, FILE* out) const;
+
+private:
+    std::vector<uint32_t> _samples[B_STAGE_COUNT];
+};
+
+// Đo thời gian 1 khối lệnh, như MetricTimer trên kiosk
+class BenchTimer {
+public:
+    BenchTimer(BenchStats& stats, BenchStage stage);
+    ~BenchTimer();
+
+private:
+    BenchStats& _stats;
+    BenchStage _stage;
+    uint32_t _t0;
+};
@@ -0,0 +1,155 @@
+// Server giả cho benchmark trên máy tính (và thử kiosk thật mà không cần MongoDB / model AI).
+// Trả lời các endpoint /api/ai/* mà kiosk gọi, với độ trễ và tỉ lệ lỗi chỉnh được, để đo
+// chuỗi upload + bộ điều khiển mạng (LinkControl) trong điều kiện mạng khác nhau.
+// Có cả /ws tối giản (chỉ khung nhị phân uplink, xem lib/UplinkFrame) để so WebSocket với HTTP.
+//
+//   node bench/mock_server.mjs [--port 3100] [--delay 150] [--jitter 50] [--fail 0.05] [--partial 0.1]
+//
+// Chỉ dùng module có sẵn của Node, không cần npm install.
+import http from 'node:http';
+import crypto from 'node:crypto';
+
+const args = process.argv.slice(2);
+const opt = (name, def) => {
+    const i = args.indexOf(`--${name}`);
+    return i >= 0 ? Number(args[i + 1]) : def;
+};
+const PORT = opt('port', 3100);
+const DELAY = opt('delay', 150);     // ms server "xử lý" mỗi request
+const JITTER = opt('jitter', 50);    // ± ms
+const FAIL = opt('fail', 0);         // tỉ lệ trả 503
+const PARTIAL = opt('partial', 0);   // tỉ lệ batch /ingest_batch chỉ xử lý được phần đầu
+
+const stats = { requests: 0, images: 0, bytes: 0, failed: 0, badLengths: 0, ws: 0, records: 0, partial: 0 };
+const serverWait = () => Math.max(0, DELAY + (Math.random() * 2 - 1) * JITTER);
+
+const reply = (res, code, body) => {
+    const txt = JSON.stringify(body);
+    res.writeHead(code, {
+        'Content-Type': 'application/json',
+        'Content-Length': Buffer.byteLength(txt),
+        'X-Image-Upload': 'jpeg',      // báo hỗ trợ upload JPEG thô như server thật
+    });
+    res.end(txt);
+};
+
+const server = http.createServer((req, res) => {
+    const chunks = [];
+    req.on('data', (c) => chunks.push(c));
+    req.on('end', () => {
+        const body = Buffer.concat(chunks);
+        stats.requests++;
+        stats.bytes += body.length;
+
+        let images = 1;
+        const lengths = req.headers['x-image-lengths'];
+        if (lengths) {
+            const parts = String(lengths).split(',').map(Number);
+            images = parts.length;
+            if (parts.reduce((a, b) => a + b, 0) !== body.length) stats.badLengths++;
+        }
+        stats.images += images;
+
+        setTimeout(() => {
+            if (Math.random() < FAIL) {
+                stats.failed++;
+                return reply(res, 503, { error: 'mock failure' });
+            }
+            if (req.url.startsWith('/api/ai/recognize')) return reply(res, 200, { match: true, name: 'Bench', employee_id: 'NV0000' });
+            if (req.url.startsWith('/api/ai/enroll')) return reply(res, 200, { status: 'collecting', count: 1 });
+            if (req.url.startsWith('/api/ai/ingest_batch')) {
+                // Record journal nối liền: header 52 byte, độ dài payload (u32 LE) ở byte 44
+                const results = [];
+                for (let off = 0; off + 52 <= body.length; off += 52 + body.readUInt32LE(off + 44)) results.push('ok');
+                // Xử lý dở: k record đầu xong, phần còn lại "retry" (kiosk gửi lại ở batch sau)
+                if (results.length && Math.random() < PARTIAL) {
+                    stats.partial++;
+                    results.fill('retry', Math.floor(Math.random() * results.length));
+                }
+                stats.records += results.filter((r) => r !== 'retry').length;
+                return reply(res, 200, { results });
+            }
+            reply(res, 404, { error: 'not found' });
+        }, serverWait());
+    });
+});
+
+// --- WebSocket /ws: handshake + frame tối giản (không chia mảnh), chỉ đủ cho kiosk / bench ---
+const wsSend = (socket, opcode, payload) => {
+    const len = payload.length;
+    const head = len < 126 ? Buffer.from([0x80 | opcode, len])
+        : len <= 0xFFFF ? Buffer.from([0x80 | opcode, 126, len >> 8, len & 0xFF])
+        : Buffer.concat([Buffer.from([0x80 | opcode, 127]), (() => { const b = Buffer.alloc(8); b.writeBigUInt64BE(BigInt(len)); return b; })()]);
+    socket.write(Buffer.concat([head, payload]));
+};
+
+// Khung uplink: "UPLK" | ver | type | count | flags | id u32 | ts u32 | aligned u16 | rsv u16 | id[32] | len u32 x count
+const onUplink = (socket, buf) => {
+    if (buf.length < 52 || buf.readUInt32LE(0) !== 0x4B4C5055) return;
+    const id = buf.readUInt32LE(8);
+    const type = buf[5];
+    const count = buf[6];
+    let total = 52 + 4 * count;
+    for (let i = 0; i < count; i++) total += buf.readUInt32LE(52 + 4 * i);
+    stats.ws++;
+    stats.images += count;
+    stats.bytes += buf.length;
+    if (total !== buf.length) stats.badLengths++;
+    setTimeout(() => {
+        const body = Math.random() < FAIL ? { error: 'mock failure', code: 503 }
+            : type === 2 ? { status: 'collecting', count: 1, code: 200 }
+            : { match: true, name: 'Bench', employee_id: 'NV0000', code: 200 };
+        const head = Buffer.alloc(8);
+        head.writeUInt32LE(0x53525055, 0);     // "UPRS"
+        head.writeUInt32LE(id, 4);
+        if (body.error) stats.failed++;
+        if (!socket.destroyed) wsSend(socket, 2, Buffer.concat([head, Buffer.from(JSON.stringify(body))]));
+    }, serverWait());
+};
+
+server.on('upgrade', (req, socket) => {
+    if (req.url !== '/ws') return socket.destroy();
+    const accept = crypto.createHash('sha1')
+        .update(req.headers['sec-websocket-key'] + '258EAFA5-E914-47DA-95CA-C5AB0DC85B11').digest('base64');
+    socket.write('HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n' +
+                 `Sec-WebSocket-Accept: ${accept}\r\n\r\n`);
+    socket.setNoDelay(true);
+    wsSend(socket, 1, Buffer.from(JSON.stringify({ type: 'uplink', version: 1 })));
+
+    let pending = Buffer.alloc(0);
+    socket.on('data', (chunk) => {
+        pending = pending.length ? Buffer.concat([pending, chunk]) : chunk;
+        for (;;) {
+            if (pending.length < 2) return;
+            const opcode = pending[0] & 0x0F;
+            let len = pending[1] & 0x7F;
+            let off = 2;
+            if (len === 126) { if (pending.length < 4) return; len = pending.readUInt16BE(2); off = 4; }
+            else if (len === 127) { if (pending.length < 10) return; len = Number(pending.readBigUInt64BE(2)); off = 10; }
+            const masked = pending[1] & 0x80;
+            const mask = masked ? pending.subarray(off, off + 4) : null;
+            if (masked) off += 4;
+            if (pending.length < off + len) return;
+            const payload = Buffer.from(pending.subarray(off, off + len));
+            if (mask) for (let i = 0; i < len; i++) payload[i] ^= mask[i & 3];
+            pending = pending.subarray(off + len);
+
+            if (opcode === 2) onUplink(socket, payload);
+            else if (opcode === 9) wsSend(socket, 10, payload);
+            else if (opcode === 8) return socket.end();
+        }
+    });
+    socket.on('error', () => {});
+});
+
+server.keepAliveTimeout = 15000;
+server.listen(PORT, () => {
+    console.log(`🧪 Mock server :${PORT} | delay ${DELAY}±${JITTER} ms | fail ${FAIL * 100}%`);
+});
+
+process.on('SIGINT', () => {
+    console.log(`\n📊 ${stats.requests} request HTTP, ${stats.ws} khung WS, ${stats.images} ảnh, ${(stats.bytes / 1024).toFixed(1)} KB, ` +
+                `${stats.failed} lỗi giả, ${stats.badLengths} sai X-Image-Lengths, ` +
+                `${stats.records} record ingest (${stats.partial} batch xử lý dở)`);
+    process.exit(0);
+});
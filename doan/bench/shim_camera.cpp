@@ -0,0 +1,142 @@
+#include "shim_camera.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <dirent.h>
+#include <algorithm>
+
+static inline int clampi(int v, int lo, int hi) { return v < lo ? lo : (v > hi ? hi : v); }
+
+static inline void putPixel(uint8_t* p, int r, int g, int b) {
+    uint16_t v = ((clampi(r, 0, 255) >> 3) << 11) | ((clampi(g, 0, 255) >> 2) << 5) | (clampi(b, 0, 255) >> 3);
+    p[0] = v >> 8;      // big-endian như camera
+    p[1] = v & 0xFF;
+}
+
+bool FrameSource::openDir(const char* dir, uint16_t width, uint16_t height) {
+    DIR* d = opendir(dir);
+    if (!d) return false;
+    _files.clear();
+    while (struct dirent* e = readdir(d)) {
+        size_t n = strlen(e->d_name);
+        if (n > 7 && strcmp(e->d_name + n - 7, ".rgb565") == 0) _files.push_back(std::string(dir) + "/" + e->d_name);
+    }
+    closedir(d);
+    std::sort(_files.begin(), _files.end());
+
+    _w = width;
+    _h = height;
+    _count = _files.size();
+    _next = 0;
+    _synthetic = false;
+    _buf.assign((size_t)_w * _h * 2, 0);
+    _faces.assign(_count, std::vector<BenchFace>());
+    if (!loadFaces(std::string(dir) + "/faces.csv")) {
+        fprintf(stderr, "⚠️ [CAMERA] Không có %s/faces.csv -> không có mặt nào được detect\n", dir);
+    }
+    return _count > 0;
+}
+
+bool FrameSource::loadFaces(const std::string& path) {
+    FILE* f = fopen(path.c_str(), "r");
+    if (!f) return false;
+    char line[256];
+    while (fgets(line, sizeof(line), f)) {
+        if (line[0] == '#') continue;
+        unsigned idx;
+        int x, y, w, h;
+        BenchFace face;
+        LiveLandmarks& lm = face.lm;
+        if (sscanf(line, "%u,%d,%d,%d,%d,%f,%f,%f,%f,%f,%f", &idx, &x, &y, &w, &h, &lm.leftEyeX, &lm.leftEyeY,
+                   &lm.rightEyeX, &lm.rightEyeY, &lm.noseX, &lm.noseY) != 11) continue;
+        if (idx >= _count || _faces[idx].size() >= CAMERA_MAX_FACES) continue;
+        face.box = {(int16_t)x, (int16_t)y, (int16_t)w, (int16_t)h};
+        _faces[idx].push_back(face);
+    }
+    fclose(f);
+    return true;
+}
+
+void FrameSource::openSynthetic(uint32_t frames, uint16_t width, uint16_t height, uint32_t empty) {
+    _w = width;
+    _h = height;
+    _count = empty + frames;
+    _empty = empty;
+    _next = 0;
+    _synthetic = true;
+    _files.clear();
+    _buf.assign((size_t)_w * _h * 2, 0);
+    _faces.assign(_count, std::vector<BenchFace>(1));
+    for (uint32_t i = 0; i < _empty; i++) _faces[i].clear();
+}
+
+// Mặt tổng hợp: nền nhiễu, mặt elip có vân da, 2 mắt chớp mỗi 40 frame, miệng mở/đóng,
+// mũi lệch theo góc quay đầu. Landmark ghi thẳng vào _faces làm kết quả "detector".
+void FrameSource::synthesize(uint32_t i) {
+    const bool empty = i < _empty;
+    i -= empty ? 0 : _empty;
+    const float cx = _w * 0.5f + _w * 0.10f * sinf(i * 0.07f);
+    const float cy = _h * 0.48f + _h * 0.03f * sinf(i * 0.05f);
+    const float fw = _w * 0.38f, fh = _h * 0.44f;
+    const float yaw = 0.12f * sinf(i * 0.11f);          // lệch mũi / khoảng cách 2 mắt
+    const bool blink = (i % 40) < 3;
+    const float mouth = 3 + 3 * (0.5f + 0.5f * sinf(i * 0.23f));
+
+    const float eyeY = cy - fh * 0.12f, eyeDx = fw * 0.2f, eyeDist = 2 * eyeDx;
+    const float noseX = cx + yaw * eyeDist, noseY = cy + fh * 0.06f;
+    const float mouthY = cy + fh * 0.25f;
+
+    uint32_t seed = i * 2654435761u + 1;
+    uint8_t* p = _buf.data();
+    for (int y = 0; y < _h; y++) {
+        for (int x = 0; x < _w; x++, p += 2) {
+            seed = seed * 1664525u + 1013904223u;
+            int noise = (int)(seed >> 29) - 4;      // nhiễu cảm biến ±4
+            float ex = (x - cx) / (fw * 0.5f), ey = (y - cy) / (fh * 0.5f);
+            if (empty || ex * ex + ey * ey >= 1) {
+                int v = 70 + ((x / 12 + y / 12) & 1) * 20 + noise;
+                putPixel(p, v, v, v + 10);
+                continue;
+            }
+            // Vân da gắn theo toạ độ mặt -> tracker bám được, liveness thấy được biểu cảm
+            float lx = x - cx, ly = y - cy;
+            int v = 165 + (int)(18 * sinf(lx * 0.35f) * cosf(ly * 0.28f)) + noise;
+            if (fabsf(ly - (eyeY - cy)) < (blink ? 1.5f : 4.5f) &&
+                (fabsf(lx + eyeDx) < 7 || fabsf(lx - eyeDx) < 7)) v = 35;
+            if (fabsf(x - noseX) < 3 && y > eyeY + 4 && y < noseY) v -= 40;
+            if (fabsf(y - mouthY) < mouth && fabsf(lx) < fw * 0.16f) v = 60;
+            putPixel(p, v + 25, v, v - 20);
+        }
+    }
+
+    if (empty) return;
+    BenchFace& f = _faces[i + _empty][0];
+    f.box = {(int16_t)(cx - fw * 0.5f), (int16_t)(cy - fh * 0.5f), (int16_t)fw, (int16_t)fh};
+    f.lm = {cx - eyeDx, eyeY, cx + eyeDx, eyeY, noseX, noseY};
+}
+
+bool FrameSource::next(Rgb565Frame& frame) {
+    if (_next >= _count) return false;
+    _index = _next++;
+    if (_synthetic) {
+        synthesize(_index);
+    } else {
+        FILE* f = fopen(_files[_index].c_str(), "rb");
+        size_t n = f ? fread(_buf.data(), 1, _buf.size(), f) : 0;
+        if (f) fclose(f);
+        if (n != _buf.size()) {
+            fprintf(stderr, "⚠️ [CAMERA] %s: %zu/%zu byte (sai --size?)\n", _files[_index].c_str(), n, _buf.size());
+            return false;
+        }
+    }
+    frame = {_buf.data(), _w, _h};
+    return true;
+}
+
+uint8_t FrameSource::faces(BenchFace* out, uint8_t max) const {
+    const std::vector<BenchFace>& v = _faces[_index];
+    uint8_t n = 0;
+    for (; n < v.size() && n < max; n++) out[n] = v[n];
+    return n;
+}
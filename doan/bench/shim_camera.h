@@ -0,0 +1,52 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include "liveness.h"   // TrackBox, LiveLandmarks, Rgb565Frame
+
+// Giả lập camera cho bản build trên máy tính: phát lại frame RGB565 ghi từ kiosk, hoặc tự
+// sinh chuỗi mặt tổng hợp (di chuyển, chớp mắt, quay đầu nhẹ) khi không có dữ liệu ghi.
+//
+// Thư mục frame ghi lại:
+//   <dir>/000000.rgb565, 000001.rgb565 ...  width*height*2 byte, thứ tự byte như camera
+//   <dir>/faces.csv (tuỳ chọn)              kết quả detector ghi kèm (máy tính không có ESP-DL):
+//       frame,x,y,w,h,left_eye_x,left_eye_y,right_eye_x,right_eye_y,nose_x,nose_y
+//   dòng bắt đầu bằng '#' bị bỏ qua; frame không có dòng nào -> không có mặt.
+
+#define CAMERA_MAX_FACES 4
+
+struct BenchFace {
+    TrackBox box;
+    LiveLandmarks lm;
+};
+
+class FrameSource {
+public:
+    bool openDir(const char* dir, uint16_t width, uint16_t height);
+    // empty: số frame đầu chỉ có nền (không ai trước máy) để đo chế độ chờ
+    void openSynthetic(uint32_t frames, uint16_t width, uint16_t height, uint32_t empty = 0);
+
+    // Đọc frame kế tiếp vào buffer nội bộ (hợp lệ tới lần gọi sau). false khi hết.
+    bool next(Rgb565Frame& frame);
+    // Kết quả "detector" của frame vừa đọc
+    uint8_t faces(BenchFace* out, uint8_t max) const;
+
+    uint32_t index() const { return _index; }
+    uint32_t count() const { return _count; }
+    bool synthetic() const { return _synthetic; }
+
+private:
+    bool loadFaces(const std::string& path);
+    void synthesize(uint32_t i);
+
+    uint16_t _w = 0, _h = 0;
+    uint32_t _count = 0;
+    uint32_t _index = 0;          // frame vừa đọc
+    uint32_t _next = 0;
+    uint32_t _empty = 0;
+    bool _synthetic = false;
+    std::vector<std::string> _files;
+    std::vector<std::vector<BenchFace>> _faces;
+    std::vector<uint8_t> _buf;
+};
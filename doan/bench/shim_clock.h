@@ -0,0 +1,34 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+#include <chrono>
+
+// Thay cho millis()/micros() của Arduino và DS3231 (rtc.now()) khi chạy trên máy tính.
+// micros() tràn sau ~71 phút giống hệt trên ESP32 -> phép trừ không dấu vẫn đúng.
+
+inline uint64_t hostMicros64() {
+    using namespace std::chrono;
+    static const steady_clock::time_point t0 = steady_clock::now();
+    return (uint64_t)duration_cast<microseconds>(steady_clock::now() - t0).count();
+}
+inline uint32_t hostMicros() { return (uint32_t)hostMicros64(); }
+inline uint32_t hostMillis() { return (uint32_t)(hostMicros64() / 1000); }
+
+// Giờ RTC (giây Unix, giờ địa phương như DS3231 trên kiosk)
+inline uint32_t rtcUnixTime() { return (uint32_t)time(nullptr); }
+
+// "YYYY-MM-DDTHH:MM:SS" giống getIsoTime() trên kiosk
+inline void rtcIsoTime(char* out, size_t n) {
+    time_t t = time(nullptr);
+    struct tm tmv;
+    localtime_r(&t, &tmv);
+    strftime(out, n, "%Y-%m-%dT%H:%M:%S", &tmv);
+}
+
+// Chờ bận (giả lập thời gian chạy của phần cứng không có trên máy tính, vd detector ESP-DL)
+inline void busyWaitUs(uint32_t us) {
+    uint64_t end = hostMicros64() + us;
+    while (hostMicros64() < end) {
+    }
+}
@@ -0,0 +1,169 @@
+#include "shim_http.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+bool HttpShim::begin(const char* hostPort) {
+    const char* colon = strrchr(hostPort, ':');
+    if (!colon) return false;
+    close();
+    _host.assign(hostPort, colon - hostPort);
+    _port = (uint16_t)atoi(colon + 1);
+    return _port != 0;
+}
+
+void HttpShim::close() {
+    if (_fd >= 0) ::close(_fd);
+    _fd = -1;
+    _rx.clear();
+    _rxPos = 0;
+}
+
+bool HttpShim::connectTo(uint32_t timeoutMs) {
+    close();
+    char port[8];
+    snprintf(port, sizeof(port), "%u", _port);
+    struct addrinfo hints = {}, *res = nullptr;
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(_host.c_str(), port, &hints, &res) != 0) return false;
+    for (struct addrinfo* a = res; a && _fd < 0; a = a->ai_next) {
+        int fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+        if (fd < 0) continue;
+        struct timeval tv = {(time_t)(timeoutMs / 1000), (suseconds_t)((timeoutMs % 1000) * 1000)};
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+        if (::connect(fd, a->ai_addr, a->ai_addrlen) == 0) {
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            _fd = fd;
+        } else {
+            ::close(fd);
+        }
+    }
+    freeaddrinfo(res);
+    if (_fd >= 0) _stats.handshakes++;
+    return _fd >= 0;
+}
+
+bool HttpShim::sendAll(const void* data, size_t len) {
+    const uint8_t* p = (const uint8_t*)data;
+    while (len) {
+        ssize_t n = ::send(_fd, p, len, MSG_NOSIGNAL);
+        if (n <= 0) return false;
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+int HttpShim::readByte() {
+    if (_rxPos >= _rx.size()) {
+        uint8_t tmp[2048];
+        ssize_t n = ::recv(_fd, tmp, sizeof(tmp), 0);
+        if (n <= 0) return -1;
+        _rx.assign(tmp, tmp + n);
+        _rxPos = 0;
+    }
+    return _rx[_rxPos++];
+}
+
+// Đọc 1 dòng kết thúc bằng CRLF (bỏ CRLF). false nếu kết nối đóng.
+bool HttpShim::readLine(std::string& line) {
+    line.clear();
+    for (;;) {
+        int c = readByte();
+        if (c < 0) return false;
+        if (c == '\n') break;
+        if (c != '\r') line += (char)c;
+    }
+    return true;
+}
+
+int HttpShim::readResponse(std::string* response, bool& keepAlive) {
+    std::string line;
+    if (!readLine(line)) return -1;
+    int code = 0;
+    if (sscanf(line.c_str(), "HTTP/%*d.%*d %d", &code) != 1) return -1;
+
+    long contentLength = -1;
+    bool chunked = false;
+    keepAlive = true;
+    while (readLine(line) && !line.empty()) {
+        const char* v = strchr(line.c_str(), ':');
+        if (!v) continue;
+        size_t nameLen = v - line.c_str();
+        do v++; while (*v == ' ');
+        if (nameLen == 14 && strncasecmp(line.c_str(), "Content-Length", 14) == 0) contentLength = atol(v);
+        else if (nameLen == 17 && strncasecmp(line.c_str(), "Transfer-Encoding", 17) == 0) chunked = strcasestr(v, "chunked");
+        else if (nameLen == 10 && strncasecmp(line.c_str(), "Connection", 10) == 0) keepAlive = !strcasestr(v, "close");
+    }
+
+    std::string body;
+    if (chunked) {
+        for (;;) {
+            if (!readLine(line)) return -1;
+            long n = strtol(line.c_str(), nullptr, 16);
+            if (n <= 0) break;
+            for (long i = 0; i < n; i++) {
+                int c = readByte();
+                if (c < 0) return -1;
+                body += (char)c;
+            }
+            readLine(line);
+        }
+        readLine(line);
+    } else if (contentLength >= 0) {
+        for (long i = 0; i < contentLength; i++) {
+            int c = readByte();
+            if (c < 0) return -1;
+            body += (char)c;
+        }
+    } else {
+        // Không có độ dài -> đọc tới khi server đóng kết nối
+        for (int c; (c = readByte()) >= 0;) body += (char)c;
+        keepAlive = false;
+    }
+    if (response) *response = body;
+    return code;
+}
+
+int HttpShim::post(const char* path, const std::vector<std::string>& headers, const std::vector<Part>& body,
+                   uint32_t timeoutMs, std::string* response) {
+    size_t total = 0;
+    for (const Part& p : body) total += p.len;
+    std::string head = "POST " + std::string(path) + " HTTP/1.1\r\nHost: " + _host + "\r\nConnection: keep-alive\r\n" +
+                       "Content-Length: " + std::to_string(total) + "\r\n";
+    for (const std::string& h : headers) head += h + "\r\n";
+    head += "\r\n";
+
+    _stats.requests++;
+    for (int attempt = 0; attempt < 2; attempt++) {
+        bool reused = _fd >= 0;
+        if (!reused && !connectTo(timeoutMs)) return -1;
+        if (reused) _stats.reused++;
+
+        struct timeval tv = {(time_t)(timeoutMs / 1000), (suseconds_t)((timeoutMs % 1000) * 1000)};
+        setsockopt(_fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        bool sent = sendAll(head.data(), head.size());
+        for (size_t i = 0; sent && i < body.size(); i++) sent = sendAll(body[i].data, body[i].len);
+
+        bool keepAlive = false;
+        int code = sent ? readResponse(response, keepAlive) : -1;
+        if (code > 0) {
+            if (!keepAlive) close();
+            return code;
+        }
+        close();
+        // Kết nối keep-alive đã bị server đóng -> mở lại và gửi lại 1 lần
+        if (!reused) return -1;
+        _stats.reconnects++;
+    }
+    return -1;
+}
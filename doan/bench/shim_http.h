@@ -0,0 +1,46 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+// Thay HttpSession (WiFiClient + HTTPClient) khi chạy trên máy tính: HTTP/1.1 keep-alive qua
+// socket POSIX tới server thật hoặc bench/mock_server.mjs. Cùng cách giữ kết nối như trên kiosk:
+// 1 kết nối TCP dùng lại qua nhiều request, server đã đóng socket thì mở lại và gửi lại 1 lần.
+class HttpShim {
+public:
+    struct Stats {
+        uint32_t requests;
+        uint32_t reused;
+        uint32_t handshakes;
+        uint32_t reconnects;
+    };
+    struct Part {
+        const uint8_t* data;
+        size_t len;
+    };
+
+    ~HttpShim() { close(); }
+    // "host:port"
+    bool begin(const char* hostPort);
+    // POST các phần body nối liền nhau. headers: "Name: value" mỗi dòng, không có CRLF cuối.
+    // Trả về HTTP code, < 0 nếu lỗi kết nối / timeout.
+    int post(const char* path, const std::vector<std::string>& headers, const std::vector<Part>& body,
+             uint32_t timeoutMs, std::string* response = nullptr);
+    void close();
+    Stats stats() const { return _stats; }
+
+private:
+    bool connectTo(uint32_t timeoutMs);
+    bool sendAll(const void* data, size_t len);
+    int readResponse(std::string* response, bool& keepAlive);
+    int readByte();
+    bool readLine(std::string& line);
+
+    std::string _host;
+    uint16_t _port = 0;
+    int _fd = -1;
+    std::vector<uint8_t> _rx;     // dữ liệu đã nhận chưa dùng
+    size_t _rxPos = 0;
+    Stats _stats = {};
+};
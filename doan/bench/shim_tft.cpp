@@ -0,0 +1,40 @@
+#include "shim_tft.h"
+#include <stdio.h>
+#include <vector>
+
+void TftShim::begin(const char* dumpDir, uint32_t every) {
+    _dir = dumpDir;
+    _every = every ? every : 1;
+    _frames = 0;
+}
+
+void TftShim::push(const Rgb565Frame& frame, const TrackBox* box) {
+    if (!_dir || (_frames++ % _every) != 0) return;
+
+    const int w = frame.width, h = frame.height;
+    std::vector<uint8_t> rgb((size_t)w * h * 3);
+    for (int i = 0; i < w * h; i++) {
+        uint16_t v = (frame.buf[i * 2] << 8) | frame.buf[i * 2 + 1];
+        rgb[i * 3] = (v >> 8) & 0xF8;
+        rgb[i * 3 + 1] = (v >> 3) & 0xFC;
+        rgb[i * 3 + 2] = (v << 3) & 0xF8;
+    }
+    if (box) {
+        // Khung xanh lá như overlay trên kiosk
+        auto dot = [&](int x, int y) {
+            if (x < 0 || y < 0 || x >= w || y >= h) return;
+            uint8_t* p = &rgb[((size_t)y * w + x) * 3];
+            p[0] = 0; p[1] = 255; p[2] = 0;
+        };
+        for (int x = box->x; x < box->x + box->w; x++) { dot(x, box->y); dot(x, box->y + box->h - 1); }
+        for (int y = box->y; y < box->y + box->h; y++) { dot(box->x, y); dot(box->x + box->w - 1, y); }
+    }
+
+    char path[256];
+    snprintf(path, sizeof(path), "%s/frame_%06u.ppm", _dir, _frames - 1);
+    FILE* f = fopen(path, "wb");
+    if (!f) return;
+    fprintf(f, "P6\n%d %d\n255\n", w, h);
+    fwrite(rgb.data(), 1, rgb.size(), f);
+    fclose(f);
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "face_tracker.h"   // TrackBox, Rgb565Frame
+
+// Giả lập màn TFT khi chạy trên máy tính: mặc định không làm gì; có thư mục dump thì cứ
+// every frame ghi 1 ảnh PPM (frame preview + khung mặt) để xem lại kết quả tracker.
+class TftShim {
+public:
+    void begin(const char* dumpDir, uint32_t every);
+    bool enabled() const { return _dir != nullptr; }
+    void push(const Rgb565Frame& frame, const TrackBox* box);
+
+private:
+    const char* _dir = nullptr;
+    uint32_t _every = 1;
+    uint32_t _frames = 0;
+};
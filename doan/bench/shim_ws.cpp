@@ -0,0 +1,174 @@
+#include "shim_ws.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+bool WsShim::connect(const char* hostPort, const char* path, uint32_t timeoutMs) {
+    close();
+    const char* colon = strrchr(hostPort, ':');
+    if (!colon) return false;
+    std::string host(hostPort, colon - hostPort);
+    struct addrinfo hints = {}, *res = nullptr;
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host.c_str(), colon + 1, &hints, &res) != 0) return false;
+    for (struct addrinfo* a = res; a && _fd < 0; a = a->ai_next) {
+        int fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+        if (fd < 0) continue;
+        struct timeval tv = {(time_t)(timeoutMs / 1000), (suseconds_t)((timeoutMs % 1000) * 1000)};
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        if (::connect(fd, a->ai_addr, a->ai_addrlen) == 0) {
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            _fd = fd;
+        } else {
+            ::close(fd);
+        }
+    }
+    freeaddrinfo(res);
+    if (_fd < 0) return false;
+
+    // Key cố định: shim không kiểm tra Sec-WebSocket-Accept
+    std::string req = "GET " + std::string(path) + " HTTP/1.1\r\nHost: " + hostPort +
+                      "\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                      "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n\r\n";
+    if (!sendAll(req.data(), req.size())) {
+        close();
+        return false;
+    }
+    // Đọc từng byte tới hết header để không nuốt mất frame đầu tiên của server
+    std::string head;
+    char c;
+    while (head.size() < 4096 && (head.size() < 4 || head.compare(head.size() - 4, 4, "\r\n\r\n") != 0)) {
+        if (::recv(_fd, &c, 1, 0) != 1) {
+            close();
+            return false;
+        }
+        head += c;
+    }
+    int code = 0;
+    if (sscanf(head.c_str(), "HTTP/%*d.%*d %d", &code) != 1 || code != 101) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void WsShim::close() {
+    if (_fd >= 0) ::close(_fd);
+    _fd = -1;
+}
+
+bool WsShim::sendAll(const void* data, size_t len) {
+    const uint8_t* p = (const uint8_t*)data;
+    while (len) {
+        ssize_t n = ::send(_fd, p, len, MSG_NOSIGNAL);
+        if (n <= 0) return false;
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+bool WsShim::readExact(void* dst, size_t len) {
+    uint8_t* p = (uint8_t*)dst;
+    while (len) {
+        ssize_t n = ::recv(_fd, p, len, 0);
+        if (n <= 0) return false;
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+bool WsShim::sendFrame(uint8_t opcode, const void* data, size_t len) {
+    if (_fd < 0) return false;
+    _tx.resize(14 + len);
+    uint8_t* h = _tx.data();
+    size_t n = 0;
+    h[n++] = 0x80 | opcode;
+    if (len < 126) {
+        h[n++] = 0x80 | (uint8_t)len;
+    } else if (len <= 0xFFFF) {
+        h[n++] = 0x80 | 126;
+        h[n++] = len >> 8;
+        h[n++] = len;
+    } else {
+        h[n++] = 0x80 | 127;
+        for (int i = 7; i >= 0; i--) h[n++] = (uint64_t)len >> (8 * i);
+    }
+    _maskSeed = _maskSeed * 1664525u + 1013904223u;
+    uint8_t mask[4] = {(uint8_t)(_maskSeed >> 24), (uint8_t)(_maskSeed >> 16), (uint8_t)(_maskSeed >> 8),
+                       (uint8_t)_maskSeed};
+    memcpy(h + n, mask, 4);
+    n += 4;
+    const uint8_t* src = (const uint8_t*)data;
+    for (size_t i = 0; i < len; i++) h[n + i] = src[i] ^ mask[i & 3];
+    if (!sendAll(h, n + len)) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool WsShim::sendBinary(const void* data, size_t len) {
+    return sendFrame(WS_BINARY, data, len);
+}
+
+int WsShim::receive(std::string& payload, uint32_t timeoutMs) {
+    for (;;) {
+        if (_fd < 0) return -1;
+        struct pollfd pfd = {_fd, POLLIN, 0};
+        int r = poll(&pfd, 1, (int)timeoutMs);
+        if (r == 0) return 0;
+        if (r < 0) return -1;
+
+        uint8_t h[2];
+        if (!readExact(h, 2)) {
+            close();
+            return -1;
+        }
+        uint8_t opcode = h[0] & 0x0F;
+        uint64_t len = h[1] & 0x7F;
+        if (len == 126 || len == 127) {
+            uint8_t ext[8];
+            size_t extLen = (len == 126) ? 2 : 8;
+            if (!readExact(ext, extLen)) {
+                close();
+                return -1;
+            }
+            len = 0;
+            for (size_t i = 0; i < extLen; i++) len = (len << 8) | ext[i];
+        }
+        uint8_t mask[4] = {};
+        bool masked = h[1] & 0x80;
+        if (masked && !readExact(mask, 4)) {
+            close();
+            return -1;
+        }
+        payload.resize(len);
+        if (len && !readExact(&payload[0], len)) {
+            close();
+            return -1;
+        }
+        if (masked) for (size_t i = 0; i < len; i++) payload[i] ^= mask[i & 3];
+
+        if (opcode == WS_PING) {
+            sendFrame(WS_PONG, payload.data(), payload.size());
+            continue;
+        }
+        if (opcode == WS_CLOSE) {
+            close();
+            return -1;
+        }
+        if (opcode == WS_TEXT || opcode == WS_BINARY) return opcode;
+    }
+}
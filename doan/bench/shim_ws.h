@@ -0,0 +1,32 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+// Thay WebSocketsClient khi chạy trên máy tính: client WebSocket tối giản qua socket POSIX
+// (handshake HTTP Upgrade, frame có mask như client thật, không chia mảnh) tới server thật hoặc
+// bench/mock_server.mjs. Đủ để đo đường gửi ảnh qua /ws (ws_uplink) so với HTTP POST.
+class WsShim {
+public:
+    enum Opcode { WS_TEXT = 1, WS_BINARY = 2, WS_CLOSE = 8, WS_PING = 9, WS_PONG = 10 };
+
+    ~WsShim() { close(); }
+    // "host:port", path "/ws"
+    bool connect(const char* hostPort, const char* path, uint32_t timeoutMs);
+    bool connected() const { return _fd >= 0; }
+    // 1 message nhị phân (mask như client thật -> có 1 lần chép)
+    bool sendBinary(const void* data, size_t len);
+    // Chờ tối đa timeoutMs cho 1 message text/binary. Trả về opcode, 0 nếu hết giờ, < 0 nếu mất kết nối.
+    int receive(std::string& payload, uint32_t timeoutMs);
+    void close();
+
+private:
+    bool sendFrame(uint8_t opcode, const void* data, size_t len);
+    bool sendAll(const void* data, size_t len);
+    bool readExact(void* dst, size_t len);
+
+    int _fd = -1;
+    std::vector<uint8_t> _tx;
+    uint32_t _maskSeed = 0x9E3779B9u;
+};
@@ -0,0 +1,179 @@
+#include "async_log.h"
+#include <stdio.h>
+#include <string.h>
+
+static_assert((LOG_RING_SLOTS & (LOG_RING_SLOTS - 1)) == 0, "LOG_RING_SLOTS phải là luỹ thừa của 2");
+
+LogRing::LogRing() {
+    // Ô i sẵn sàng cho lượt ghi thứ i
+    for (uint32_t i = 0; i < LOG_RING_SLOTS; i++) _slots[i].seq.store(i, std::memory_order_relaxed);
+}
+
+bool LogRing::push(uint8_t level, uint32_t timeMs, const char* fmt, const LogArg* args, uint8_t n) {
+    uint32_t pos = _head.load(std::memory_order_relaxed);
+    Slot* s;
+    for (;;) {
+        s = &_slots[pos & (LOG_RING_SLOTS - 1)];
+        uint32_t seq = s->seq.load(std::memory_order_acquire);
+        int32_t diff = (int32_t)(seq - pos);
+        if (diff == 0) {
+            // Giành ô pos; task khác giành trước thì pos được nạp lại và thử tiếp
+            if (_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+        } else if (diff < 0) {
+            // Task đọc chưa giải phóng ô này -> ring đầy
+            _dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        } else {
+            pos = _head.load(std::memory_order_relaxed);
+        }
+    }
+
+    s->timeMs = timeMs;
+    s->fmt = fmt;
+    s->level = level;
+    s->n = n < LOG_MAX_ARGS ? n : LOG_MAX_ARGS;
+    uint32_t textLen = 0;
+    bool cut = false;
+    s->text[LOG_TEXT - 1] = '\0';       // chuỗi rỗng cho tham số hết chỗ
+    for (uint8_t i = 0; i < s->n; i++) {
+        s->types[i] = args[i].type;
+        if (args[i].type != LogArg::STR) {
+            s->args[i].u = args[i].u;
+            continue;
+        }
+        // Chuỗi có thể là biến tạm (String::c_str()) -> chép ngay
+        const char* src = args[i].s ? args[i].s : "(null)";
+        size_t room = textLen < LOG_TEXT - 1 ? LOG_TEXT - 1 - textLen : 0;
+        size_t len = strnlen(src, room + 1);
+        if (len > room) {
+            len = room;
+            cut = true;
+        }
+        if (!room) {
+            s->args[i].str = LOG_TEXT - 1;
+            continue;
+        }
+        memcpy(s->text + textLen, src, len);
+        s->text[textLen + len] = '\0';
+        s->args[i].str = textLen;
+        textLen += len + 1;
+    }
+    s->seq.store(pos + 1, std::memory_order_release);
+
+    _written.fetch_add(1, std::memory_order_relaxed);
+    if (cut) _truncated.fetch_add(1, std::memory_order_relaxed);
+    uint32_t used = pos + 1 - _tail.load(std::memory_order_relaxed);
+    uint32_t hw = _highWater.load(std::memory_order_relaxed);
+    if (used <= LOG_RING_SLOTS && used > hw) _highWater.store(used, std::memory_order_relaxed);
+    return true;
+}
+
+bool LogRing::pop(char* line, size_t size, uint8_t* level, uint32_t* timeMs) {
+    const uint32_t tail = _tail.load(std::memory_order_relaxed);
+    Slot* s = &_slots[tail & (LOG_RING_SLOTS - 1)];
+    if (s->seq.load(std::memory_order_acquire) != tail + 1) return false;
+
+    LogArg args[LOG_MAX_ARGS];
+    for (uint8_t i = 0; i < s->n; i++) {
+        args[i].type = s->types[i];
+        if (s->types[i] == LogArg::STR) args[i].s = s->text + s->args[i].str;
+        else args[i].u = s->args[i].u;
+    }
+    logFormat(line, size, s->fmt, args, s->n);
+    if (level) *level = s->level;
+    if (timeMs) *timeMs = s->timeMs;
+
+    // Trả ô cho lượt ghi vòng sau
+    s->seq.store(tail + LOG_RING_SLOTS, std::memory_order_release);
+    _tail.store(tail + 1, std::memory_order_relaxed);
+    return true;
+}
+
+bool LogRing::empty() const {
+    const uint32_t tail = _tail.load(std::memory_order_relaxed);
+    return _slots[tail & (LOG_RING_SLOTS - 1)].seq.load(std::memory_order_acquire) != tail + 1;
+}
+
+LogStats LogRing::stats() const {
+    LogStats st;
+    st.written = _written.load(std::memory_order_relaxed);
+    st.dropped = _dropped.load(std::memory_order_relaxed);
+    st.truncated = _truncated.load(std::memory_order_relaxed);
+    st.highWater = _highWater.load(std::memory_order_relaxed);
+    return st;
+}
+
+size_t logFormat(char* out, size_t size, const char* fmt, const LogArg* args, uint8_t n) {
+    if (!size) return 0;
+    size_t len = 0;
+    uint8_t next = 0;
+    auto room = [&]() { return len < size ? size - len : 0; };
+    auto advance = [&](int w) {
+        if (w > 0) len += (size_t)w;
+        if (len >= size) len = size - 1;
+    };
+
+    while (*fmt && len + 1 < size) {
+        if (*fmt != '%') {
+            out[len++] = *fmt++;
+            continue;
+        }
+        if (fmt[1] == '%') {
+            out[len++] = '%';
+            fmt += 2;
+            continue;
+        }
+        // Tách "%[flag][width][.precision]" rồi bỏ length modifier
+        char spec[24];
+        size_t k = 0;
+        spec[k++] = *fmt++;
+        while (*fmt && strchr("-+ #0123456789.", *fmt) && k < sizeof(spec) - 5) spec[k++] = *fmt++;
+        while (*fmt && strchr("hlLqjzt", *fmt)) fmt++;
+        char conv = *fmt;
+        if (!conv) break;
+        fmt++;
+
+        const LogArg* a = next < n ? &args[next++] : nullptr;
+        if (!a) {
+            advance(snprintf(out + len, room(), "<?>"));
+            continue;
+        }
+        switch (conv) {
+            case 'c':
+                spec[k++] = 'c';
+                spec[k] = '\0';
+                advance(snprintf(out + len, room(), spec, (int)a->i));
+                break;
+            case 'd': case 'i': case 'u': case 'x': case 'X': case 'o': {
+                spec[k++] = 'l';
+                spec[k++] = 'l';
+                spec[k++] = conv;
+                spec[k] = '\0';
+                long long v = (a->type == LogArg::FLOAT) ? (long long)a->d : a->i;
+                advance(snprintf(out + len, room(), spec, v));
+                break;
+            }
+            case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': {
+                spec[k++] = conv;
+                spec[k] = '\0';
+                double v = (a->type == LogArg::FLOAT) ? a->d
+                         : (a->type == LogArg::INT) ? (double)a->i : (double)a->u;
+                advance(snprintf(out + len, room(), spec, v));
+                break;
+            }
+            case 's':
+                spec[k++] = 's';
+                spec[k] = '\0';
+                advance(snprintf(out + len, room(), spec, a->type == LogArg::STR ? a->s : "<?>"));
+                break;
+            case 'p':
+                advance(snprintf(out + len, room(), "%p", a->p));
+                break;
+            default:
+                advance(snprintf(out + len, room(), "<%%%c?>", conv));
+                break;
+        }
+    }
+    out[len] = '\0';
+    return len;
+}
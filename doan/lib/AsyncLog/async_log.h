@@ -0,0 +1,118 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+// Log bất đồng bộ: task gọi log chỉ chép format + tham số (chưa định dạng) vào 1 ô của ring
+// buffer không khoá (nhiều task ghi, 1 task đọc, kiểu hàng đợi có số thứ tự từng ô), việc
+// định dạng chuỗi và ghi UART / thẻ SD do task drain ưu tiên thấp làm sau.
+//   - format phải là chuỗi hằng (chỉ lưu con trỏ)
+//   - tham số chuỗi (const char*, String, std::string) được chép ngay vào ô, tối đa LOG_TEXT byte
+//     cho cả dòng; dài hơn thì bị cắt
+//   - ring đầy -> bỏ dòng mới, đếm vào dropped (không bao giờ chờ)
+// Hỗ trợ %d %i %u %x %X %o %c %f %e %g %s %p %% với flag/độ rộng/độ chính xác; bỏ qua
+// length modifier (l, ll, h, z...) vì kiểu thật đã được ghi lại theo từng tham số.
+// Thuần C++ (không phụ thuộc Arduino) -> build và đo tốc độ được trên Linux.
+
+#define LOG_RING_SLOTS  64         // luỹ thừa của 2
+#define LOG_MAX_ARGS    8
+#define LOG_TEXT        48         // byte chứa các tham số chuỗi của 1 dòng
+#define LOG_LINE_MAX    256        // độ dài tối đa 1 dòng sau khi định dạng
+
+enum LogLevel : uint8_t {
+    LOG_LEVEL_NONE  = 0,
+    LOG_LEVEL_ERROR = 1,
+    LOG_LEVEL_WARN  = 2,
+    LOG_LEVEL_INFO  = 3,
+    LOG_LEVEL_DEBUG = 4,
+};
+
+struct LogArg {
+    enum Type : uint8_t { NONE, INT, UINT, FLOAT, STR, PTR };
+    Type type;
+    union {
+        int64_t i;
+        uint64_t u;
+        double d;
+        const char* s;
+        const void* p;
+    };
+
+    LogArg() : type(NONE), u(0) {}
+    LogArg(bool v) : type(INT), i(v) {}
+    LogArg(char v) : type(INT), i(v) {}
+    LogArg(signed char v) : type(INT), i(v) {}
+    LogArg(short v) : type(INT), i(v) {}
+    LogArg(int v) : type(INT), i(v) {}
+    LogArg(long v) : type(INT), i(v) {}
+    LogArg(long long v) : type(INT), i(v) {}
+    LogArg(unsigned char v) : type(UINT), u(v) {}
+    LogArg(unsigned short v) : type(UINT), u(v) {}
+    LogArg(unsigned int v) : type(UINT), u(v) {}
+    LogArg(unsigned long v) : type(UINT), u(v) {}
+    LogArg(unsigned long long v) : type(UINT), u(v) {}
+    LogArg(float v) : type(FLOAT), d(v) {}
+    LogArg(double v) : type(FLOAT), d(v) {}
+    LogArg(const char* v) : type(STR), s(v) {}
+    LogArg(char* v) : type(STR), s(v) {}
+    LogArg(const void* v) : type(PTR), p(v) {}
+    // String (Arduino), std::string...
+    template <typename T, typename = decltype(((const T*)0)->c_str())>
+    LogArg(const T& v) : type(STR), s(v.c_str()) {}
+};
+
+struct LogStats {
+    uint32_t written;         // dòng đã vào ring
+    uint32_t dropped;         // dòng bị bỏ vì ring đầy
+    uint32_t truncated;       // dòng có tham số chuỗi bị cắt
+    uint32_t highWater;       // số ô dùng nhiều nhất cùng lúc
+};
+
+class LogRing {
+public:
+    LogRing();
+
+    // Bỏ qua các dòng có level > level (lọc lúc chạy, sau khi đã lọc lúc biên dịch)
+    void setLevel(uint8_t level) { _level.store(level, std::memory_order_relaxed); }
+    uint8_t level() const { return _level.load(std::memory_order_relaxed); }
+
+    template <typename... A>
+    bool write(uint8_t level, uint32_t timeMs, const char* fmt, const A&... a) {
+        if (level > _level.load(std::memory_order_relaxed)) return false;
+        const LogArg args[sizeof...(A) + 1] = {LogArg(a)..., LogArg()};
+        return push(level, timeMs, fmt, args, sizeof...(A));
+    }
+    bool push(uint8_t level, uint32_t timeMs, const char* fmt, const LogArg* args, uint8_t n);
+
+    // Chỉ 1 task đọc. Định dạng dòng cũ nhất vào line (không có '\n'), false nếu ring rỗng.
+    bool pop(char* line, size_t size, uint8_t* level, uint32_t* timeMs);
+    bool empty() const;
+    LogStats stats() const;
+
+private:
+    struct Slot {
+        std::atomic<uint32_t> seq;
+        uint32_t timeMs;
+        const char* fmt;
+        uint8_t level;
+        uint8_t n;
+        LogArg::Type types[LOG_MAX_ARGS];
+        union {
+            int64_t i;
+            uint64_t u;
+            double d;
+            uint32_t str;      // vị trí chuỗi trong text
+            const void* p;
+        } args[LOG_MAX_ARGS];
+        char text[LOG_TEXT];
+    };
+
+    Slot _slots[LOG_RING_SLOTS];
+    std::atomic<uint32_t> _head{0};      // ô kế tiếp cho task ghi
+    std::atomic<uint32_t> _tail{0};      // ô kế tiếp cho task đọc (chỉ task đọc ghi)
+    std::atomic<uint8_t> _level{LOG_LEVEL_DEBUG};
+    std::atomic<uint32_t> _written{0}, _dropped{0}, _truncated{0}, _highWater{0};
+};
+
+// Định dạng fmt với các tham số đã ghi lại (dùng chung cho pop và để kiểm tra trên máy tính)
+size_t logFormat(char* out, size_t size, const char* fmt, const LogArg* args, uint8_t n);
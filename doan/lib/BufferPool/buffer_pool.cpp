@@ -0,0 +1,126 @@
+#include "buffer_pool.h"
+#include <stdlib.h>
+
+#if defined(ESP_PLATFORM)
+#include <esp_heap_caps.h>
+// Ưu tiên PSRAM, hết PSRAM mới lấy RAM trong
+static void* poolAlloc(size_t n) {
+    void* p = heap_caps_aligned_alloc(16, n, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    return p ? p : heap_caps_aligned_alloc(16, n, MALLOC_CAP_8BIT);
+}
+static void poolFree(void* p) { heap_caps_free(p); }
+#else
+static void* poolAlloc(size_t n) { return aligned_alloc(16, n); }
+static void poolFree(void* p) { free(p); }
+#endif
+
+bool BufferPool::begin(size_t blockSize, uint8_t blocks) {
+    end();
+    if (blockSize == 0 || blocks == 0 || blocks > BUFFER_POOL_MAX_BLOCKS) return false;
+    _blockSize = (blockSize + 15) & ~(size_t)15;
+    _base = (uint8_t*)poolAlloc(_blockSize * blocks);
+    if (!_base) {
+        _blockSize = 0;
+        return false;
+    }
+    _blocks = blocks;
+    _used.store(0);
+    _highWater.store(0);
+    _acquired.store(0);
+    _exhausted.store(0);
+    _oversize.store(0);
+    return true;
+}
+
+void BufferPool::end() {
+    if (_base) poolFree(_base);
+    _base = nullptr;
+    _blockSize = 0;
+    _blocks = 0;
+    _used.store(0);
+}
+
+uint8_t* BufferPool::acquire(size_t len) {
+    if (!_base) return nullptr;
+    if (len > _blockSize) {
+        _oversize.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    uint32_t all = (_blocks == 32) ? 0xFFFFFFFFu : ((1u << _blocks) - 1);
+    uint32_t used = _used.load(std::memory_order_relaxed);
+    uint32_t bit;
+    do {
+        uint32_t avail = ~used & all;
+        if (!avail) {
+            _exhausted.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        bit = avail & (0u - avail);           // block rảnh có chỉ số nhỏ nhất
+    } while (!_used.compare_exchange_weak(used, used | bit, std::memory_order_acquire, std::memory_order_relaxed));
+
+    _acquired.fetch_add(1, std::memory_order_relaxed);
+    uint32_t inUse = __builtin_popcount(used | bit);
+    uint32_t hw = _highWater.load(std::memory_order_relaxed);
+    while (inUse > hw && !_highWater.compare_exchange_weak(hw, inUse, std::memory_order_relaxed)) {}
+    return _base + (size_t)__builtin_ctz(bit) * _blockSize;
+}
+
+int BufferPool::indexOf(const void* p) const {
+    const uint8_t* b = (const uint8_t*)p;
+    if (!_base || b < _base || b >= _base + _blockSize * _blocks) return -1;
+    return (int)((size_t)(b - _base) / _blockSize);
+}
+
+void BufferPool::release(const void* p) {
+    int i = indexOf(p);
+    if (i < 0) return;
+    _used.fetch_and(~(1u << i), std::memory_order_release);
+}
+
+bool BufferPool::owns(const void* p) const {
+    return indexOf(p) >= 0;
+}
+
+BufferPoolStats BufferPool::stats() const {
+    BufferPoolStats s;
+    s.blockSize = (uint32_t)_blockSize;
+    s.blocks = _blocks;
+    s.inUse = __builtin_popcount(_used.load(std::memory_order_relaxed));
+    s.highWater = _highWater.load(std::memory_order_relaxed);
+    s.acquired = _acquired.load(std::memory_order_relaxed);
+    s.exhausted = _exhausted.load(std::memory_order_relaxed);
+    s.oversize = _oversize.load(std::memory_order_relaxed);
+    return s;
+}
+
+PoolBuffer& PoolBuffer::operator=(PoolBuffer&& o) noexcept {
+    if (this != &o) {
+        reset();
+        _pool = o._pool;
+        _data = o._data;
+        o._data = nullptr;
+    }
+    return *this;
+}
+
+uint8_t* PoolBuffer::detach() {
+    uint8_t* p = _data;
+    _data = nullptr;
+    return p;
+}
+
+void PoolBuffer::reset() {
+    if (_data) _pool->release(_data);
+    _data = nullptr;
+}
+
+void* ScratchArena::alloc(size_t len, size_t align) {
+    if (!_block) return nullptr;
+    size_t start = (_used + align - 1) & ~(align - 1);
+    if (start + len > _block.capacity()) {
+        _overflows++;
+        return nullptr;
+    }
+    _used = start + len;
+    return _block.data() + start;
+}
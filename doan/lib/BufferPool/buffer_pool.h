@@ -0,0 +1,103 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+// Pool các block cùng cỡ cắt từ 1 vùng nhớ cấp phát 1 lần lúc khởi động (PSRAM trên kiosk):
+// ảnh JPEG của mặt, khung gửi ảnh... lấy / trả block thay vì malloc / free mỗi lượt nhận diện,
+// nên chạy lâu ngày không làm phân mảnh heap. Block rảnh đánh dấu trong 1 bitmap atomic ->
+// lấy ở task này, trả ở task khác (CameraAppTask -> UploaderTask / NetworkTask) không cần khoá.
+//   - PoolBuffer: RAII giữ 1 block, tự trả khi ra khỏi scope; detach() để chuyển quyền sở hữu
+//     qua hàng đợi (struct POD), bên nhận trả bằng release()
+//   - ScratchArena: vùng nhớ tạm cho 1 request, cấp phát kiểu "dời con trỏ" trong 1 block,
+//     trả cả block 1 lần khi xong request
+// Hết block / cần nhiều hơn 1 block -> nullptr và đếm vào stats, người gọi tự quyết định
+// (bỏ frame hoặc cấp phát heap như cũ).
+// Thuần C++ (không phụ thuộc Arduino) -> build và đo tốc độ được trên Linux.
+
+#define BUFFER_POOL_MAX_BLOCKS 32
+
+struct BufferPoolStats {
+    uint32_t blockSize;
+    uint32_t blocks;
+    uint32_t inUse;
+    uint32_t highWater;       // số block dùng đồng thời cao nhất
+    uint32_t acquired;        // tổng số lần lấy được block
+    uint32_t exhausted;       // lấy thất bại vì hết block
+    uint32_t oversize;        // yêu cầu lớn hơn 1 block
+};
+
+class BufferPool {
+public:
+    BufferPool() = default;
+    ~BufferPool() { end(); }
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    // Cấp phát blocks x blockSize (blockSize làm tròn lên bội 16). Chỉ gọi lúc chưa có block nào đang dùng.
+    bool begin(size_t blockSize, uint8_t blocks);
+    void end();
+    bool ready() const { return _base != nullptr; }
+
+    // Không chặn. nullptr nếu len > blockSize() hoặc hết block.
+    uint8_t* acquire(size_t len);
+    // Trả block lấy từ acquire() (bỏ qua nullptr). p có thể trỏ vào giữa block.
+    void release(const void* p);
+    bool owns(const void* p) const;
+
+    size_t blockSize() const { return _blockSize; }
+    BufferPoolStats stats() const;
+
+private:
+    int indexOf(const void* p) const;
+
+    uint8_t* _base = nullptr;
+    size_t _blockSize = 0;
+    uint8_t _blocks = 0;
+    std::atomic<uint32_t> _used{0};          // bit i = block i đang dùng
+    std::atomic<uint32_t> _highWater{0}, _acquired{0}, _exhausted{0}, _oversize{0};
+};
+
+// Giữ 1 block của pool, tự trả khi huỷ. Chỉ di chuyển, không chép.
+class PoolBuffer {
+public:
+    PoolBuffer() = default;
+    PoolBuffer(BufferPool& pool, size_t len) : _pool(&pool), _data(pool.acquire(len)) {}
+    ~PoolBuffer() { reset(); }
+    PoolBuffer(PoolBuffer&& o) noexcept : _pool(o._pool), _data(o._data) { o._data = nullptr; }
+    PoolBuffer& operator=(PoolBuffer&& o) noexcept;
+    PoolBuffer(const PoolBuffer&) = delete;
+    PoolBuffer& operator=(const PoolBuffer&) = delete;
+
+    explicit operator bool() const { return _data != nullptr; }
+    uint8_t* data() const { return _data; }
+    size_t capacity() const { return _data ? _pool->blockSize() : 0; }
+    // Chuyển quyền sở hữu cho người gọi (trả lại bằng BufferPool::release)
+    uint8_t* detach();
+    void reset();
+
+private:
+    BufferPool* _pool = nullptr;
+    uint8_t* _data = nullptr;
+};
+
+// Vùng nhớ tạm cho 1 request trong đúng 1 block của pool: alloc() chỉ dời con trỏ, không có
+// free lẻ; cả block được trả khi arena bị huỷ / reset().
+class ScratchArena {
+public:
+    explicit ScratchArena(BufferPool& pool) : _block(pool, pool.blockSize()) {}
+
+    // nullptr nếu không lấy được block hoặc không còn đủ chỗ (đếm vào overflows())
+    void* alloc(size_t len, size_t align = 4);
+    size_t used() const { return _used; }
+    size_t remaining() const { return _block.capacity() - _used; }
+    uint32_t overflows() const { return _overflows; }
+    bool valid() const { return (bool)_block; }
+    // Giữ block, dùng lại từ đầu
+    void rewind() { _used = 0; }
+
+private:
+    PoolBuffer _block;
+    size_t _used = 0;
+    uint32_t _overflows = 0;
+};
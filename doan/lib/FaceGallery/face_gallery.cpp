@@ -0,0 +1,254 @@
+#include "face_gallery.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "vec_kernels.h"
+
+#if defined(ESP_PLATFORM)
+#include <esp_heap_caps.h>
+// Ưu tiên PSRAM, hết PSRAM mới lấy RAM trong
+static void* galleryAlloc(size_t n) {
+    void* p = heap_caps_aligned_alloc(VK_ALIGN, n, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    return p ? p : heap_caps_aligned_alloc(VK_ALIGN, n, MALLOC_CAP_8BIT);
+}
+static void galleryFree(void* p) { heap_caps_free(p); }
+#else
+static void* galleryAlloc(size_t n) {
+    return aligned_alloc(VK_ALIGN, (n + VK_ALIGN - 1) & ~(size_t)(VK_ALIGN - 1));
+}
+static void galleryFree(void* p) { free(p); }
+#endif
+
+static const char MAGIC[4] = {'F', 'G', 'D', '1'};
+
+static uint16_t rd16(const uint8_t* p) { return p[0] | (p[1] << 8); }
+static uint32_t rd32(const uint8_t* p) { return rd16(p) | ((uint32_t)rd16(p + 2) << 16); }
+static uint64_t rd64(const uint8_t* p) { return rd32(p) | ((uint64_t)rd32(p + 4) << 32); }
+static void wr16(uint8_t* p, uint16_t v) { p[0] = v; p[1] = v >> 8; }
+static void wr32(uint8_t* p, uint32_t v) { wr16(p, v); wr16(p + 2, v >> 16); }
+static void wr64(uint8_t* p, uint64_t v) { wr32(p, (uint32_t)v); wr32(p + 4, (uint32_t)(v >> 32)); }
+
+bool FaceGallery::begin(uint16_t dim, uint32_t capacity) {
+    end();
+    if (dim == 0 || capacity == 0) return false;
+    _dim = dim;
+    _stride = (dim + VK_ALIGN - 1) & ~(VK_ALIGN - 1);
+    _emb = (int8_t*)galleryAlloc((size_t)capacity * _stride);
+    _scale = (float*)galleryAlloc((size_t)capacity * sizeof(float));
+    _ids = (char*)galleryAlloc((size_t)capacity * GALLERY_ID_LEN);
+    _names = (char*)galleryAlloc((size_t)capacity * GALLERY_NAME_LEN);
+    _query = (int8_t*)galleryAlloc(_stride);
+    if (!_emb || !_scale || !_ids || !_names || !_query) {
+        end();
+        return false;
+    }
+    _capacity = capacity;
+    return true;
+}
+
+void FaceGallery::end() {
+    galleryFree(_emb); galleryFree(_scale); galleryFree(_ids);
+    galleryFree(_names); galleryFree(_query);
+    _emb = nullptr; _scale = nullptr; _ids = nullptr; _names = nullptr; _query = nullptr;
+    _dim = 0; _stride = 0; _capacity = 0;
+    clear();
+}
+
+void FaceGallery::clear() {
+    _count = 0;
+    _version = 0;
+    _serverTotal = 0;
+    _dropped = 0;
+}
+
+float FaceGallery::quantize(const float* v, uint16_t dim, int8_t* out) {
+    float norm = 0, maxAbs = 0;
+    for (uint16_t i = 0; i < dim; i++) {
+        norm += v[i] * v[i];
+        float a = fabsf(v[i]);
+        if (a > maxAbs) maxAbs = a;
+    }
+    if (norm <= 0 || maxAbs <= 0) return 0;
+    norm = sqrtf(norm);
+    // Sau chuẩn hoá, phần tử lớn nhất (maxAbs / norm) ứng với 127
+    float scale = maxAbs / norm / 127.0f;
+    float k = 127.0f / maxAbs;
+    for (uint16_t i = 0; i < dim; i++) {
+        long q = lroundf(v[i] * k);
+        out[i] = (int8_t)(q > 127 ? 127 : (q < -127 ? -127 : q));
+    }
+    return scale;
+}
+
+int FaceGallery::find(const char* id) const {
+    for (uint32_t i = 0; i < _count; i++) {
+        if (strncmp(idAt(i), id, GALLERY_ID_LEN) == 0) return (int)i;
+    }
+    return -1;
+}
+
+bool FaceGallery::upsert(const char* id, const char* name, float scale, const int8_t* q) {
+    if (!_emb || !id || !id[0]) return false;
+    int i = find(id);
+    if (i < 0) {
+        if (_count >= _capacity) {
+            _dropped++;
+            return false;
+        }
+        i = (int)_count++;
+    }
+    setRow(i, id, name, scale, q);
+    return true;
+}
+
+void FaceGallery::setRow(uint32_t i, const char* id, const char* name, float scale, const int8_t* q) {
+    char* dstId = _ids + (size_t)i * GALLERY_ID_LEN;
+    char* dstName = _names + (size_t)i * GALLERY_NAME_LEN;
+    snprintf(dstId, GALLERY_ID_LEN, "%s", id);
+    snprintf(dstName, GALLERY_NAME_LEN, "%s", name ? name : "");
+    _scale[i] = scale;
+    memcpy(row(i), q, _dim);
+    memset(row(i) + _dim, 0, _stride - _dim);
+}
+
+bool FaceGallery::upsertFloat(const char* id, const char* name, const float* emb) {
+    if (!_query) return false;
+    float scale = quantize(emb, _dim, _query);
+    return scale > 0 && upsert(id, name, scale, _query);
+}
+
+bool FaceGallery::remove(const char* id) {
+    int i = find(id);
+    if (i < 0) return false;
+    // Đưa phần tử cuối vào chỗ trống -> O(1), thứ tự không quan trọng
+    uint32_t last = --_count;
+    if ((uint32_t)i != last) {
+        memcpy(_ids + (size_t)i * GALLERY_ID_LEN, idAt(last), GALLERY_ID_LEN);
+        memcpy(_names + (size_t)i * GALLERY_NAME_LEN, nameAt(last), GALLERY_NAME_LEN);
+        _scale[i] = _scale[last];
+        memcpy(row(i), row(last), _stride);
+    }
+    return true;
+}
+
+GalleryMatch FaceGallery::match(const float* query) {
+    GalleryMatch best = {-1, -1.0f};
+    if (!_query || _count == 0) return best;
+    memset(_query, 0, _stride);
+    float qs = quantize(query, _dim, _query);
+    if (qs <= 0) return best;
+
+    int32_t bestDot = 0;
+    float bestScore = -2.0f;
+    for (uint32_t i = 0; i < _count; i++) {
+        int32_t d = vk_dot_s8(_query, row(i), _stride);
+        float s = d * _scale[i];
+        if (s > bestScore) { bestScore = s; bestDot = d; best.index = (int)i; }
+    }
+    best.score = qs * _scale[best.index] * bestDot;
+    return best;
+}
+
+bool FaceGallery::apply(ReadFn read, void* ctx) {
+    uint8_t h[GALLERY_HEADER_LEN];
+    if (read(ctx, h, sizeof(h)) != sizeof(h) || memcmp(h, MAGIC, 4) != 0) return false;
+    uint8_t flags = h[4];
+    uint16_t dim = rd16(h + 5);
+    uint32_t total = rd32(h + 7);
+    uint64_t version = rd64(h + 11);
+    uint32_t nrec = rd32(h + 19);
+
+    bool full = flags & GALLERY_FLAG_FULL;
+    if (dim != _dim) {
+        // Đổi model embedding -> chỉ chấp nhận gói FULL
+        if (!full || !begin(dim, _capacity)) return false;
+    }
+    if (full) clear();
+
+    uint8_t rec[1 + GALLERY_ID_LEN + GALLERY_NAME_LEN];
+    char id[GALLERY_ID_LEN + 1];
+    char name[GALLERY_NAME_LEN + 1];
+    for (uint32_t n = 0; n < nrec; n++) {
+        if (read(ctx, rec, sizeof(rec)) != sizeof(rec)) return false;
+        memcpy(id, rec + 1, GALLERY_ID_LEN); id[GALLERY_ID_LEN] = 0;
+        memcpy(name, rec + 1 + GALLERY_ID_LEN, GALLERY_NAME_LEN); name[GALLERY_NAME_LEN] = 0;
+
+        if (rec[0] == GALLERY_OP_UPSERT) {
+            uint8_t s[4];
+            float scale;
+            if (read(ctx, s, 4) != 4) return false;
+            uint32_t bits = rd32(s);
+            memcpy(&scale, &bits, 4);
+            if (read(ctx, (uint8_t*)_query, _dim) != _dim) return false;
+
+            if (full && _count < _capacity) {
+                // Gói FULL không có id trùng -> thêm thẳng, bỏ qua find() O(n)
+                setRow(_count++, id, name, scale, _query);
+            } else {
+                upsert(id, name, scale, _query);
+            }
+        } else if (rec[0] == GALLERY_OP_REMOVE) {
+            remove(id);
+        } else {
+            return false;
+        }
+    }
+    _serverTotal = total;
+    _version = version;
+    return true;
+}
+
+bool FaceGallery::write(WriteFn write, void* ctx) const {
+    uint8_t h[GALLERY_HEADER_LEN];
+    memcpy(h, MAGIC, 4);
+    h[4] = GALLERY_FLAG_FULL;
+    wr16(h + 5, _dim);
+    wr32(h + 7, _count);
+    wr64(h + 11, _version);
+    wr32(h + 19, _count);
+    if (write(ctx, h, sizeof(h)) != sizeof(h)) return false;
+
+    uint8_t rec[1 + GALLERY_ID_LEN + GALLERY_NAME_LEN + 4];
+    for (uint32_t i = 0; i < _count; i++) {
+        rec[0] = GALLERY_OP_UPSERT;
+        memcpy(rec + 1, idAt(i), GALLERY_ID_LEN);
+        memcpy(rec + 1 + GALLERY_ID_LEN, nameAt(i), GALLERY_NAME_LEN);
+        uint32_t bits;
+        memcpy(&bits, &_scale[i], 4);
+        wr32(rec + 1 + GALLERY_ID_LEN + GALLERY_NAME_LEN, bits);
+        if (write(ctx, rec, sizeof(rec)) != sizeof(rec)) return false;
+        if (write(ctx, (const uint8_t*)row(i), _dim) != _dim) return false;
+    }
+    return true;
+}
+
+static size_t fileRead(void* ctx, uint8_t* dst, size_t len) {
+    return fread(dst, 1, len, (FILE*)ctx);
+}
+
+static size_t fileWrite(void* ctx, const uint8_t* src, size_t len) {
+    return fwrite(src, 1, len, (FILE*)ctx);
+}
+
+bool FaceGallery::save(const char* path) const {
+    // Ghi ra file tạm rồi mới thay file cũ -> mất điện giữa chừng không làm hỏng bản đang có
+    char tmp[64];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE* f = fopen(tmp, "wb");
+    if (!f) return false;
+    bool ok = write(fileWrite, f);
+    ok = (fclose(f) == 0) && ok;
+    if (!ok) { ::remove(tmp); return false; }
+    ::remove(path);
+    return rename(tmp, path) == 0;
+}
+
+bool FaceGallery::load(const char* path) {
+    FILE* f = fopen(path, "rb");
+    if (!f) return false;
+    bool ok = apply(fileRead, f);
+    fclose(f);
+    if (!ok) clear();
+    return ok;
+}
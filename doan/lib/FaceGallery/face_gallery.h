@@ -0,0 +1,94 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// Gallery embedding khuôn mặt của các nhân viên đã enroll, giữ trong PSRAM để kiosk
+// tự nhận diện khi mất mạng. Mỗi embedding được chuẩn hoá L2 rồi lượng tử int8 kèm
+// hệ số scale, nên cosine similarity = scaleA * scaleB * dot_s8(a, b).
+// Thuần C++ (không phụ thuộc Arduino) -> build và đo tốc độ được trên Linux.
+//
+// Định dạng gói dữ liệu (little-endian), dùng chung cho delta-sync từ server
+// (GET /api/ai/gallery?since=<version>) và file lưu trên thẻ SD:
+//   Header : magic "FGD1" | flags u8 (bit0 = FULL: xoá gallery trước khi áp dụng)
+//            | dim u16 | total u32 (số nhân viên trên server sau khi áp dụng)
+//            | version u64 (updatedAt lớn nhất, ms) | nrec u32
+//   Record : op u8 (1 = upsert, 2 = remove) | employee_id char[16] | name char[32]
+//            | (chỉ upsert) scale f32 | int8[dim]
+
+#define GALLERY_ID_LEN      16
+#define GALLERY_NAME_LEN    32
+#define GALLERY_HEADER_LEN  23
+
+#define GALLERY_FLAG_FULL   0x01
+#define GALLERY_OP_UPSERT   1
+#define GALLERY_OP_REMOVE   2
+
+struct GalleryMatch {
+    int index;      // -1 nếu gallery rỗng hoặc query không hợp lệ
+    float score;    // cosine similarity [-1, 1]
+};
+
+class FaceGallery {
+public:
+    // Đọc tuần tự đúng len byte (HTTP stream, file...). Trả về số byte đọc được.
+    typedef size_t (*ReadFn)(void* ctx, uint8_t* dst, size_t len);
+    typedef size_t (*WriteFn)(void* ctx, const uint8_t* src, size_t len);
+
+    ~FaceGallery() { end(); }
+
+    // Cấp phát sẵn chỗ cho capacity embedding (PSRAM trên ESP32)
+    bool begin(uint16_t dim, uint32_t capacity);
+    void end();
+    void clear();
+
+    uint16_t dim() const { return _dim; }
+    uint32_t size() const { return _count; }
+    uint32_t capacity() const { return _capacity; }
+    uint64_t version() const { return _version; }
+    void setVersion(uint64_t v) { _version = v; }
+    // Số nhân viên server báo ở gói gần nhất; khác size() -> cần đồng bộ lại toàn bộ
+    uint32_t serverTotal() const { return _serverTotal; }
+    uint32_t dropped() const { return _dropped; }
+
+    bool upsert(const char* id, const char* name, float scale, const int8_t* q);
+    bool upsertFloat(const char* id, const char* name, const float* emb);
+    bool remove(const char* id);
+    int find(const char* id) const;
+
+    const char* idAt(int i) const { return _ids + (size_t)i * GALLERY_ID_LEN; }
+    const char* nameAt(int i) const { return _names + (size_t)i * GALLERY_NAME_LEN; }
+
+    // Tìm người gần nhất với query (float, chưa cần chuẩn hoá). Dùng bộ đệm nội bộ
+    // nên không gọi song song từ 2 task.
+    GalleryMatch match(const float* query);
+
+    // Áp dụng 1 gói delta/snapshot. false nếu gói hỏng hoặc đọc thiếu (các record
+    // đã áp dụng vẫn giữ, version chỉ cập nhật khi đọc trọn gói).
+    bool apply(ReadFn read, void* ctx);
+    // Ghi toàn bộ gallery thành 1 gói FULL (để nạp lại bằng apply())
+    bool write(WriteFn write, void* ctx) const;
+
+    bool save(const char* path) const;
+    bool load(const char* path);
+
+    // Chuẩn hoá L2 + lượng tử int8. Trả về scale (0 nếu vector toàn 0).
+    static float quantize(const float* v, uint16_t dim, int8_t* out);
+
+private:
+    int8_t* row(uint32_t i) const { return _emb + (size_t)i * _stride; }
+    void setRow(uint32_t i, const char* id, const char* name, float scale, const int8_t* q);
+
+    uint16_t _dim = 0;
+    uint16_t _stride = 0;        // dim làm tròn lên bội số 16 (phần đệm = 0)
+    uint32_t _capacity = 0;
+    uint32_t _count = 0;
+    uint64_t _version = 0;
+    uint32_t _serverTotal = 0;
+    uint32_t _dropped = 0;       // record bỏ qua vì gallery đầy
+
+    int8_t* _emb = nullptr;      // capacity * stride, căn 16 byte
+    float* _scale = nullptr;
+    char* _ids = nullptr;
+    char* _names = nullptr;
+    int8_t* _query = nullptr;    // query đã lượng tử
+};
@@ -0,0 +1,192 @@
+#include "face_tracker.h"
+#include <string.h>
+
+// Độ sáng 8 bit từ pixel RGB565 big-endian (RRRRRGGG GGGBBBBB)
+static inline uint8_t luma565(const uint8_t* p) {
+    uint32_t r = p[0] & 0xF8;
+    uint32_t g = ((p[0] & 0x07) << 5) | ((p[1] >> 3) & 0x1C);
+    uint32_t b = (p[1] & 0x1F) << 3;
+    return (uint8_t)((r * 77 + g * 150 + b * 29) >> 8);
+}
+
+static inline int clampi(int v, int lo, int hi) { return v < lo ? lo : (v > hi ? hi : v); }
+
+// Toạ độ các điểm lấy mẫu của khung (x0, y0, w, h) trên lưới TRACK_TPL, đã cắt theo biên frame
+static void sampleGrid(const Rgb565Frame& frame, int x0, int y0, int w, int h,
+                       uint16_t* xs, uint16_t* ys) {
+    for (int g = 0; g < TRACK_TPL; g++) {
+        xs[g] = (uint16_t)clampi(x0 + (g * w + w / 2) / TRACK_TPL, 0, frame.width - 1);
+        ys[g] = (uint16_t)clampi(y0 + (g * h + h / 2) / TRACK_TPL, 0, frame.height - 1);
+    }
+}
+
+// Tổng sai khác tuyệt đối giữa mẫu và khung tại (x0, y0); dừng sớm khi đã vượt limit
+static uint32_t templateSad(const Rgb565Frame& frame, const Track& t, int x0, int y0, uint32_t limit) {
+    uint16_t xs[TRACK_TPL], ys[TRACK_TPL];
+    sampleGrid(frame, x0, y0, t.box.w, t.box.h, xs, ys);
+    const size_t stride = (size_t)frame.width * 2;
+    const uint8_t* tp = t.tpl;
+    uint32_t sad = 0;
+    for (int gy = 0; gy < TRACK_TPL; gy++) {
+        const uint8_t* row = frame.buf + ys[gy] * stride;
+        for (int gx = 0; gx < TRACK_TPL; gx++) {
+            int d = (int)luma565(row + xs[gx] * 2) - *tp++;
+            sad += d < 0 ? -d : d;
+        }
+        if (sad >= limit) break;
+    }
+    return sad;
+}
+
+float trackIoU(const TrackBox& a, const TrackBox& b) {
+    int x1 = a.x > b.x ? a.x : b.x;
+    int y1 = a.y > b.y ? a.y : b.y;
+    int x2 = (a.x + a.w) < (b.x + b.w) ? (a.x + a.w) : (b.x + b.w);
+    int y2 = (a.y + a.h) < (b.y + b.h) ? (a.y + a.h) : (b.y + b.h);
+    if (x2 <= x1 || y2 <= y1) return 0;
+    float inter = (float)(x2 - x1) * (y2 - y1);
+    float uni = (float)a.w * a.h + (float)b.w * b.h - inter;
+    return uni > 0 ? inter / uni : 0;
+}
+
+void FaceTracker::sampleTemplate(const Rgb565Frame& frame, Track& t) {
+    uint16_t xs[TRACK_TPL], ys[TRACK_TPL];
+    sampleGrid(frame, t.box.x, t.box.y, t.box.w, t.box.h, xs, ys);
+    const size_t stride = (size_t)frame.width * 2;
+    uint8_t* tp = t.tpl;
+    for (int gy = 0; gy < TRACK_TPL; gy++) {
+        const uint8_t* row = frame.buf + ys[gy] * stride;
+        for (int gx = 0; gx < TRACK_TPL; gx++) *tp++ = luma565(row + xs[gx] * 2);
+    }
+}
+
+bool FaceTracker::needsDetection() const {
+    return _forceDetect || _count == 0 || _sinceDetect >= _cfg.detectEvery;
+}
+
+void FaceTracker::removeAt(uint8_t i) {
+    _tracks[i] = _tracks[--_count];
+    _stats.lost++;
+}
+
+uint8_t FaceTracker::track(const Rgb565Frame& frame) {
+    _stats.tracked++;
+    _sinceDetect++;
+    const uint32_t maxSad = (uint32_t)_cfg.maxSad * TRACK_TPL * TRACK_TPL;
+    const int r = _cfg.searchRadius;
+
+    for (uint8_t i = 0; i < _count;) {
+        Track& t = _tracks[i];
+        int px = t.box.x + (int)(t.vx + (t.vx < 0 ? -0.5f : 0.5f));
+        int py = t.box.y + (int)(t.vy + (t.vy < 0 ? -0.5f : 0.5f));
+
+        // Tìm thô bước 4 px, rồi tinh chỉnh ±3 px quanh điểm tốt nhất
+        uint32_t best = UINT32_MAX;
+        int bx = px, by = py;
+        for (int dy = -r; dy <= r; dy += 4) {
+            for (int dx = -r; dx <= r; dx += 4) {
+                uint32_t s = templateSad(frame, t, px + dx, py + dy, best);
+                if (s < best) { best = s; bx = px + dx; by = py + dy; }
+            }
+        }
+        int cx = bx, cy = by;
+        for (int dy = -3; dy <= 3; dy++) {
+            for (int dx = -3; dx <= 3; dx++) {
+                if (!dx && !dy) continue;
+                uint32_t s = templateSad(frame, t, cx + dx, cy + dy, best);
+                if (s < best) { best = s; bx = cx + dx; by = cy + dy; }
+            }
+        }
+
+        // Tâm khung ra khỏi frame hoặc khớp kém -> mất dấu, frame sau phải detect
+        int mx = bx + t.box.w / 2, my = by + t.box.h / 2;
+        if (best > maxSad || mx < 0 || my < 0 || mx >= frame.width || my >= frame.height) {
+            removeAt(i);
+            _forceDetect = true;
+            continue;
+        }
+        // Lọc alpha-beta cho vận tốc
+        t.vx = 0.5f * t.vx + 0.5f * (bx - t.box.x);
+        t.vy = 0.5f * t.vy + 0.5f * (by - t.box.y);
+        t.box.x = (int16_t)bx;
+        t.box.y = (int16_t)by;
+        t.sad = (uint8_t)(best / (TRACK_TPL * TRACK_TPL));
+        t.age++;
+        t.sinceDetect++;
+        i++;
+    }
+    return _count;
+}
+
+void FaceTracker::correct(const Rgb565Frame& frame, const TrackBox* boxes, const float* scores, uint8_t n) {
+    _stats.detects++;
+    _sinceDetect = 0;
+    _forceDetect = false;
+
+    bool matched[TRACK_MAX] = {};
+    for (uint8_t d = 0; d < n; d++) {
+        // Ghép tham lam: track chưa ghép có IoU lớn nhất
+        int bestT = -1;
+        float bestIoU = _cfg.iouMatch;
+        for (uint8_t i = 0; i < _count; i++) {
+            if (matched[i]) continue;
+            float iou = trackIoU(_tracks[i].box, boxes[d]);
+            if (iou >= bestIoU) { bestIoU = iou; bestT = i; }
+        }
+        Track* t;
+        if (bestT >= 0) {
+            t = &_tracks[bestT];
+            int frames = t->sinceDetect ? t->sinceDetect : 1;
+            t->vx = 0.5f * t->vx + 0.5f * (float)(boxes[d].x - t->box.x) / frames;
+            t->vy = 0.5f * t->vy + 0.5f * (float)(boxes[d].y - t->box.y) / frames;
+        } else if (_count < TRACK_MAX) {
+            bestT = _count++;
+            t = &_tracks[bestT];
+            memset(t, 0, sizeof(Track));
+            t->id = _nextId++;
+            _stats.created++;
+        } else {
+            continue;
+        }
+        matched[bestT] = true;
+        t->box = boxes[d];
+        t->score = scores ? scores[d] : 1.0f;
+        t->sad = 0;
+        t->misses = 0;
+        t->sinceDetect = 0;
+        t->age++;
+        sampleTemplate(frame, *t);
+    }
+
+    // Track không có trong kết quả detect: giữ thêm vài lần (detector đôi khi bỏ sót)
+    for (uint8_t i = 0; i < _count;) {
+        if (!matched[i] && ++_tracks[i].misses > _cfg.maxMisses) {
+            matched[i] = matched[_count - 1];
+            removeAt(i);
+            continue;
+        }
+        i++;
+    }
+}
+
+void FaceTracker::reset() {
+    _count = 0;
+    _sinceDetect = 0;
+    _forceDetect = false;
+}
+
+const Track* FaceTracker::find(uint32_t id) const {
+    for (uint8_t i = 0; i < _count; i++) {
+        if (_tracks[i].id == id) return &_tracks[i];
+    }
+    return nullptr;
+}
+
+const Track* FaceTracker::primary() const {
+    const Track* best = nullptr;
+    for (uint8_t i = 0; i < _count; i++) {
+        const Track& t = _tracks[i];
+        if (!best || (int32_t)t.box.w * t.box.h > (int32_t)best->box.w * best->box.h) best = &t;
+    }
+    return best;
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "roi_jpeg.h"   // Rgb565Frame
+
+// Detect-then-track: detector khuôn mặt chỉ chạy đầy đủ mỗi detectEvery frame (hoặc khi
+// mất dấu), các frame ở giữa bám mặt bằng so khớp mẫu (template) độ sáng trong cửa sổ
+// quanh vị trí dự đoán (vận tốc không đổi). Mỗi track giữ 1 id ổn định suốt thời gian
+// người đó còn trong khung hình -> nền cho trạng thái theo từng người (liveness...).
+// Thuần C++ (không phụ thuộc Arduino) -> build và đo tốc độ được trên Linux.
+//
+// So khớp: mẫu TRACK_TPL x TRACK_TPL lấy mẫu từ khung mặt lúc detect, tìm thô bước 4 px
+// trong ±searchRadius rồi tinh chỉnh bước 1 px trong ±3 px. Kích thước khung giữ nguyên
+// giữa 2 lần detect (lần detect sau cập nhật lại).
+
+#define TRACK_MAX   4
+#define TRACK_TPL   24
+
+struct TrackBox {
+    int16_t x, y, w, h;
+};
+
+struct TrackerConfig {
+    uint8_t detectEvery = 4;      // detect đầy đủ mỗi N frame
+    uint8_t searchRadius = 16;    // px quanh vị trí dự đoán
+    uint8_t maxSad = 28;          // sai khác độ sáng trung bình / pixel vượt mức này -> mất dấu
+    float iouMatch = 0.3f;        // box detect ghép với track cũ khi IoU >= ngưỡng
+    uint8_t maxMisses = 2;        // số lần detect liên tiếp không thấy -> xoá track
+};
+
+struct Track {
+    uint32_t id;
+    TrackBox box;
+    float vx, vy;                 // px / frame
+    float score;                  // score của lần detect gần nhất
+    uint8_t sad;                  // sai khác của lần so khớp gần nhất (0 ngay sau detect)
+    uint32_t age;                 // số frame từ lúc tạo track
+    uint16_t sinceDetect;         // số frame từ lần detect gần nhất thấy track này
+    uint8_t misses;
+    uint8_t tpl[TRACK_TPL * TRACK_TPL];
+};
+
+struct TrackerStats {
+    uint32_t detects;             // số frame chạy detector
+    uint32_t tracked;             // số frame chỉ bám template
+    uint32_t created;
+    uint32_t lost;                // track bị xoá (so khớp kém hoặc detect không thấy)
+};
+
+class FaceTracker {
+public:
+    explicit FaceTracker(const TrackerConfig& cfg = TrackerConfig()) : _cfg(cfg) {}
+
+    // true -> frame kế tiếp nên chạy detector rồi gọi correct()
+    bool needsDetection() const;
+    void requestDetection() { _forceDetect = true; }
+
+    // Frame không detect: dời mọi track theo template. Trả về số track còn lại.
+    uint8_t track(const Rgb565Frame& frame);
+    // Frame có detect: ghép box với track cũ theo IoU (giữ id), box lạ thành track mới
+    void correct(const Rgb565Frame& frame, const TrackBox* boxes, const float* scores, uint8_t n);
+    void reset();
+
+    uint8_t size() const { return _count; }
+    const Track& at(uint8_t i) const { return _tracks[i]; }
+    const Track* find(uint32_t id) const;
+    // Track có khung lớn nhất (người đứng gần kiosk nhất), nullptr nếu không có
+    const Track* primary() const;
+
+    TrackerStats stats() const { return _stats; }
+
+private:
+    void removeAt(uint8_t i);
+    void sampleTemplate(const Rgb565Frame& frame, Track& t);
+
+    TrackerConfig _cfg;
+    Track _tracks[TRACK_MAX];
+    uint8_t _count = 0;
+    uint32_t _nextId = 1;
+    uint16_t _sinceDetect = 0;
+    bool _forceDetect = false;
+    TrackerStats _stats = {};
+};
+
+// Độ tương đồng 2 khung (0..1)
+float trackIoU(const TrackBox& a, const TrackBox& b);
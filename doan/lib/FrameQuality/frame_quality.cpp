@@ -0,0 +1,95 @@
+#include "frame_quality.h"
+#include <math.h>
+#include "vec_kernels.h"
+
+static inline int luma565(const uint8_t* p) {
+    int r = p[0] & 0xF8;
+    int g = ((p[0] & 0x07) << 5) | ((p[1] >> 3) & 0x1C);
+    int b = (p[1] & 0x1F) << 3;
+    return (r * 77 + g * 150 + b * 29) >> 8;
+}
+
+static inline int clampi(int v, int lo, int hi) { return v < lo ? lo : (v > hi ? hi : v); }
+static inline float clamp01(float v) { return v < 0 ? 0 : (v > 1 ? 1 : v); }
+
+float laplacianVariance(const uint8_t* luma, int w, int h) {
+    // Mỗi hàng Laplacian ghi vào buffer int16 căn 16 byte, 2 cột biên = 0 (không đóng góp
+    // vào tổng) -> SIMD chạy trọn QUALITY_GRID phần tử mỗi hàng
+    alignas(VK_ALIGN) static const int16_t ones[QUALITY_GRID] = {
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1
+    };
+    alignas(VK_ALIGN) int16_t lap[QUALITY_GRID] = {};
+    if (w < 3 || h < 3 || w > QUALITY_GRID) return 0;
+
+    int64_t sum = 0, sum2 = 0;
+    for (int y = 1; y < h - 1; y++) {
+        const uint8_t* up = luma + (y - 1) * w;
+        const uint8_t* row = luma + y * w;
+        const uint8_t* dn = luma + (y + 1) * w;
+        for (int x = 1; x < w - 1; x++) {
+            lap[x] = (int16_t)(4 * row[x] - up[x] - dn[x] - row[x - 1] - row[x + 1]);
+        }
+        // 1 hàng: QUALITY_GRID * 1020^2 < 2^31, không tràn
+        sum += vk_dot_s16(lap, ones, QUALITY_GRID);
+        sum2 += vk_dot_s16(lap, lap, QUALITY_GRID);
+    }
+    float n = (float)(w - 2) * (h - 2);
+    float mean = sum / n;
+    return sum2 / n - mean * mean;
+}
+
+FaceQuality scoreFaceQuality(const Rgb565Frame& frame, const TrackBox& box, const LiveLandmarks* lm,
+                             const QualityConfig& cfg) {
+    FaceQuality q = {};
+
+    // Lấy mẫu khung mặt về lưới cố định: điểm độ nét không phụ thuộc cỡ mặt.
+    // Lưới 4 KB để static cho nhẹ stack task camera (chỉ gọi từ 1 task).
+    static uint8_t grid[QUALITY_GRID * QUALITY_GRID];
+    const size_t stride = (size_t)frame.width * 2;
+    int xs[QUALITY_GRID];
+    for (int g = 0; g < QUALITY_GRID; g++) {
+        xs[g] = clampi(box.x + ((2 * g + 1) * box.w) / (2 * QUALITY_GRID), 0, frame.width - 1) * 2;
+    }
+    uint32_t sum = 0, sum2 = 0;
+    uint8_t* out = grid;
+    for (int gy = 0; gy < QUALITY_GRID; gy++) {
+        int y = clampi(box.y + ((2 * gy + 1) * box.h) / (2 * QUALITY_GRID), 0, frame.height - 1);
+        const uint8_t* row = frame.buf + y * stride;
+        for (int gx = 0; gx < QUALITY_GRID; gx++) {
+            int v = luma565(row + xs[gx]);
+            *out++ = (uint8_t)v;
+            sum += v;
+            sum2 += v * v;
+        }
+    }
+    const float n = QUALITY_GRID * QUALITY_GRID;
+    q.brightness = sum / n;
+    float var = sum2 / n - q.brightness * q.brightness;
+    q.contrast = var > 0 ? sqrtf(var) : 0;
+    q.sharpness = laplacianVariance(grid, QUALITY_GRID, QUALITY_GRID);
+
+    float sharpS = clamp01(q.sharpness / cfg.sharpRef);
+    float expS = 1;
+    if (q.brightness < cfg.exposureLo) expS = clamp01(1 - (cfg.exposureLo - q.brightness) / 50.0f);
+    else if (q.brightness > cfg.exposureHi) expS = clamp01(1 - (q.brightness - cfg.exposureHi) / 50.0f);
+    float contrastS = clamp01(q.contrast / cfg.contrastRef);
+    float sizeS = 1;
+    if (box.w < cfg.sizeMin) sizeS = (float)box.w / cfg.sizeMin;
+    else if (box.w > cfg.sizeMax) sizeS = (float)cfg.sizeMax / box.w;
+
+    float poseS = 1;
+    if (lm) {
+        float ex = lm->rightEyeX - lm->leftEyeX, ey = lm->rightEyeY - lm->leftEyeY;
+        float d2 = ex * ex + ey * ey;
+        if (d2 > 1) {
+            float mx = (lm->leftEyeX + lm->rightEyeX) * 0.5f, my = (lm->leftEyeY + lm->rightEyeY) * 0.5f;
+            q.yaw = ((lm->noseX - mx) * ex + (lm->noseY - my) * ey) / d2;
+            q.rollDeg = atan2f(ey, ex) * 57.29578f;
+            poseS = clamp01(1 - fabsf(q.yaw) / cfg.yawMax) * clamp01(1 - fabsf(q.rollDeg) / cfg.rollMaxDeg);
+        }
+    }
+
+    q.score = sharpS * expS * sizeS * poseS * (0.5f + 0.5f * contrastS);
+    return q;
+}
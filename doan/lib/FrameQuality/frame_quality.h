@@ -0,0 +1,41 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "liveness.h"   // TrackBox, Rgb565Frame, LiveLandmarks
+
+// Chấm điểm chất lượng ảnh mặt trước khi gửi, để burst chỉ upload các frame tốt nhất:
+//   - độ nét   : phương sai Laplacian trên lưới độ sáng QUALITY_GRID x QUALITY_GRID lấy theo
+//                khung mặt (tổng và tổng bình phương qua vk_dot_s16, SIMD trên ESP32-S3)
+//   - phơi sáng: độ sáng trung bình nằm trong [exposureLo, exposureHi] (ngược sáng -> tối)
+//   - tương phản: độ lệch chuẩn độ sáng
+//   - kích thước: bề rộng khung mặt trong [sizeMin, sizeMax]
+//   - tư thế   : lệch mũi so với giữa 2 mắt (yaw) và góc nghiêng đường 2 mắt (roll)
+// Điểm tổng = tích các điểm thành phần (0..1): 1 yếu tố hỏng là đủ để loại frame.
+// Thuần C++ (không phụ thuộc Arduino) -> build và đo tốc độ được trên Linux.
+
+#define QUALITY_GRID 64
+
+struct QualityConfig {
+    float sharpRef = 400;         // phương sai Laplacian đạt mức này -> nét tối đa
+    uint8_t exposureLo = 70, exposureHi = 190;
+    float contrastRef = 35;       // độ lệch chuẩn độ sáng đạt mức này -> đủ tương phản
+    int16_t sizeMin = 55, sizeMax = 110;
+    float yawMax = 0.35f;         // |lệch mũi| / khoảng cách 2 mắt coi như quay ngang hẳn
+    float rollMaxDeg = 25;
+};
+
+struct FaceQuality {
+    float sharpness;              // phương sai Laplacian
+    float brightness;             // 0..255
+    float contrast;               // độ lệch chuẩn
+    float yaw;                    // lệch mũi theo trục 2 mắt (0 = nhìn thẳng)
+    float rollDeg;
+    float score;                  // 0..1
+};
+
+// lm = nullptr: bỏ qua điểm tư thế. Dùng buffer tĩnh: không gọi đồng thời từ nhiều task.
+FaceQuality scoreFaceQuality(const Rgb565Frame& frame, const TrackBox& box, const LiveLandmarks* lm,
+                             const QualityConfig& cfg = QualityConfig());
+
+// Phương sai Laplacian 4 lân cận của ảnh độ sáng w x h (w <= QUALITY_GRID)
+float laplacianVariance(const uint8_t* luma, int w, int h);
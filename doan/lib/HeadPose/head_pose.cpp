@@ -0,0 +1,82 @@
+#include "head_pose.h"
+#include <math.h>
+
+HeadPose estimateHeadPose(const PoseLandmarks& lm, const PoseConfig& cfg) {
+    HeadPose p = {};
+    // Mắt / miệng theo thứ tự x trên ảnh
+    bool swapEyes = lm.leftEyeX > lm.rightEyeX;
+    float lx = swapEyes ? lm.rightEyeX : lm.leftEyeX, ly = swapEyes ? lm.rightEyeY : lm.leftEyeY;
+    float rx = swapEyes ? lm.leftEyeX : lm.rightEyeX, ry = swapEyes ? lm.leftEyeY : lm.rightEyeY;
+    float ex = rx - lx, ey = ry - ly;
+    float d2 = ex * ex + ey * ey;
+    if (d2 < 16) return p;                       // 2 mắt gần hơn 4 px: landmark hỏng
+    float d = sqrtf(d2);
+
+    float mx = (lx + rx) * 0.5f, my = (ly + ry) * 0.5f;
+    float mouthX = (lm.leftMouthX + lm.rightMouthX) * 0.5f, mouthY = (lm.leftMouthY + lm.rightMouthY) * 0.5f;
+    // Trục dọc mặt: vuông góc trục 2 mắt, hướng xuống (y ảnh tăng)
+    float ux = -ey / d, uy = ex / d;
+    float mouthDown = (mouthX - mx) * ux + (mouthY - my) * uy;
+    if (mouthDown < 0.2f * d) return p;          // miệng không nằm dưới mắt
+
+    float noseAlong = ((lm.noseX - mx) * ex + (lm.noseY - my) * ey) / d2;
+    float noseDown = ((lm.noseX - mx) * ux + (lm.noseY - my) * uy) / mouthDown;
+
+    // Ảnh không lật: người quay sang trái của họ -> mũi lệch sang phải ảnh (x tăng)
+    p.rawYaw = cfg.mirrored ? -noseAlong : noseAlong;
+    p.rawPitch = noseDown;
+    p.yaw = p.rawYaw - cfg.yawNeutral;
+    p.pitch = cfg.pitchNeutral - p.rawPitch;
+    p.rollDeg = atan2f(ey, ex) * 57.29578f;
+    p.valid = true;
+    return p;
+}
+
+// Hint để đưa giá trị v (dương: trái / lên) vào [lo, hi]
+static PoseHint axisHint(float v, float lo, float hi, PoseHint positive, PoseHint negative) {
+    if (v < lo) return positive;
+    if (v > hi) return negative;
+    return POSE_HINT_OK;
+}
+
+PoseHint checkPose(const HeadPose& p, PoseTarget target, const PoseConfig& cfg) {
+    if (!p.valid) return POSE_HINT_NO_FACE;
+    if (fabsf(p.rollDeg) > cfg.rollMaxDeg) return POSE_HINT_LEVEL_HEAD;
+
+    PoseHint yawFix = axisHint(p.yaw, -cfg.offAxisMax, cfg.offAxisMax, POSE_HINT_TURN_LEFT, POSE_HINT_TURN_RIGHT);
+    PoseHint pitchFix = axisHint(p.pitch, -cfg.offAxisMax, cfg.offAxisMax, POSE_HINT_LOOK_UP, POSE_HINT_LOOK_DOWN);
+    PoseHint primary = POSE_HINT_OK;
+    switch (target) {
+        case POSE_FRONT:
+            yawFix = axisHint(p.yaw, -cfg.frontYawMax, cfg.frontYawMax, POSE_HINT_TURN_LEFT, POSE_HINT_TURN_RIGHT);
+            pitchFix = axisHint(p.pitch, -cfg.frontPitchMax, cfg.frontPitchMax, POSE_HINT_LOOK_UP, POSE_HINT_LOOK_DOWN);
+            break;
+        case POSE_LEFT:
+            primary = axisHint(p.yaw, cfg.turnYawMin, cfg.turnYawMax, POSE_HINT_TURN_LEFT, POSE_HINT_TURN_RIGHT);
+            yawFix = POSE_HINT_OK;
+            break;
+        case POSE_RIGHT:
+            primary = axisHint(p.yaw, -cfg.turnYawMax, -cfg.turnYawMin, POSE_HINT_TURN_LEFT, POSE_HINT_TURN_RIGHT);
+            yawFix = POSE_HINT_OK;
+            break;
+        case POSE_UP:
+            primary = axisHint(p.pitch, cfg.tiltPitchMin, cfg.tiltPitchMax, POSE_HINT_LOOK_UP, POSE_HINT_LOOK_DOWN);
+            pitchFix = POSE_HINT_OK;
+            break;
+        case POSE_DOWN:
+            primary = axisHint(p.pitch, -cfg.tiltPitchMax, -cfg.tiltPitchMin, POSE_HINT_LOOK_UP, POSE_HINT_LOOK_DOWN);
+            pitchFix = POSE_HINT_OK;
+            break;
+        default:
+            return POSE_HINT_NO_FACE;
+    }
+    if (primary != POSE_HINT_OK) return primary;
+    if (yawFix != POSE_HINT_OK) return yawFix;
+    return pitchFix;
+}
+
+void poseSetNeutral(PoseConfig& cfg, const HeadPose& front) {
+    if (!front.valid) return;
+    cfg.yawNeutral = front.rawYaw;
+    cfg.pitchNeutral = front.rawPitch;
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// Ước lượng tư thế đầu từ 5 landmark của detector (2 mắt, mũi, 2 khoé miệng) bằng tỉ lệ hình
+// học, không cần mô hình 3D:
+//   - yaw  : hình chiếu của mũi lên trục 2 mắt, tính từ giữa 2 mắt, chia khoảng cách 2 mắt
+//            (mũi nhô khỏi mặt phẳng mắt nên lệch sang bên đầu quay tới; ~0.45 * tan(góc))
+//   - pitch: vị trí mũi giữa đường 2 mắt và đường miệng theo trục vuông góc (0 = ngang mắt,
+//            1 = ngang miệng); ngẩng lên thì mũi tiến về phía mắt, cúi xuống thì về phía miệng
+//   - roll : góc nghiêng đường 2 mắt (độ)
+// Mắt / khoé miệng được xếp theo x nên không phụ thuộc detector gọi bên nào là "trái".
+// yaw / pitch trả về theo hướng của người đứng trước máy (yaw > 0: quay sang trái của họ,
+// pitch > 0: ngẩng lên), đã trừ tư thế trung tính (PoseConfig::yawNeutral / pitchNeutral,
+// hiệu chỉnh theo từng người bằng ảnh nhìn thẳng).
+// Thuần C++ (không phụ thuộc Arduino) -> build và đo tốc độ được trên Linux.
+
+struct PoseLandmarks {
+    float leftEyeX, leftEyeY;
+    float rightEyeX, rightEyeY;
+    float noseX, noseY;
+    float leftMouthX, leftMouthY;
+    float rightMouthX, rightMouthY;
+};
+
+struct PoseConfig {
+    bool mirrored = false;        // ảnh camera đã lật ngang (kiểu gương)
+    float yawNeutral = 0;         // tỉ lệ yaw thô khi người đó nhìn thẳng
+    float pitchNeutral = 0.53f;   // vị trí mũi thô (0..1) khi nhìn thẳng
+    float frontYawMax = 0.12f;    // nhìn thẳng: |yaw| ~ < 15 độ
+    float frontPitchMax = 0.08f;  //             |pitch| ~ < 13 độ
+    float turnYawMin = 0.13f;     // quay trái / phải: ~16..48 độ
+    float turnYawMax = 0.50f;
+    float tiltPitchMin = 0.09f;   // ngẩng / cúi: ~14..45 độ
+    float tiltPitchMax = 0.30f;
+    float offAxisMax = 0.16f;     // trục còn lại khi quay / ngẩng không được lệch quá mức này
+    float rollMaxDeg = 20;
+};
+
+struct HeadPose {
+    float yaw;                    // đã trừ yawNeutral, > 0: quay sang trái (của người đứng trước máy)
+    float pitch;                  // đã trừ pitchNeutral, > 0: ngẩng lên
+    float rollDeg;
+    float rawYaw, rawPitch;       // chưa trừ tư thế trung tính (dùng để hiệu chỉnh)
+    bool valid;                   // landmark đủ tin cậy (2 mắt tách rời, miệng dưới mắt)
+};
+
+// Thứ tự giống enrollSteps[] trên kiosk
+enum PoseTarget : uint8_t { POSE_FRONT, POSE_LEFT, POSE_RIGHT, POSE_UP, POSE_DOWN, POSE_TARGET_COUNT };
+
+// Gợi ý hướng chỉnh, theo hướng của người đứng trước máy
+enum PoseHint : uint8_t {
+    POSE_HINT_OK,
+    POSE_HINT_TURN_LEFT,
+    POSE_HINT_TURN_RIGHT,
+    POSE_HINT_LOOK_UP,
+    POSE_HINT_LOOK_DOWN,
+    POSE_HINT_LEVEL_HEAD,         // đầu nghiêng (roll) quá mức
+    POSE_HINT_NO_FACE,            // landmark không dùng được
+};
+
+HeadPose estimateHeadPose(const PoseLandmarks& lm, const PoseConfig& cfg = PoseConfig());
+// POSE_HINT_OK nếu tư thế khớp target; không thì hướng cần chỉnh (ưu tiên roll, rồi trục chính)
+PoseHint checkPose(const HeadPose& pose, PoseTarget target, const PoseConfig& cfg = PoseConfig());
+// Lấy tư thế hiện tại (ảnh nhìn thẳng) làm trung tính cho các bước sau
+void poseSetNeutral(PoseConfig& cfg, const HeadPose& front);
@@ -0,0 +1,90 @@
+#include "link_control.h"
+
+template <typename T>
+static T clampv(T v, T lo, T hi) { return v < lo ? lo : (v > hi ? hi : v); }
+
+LinkController::LinkController(const LinkControlConfig& cfg) : _cfg(cfg) {
+    _p.quality = _cfg.qualityMax;
+    _p.cropSize = _cfg.cropMax;
+    _p.burst = _cfg.burstMax;
+    _p.timeoutMs = _cfg.timeoutMax;
+    _p.offlineFirst = false;
+}
+
+LinkParams LinkController::next(uint32_t nowMs) {
+    LinkParams p = _p;
+    if (_p.offlineFirst && nowMs - _lastProbeAt >= _cfg.probeIntervalMs) {
+        _lastProbeAt = nowMs;
+        _probing = true;
+        p.offlineFirst = false;
+        p.timeoutMs = _cfg.timeoutMin;
+    }
+    return p;
+}
+
+void LinkController::report(uint32_t nowMs, uint32_t rttMs, size_t bytes, bool ok) {
+    _s.samples++;
+    // Tỉ lệ lỗi: EWMA hệ số 1/4
+    _s.errorRate += ((ok ? 0.0f : 1.0f) - _s.errorRate) * 0.25f;
+
+    if (ok) {
+        _s.consecutiveFailures = 0;
+        if (_s.srttMs == 0) {
+            _s.srttMs = rttMs;
+            _s.rttVarMs = rttMs / 2;
+        } else {
+            // RFC 6298: rttvar = 3/4 rttvar + 1/4 |srtt - rtt|, srtt = 7/8 srtt + 1/8 rtt
+            uint32_t diff = rttMs > _s.srttMs ? rttMs - _s.srttMs : _s.srttMs - rttMs;
+            _s.rttVarMs = (_s.rttVarMs * 3 + diff) / 4;
+            _s.srttMs = (_s.srttMs * 7 + rttMs) / 8;
+        }
+        if (rttMs > 0) {
+            float kbs = bytes / 1.024f / rttMs;
+            _s.throughputKBs = _s.throughputKBs > 0 ? _s.throughputKBs * 0.75f + kbs * 0.25f : kbs;
+        }
+    } else if (_s.consecutiveFailures < 255) {
+        _s.consecutiveFailures++;
+    }
+
+    bool degraded = _s.consecutiveFailures >= _cfg.degradedFailures ||
+                    (_s.srttMs > _cfg.degradedRttMs && _s.errorRate > 0.25f);
+    if (degraded && !_p.offlineFirst) {
+        _p.offlineFirst = true;
+        _lastProbeAt = nowMs;
+        _s.degradedEnters++;
+    } else if (_p.offlineFirst && ok && _probing) {
+        // Probe thành công -> quay lại online, bắt đầu từ mức thận trọng
+        _p.offlineFirst = false;
+        _p.quality = _cfg.qualityMin;
+        _p.cropSize = _cfg.cropMin;
+        _p.burst = _cfg.burstMin;
+    }
+    _probing = false;
+    adapt();
+}
+
+void LinkController::adapt() {
+    uint32_t rto = _s.srttMs ? _s.srttMs + 4 * _s.rttVarMs : _cfg.timeoutMax;
+    _p.timeoutMs = clampv<uint32_t>(rto, _cfg.timeoutMin, _cfg.timeoutMax);
+
+    bool slow = _s.srttMs > _cfg.rttBudgetMs || _s.errorRate > 0.2f;
+    bool fast = _s.srttMs && _s.srttMs * 10 < _cfg.rttBudgetMs * 7 && _s.errorRate < 0.05f;
+    if (slow) {
+        // Giảm theo thứ tự ít ảnh hưởng nhận diện nhất: chất lượng -> kích thước -> số frame
+        if (_p.quality > _cfg.qualityMin) {
+            _p.quality = clampv<int>(_p.quality * 3 / 4, _cfg.qualityMin, _cfg.qualityMax);
+        } else if (_p.cropSize > _cfg.cropMin) {
+            _p.cropSize = _cfg.cropMin;
+        } else if (_p.burst > _cfg.burstMin) {
+            _p.burst--;
+        }
+    } else if (fast) {
+        if (_p.burst < _cfg.burstMax) {
+            _p.burst++;
+        } else if (_p.cropSize < _cfg.cropMax) {
+            _p.cropSize = _cfg.cropMax;
+        } else if (_p.quality < _cfg.qualityMax) {
+            _p.quality = clampv<int>(_p.quality + 5, _cfg.qualityMin, _cfg.qualityMax);
+        }
+    }
+}
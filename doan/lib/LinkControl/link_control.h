@@ -0,0 +1,70 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// Bộ điều khiển upload thích nghi theo chất lượng đường mạng. Mỗi lần gửi xong,
+// kết quả (RTT, số byte, thành công/lỗi) được đưa vào; bộ điều khiển theo dõi
+//   - RTT trơn + độ lệch (kiểu TCP: srtt/rttvar) -> timeout = srtt + 4*rttvar
+//   - thông lượng (EWMA, KB/s) và tỉ lệ lỗi (EWMA)
+// rồi chỉnh chất lượng JPEG, kích thước ảnh mặt, số frame burst trong giới hạn cấu hình:
+// chậm hơn ngân sách RTT thì giảm mạnh (nhân), nhanh thì tăng dần (cộng).
+// Mạng rõ ràng hỏng (lỗi liên tiếp / RTT quá lớn) -> chế độ offline-first: lưu offline
+// ngay, chỉ thỉnh thoảng gửi thử 1 request (probe) với timeout ngắn.
+// Thuần C++ (thời gian truyền vào từ ngoài) -> chạy và kiểm thử được trên Linux.
+
+struct LinkControlConfig {
+    uint8_t qualityMin = 60, qualityMax = 90;
+    uint16_t cropMin = 0, cropMax = 0;         // 0 = cắt theo khung mặt (không đổi kích thước)
+    uint8_t burstMin = 2, burstMax = 3;        // server cần >= 2 frame để đo liveness
+    uint32_t timeoutMin = 2500, timeoutMax = 8000;
+    uint32_t rttBudgetMs = 1500;               // mục tiêu RTT cho 1 lượt chấm công
+    uint32_t degradedRttMs = 5000;             // srtt vượt mức này -> coi như mạng hỏng
+    uint8_t degradedFailures = 2;              // số lần lỗi liên tiếp -> offline-first
+    uint32_t probeIntervalMs = 30000;          // offline-first: khoảng cách giữa 2 lần gửi thử
+};
+
+struct LinkParams {
+    uint8_t quality;
+    uint16_t cropSize;        // 0 = cắt theo khung mặt
+    uint8_t burst;
+    uint32_t timeoutMs;
+    bool offlineFirst;        // true: lưu offline ngay, không chờ mạng
+};
+
+struct LinkStats {
+    uint32_t srttMs;
+    uint32_t rttVarMs;
+    float throughputKBs;
+    float errorRate;          // 0..1
+    uint8_t consecutiveFailures;
+    uint32_t samples;
+    uint32_t degradedEnters;  // số lần chuyển sang offline-first
+};
+
+class LinkController {
+public:
+    explicit LinkController(const LinkControlConfig& cfg = LinkControlConfig());
+
+    // Tham số cho request kế tiếp. Trong chế độ offline-first, mỗi probeIntervalMs
+    // trả về 1 lần offlineFirst = false (probe, timeout ngắn nhất).
+    LinkParams next(uint32_t nowMs);
+    // Kết quả 1 request: rttMs tính cả thời gian server xử lý, bytes là body đã gửi
+    void report(uint32_t nowMs, uint32_t rttMs, size_t bytes, bool ok);
+
+    // Còn trong offline-first và chưa tới lượt probe -> xử lý tại máy, không đẩy lên mạng
+    bool offlineFirst(uint32_t nowMs) const {
+        return _p.offlineFirst && nowMs - _lastProbeAt < _cfg.probeIntervalMs;
+    }
+    LinkParams params() const { return _p; }
+    LinkStats stats() const { return _s; }
+    const LinkControlConfig& config() const { return _cfg; }
+
+private:
+    void adapt();
+
+    LinkControlConfig _cfg;
+    LinkParams _p;
+    LinkStats _s = {};
+    uint32_t _lastProbeAt = 0;
+    bool _probing = false;
+};
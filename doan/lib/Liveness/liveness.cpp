@@ -0,0 +1,162 @@
+#include "liveness.h"
+#include <math.h>
+#include <string.h>
+
+static inline int luma565(const uint8_t* p) {
+    int r = p[0] & 0xF8;
+    int g = ((p[0] & 0x07) << 5) | ((p[1] >> 3) & 0x1C);
+    int b = (p[1] & 0x1F) << 3;
+    return (r * 77 + g * 150 + b * 29) >> 8;
+}
+
+static inline int clampi(int v, int lo, int hi) { return v < lo ? lo : (v > hi ? hi : v); }
+static inline float clampf(float v, float lo, float hi) { return v < lo ? lo : (v > hi ? hi : v); }
+
+// Patch độ sáng (trừ 128 -> int8) theo lưới LIVE_PATCH trên khung, mỗi ô lấy trung bình 2x2 px.
+// (sx, sy) dời lưới theo px. Trả về giá trị trung bình của patch, norm = tổng bình phương.
+static float samplePatch(const Rgb565Frame& frame, const TrackBox& box, int sx, int sy, int8_t* out,
+                         int32_t& norm) {
+    const size_t stride = (size_t)frame.width * 2;
+    int xs[LIVE_PATCH], xs1[LIVE_PATCH];
+    for (int g = 0; g < LIVE_PATCH; g++) {
+        int x = box.x + sx + ((2 * g + 1) * box.w) / (2 * LIVE_PATCH);
+        xs[g] = clampi(x, 0, frame.width - 1) * 2;
+        xs1[g] = clampi(x + 1, 0, frame.width - 1) * 2;
+    }
+    int32_t sum = 0, sum2 = 0;
+    for (int gy = 0; gy < LIVE_PATCH; gy++) {
+        int y = box.y + sy + ((2 * gy + 1) * box.h) / (2 * LIVE_PATCH);
+        const uint8_t* r0 = frame.buf + clampi(y, 0, frame.height - 1) * stride;
+        const uint8_t* r1 = frame.buf + clampi(y + 1, 0, frame.height - 1) * stride;
+        for (int gx = 0; gx < LIVE_PATCH; gx++) {
+            int v = (luma565(r0 + xs[gx]) + luma565(r0 + xs1[gx]) +
+                     luma565(r1 + xs[gx]) + luma565(r1 + xs1[gx]) + 2) >> 2;
+            *out++ = (int8_t)(v - 128);
+            sum += v - 128;
+            sum2 += (v - 128) * (v - 128);
+        }
+    }
+    norm = sum2;
+    return (float)sum / (LIVE_PATCH * LIVE_PATCH);
+}
+
+LivenessEngine::State* LivenessEngine::slotFor(uint32_t trackId) {
+    State* lru = &_states[0];
+    for (uint8_t i = 0; i < LIVE_TRACKS; i++) {
+        State& s = _states[i];
+        if (s.id == trackId) return &s;
+        if (s.id == 0 || (lru->id != 0 && s.lastUsed < lru->lastUsed)) lru = &s;
+    }
+    // Track mới: lấy slot trống hoặc slot lâu không dùng nhất
+    memset(lru, 0, sizeof(State));
+    lru->id = trackId;
+    return lru;
+}
+
+LivenessResult LivenessEngine::update(uint32_t trackId, const Rgb565Frame& frame, const TrackBox& box,
+                                      const LiveLandmarks* lm) {
+    State& s = *slotFor(trackId);
+    s.lastUsed = ++_tick;
+
+    Sample smp = {-1, -1, -1, 0};
+    if (s.count || s.hasPatch) {
+        float dx = (box.x + box.w * 0.5f) - (s.lastBox.x + s.lastBox.w * 0.5f);
+        float dy = (box.y + box.h * 0.5f) - (s.lastBox.y + s.lastBox.h * 0.5f);
+        smp.motion = sqrtf(dx * dx + dy * dy);
+    }
+
+    const size_t n = LIVE_PATCH * LIVE_PATCH;
+    int32_t norm0;
+    float mean0 = samplePatch(frame, box, 0, 0, _center, norm0);
+
+    if (s.hasPatch && smp.motion <= _cfg.motionMax) {
+        // Sai khác nhỏ nhất sau khi bù lệch ±1 px ngang/dọc (khung detect rung vài px), đã trừ
+        // phần chênh độ sáng trung bình (auto exposure), chia cho năng lượng của patch trước
+        float best = 1e30f;
+        for (int dy = -1; dy <= 1; dy++) {
+            for (int dx = -1; dx <= 1; dx++) {
+                const int8_t* cur = _center;
+                float mean = mean0;
+                int32_t norm = norm0;
+                if (dx || dy) {
+                    mean = samplePatch(frame, box, dx, dy, _scratch, norm);
+                    cur = _scratch;
+                }
+                float dm = mean - s.patchMean;
+                float ssd = (float)vk_ssd_s8_norms(s.patch, s.patchNorm, cur, norm, n) - n * dm * dm;
+                if (ssd < best) best = ssd;
+            }
+        }
+        float var = (float)s.patchNorm / n - s.patchMean * s.patchMean;
+        smp.micro = (best > 0 ? best : 0) / (n * (var + 16.0f));
+    }
+    memcpy(s.patch, _center, sizeof(s.patch));
+    s.patchMean = mean0;
+    s.patchNorm = norm0;
+    s.hasPatch = true;
+    s.lastBox = box;
+
+    if (lm) {
+        float ex = lm->rightEyeX - lm->leftEyeX, ey = lm->rightEyeY - lm->leftEyeY;
+        float d2 = ex * ex + ey * ey;
+        if (d2 > 1 && box.w > 0) {
+            float mx = (lm->leftEyeX + lm->rightEyeX) * 0.5f, my = (lm->leftEyeY + lm->rightEyeY) * 0.5f;
+            smp.eyeRatio = sqrtf(d2) / box.w;
+            // Chiếu vị trí mũi lên trục 2 mắt: lệch trái/phải khi đầu xoay (yaw)
+            smp.noseOffset = ((lm->noseX - mx) * ex + (lm->noseY - my) * ey) / d2;
+        }
+    }
+
+    s.hist[s.head] = smp;
+    s.head = (s.head + 1) % LIVE_HISTORY;
+    if (s.count < LIVE_HISTORY) s.count++;
+    return evaluate(s);
+}
+
+LivenessResult LivenessEngine::evaluate(const State& s) const {
+    LivenessResult r = {};
+    r.frames = s.count;
+
+    float microSum = 0; int microN = 0;
+    int moveN = 0, moveOk = 0;
+    float er = 0, er2 = 0, no = 0, no2 = 0; int geomN = 0;
+    for (uint8_t i = 0; i < s.count; i++) {
+        const Sample& h = s.hist[i];
+        if (h.micro >= 0) { microSum += h.micro; microN++; }
+        if (h.motion >= 0) {
+            moveN++;
+            if (h.motion >= _cfg.motionMin && h.motion <= _cfg.motionMax) moveOk++;
+        }
+        if (h.eyeRatio >= 0) {
+            er += h.eyeRatio; er2 += h.eyeRatio * h.eyeRatio;
+            no += h.noseOffset; no2 += h.noseOffset * h.noseOffset;
+            geomN++;
+        }
+    }
+    r.micro = microN ? microSum / microN : 0;
+    r.move = moveN ? (float)moveOk / moveN : 0;
+    if (geomN >= 2) {
+        float vr = er2 / geomN - (er / geomN) * (er / geomN);
+        float vn = no2 / geomN - (no / geomN) * (no / geomN);
+        float v = vr > vn ? vr : vn;
+        r.geom = v > 0 ? sqrtf(v) : 0;
+    }
+
+    // Cử động cả khung chỉ đóng góp phần nhỏ: ảnh chụp bị di chuyển cũng có cử động
+    float microScore = clampf((r.micro - _cfg.microFloor) / (_cfg.microRef - _cfg.microFloor), 0, 1);
+    float geomScore = _cfg.geomRef > 0 ? clampf(r.geom / _cfg.geomRef, 0, 1) : 0;
+    r.score = 0.7f * (microScore > geomScore ? microScore : geomScore) + 0.3f * r.move;
+    r.ready = s.count >= _cfg.minFrames;
+    r.live = r.ready && r.score >= _cfg.threshold;
+    return r;
+}
+
+void LivenessEngine::forget(uint32_t trackId) {
+    for (uint8_t i = 0; i < LIVE_TRACKS; i++) {
+        if (_states[i].id == trackId) memset(&_states[i], 0, sizeof(State));
+    }
+}
+
+void LivenessEngine::reset() {
+    memset(_states, 0, sizeof(_states));
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "face_tracker.h"   // TrackBox, Rgb565Frame
+#include "vec_kernels.h"
+
+// Liveness nhiều frame tại kiosk, thay cho so tâm khung mặt với 1 vị trí toàn cục.
+// Mỗi track (id từ FaceTracker) có ring buffer LIVE_HISTORY mẫu gần nhất, mỗi mẫu gồm:
+//   - dịch chuyển tâm khung so với frame trước (px)
+//   - vi chuyển động trong mặt: ảnh độ sáng LIVE_PATCH x LIVE_PATCH lấy theo khung (đã bù
+//     tịnh tiến), năng lượng sai khác với patch trước chia cho năng lượng patch -> ảnh chụp
+//     bị cầm di chuyển vẫn gần 0, mặt thật có chớp mắt / biểu cảm / xoay đầu thì lớn hơn
+//   - hình học landmark (chỉ frame có detect): khoảng cách 2 mắt / bề rộng khung và độ lệch
+//     mũi so với giữa 2 mắt; mặt phẳng (ảnh) giữ gần như không đổi, đầu thật xoay thì đổi
+// Chi phí mỗi frame cố định: lấy mẫu 9 patch (bù lệch ±1 px ngang/dọc) + 9 lần SSD qua
+// vk_ssd_s8_norms (tổng bình phương có sẵn từ lúc lấy mẫu, mỗi SSD chỉ còn 1 lần vk_dot_s8).
+// Thuần C++ (không phụ thuộc Arduino) -> build và đo tốc độ được trên Linux.
+
+#define LIVE_HISTORY  8
+#define LIVE_PATCH    32
+#define LIVE_TRACKS   TRACK_MAX
+
+struct LivenessConfig {
+    float motionMin = 5;       // px/frame: dịch chuyển tối thiểu được tính là "có cử động"
+    float motionMax = 60;      // px/frame: lớn hơn -> frame nhoè / nhảy khung, bỏ mẫu
+    float microFloor = 0.05f;  // vi chuyển động dưới mức này coi như nhiễu
+    float microRef = 0.15f;    // vi chuyển động đạt mức này -> điểm tối đa
+    float geomRef = 0.04f;     // độ lệch chuẩn hình học landmark đạt mức này -> điểm tối đa
+    float threshold = 0.5f;    // điểm >= threshold -> live
+    uint8_t minFrames = 4;     // số mẫu tối thiểu trước khi kết luận
+};
+
+struct LiveLandmarks {
+    float leftEyeX, leftEyeY;
+    float rightEyeX, rightEyeY;
+    float noseX, noseY;
+};
+
+struct LivenessResult {
+    float score;               // 0..1
+    float micro;               // vi chuyển động trung bình
+    float geom;                // độ lệch chuẩn hình học landmark
+    float move;                // tỉ lệ mẫu có cử động hợp lệ
+    uint8_t frames;            // số mẫu trong lịch sử
+    bool ready;                // đủ minFrames mẫu
+    bool live;
+};
+
+class LivenessEngine {
+public:
+    void setConfig(const LivenessConfig& cfg) { _cfg = cfg; }
+    const LivenessConfig& config() const { return _cfg; }
+
+    // Thêm 1 frame cho track. lm = nullptr khi frame chỉ có tracker (landmark không tin được).
+    LivenessResult update(uint32_t trackId, const Rgb565Frame& frame, const TrackBox& box,
+                          const LiveLandmarks* lm);
+    void forget(uint32_t trackId);
+    void reset();
+
+private:
+    struct Sample {
+        float motion;          // px, < 0: frame đầu / bị bỏ
+        float micro;           // < 0: không đo
+        float eyeRatio;        // < 0: không có landmark
+        float noseOffset;
+    };
+    struct State {
+        uint32_t id;           // 0 = slot trống
+        uint32_t lastUsed;
+        uint8_t head, count;
+        Sample hist[LIVE_HISTORY];
+        TrackBox lastBox;
+        bool hasPatch;
+        float patchMean;
+        int32_t patchNorm;     // sum(v^2) của patch
+        alignas(VK_ALIGN) int8_t patch[LIVE_PATCH * LIVE_PATCH];
+    };
+
+    State* slotFor(uint32_t trackId);
+    LivenessResult evaluate(const State& s) const;
+
+    LivenessConfig _cfg;
+    State _states[LIVE_TRACKS] = {};
+    uint32_t _tick = 0;
+    alignas(VK_ALIGN) int8_t _center[LIVE_PATCH * LIVE_PATCH];   // patch của frame hiện tại
+    alignas(VK_ALIGN) int8_t _scratch[LIVE_PATCH * LIVE_PATCH];  // patch đã dời ±1 px
+};
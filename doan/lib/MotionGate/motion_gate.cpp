@@ -0,0 +1,92 @@
+#include "motion_gate.h"
+#include <string.h>
+
+static inline int luma565(const uint8_t* p) {
+    int r = p[0] & 0xF8;
+    int g = ((p[0] & 0x07) << 5) | ((p[1] >> 3) & 0x1C);
+    int b = (p[1] & 0x1F) << 3;
+    return (r * 77 + g * 150 + b * 29) >> 8;
+}
+
+static const size_t BAND_PX = (MOTION_GRID / MOTION_BANDS) * MOTION_GRID;
+static_assert(MOTION_GRID % MOTION_BANDS == 0 && BAND_PX % VK_ALIGN == 0, "dải phải căn VK_ALIGN byte");
+
+// Lấy ảnh độ sáng (trừ 128 -> int8) vào _cur, trả về sai khác lớn nhất giữa các dải so với _ref
+float MotionGate::sample(const Rgb565Frame& frame) {
+    const size_t stride = (size_t)frame.width * 2;
+    int xs[MOTION_GRID];
+    for (int g = 0; g < MOTION_GRID; g++) {
+        int x = ((2 * g + 1) * frame.width) / (2 * MOTION_GRID);
+        xs[g] = (x + 1 < frame.width ? x : frame.width - 2) * 2;
+    }
+    int8_t* out = _cur;
+    float worst = 0;
+    for (int band = 0; band < MOTION_BANDS; band++) {
+        int32_t sum = 0, sum2 = 0;
+        for (int gy = band * (MOTION_GRID / MOTION_BANDS); gy < (band + 1) * (MOTION_GRID / MOTION_BANDS); gy++) {
+            int y = ((2 * gy + 1) * frame.height) / (2 * MOTION_GRID);
+            if (y + 1 >= frame.height) y = frame.height - 2;
+            const uint8_t* r0 = frame.buf + y * stride;
+            const uint8_t* r1 = r0 + stride;
+            for (int gx = 0; gx < MOTION_GRID; gx++) {
+                int v = (luma565(r0 + xs[gx]) + luma565(r0 + xs[gx] + 2) +
+                         luma565(r1 + xs[gx]) + luma565(r1 + xs[gx] + 2) + 2) >> 2;
+                *out++ = (int8_t)(v - 128);
+                sum += v - 128;
+                sum2 += (v - 128) * (v - 128);
+            }
+        }
+        float mean = (float)sum / BAND_PX;
+        if (_hasRef) {
+            size_t off = band * BAND_PX;
+            float dm = mean - _bandMean[band];
+            int32_t ssd = vk_ssd_s8_norms(_ref + off, _bandNorm[band], _cur + off, sum2, BAND_PX);
+            float msd = ((float)ssd - BAND_PX * dm * dm) / BAND_PX;
+            if (msd > worst) worst = msd;
+        }
+        _bandMean[band] = mean;
+        _bandNorm[band] = sum2;
+    }
+    memcpy(_ref, _cur, sizeof(_ref));
+    _hasRef = true;
+    return worst;
+}
+
+MotionTier MotionGate::update(const Rgb565Frame& frame, uint32_t nowMs) {
+    if (_started) {
+        uint32_t dt = nowMs - _lastUpdate;
+        if (dt <= _cfg.maxGapMs) {
+            if (_tier == MOTION_IDLE) _stats.idleMs += dt;
+            else _stats.activeMs += dt;
+        }
+    }
+    _started = true;
+    _lastUpdate = nowMs;
+    if (frame.width < 2 || frame.height < 2) return _tier;
+
+    bool hadRef = _hasRef;
+    _stats.lastScore = sample(frame);
+    bool motion = hadRef && _stats.lastScore > _cfg.threshold;
+
+    if (_tier == MOTION_IDLE) {
+        if (motion) {
+            _tier = MOTION_ACTIVE;
+            _lastActivity = nowMs;
+            _stats.wakeups++;
+        }
+    } else if (motion) {
+        _lastActivity = nowMs;
+    } else if (nowMs - _lastActivity > _cfg.quietMs) {
+        _tier = MOTION_IDLE;
+    }
+    if (_tier == MOTION_IDLE) _stats.idleFrames++;
+    else _stats.activeFrames++;
+    return _tier;
+}
+
+void MotionGate::reset(MotionTier tier, uint32_t nowMs) {
+    _tier = tier;
+    _hasRef = false;
+    _started = false;
+    _lastActivity = nowMs;
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "roi_jpeg.h"      // Rgb565Frame
+#include "vec_kernels.h"
+
+// Cổng chuyển động cho 2 chế độ của kiosk:
+//   - IDLE  : không ai trước máy -> capture chậm (vài FPS), mỗi frame chỉ lấy ảnh độ sáng
+//             MOTION_GRID x MOTION_GRID (mỗi ô trung bình 2x2 px) và so với frame trước
+//   - ACTIVE: chạy đủ detect / track / liveness. Vào ngay trên frame thấy chuyển động (frame
+//             đó đi tiếp vào pipeline đầy đủ), quay về IDLE sau quietMs không có chuyển động
+//             lẫn hoạt động (mặt, burst... báo qua hold())
+// Sai khác tính theo MOTION_BANDS dải ngang (mỗi dải là 1 đoạn liền trong bộ nhớ ->
+// vk_ssd_s8_norms: tổng bình phương tính sẵn lúc lấy mẫu + 1 lần vk_dot_s8 SIMD), đã trừ phần chênh độ sáng trung bình của dải (auto exposure)
+// -> người bước vào 1 góc khung vẫn đủ làm 1 dải vượt ngưỡng.
+// Thời gian ở mỗi chế độ cộng dồn giữa 2 lần update() (khoảng trống > maxGapMs, vd ngoài giờ
+// làm, không tính) -> tỉ lệ IDLE/ACTIVE.
+// Thuần C++ (không phụ thuộc Arduino) -> build và đo tốc độ được trên Linux.
+
+#define MOTION_GRID   32
+#define MOTION_BANDS  8
+
+enum MotionTier : uint8_t { MOTION_IDLE, MOTION_ACTIVE };
+
+struct MotionGateConfig {
+    float threshold = 50;         // sai khác bình phương trung bình / px (độ sáng 0..255) của 1 dải
+    uint32_t quietMs = 8000;      // ACTIVE không có chuyển động / hoạt động bấy lâu -> IDLE
+    uint32_t maxGapMs = 2000;     // 2 lần update cách xa hơn -> không cộng vào duty cycle
+};
+
+struct MotionGateStats {
+    uint64_t idleMs, activeMs;
+    uint32_t wakeups;             // số lần IDLE -> ACTIVE
+    uint32_t idleFrames, activeFrames;
+    float lastScore;              // sai khác lớn nhất giữa các dải ở frame gần nhất
+};
+
+class MotionGate {
+public:
+    void setConfig(const MotionGateConfig& cfg) { _cfg = cfg; }
+    const MotionGateConfig& config() const { return _cfg; }
+
+    // 1 frame mới: đo chuyển động, chuyển chế độ, trả về chế độ cho chính frame này
+    MotionTier update(const Rgb565Frame& frame, uint32_t nowMs);
+    // Pipeline đầy đủ đang có việc (thấy mặt, đang burst...) -> giữ ACTIVE
+    void hold(uint32_t nowMs) { _lastActivity = nowMs; }
+    // Về chế độ cho trước, bỏ frame tham chiếu (vd hết giờ làm, xong enroll)
+    void reset(MotionTier tier, uint32_t nowMs);
+
+    MotionTier tier() const { return _tier; }
+    MotionGateStats stats() const { return _stats; }
+
+private:
+    float sample(const Rgb565Frame& frame);
+
+    MotionGateConfig _cfg;
+    MotionGateStats _stats = {};
+    MotionTier _tier = MOTION_ACTIVE;
+    uint32_t _lastUpdate = 0, _lastActivity = 0;
+    bool _hasRef = false, _started = false;
+    float _bandMean[MOTION_BANDS] = {};
+    int32_t _bandNorm[MOTION_BANDS] = {};    // sum(v^2) của từng dải trong _ref
+    alignas(VK_ALIGN) int8_t _ref[MOTION_GRID * MOTION_GRID];
+    alignas(VK_ALIGN) int8_t _cur[MOTION_GRID * MOTION_GRID];
+};
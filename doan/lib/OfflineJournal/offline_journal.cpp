@@ -0,0 +1,390 @@
+#include "offline_journal.h"
+#include <dirent.h>
+#include <string.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const uint32_t RECORD_MAGIC = 0x4C524E4A;  // "JNRL"
+static const uint32_t CURSOR_MAGIC = 0x5255434A;  // "JCUR"
+static const size_t CRC_SPAN = JOURNAL_HEADER_LEN - 4;
+
+static uint16_t rd16(const uint8_t* p) { return p[0] | (p[1] << 8); }
+static uint32_t rd32(const uint8_t* p) { return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24); }
+static void wr32(uint8_t* p, uint32_t v) { p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24; }
+
+// CRC32 (IEEE, giống zlib) dùng bảng 16 phần tử -> gọn, không tốn RAM
+static uint32_t crc32Update(uint32_t crc, const uint8_t* p, size_t n) {
+    static const uint32_t T[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+    };
+    crc = ~crc;
+    while (n--) {
+        crc ^= *p++;
+        crc = (crc >> 4) ^ T[crc & 0x0F];
+        crc = (crc >> 4) ^ T[crc & 0x0F];
+    }
+    return ~crc;
+}
+
+static uint32_t fileSizeOf(FILE* f) {
+    if (fseek(f, 0, SEEK_END) != 0) return 0;
+    long n = ftell(f);
+    return n > 0 ? (uint32_t)n : 0;
+}
+
+void OfflineJournal::segPath(char* out, size_t n, uint32_t seg) const {
+    snprintf(out, n, "%s/seg_%08lu.log", _dir, (unsigned long)seg);
+}
+
+void OfflineJournal::cursorPath(char* out, size_t n) const {
+    snprintf(out, n, "%s/cursor", _dir);
+}
+
+bool OfflineJournal::begin(const char* dir, uint32_t segmentMax) {
+    end();
+    std::lock_guard<std::mutex> lock(_mtx);
+    snprintf(_dir, sizeof(_dir), "%s", dir);
+    _segMax = segmentMax;
+    _stats = {};
+    mkdir(_dir, 0777);
+
+    // 1. Tìm segment cũ nhất / mới nhất
+    DIR* d = opendir(_dir);
+    if (!d) return false;
+    uint32_t minSeg = 0, maxSeg = 0;
+    struct dirent* e;
+    while ((e = readdir(d)) != nullptr) {
+        unsigned long seg;
+        if (sscanf(e->d_name, "seg_%08lu.log", &seg) != 1 || seg == 0) continue;
+        if (!minSeg || seg < minSeg) minSeg = seg;
+        if (seg > maxSeg) maxSeg = seg;
+    }
+    closedir(d);
+    if (!minSeg) minSeg = maxSeg = 1;
+    _firstSeg = minSeg;
+
+    // 2. Cursor; hỏng/mất -> gửi lại từ segment cũ nhất (server tự bỏ quét lặp)
+    if (!loadCursor() || _curSeg < minSeg || _curSeg > maxSeg) {
+        _curSeg = minSeg;
+        _curOff = 0;
+    }
+    // Segment đã gửi hết nhưng chưa kịp xoá (mất điện ngay sau ack)
+    char path[64];
+    for (uint32_t s = minSeg; s < _curSeg; s++) {
+        segPath(path, sizeof(path), s);
+        ::remove(path);
+    }
+    _firstSeg = _curSeg;
+
+    // 3. Đếm record chưa gửi; đuôi segment cuối bị ghi dở -> niêm phong, ghi sang segment mới
+    uint32_t validEnd = 0, size = 0;
+    for (uint32_t s = _curSeg; s <= maxSeg; s++) {
+        _stats.pending += scanSegment(s, s == _curSeg ? _curOff : 0, &validEnd, &size);
+    }
+    _writeSeg = maxSeg;
+    _writeOff = size;
+    if (validEnd < size) {
+        _stats.recovered++;
+        _writeSeg = maxSeg + 1;
+        _writeOff = 0;
+    }
+
+    cursorPath(path, sizeof(path));
+    _c = fopen(path, "r+b");
+    if (!_c) _c = fopen(path, "w+b");
+    if (!_c || !saveCursor()) return false;
+    return openWriter();
+}
+
+void OfflineJournal::end() {
+    std::lock_guard<std::mutex> lock(_mtx);
+    closeReader();
+    if (_w) { fclose(_w); _w = nullptr; }
+    if (_c) { fclose(_c); _c = nullptr; }
+}
+
+bool OfflineJournal::openWriter() {
+    if (_w) fclose(_w);
+    char path[64];
+    segPath(path, sizeof(path), _writeSeg);
+    _w = fopen(path, "ab");
+    return _w != nullptr;
+}
+
+bool OfflineJournal::openReader(uint32_t seg, uint32_t need) {
+    // Segment đang ghi lớn dần -> mở lại khi cần đọc quá kích thước lúc mở
+    if (_r && _rSeg == seg && _rSize >= need) return true;
+    closeReader();
+    char path[64];
+    segPath(path, sizeof(path), seg);
+    _r = fopen(path, "rb");
+    if (!_r) return false;
+    _rSeg = seg;
+    _rSize = fileSizeOf(_r);
+    return true;
+}
+
+void OfflineJournal::closeReader() {
+    if (_r) { fclose(_r); _r = nullptr; }
+    _rSeg = 0;
+    _rSize = 0;
+}
+
+bool OfflineJournal::readHeader(FILE* f, uint32_t off, uint32_t fileSize, uint8_t* h, JournalRecord& rec) {
+    if (off + JOURNAL_HEADER_LEN > fileSize) return false;
+    if (fseek(f, off, SEEK_SET) != 0 || fread(h, 1, JOURNAL_HEADER_LEN, f) != JOURNAL_HEADER_LEN) return false;
+    if (rd32(h) != RECORD_MAGIC) return false;
+    rec.type = h[4];
+    rec.aligned = rd16(h + 6);
+    rec.timestamp = rd32(h + 8);
+    memcpy(rec.employeeId, h + 12, JOURNAL_ID_LEN);
+    rec.employeeId[JOURNAL_ID_LEN - 1] = 0;
+    rec.length = rd32(h + 44);
+    rec.offset = off;
+    return rec.length <= JOURNAL_MAX_PAYLOAD && off + JOURNAL_HEADER_LEN + rec.length <= fileSize;
+}
+
+bool OfflineJournal::checkPayload(const uint8_t* h, const JournalRecord& rec) {
+    uint32_t crc = crc32Update(0, h, CRC_SPAN);
+    uint8_t buf[512];
+    uint32_t left = rec.length;
+    if (fseek(_r, rec.offset + JOURNAL_HEADER_LEN, SEEK_SET) != 0) return false;
+    while (left) {
+        size_t n = fread(buf, 1, left < sizeof(buf) ? left : sizeof(buf), _r);
+        if (n == 0) return false;
+        crc = crc32Update(crc, buf, n);
+        left -= n;
+    }
+    return crc == rd32(h + CRC_SPAN);
+}
+
+// Duyệt header từ startOff (không đọc payload). Trả về số record hợp lệ,
+// *validEnd = cuối record hợp lệ cuối cùng, *fileSize = kích thước segment.
+uint32_t OfflineJournal::scanSegment(uint32_t seg, uint32_t startOff, uint32_t* validEnd, uint32_t* fileSize) {
+    char path[64];
+    segPath(path, sizeof(path), seg);
+    *validEnd = 0; *fileSize = 0;
+    FILE* f = fopen(path, "rb");
+    if (!f) return 0;
+    uint32_t size = fileSizeOf(f);
+    uint32_t off = startOff, count = 0;
+    uint8_t h[JOURNAL_HEADER_LEN];
+    JournalRecord rec;
+    while (readHeader(f, off, size, h, rec)) {
+        off += JOURNAL_HEADER_LEN + rec.length;
+        count++;
+    }
+    fclose(f);
+    *validEnd = off;
+    *fileSize = size;
+    return count;
+}
+
+// Số record chưa gửi tính lại từ cursor tới cuối journal (chỉ duyệt header)
+void OfflineJournal::recountPending() {
+    uint32_t validEnd, size, n = 0;
+    for (uint32_t s = _curSeg; s <= _writeSeg; s++) {
+        n += scanSegment(s, s == _curSeg ? _curOff : 0, &validEnd, &size);
+    }
+    _stats.pending = n;
+}
+
+bool OfflineJournal::append(uint8_t type, uint32_t timestamp, const char* employeeId,
+                            const uint8_t* data, size_t len, uint16_t aligned) {
+    std::lock_guard<std::mutex> lock(_mtx);
+    if (!_w || len > JOURNAL_MAX_PAYLOAD) return false;
+
+    if (_writeOff > 0 && _writeOff + JOURNAL_HEADER_LEN + len > _segMax) {
+        _writeSeg++;
+        _writeOff = 0;
+        if (!openWriter()) return false;
+    }
+
+    uint8_t h[JOURNAL_HEADER_LEN] = {};
+    wr32(h, RECORD_MAGIC);
+    h[4] = type;
+    h[6] = aligned;
+    h[7] = aligned >> 8;
+    wr32(h + 8, timestamp);
+    if (employeeId) strncpy((char*)h + 12, employeeId, JOURNAL_ID_LEN - 1);
+    wr32(h + 44, (uint32_t)len);
+    wr32(h + CRC_SPAN, crc32Update(crc32Update(0, h, CRC_SPAN), data, len));
+
+    bool ok = fwrite(h, 1, sizeof(h), _w) == sizeof(h) && fwrite(data, 1, len, _w) == len;
+    ok = (fflush(_w) == 0) && ok;
+    fsync(fileno(_w));
+    if (!ok) {
+        // Ghi dở -> phần đuôi hỏng, chuyển sang segment mới để reader không kẹt
+        _writeSeg++;
+        _writeOff = 0;
+        openWriter();
+        return false;
+    }
+    _writeOff += JOURNAL_HEADER_LEN + len;
+    _stats.appended++;
+    _stats.pending++;
+    return true;
+}
+
+void OfflineJournal::advanceSegment() {
+    closeReader();
+    char path[64];
+    segPath(path, sizeof(path), _curSeg);
+    ::remove(path);
+    _curSeg++;
+    _curOff = 0;
+    _firstSeg = _curSeg;
+    saveCursor();
+}
+
+bool OfflineJournal::peek(JournalRecord& rec) {
+    std::lock_guard<std::mutex> lock(_mtx);
+    uint8_t h[JOURNAL_HEADER_LEN];
+    for (;;) {
+        bool sealed = _curSeg < _writeSeg;
+        uint32_t segEnd = sealed ? 0 : _writeOff;
+        if (!sealed && _curOff >= segEnd) return false;
+
+        if (!openReader(_curSeg, sealed ? 0 : segEnd)) {
+            if (sealed) { advanceSegment(); continue; }
+            return false;
+        }
+        if (sealed) segEnd = _rSize;
+        if (_curOff >= segEnd) { advanceSegment(); continue; }
+
+        if (!readHeader(_r, _curOff, segEnd, h, rec)) {
+            // Header hỏng: không biết record kế tiếp ở đâu -> bỏ phần còn lại của segment,
+            // các record bị bỏ theo không còn chờ gửi -> đếm lại pending từ cursor mới
+            _stats.corrupt++;
+            if (sealed) {
+                advanceSegment();
+                recountPending();
+                continue;
+            }
+            _curOff = _writeOff;
+            saveCursor();
+            recountPending();
+            return false;
+        }
+        rec.segment = _curSeg;
+        if (!checkPayload(h, rec)) {
+            _stats.corrupt++;
+            _curOff += JOURNAL_HEADER_LEN + rec.length;
+            if (_stats.pending) _stats.pending--;
+            saveCursor();
+            continue;
+        }
+        return true;
+    }
+}
+
+// Tìm record hợp lệ đầu tiên từ (seg, off), không đụng tới cursor.
+// Record hỏng được bỏ qua ở đây; peek() sẽ đếm và bỏ chúng khi cursor tới nơi.
+bool OfflineJournal::findFrom(uint32_t seg, uint32_t off, JournalRecord& rec) {
+    uint8_t h[JOURNAL_HEADER_LEN];
+    while (seg <= _writeSeg) {
+        bool sealed = seg < _writeSeg;
+        if (!sealed && off >= _writeOff) return false;
+        if (!openReader(seg, sealed ? 0 : _writeOff)) {
+            if (!sealed) return false;
+            seg++; off = 0;
+            continue;
+        }
+        uint32_t segEnd = sealed ? _rSize : _writeOff;
+        if (off >= segEnd || !readHeader(_r, off, segEnd, h, rec)) {
+            if (!sealed) return false;
+            seg++; off = 0;
+            continue;
+        }
+        rec.segment = seg;
+        if (!checkPayload(h, rec)) {
+            off += JOURNAL_HEADER_LEN + rec.length;
+            continue;
+        }
+        return true;
+    }
+    return false;
+}
+
+bool OfflineJournal::next(const JournalRecord& after, JournalRecord& rec) {
+    std::lock_guard<std::mutex> lock(_mtx);
+    return findFrom(after.segment, after.offset + JOURNAL_HEADER_LEN + after.length, rec);
+}
+
+size_t OfflineJournal::readAt(uint32_t seg, uint32_t pos, uint8_t* dst, size_t len) {
+    if (!openReader(seg, pos + len)) return 0;
+    if (fseek(_r, pos, SEEK_SET) != 0) return 0;
+    return fread(dst, 1, len, _r);
+}
+
+size_t OfflineJournal::read(const JournalRecord& rec, uint32_t offset, uint8_t* dst, size_t len) {
+    std::lock_guard<std::mutex> lock(_mtx);
+    if (offset >= rec.length) return 0;
+    if (len > rec.length - offset) len = rec.length - offset;
+    return readAt(rec.segment, rec.offset + JOURNAL_HEADER_LEN + offset, dst, len);
+}
+
+size_t OfflineJournal::readRecord(const JournalRecord& rec, uint32_t offset, uint8_t* dst, size_t len) {
+    std::lock_guard<std::mutex> lock(_mtx);
+    uint32_t total = JOURNAL_HEADER_LEN + rec.length;
+    if (offset >= total) return 0;
+    if (len > total - offset) len = total - offset;
+    return readAt(rec.segment, rec.offset + offset, dst, len);
+}
+
+bool OfflineJournal::ack(const JournalRecord& rec) {
+    std::lock_guard<std::mutex> lock(_mtx);
+    if (rec.segment != _curSeg || rec.offset != _curOff) return false;
+    _curOff += JOURNAL_HEADER_LEN + rec.length;
+    _stats.acked++;
+    if (_stats.pending) _stats.pending--;
+    if (_curSeg < _writeSeg && openReader(_curSeg, 0) && _curOff >= _rSize) {
+        advanceSegment();   // segment đã gửi hết -> xoá luôn
+    } else {
+        saveCursor();
+    }
+    return true;
+}
+
+uint32_t OfflineJournal::pending() const {
+    std::lock_guard<std::mutex> lock(_mtx);
+    return _stats.pending;
+}
+
+JournalStats OfflineJournal::stats() const {
+    std::lock_guard<std::mutex> lock(_mtx);
+    JournalStats s = _stats;
+    s.firstSegment = _firstSeg;
+    s.writeSegment = _writeSeg;
+    return s;
+}
+
+bool OfflineJournal::loadCursor() {
+    char path[64];
+    cursorPath(path, sizeof(path));
+    FILE* f = fopen(path, "rb");
+    if (!f) return false;
+    uint8_t b[16];
+    bool ok = fread(b, 1, sizeof(b), f) == sizeof(b);
+    fclose(f);
+    if (!ok || rd32(b) != CURSOR_MAGIC || rd32(b + 12) != crc32Update(0, b, 12)) return false;
+    _curSeg = rd32(b + 4);
+    _curOff = rd32(b + 8);
+    return true;
+}
+
+// Ghi đè 16 byte tại chỗ (1 sector) -> ack là O(1), không rename file
+bool OfflineJournal::saveCursor() {
+    if (!_c) return false;
+    uint8_t b[16];
+    wr32(b, CURSOR_MAGIC);
+    wr32(b + 4, _curSeg);
+    wr32(b + 8, _curOff);
+    wr32(b + 12, crc32Update(0, b, 12));
+    if (fseek(_c, 0, SEEK_SET) != 0 || fwrite(b, 1, sizeof(b), _c) != sizeof(b)) return false;
+    fflush(_c);
+    fsync(fileno(_c));
+    return true;
+}
@@ -0,0 +1,112 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <mutex>
+
+// Hàng đợi offline dạng journal nhị phân chỉ-ghi-thêm (append-only) trên thẻ SD.
+// Mỗi sự kiện là 1 record: header cố định + ảnh JPEG nằm ngay sau, không còn
+// file queue.txt hay file ảnh riêng cho từng sự kiện.
+//
+//   <dir>/seg_00000001.log, seg_00000002.log ...  các segment, xoay vòng khi vượt segmentMax
+//   <dir>/cursor                                  vị trí record cũ nhất chưa gửi (ghi đè tại chỗ)
+//
+// Header record (little-endian, JOURNAL_HEADER_LEN byte):
+//   magic u32 "JNRL" | type u8 | flags u8 | aligned u16 | timestamp u32 (giờ RTC, giây)
+//   | employee_id char[32] | length u32 | crc32 u32 (của 48 byte đầu header + payload)
+// aligned: cạnh ảnh vuông đã căn mặt theo 2 mắt (như X-Face-Aligned), 0 = ảnh cắt khung mặt.
+//
+// Khôi phục sau mất điện: chỉ duyệt header của segment cuối; đuôi bị ghi dở thì bỏ
+// segment đó (niêm phong) và ghi tiếp sang segment mới, không cần rename/truncate.
+// Thuần C++ (stdio + dirent) nên chạy được cả trên ESP32 (VFS /sd) lẫn Linux.
+
+#define JOURNAL_HEADER_LEN    52
+#define JOURNAL_ID_LEN        32
+#define JOURNAL_SEGMENT_MAX   (4UL * 1024 * 1024)
+#define JOURNAL_MAX_PAYLOAD   (512UL * 1024)
+
+enum JournalType : uint8_t {
+    JOURNAL_RECOGNIZE = 1,
+    JOURNAL_ENROLL    = 2,
+};
+
+struct JournalRecord {
+    uint8_t type;
+    uint32_t timestamp;
+    char employeeId[JOURNAL_ID_LEN];
+    uint32_t length;       // số byte payload (JPEG)
+    uint16_t aligned;      // cạnh ảnh đã căn mặt, 0 = chưa căn
+    uint32_t segment;      // vị trí record trong journal
+    uint32_t offset;
+};
+
+struct JournalStats {
+    uint32_t appended;
+    uint32_t acked;
+    uint32_t corrupt;      // record hỏng (sai CRC/header) đã bị bỏ qua
+    uint32_t recovered;    // số lần phát hiện đuôi ghi dở lúc khởi động
+    uint32_t pending;      // record chưa gửi
+    uint32_t firstSegment;
+    uint32_t writeSegment;
+};
+
+class OfflineJournal {
+public:
+    ~OfflineJournal() { end(); }
+
+    bool begin(const char* dir, uint32_t segmentMax = JOURNAL_SEGMENT_MAX);
+    void end();
+
+    bool append(uint8_t type, uint32_t timestamp, const char* employeeId,
+                const uint8_t* data, size_t len, uint16_t aligned = 0);
+
+    // Record cũ nhất chưa ack (đã kiểm tra CRC). false nếu hàng đợi rỗng.
+    bool peek(JournalRecord& rec);
+    // Record hợp lệ ngay sau "after" (gom nhiều record gửi 1 lần, chưa ack)
+    bool next(const JournalRecord& after, JournalRecord& rec);
+    // Đọc payload của rec từ vị trí offset (để stream thẳng lên HTTP theo từng khối)
+    size_t read(const JournalRecord& rec, uint32_t offset, uint8_t* dst, size_t len);
+    // Như read() nhưng tính cả header: offset 0 là byte đầu của record (gửi nguyên record)
+    size_t readRecord(const JournalRecord& rec, uint32_t offset, uint8_t* dst, size_t len);
+    // Xác nhận đã gửi rec. Phải ack theo thứ tự: rec là record cũ nhất chưa ack.
+    // O(1), chỉ ghi lại cursor.
+    bool ack(const JournalRecord& rec);
+
+    uint32_t pending() const;
+    JournalStats stats() const;
+
+private:
+    void segPath(char* out, size_t n, uint32_t seg) const;
+    void cursorPath(char* out, size_t n) const;
+    bool openWriter();
+    bool openReader(uint32_t seg, uint32_t need);
+    void closeReader();
+    bool findFrom(uint32_t seg, uint32_t off, JournalRecord& rec);
+    size_t readAt(uint32_t seg, uint32_t pos, uint8_t* dst, size_t len);
+    bool readHeader(FILE* f, uint32_t off, uint32_t fileSize, uint8_t* h, JournalRecord& rec);
+    bool checkPayload(const uint8_t* h, const JournalRecord& rec);
+    uint32_t scanSegment(uint32_t seg, uint32_t startOff, uint32_t* validEnd, uint32_t* fileSize);
+    void recountPending();
+    void advanceSegment();
+    bool loadCursor();
+    bool saveCursor();
+
+    char _dir[32] = "";
+    uint32_t _segMax = JOURNAL_SEGMENT_MAX;
+
+    uint32_t _firstSeg = 1;
+    uint32_t _writeSeg = 1;
+    uint32_t _writeOff = 0;
+    FILE* _w = nullptr;
+
+    uint32_t _curSeg = 1;        // cursor: record cũ nhất chưa gửi
+    uint32_t _curOff = 0;
+    FILE* _c = nullptr;          // file cursor, giữ mở để ack O(1)
+
+    FILE* _r = nullptr;
+    uint32_t _rSeg = 0;
+    uint32_t _rSize = 0;         // kích thước segment lúc mở (FAT không thấy phần ghi sau đó)
+
+    JournalStats _stats = {};
+    mutable std::mutex _mtx;
+};
@@ -0,0 +1,383 @@
+#include "roi_jpeg.h"
+#include <math.h>
+#include <string.h>
+
+// Vị trí natural -> zigzag của 64 hệ số
+static const uint8_t ZIGZAG[64] = {
+     0,  1,  5,  6, 14, 15, 27, 28,  2,  4,  7, 13, 16, 26, 29, 42,
+     3,  8, 12, 17, 25, 30, 41, 43,  9, 11, 18, 24, 31, 40, 44, 53,
+    10, 19, 23, 32, 39, 45, 52, 54, 20, 22, 33, 38, 46, 51, 55, 60,
+    21, 34, 37, 47, 50, 56, 59, 61, 35, 36, 48, 49, 57, 58, 62, 63
+};
+
+// Bảng lượng tử chuẩn (Annex K), thứ tự natural
+static const uint8_t LUMA_QT[64] = {
+    16, 11, 10, 16, 24, 40, 51, 61,   12, 12, 14, 19, 26, 58, 60, 55,
+    14, 13, 16, 24, 40, 57, 69, 56,   14, 17, 22, 29, 51, 87, 80, 62,
+    18, 22, 37, 56, 68,109,103, 77,   24, 35, 55, 64, 81,104,113, 92,
+    49, 64, 78, 87,103,121,120,101,   72, 92, 95, 98,112,100,103, 99
+};
+static const uint8_t CHROMA_QT[64] = {
+    17, 18, 24, 47, 99, 99, 99, 99,   18, 21, 26, 66, 99, 99, 99, 99,
+    24, 26, 56, 99, 99, 99, 99, 99,   47, 66, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,   99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,   99, 99, 99, 99, 99, 99, 99, 99
+};
+
+// Bảng Huffman chuẩn: số mã theo độ dài 1..16, rồi các giá trị
+static const uint8_t DC_LUMA_BITS[16] = {0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0};
+static const uint8_t DC_CHROMA_BITS[16] = {0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0};
+static const uint8_t DC_VALS[12] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11};
+
+static const uint8_t AC_LUMA_BITS[16] = {0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d};
+static const uint8_t AC_LUMA_VALS[162] = {
+    0x01,0x02,0x03,0x00,0x04,0x11,0x05,0x12,0x21,0x31,0x41,0x06,0x13,0x51,0x61,0x07,0x22,0x71,0x14,0x32,0x81,0x91,0xa1,0x08,
+    0x23,0x42,0xb1,0xc1,0x15,0x52,0xd1,0xf0,0x24,0x33,0x62,0x72,0x82,0x09,0x0a,0x16,0x17,0x18,0x19,0x1a,0x25,0x26,0x27,0x28,
+    0x29,0x2a,0x34,0x35,0x36,0x37,0x38,0x39,0x3a,0x43,0x44,0x45,0x46,0x47,0x48,0x49,0x4a,0x53,0x54,0x55,0x56,0x57,0x58,0x59,
+    0x5a,0x63,0x64,0x65,0x66,0x67,0x68,0x69,0x6a,0x73,0x74,0x75,0x76,0x77,0x78,0x79,0x7a,0x83,0x84,0x85,0x86,0x87,0x88,0x89,
+    0x8a,0x92,0x93,0x94,0x95,0x96,0x97,0x98,0x99,0x9a,0xa2,0xa3,0xa4,0xa5,0xa6,0xa7,0xa8,0xa9,0xaa,0xb2,0xb3,0xb4,0xb5,0xb6,
+    0xb7,0xb8,0xb9,0xba,0xc2,0xc3,0xc4,0xc5,0xc6,0xc7,0xc8,0xc9,0xca,0xd2,0xd3,0xd4,0xd5,0xd6,0xd7,0xd8,0xd9,0xda,0xe1,0xe2,
+    0xe3,0xe4,0xe5,0xe6,0xe7,0xe8,0xe9,0xea,0xf1,0xf2,0xf3,0xf4,0xf5,0xf6,0xf7,0xf8,0xf9,0xfa
+};
+static const uint8_t AC_CHROMA_BITS[16] = {0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77};
+static const uint8_t AC_CHROMA_VALS[162] = {
+    0x00,0x01,0x02,0x03,0x11,0x04,0x05,0x21,0x31,0x06,0x12,0x41,0x51,0x07,0x61,0x71,0x13,0x22,0x32,0x81,0x08,0x14,0x42,0x91,
+    0xa1,0xb1,0xc1,0x09,0x23,0x33,0x52,0xf0,0x15,0x62,0x72,0xd1,0x0a,0x16,0x24,0x34,0xe1,0x25,0xf1,0x17,0x18,0x19,0x1a,0x26,
+    0x27,0x28,0x29,0x2a,0x35,0x36,0x37,0x38,0x39,0x3a,0x43,0x44,0x45,0x46,0x47,0x48,0x49,0x4a,0x53,0x54,0x55,0x56,0x57,0x58,
+    0x59,0x5a,0x63,0x64,0x65,0x66,0x67,0x68,0x69,0x6a,0x73,0x74,0x75,0x76,0x77,0x78,0x79,0x7a,0x82,0x83,0x84,0x85,0x86,0x87,
+    0x88,0x89,0x8a,0x92,0x93,0x94,0x95,0x96,0x97,0x98,0x99,0x9a,0xa2,0xa3,0xa4,0xa5,0xa6,0xa7,0xa8,0xa9,0xaa,0xb2,0xb3,0xb4,
+    0xb5,0xb6,0xb7,0xb8,0xb9,0xba,0xc2,0xc3,0xc4,0xc5,0xc6,0xc7,0xc8,0xc9,0xca,0xd2,0xd3,0xd4,0xd5,0xd6,0xd7,0xd8,0xd9,0xda,
+    0xe2,0xe3,0xe4,0xe5,0xe6,0xe7,0xe8,0xe9,0xea,0xf2,0xf3,0xf4,0xf5,0xf6,0xf7,0xf8,0xf9,0xfa
+};
+
+// Hệ số co giãn của DCT AAN (đã nhân sqrt(8)) -> gộp vào bảng chia khi lượng tử
+static const float AAN_SCALE[8] = {
+    1.0f * 2.828427125f, 1.387039845f * 2.828427125f, 1.306562965f * 2.828427125f, 1.175875602f * 2.828427125f,
+    1.0f * 2.828427125f, 0.785694958f * 2.828427125f, 0.541196100f * 2.828427125f, 0.275899379f * 2.828427125f
+};
+
+// Mẫu vị trí 2 mắt của ảnh mặt 112x112 đã căn (ArcFace)
+static const float ALIGN_LEFT_EYE[2] = {38.2946f, 51.6963f};
+static const float ALIGN_RIGHT_EYE[2] = {73.5318f, 51.5014f};
+
+struct HuffCode { uint16_t code; uint8_t len; };
+
+// Nguồn pixel: trả về 1 khối 16x16 RGB888 tại (x0, y0) của ảnh đích
+class PixelSource {
+public:
+    virtual ~PixelSource() {}
+    virtual void block(int x0, int y0, uint8_t rgb[16][16][3]) = 0;
+    int width = 0, height = 0;
+};
+
+static inline void rgb565At(const uint8_t* p, uint8_t* out) {
+    out[0] = p[0] & 0xF8;
+    out[1] = ((p[0] & 0x07) << 5) | ((p[1] & 0xE0) >> 3);
+    out[2] = (p[1] & 0x1F) << 3;
+}
+
+// ROI đọc thẳng từ frame theo stride; ngoài biên ROI thì lặp lại pixel mép
+class RoiSource : public PixelSource {
+public:
+    RoiSource(const Rgb565Frame& f, int x, int y, int w, int h) : _f(f), _x(x), _y(y) { width = w; height = h; }
+
+    void block(int x0, int y0, uint8_t rgb[16][16][3]) override {
+        size_t stride = (size_t)_f.width * 2;
+        for (int j = 0; j < 16; j++) {
+            int sy = _y + (y0 + j < height ? y0 + j : height - 1);
+            const uint8_t* row = _f.buf + sy * stride;
+            for (int i = 0; i < 16; i++) {
+                int sx = _x + (x0 + i < width ? x0 + i : width - 1);
+                rgb565At(row + sx * 2, rgb[j][i]);
+            }
+        }
+    }
+
+private:
+    const Rgb565Frame& _f;
+    int _x, _y;
+};
+
+// Ảnh đích size x size lấy mẫu song tuyến qua phép đồng dạng (xoay + co giãn + tịnh tiến)
+class AlignedSource : public PixelSource {
+public:
+    AlignedSource(const Rgb565Frame& f, const FaceEyes& e, uint16_t size) : _f(f) {
+        width = height = size;
+        float k = size / 112.0f;
+        float dlx = ALIGN_LEFT_EYE[0] * k, dly = ALIGN_LEFT_EYE[1] * k;
+        float ddx = (ALIGN_RIGHT_EYE[0] - ALIGN_LEFT_EYE[0]) * k;
+        float ddy = (ALIGN_RIGHT_EYE[1] - ALIGN_LEFT_EYE[1]) * k;
+        float sdx = e.rightX - e.leftX, sdy = e.rightY - e.leftY;
+        float d2 = ddx * ddx + ddy * ddy;
+        // src = [a -b; b a] * (dst - mắt trái đích) + mắt trái nguồn
+        _a = (sdx * ddx + sdy * ddy) / d2;
+        _b = (sdy * ddx - sdx * ddy) / d2;
+        _tx = e.leftX - _a * dlx + _b * dly;
+        _ty = e.leftY - _b * dlx - _a * dly;
+    }
+
+    void block(int x0, int y0, uint8_t rgb[16][16][3]) override {
+        for (int j = 0; j < 16; j++) {
+            float v = (float)(y0 + j);
+            float sx = _a * x0 - _b * v + _tx;
+            float sy = _b * x0 + _a * v + _ty;
+            for (int i = 0; i < 16; i++, sx += _a, sy += _b) sample(sx, sy, rgb[j][i]);
+        }
+    }
+
+private:
+    void sample(float sx, float sy, uint8_t* out) {
+        int maxX = _f.width - 1, maxY = _f.height - 1;
+        if (sx < 0) sx = 0; else if (sx > maxX) sx = (float)maxX;
+        if (sy < 0) sy = 0; else if (sy > maxY) sy = (float)maxY;
+        int x = (int)sx, y = (int)sy;
+        int x1 = x < maxX ? x + 1 : x, y1 = y < maxY ? y + 1 : y;
+        float fx = sx - x, fy = sy - y;
+        size_t stride = (size_t)_f.width * 2;
+        uint8_t p00[3], p01[3], p10[3], p11[3];
+        rgb565At(_f.buf + y * stride + x * 2, p00);
+        rgb565At(_f.buf + y * stride + x1 * 2, p01);
+        rgb565At(_f.buf + y1 * stride + x * 2, p10);
+        rgb565At(_f.buf + y1 * stride + x1 * 2, p11);
+        for (int c = 0; c < 3; c++) {
+            float top = p00[c] + (p01[c] - p00[c]) * fx;
+            float bot = p10[c] + (p11[c] - p10[c]) * fx;
+            out[c] = (uint8_t)(top + (bot - top) * fy + 0.5f);
+        }
+    }
+
+    const Rgb565Frame& _f;
+    float _a, _b, _tx, _ty;
+};
+
+class JpegEncoder {
+public:
+    JpegEncoder(JpegWriteFn write, void* ctx) : _write(write), _ctx(ctx) {}
+
+    bool encode(PixelSource& src, uint8_t quality) {
+        if (src.width <= 0 || src.height <= 0 || src.width > 0xFFFF || src.height > 0xFFFF) return false;
+        setupTables(quality);
+        writeHeaders(src.width, src.height);
+
+        uint8_t rgb[16][16][3];
+        float y[4][64], cb[64], cr[64];
+        int dcY = 0, dcCb = 0, dcCr = 0;
+        for (int my = 0; my < src.height && _ok; my += 16) {
+            for (int mx = 0; mx < src.width && _ok; mx += 16) {
+                src.block(mx, my, rgb);
+                // Y: 4 khối 8x8; Cb/Cr: trung bình 2x2 (4:2:0). Trừ 128 để về khoảng có dấu.
+                for (int j = 0; j < 16; j++) {
+                    for (int i = 0; i < 16; i++) {
+                        const uint8_t* p = rgb[j][i];
+                        y[(j >> 3) * 2 + (i >> 3)][(j & 7) * 8 + (i & 7)] =
+                            0.299f * p[0] + 0.587f * p[1] + 0.114f * p[2] - 128.0f;
+                    }
+                }
+                for (int j = 0; j < 8; j++) {
+                    for (int i = 0; i < 8; i++) {
+                        float r = 0, g = 0, b = 0;
+                        for (int dj = 0; dj < 2; dj++) {
+                            for (int di = 0; di < 2; di++) {
+                                const uint8_t* p = rgb[j * 2 + dj][i * 2 + di];
+                                r += p[0]; g += p[1]; b += p[2];
+                            }
+                        }
+                        r *= 0.25f; g *= 0.25f; b *= 0.25f;
+                        cb[j * 8 + i] = -0.168736f * r - 0.331264f * g + 0.5f * b;
+                        cr[j * 8 + i] = 0.5f * r - 0.418688f * g - 0.081312f * b;
+                    }
+                }
+                for (int k = 0; k < 4; k++) dcY = block(y[k], _fdY, dcY, _dcY, _acY);
+                dcCb = block(cb, _fdC, dcCb, _dcC, _acC);
+                dcCr = block(cr, _fdC, dcCr, _dcC, _acC);
+            }
+        }
+        // Lấp byte cuối bằng bit 1, rồi EOI
+        putBits(0x7F, 7);
+        const uint8_t eoi[2] = {0xFF, 0xD9};
+        put(eoi, 2);
+        flushOut();
+        return _ok;
+    }
+
+private:
+    void setupTables(uint8_t quality) {
+        if (quality < 1) quality = 1;
+        if (quality > 100) quality = 100;
+        int scale = quality < 50 ? 5000 / quality : 200 - quality * 2;
+        for (int i = 0; i < 64; i++) {
+            int yq = (LUMA_QT[i] * scale + 50) / 100;
+            int cq = (CHROMA_QT[i] * scale + 50) / 100;
+            yq = yq < 1 ? 1 : (yq > 255 ? 255 : yq);
+            cq = cq < 1 ? 1 : (cq > 255 ? 255 : cq);
+            _qY[ZIGZAG[i]] = (uint8_t)yq;
+            _qC[ZIGZAG[i]] = (uint8_t)cq;
+            int row = i >> 3, col = i & 7;
+            _fdY[i] = 1.0f / (yq * AAN_SCALE[row] * AAN_SCALE[col]);
+            _fdC[i] = 1.0f / (cq * AAN_SCALE[row] * AAN_SCALE[col]);
+        }
+        buildHuff(DC_LUMA_BITS, DC_VALS, _dcY);
+        buildHuff(DC_CHROMA_BITS, DC_VALS, _dcC);
+        buildHuff(AC_LUMA_BITS, AC_LUMA_VALS, _acY);
+        buildHuff(AC_CHROMA_BITS, AC_CHROMA_VALS, _acC);
+    }
+
+    static void buildHuff(const uint8_t* bits, const uint8_t* vals, HuffCode* out) {
+        uint16_t code = 0;
+        int k = 0;
+        for (int len = 1; len <= 16; len++) {
+            for (int i = 0; i < bits[len - 1]; i++, k++) out[vals[k]] = {code++, (uint8_t)len};
+            code <<= 1;
+        }
+    }
+
+    void writeHeaders(int w, int h) {
+        static const uint8_t SOI_APP0[] = {
+            0xFF, 0xD8, 0xFF, 0xE0, 0, 16, 'J', 'F', 'I', 'F', 0, 1, 1, 0, 0, 1, 0, 1, 0, 0
+        };
+        put(SOI_APP0, sizeof(SOI_APP0));
+
+        const uint8_t dqt[] = {0xFF, 0xDB, 0, 132};
+        put(dqt, sizeof(dqt));
+        putByte(0); put(_qY, 64);
+        putByte(1); put(_qC, 64);
+
+        const uint8_t sof[] = {
+            0xFF, 0xC0, 0, 17, 8, (uint8_t)(h >> 8), (uint8_t)h, (uint8_t)(w >> 8), (uint8_t)w, 3,
+            1, 0x22, 0,   2, 0x11, 1,   3, 0x11, 1
+        };
+        put(sof, sizeof(sof));
+
+        const uint8_t dht[] = {0xFF, 0xC4, 0x01, 0xA2};
+        put(dht, sizeof(dht));
+        putByte(0x00); put(DC_LUMA_BITS, 16); put(DC_VALS, 12);
+        putByte(0x10); put(AC_LUMA_BITS, 16); put(AC_LUMA_VALS, 162);
+        putByte(0x01); put(DC_CHROMA_BITS, 16); put(DC_VALS, 12);
+        putByte(0x11); put(AC_CHROMA_BITS, 16); put(AC_CHROMA_VALS, 162);
+
+        static const uint8_t SOS[] = {0xFF, 0xDA, 0, 12, 3, 1, 0x00, 2, 0x11, 3, 0x11, 0, 63, 0};
+        put(SOS, sizeof(SOS));
+    }
+
+    static void dct8(float* d, int step) {
+        float t0 = d[0] + d[7 * step], t7 = d[0] - d[7 * step];
+        float t1 = d[step] + d[6 * step], t6 = d[step] - d[6 * step];
+        float t2 = d[2 * step] + d[5 * step], t5 = d[2 * step] - d[5 * step];
+        float t3 = d[3 * step] + d[4 * step], t4 = d[3 * step] - d[4 * step];
+
+        float t10 = t0 + t3, t13 = t0 - t3, t11 = t1 + t2, t12 = t1 - t2;
+        d[0] = t10 + t11;
+        d[4 * step] = t10 - t11;
+        float z1 = (t12 + t13) * 0.707106781f;
+        d[2 * step] = t13 + z1;
+        d[6 * step] = t13 - z1;
+
+        t10 = t4 + t5; t11 = t5 + t6; t12 = t6 + t7;
+        float z5 = (t10 - t12) * 0.382683433f;
+        float z2 = t10 * 0.541196100f + z5;
+        float z4 = t12 * 1.306562965f + z5;
+        float z3 = t11 * 0.707106781f;
+        float z11 = t7 + z3, z13 = t7 - z3;
+        d[5 * step] = z13 + z2;
+        d[3 * step] = z13 - z2;
+        d[step] = z11 + z4;
+        d[7 * step] = z11 - z4;
+    }
+
+    static void category(int v, uint16_t& bits, uint8_t& len) {
+        int a = v < 0 ? -v : v;
+        len = 0;
+        while (a) { len++; a >>= 1; }
+        bits = (uint16_t)((v < 0 ? v - 1 : v) & ((1 << len) - 1));
+    }
+
+    // DCT + lượng tử + mã Huffman 1 khối 8x8, trả về DC để tính DC kế tiếp
+    int block(float* du, const float* fd, int prevDc, const HuffCode* dc, const HuffCode* ac) {
+        for (int r = 0; r < 8; r++) dct8(du + r * 8, 1);
+        for (int c = 0; c < 8; c++) dct8(du + c, 8);
+
+        int q[64];
+        for (int i = 0; i < 64; i++) {
+            float v = du[i] * fd[i];
+            q[ZIGZAG[i]] = (int)(v < 0 ? ceilf(v - 0.5f) : floorf(v + 0.5f));
+        }
+
+        uint16_t bits; uint8_t len;
+        category(q[0] - prevDc, bits, len);
+        putCode(dc[len]);
+        if (len) putBits(bits, len);
+
+        int last = 63;
+        while (last > 0 && q[last] == 0) last--;
+        for (int i = 1; i <= last; i++) {
+            int run = 0;
+            while (q[i] == 0) { run++; i++; }
+            while (run >= 16) { putCode(ac[0xF0]); run -= 16; }
+            category(q[i], bits, len);
+            putCode(ac[(run << 4) | len]);
+            putBits(bits, len);
+        }
+        if (last != 63) putCode(ac[0x00]);
+        return q[0];
+    }
+
+    void putCode(const HuffCode& c) { putBits(c.code, c.len); }
+
+    void putBits(uint32_t bits, uint8_t len) {
+        _bitBuf = (_bitBuf << len) | (bits & ((1u << len) - 1));
+        _bitCnt += len;
+        while (_bitCnt >= 8) {
+            uint8_t b = (uint8_t)(_bitBuf >> (_bitCnt - 8));
+            putByte(b);
+            if (b == 0xFF) putByte(0);   // byte stuffing
+            _bitCnt -= 8;
+        }
+    }
+
+    void putByte(uint8_t b) {
+        _out[_outLen++] = b;
+        if (_outLen == ROI_JPEG_OUT_CHUNK) flushOut();
+    }
+
+    void put(const uint8_t* p, size_t n) {
+        while (n--) putByte(*p++);
+    }
+
+    void flushOut() {
+        if (_outLen && _ok) _ok = _write(_ctx, _out, _outLen);
+        _outLen = 0;
+    }
+
+    JpegWriteFn _write;
+    void* _ctx;
+    bool _ok = true;
+    uint8_t _out[ROI_JPEG_OUT_CHUNK];
+    size_t _outLen = 0;
+    uint32_t _bitBuf = 0;
+    uint8_t _bitCnt = 0;
+
+    uint8_t _qY[64], _qC[64];          // thứ tự zigzag (ghi vào DQT)
+    float _fdY[64], _fdC[64];          // 1 / (q * hệ số AAN), thứ tự natural
+    HuffCode _dcY[12], _dcC[12], _acY[256], _acC[256];
+};
+
+bool jpegEncodeRoi(const Rgb565Frame& frame, int x, int y, int w, int h,
+                   uint8_t quality, JpegWriteFn write, void* ctx) {
+    if (x < 0) { w += x; x = 0; }
+    if (y < 0) { h += y; y = 0; }
+    if (x + w > frame.width) w = frame.width - x;
+    if (y + h > frame.height) h = frame.height - y;
+    if (w <= 0 || h <= 0) return false;
+    RoiSource src(frame, x, y, w, h);
+    JpegEncoder enc(write, ctx);
+    return enc.encode(src, quality);
+}
+
+bool jpegEncodeAligned(const Rgb565Frame& frame, const FaceEyes& eyes, uint16_t size,
+                       uint8_t quality, JpegWriteFn write, void* ctx) {
+    float dx = eyes.rightX - eyes.leftX, dy = eyes.rightY - eyes.leftY;
+    if (size < 16 || dx * dx + dy * dy < 4.0f) return false;   // mắt trùng nhau -> landmark hỏng
+    AlignedSource src(frame, eyes, size);
+    JpegEncoder enc(write, ctx);
+    return enc.encode(src, quality);
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// Bộ mã hoá JPEG baseline (YCbCr 4:2:0, bảng Huffman chuẩn) đọc thẳng vùng mặt
+// trong frame RGB565 của camera theo stride: không cần chép ROI ra buffer riêng.
+// Có thêm chế độ mặt chuẩn hoá: xoay + co giãn theo 2 mắt về ảnh size x size
+// (mẫu ArcFace 112x112), nên kích thước payload và thời gian nén gần như cố định.
+// Thuần C++ (không phụ thuộc Arduino) -> build và đo tốc độ được trên Linux.
+//
+// Pixel RGB565 theo thứ tự byte của camera (big-endian: RRRRRGGG GGGBBBBB).
+
+#define ROI_JPEG_OUT_CHUNK 256     // byte gom lại trước mỗi lần gọi JpegWriteFn
+
+// Ghi tiếp len byte của file JPEG. false -> huỷ mã hoá.
+typedef bool (*JpegWriteFn)(void* ctx, const uint8_t* data, size_t len);
+
+struct Rgb565Frame {
+    const uint8_t* buf;
+    uint16_t width;
+    uint16_t height;
+};
+
+struct FaceEyes {
+    float leftX, leftY;      // mắt bên trái ảnh
+    float rightX, rightY;
+};
+
+// Mã hoá vùng [x, y, w, h] của frame (phần nằm ngoài frame bị cắt bỏ)
+bool jpegEncodeRoi(const Rgb565Frame& frame, int x, int y, int w, int h,
+                   uint8_t quality, JpegWriteFn write, void* ctx);
+
+// Mã hoá mặt đã căn theo 2 mắt thành ảnh size x size (nội suy song tuyến)
+bool jpegEncodeAligned(const Rgb565Frame& frame, const FaceEyes& eyes, uint16_t size,
+                       uint8_t quality, JpegWriteFn write, void* ctx);
@@ -0,0 +1,152 @@
+#include "server_reply.h"
+#include <string.h>
+
+// Cấp phát kiểu "dời con trỏ" trong 1 mảng tĩnh. ArduinoJson chỉ cấp vài khối (pool slot +
+// chuỗi) và giải phóng hết khi JsonDocument bị huỷ -> khi không còn khối nào thì về đầu mảng.
+// Mỗi khối có header ghi kích thước để reallocate() co/giãn tại chỗ được khối cuối.
+class ReplyPool : public ArduinoJson::Allocator {
+public:
+    void* allocate(size_t size) override {
+        size_t need = HEADER + roundUp(size);
+        if (need > REPLY_POOL_BYTES - _used) return nullptr;
+        uint8_t* block = _buf + _used;
+        *(size_t*)block = roundUp(size);
+        _used += need;
+        _live++;
+        if (_used > _peak) _peak = _used;
+        return block + HEADER;
+    }
+
+    void deallocate(void* ptr) override {
+        if (!ptr) return;
+        uint8_t* block = (uint8_t*)ptr - HEADER;
+        if (block + HEADER + *(size_t*)block == _buf + _used) _used = block - _buf;   // khối cuối
+        if (--_live == 0) _used = 0;
+    }
+
+    void* reallocate(void* ptr, size_t newSize) override {
+        if (!ptr) return allocate(newSize);
+        uint8_t* block = (uint8_t*)ptr - HEADER;
+        size_t old = *(size_t*)block;
+        size_t size = roundUp(newSize);
+        if (block + HEADER + old == _buf + _used) {
+            // Khối cuối: co/giãn tại chỗ
+            size_t start = block + HEADER - _buf;
+            if (size > REPLY_POOL_BYTES - start) return nullptr;
+            *(size_t*)block = size;
+            _used = start + size;
+            if (_used > _peak) _peak = _used;
+            return ptr;
+        }
+        if (size <= old) return ptr;
+        void* moved = allocate(newSize);
+        if (!moved) return nullptr;     // khối cũ vẫn còn nguyên như realloc()
+        memcpy(moved, ptr, old);
+        deallocate(ptr);
+        return moved;
+    }
+
+    uint32_t peak() const { return _peak; }
+
+private:
+    static const size_t HEADER = 8;     // giữ căn lề 8 byte cho khối phía sau
+    static size_t roundUp(size_t n) { return (n + 7) & ~(size_t)7; }
+
+    alignas(8) uint8_t _buf[REPLY_POOL_BYTES];
+    size_t _used = 0;
+    uint32_t _live = 0;
+    uint32_t _peak = 0;
+};
+
+static ReplyPool replyPool;
+static std::mutex replyMutex;
+static ReplyPoolStats replyStats = {};
+
+std::mutex& serverReplyLock() {
+    return replyMutex;
+}
+
+ArduinoJson::Allocator* serverReplyPool() {
+    return &replyPool;
+}
+
+const JsonDocument& serverReplyFilter() {
+    // Tạo 1 lần (heap mặc định), dùng lại cho mọi phản hồi
+    static JsonDocument filter;
+    if (filter.isNull()) {
+        filter["match"] = true;
+        filter["name"] = true;
+        filter["employee_id"] = true;
+        filter["status"] = true;
+        filter["count"] = true;
+        filter["success"] = true;
+        filter["message"] = true;
+        filter["error"] = true;
+        filter["code"] = true;
+    }
+    return filter;
+}
+
+void serverReplyClear(ServerReply& out, ReplyKind kind) {
+    memset(&out, 0, sizeof(out));
+    out.kind = kind;
+}
+
+static void copyField(char* dst, size_t size, JsonVariantConst v) {
+    const char* s = v.is<const char*>() ? v.as<const char*>() : "";
+    strncpy(dst, s, size - 1);
+    dst[size - 1] = '\0';
+}
+
+bool serverReplyFromJson(JsonVariantConst v, ServerReply& out) {
+    if (!v.is<JsonObjectConst>()) return false;
+    copyField(out.name, sizeof(out.name), v["name"]);
+    copyField(out.employeeId, sizeof(out.employeeId), v["employee_id"]);
+    copyField(out.message, sizeof(out.message), v["error"].is<const char*>() ? v["error"] : v["message"]);
+
+    // Qua WebSocket không có status HTTP: server ghi "code" trong body. {"error"} luôn là lỗi
+    // phía server (Python / Mongo), kể cả server cũ chưa gửi code.
+    if (v["code"].is<int>()) out.httpCode = v["code"].as<int>();
+    else if (v["error"].is<const char*>() && out.httpCode < 400) out.httpCode = 500;
+
+    const char* status = v["status"] | "";
+    if (v["match"].is<bool>()) {
+        out.kind = v["match"].as<bool>() ? REPLY_MATCH : REPLY_NO_MATCH;
+    } else if (strcmp(status, "collecting") == 0) {
+        out.kind = REPLY_COLLECTING;
+        out.count = v["count"] | 0;
+    } else if (v["success"].is<bool>()) {
+        out.kind = v["success"].as<bool>() ? REPLY_DONE : REPLY_FAILED;
+    } else if (v["error"].is<const char*>()) {
+        out.kind = REPLY_FAILED;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void serverReplyCount(bool ok) {
+    std::lock_guard<std::mutex> lock(replyMutex);
+    replyStats.decoded++;
+    if (!ok) replyStats.failed++;
+}
+
+ReplyPoolStats serverReplyStats() {
+    ReplyPoolStats st = replyStats;
+    st.peakBytes = replyPool.peak();
+    return st;
+}
+
+const char* serverReplyKindName(ReplyKind kind) {
+    switch (kind) {
+        case REPLY_OFFLINE:    return "offline";
+        case REPLY_PENDING:    return "pending";
+        case REPLY_DROPPED:    return "dropped";
+        case REPLY_MATCH:      return "match";
+        case REPLY_NO_MATCH:   return "no_match";
+        case REPLY_COLLECTING: return "collecting";
+        case REPLY_DONE:       return "done";
+        case REPLY_FAILED:     return "failed";
+        default:               return "invalid";
+    }
+}
@@ -0,0 +1,91 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <mutex>
+#include <ArduinoJson.h>
+
+// Giải mã phản hồi JSON của server (/recognize, /recognize_batch, /enroll) thành struct có
+// kiểu, đọc thẳng từ stream HTTP thay vì getString() + indexOf():
+//   - chỉ giữ các trường cần (filter của ArduinoJson): match, name, employee_id, status,
+//     count, success, message, error, code; trường khác / object lồng nhau bị bỏ qua khi đọc
+//   - bộ nhớ của JsonDocument lấy từ 1 vùng tĩnh REPLY_POOL_BYTES, trả lại hết sau mỗi lần
+//     giải mã -> heap không đổi theo kích thước phản hồi; phản hồi quá lớn thì lỗi NoMemory
+//   - không phụ thuộc thứ tự trường hay khoảng trắng
+// Vùng nhớ dùng chung, có khoá bên trong: UploaderTask (HTTP) và NetworkTask (WebSocket)
+// giải mã lần lượt.
+// Chỉ cần ArduinoJson (không phụ thuộc Arduino) -> build và đo tốc độ được trên Linux.
+
+#define REPLY_NAME_LEN     40
+#define REPLY_ID_LEN       32
+#define REPLY_MSG_LEN      64
+#define REPLY_NESTING      4
+// Đủ cho 1 pool slot của ArduinoJson (1 KB trên ESP32, 4 KB trên máy 64-bit) + vài chuỗi
+#define REPLY_POOL_BYTES   (sizeof(void*) > 4 ? 6144 : 3072)
+
+enum ReplyKind : uint8_t {
+    REPLY_INVALID,       // không phải JSON / thiếu trường nhận biết / hết vùng nhớ
+    REPLY_OFFLINE,       // không gửi được, firmware đã lưu offline (không do server trả)
+    REPLY_PENDING,       // đã gửi qua WebSocket, kết quả về sau (không do server trả)
+    REPLY_DROPPED,       // bị bỏ khỏi hàng đợi upload trước khi gửi, không lưu offline (không do server trả)
+    REPLY_MATCH,         // {"match":true, "name", "employee_id"}
+    REPLY_NO_MATCH,      // {"match":false, "name": "unknown" | "Spoof/NoFace" | ..., "message"}
+    REPLY_COLLECTING,    // {"status":"collecting", "count"}: server đang gom ảnh của phiên
+    REPLY_DONE,          // {"success":true}: enroll xong
+    REPLY_FAILED,        // {"success":false} hoặc {"error"}
+};
+
+struct ServerReply {
+    ReplyKind kind;
+    int16_t httpCode;                    // status HTTP, hoặc "code" trong body (WebSocket); {"error"} -> >= 500
+    uint8_t count;                       // số ảnh server đã gom (REPLY_COLLECTING)
+    char name[REPLY_NAME_LEN];
+    char employeeId[REPLY_ID_LEN];
+    char message[REPLY_MSG_LEN];         // message hoặc error của server
+};
+
+struct ReplyPoolStats {
+    uint32_t decoded;       // số lần giải mã
+    uint32_t failed;        // lỗi cú pháp / hết vùng nhớ
+    uint32_t peakBytes;     // vùng nhớ dùng nhiều nhất trong 1 lần giải mã
+};
+
+void serverReplyClear(ServerReply& out, ReplyKind kind = REPLY_INVALID);
+const char* serverReplyKindName(ReplyKind kind);
+
+// Dùng bởi decodeServerReply
+const JsonDocument& serverReplyFilter();
+ArduinoJson::Allocator* serverReplyPool();
+bool serverReplyFromJson(JsonVariantConst v, ServerReply& out);
+std::mutex& serverReplyLock();
+void serverReplyCount(bool ok);
+ReplyPoolStats serverReplyStats();
+
+// input...: Stream& (WiFiClient của HTTPClient), std::istream&, const char*, std::string,
+// hoặc (const char*, size_t) cho buffer không kết thúc bằng '\0'.
+template <typename... TInput>
+bool serverReplyDecode(ServerReply& out, TInput&&... input) {
+    int16_t code = out.httpCode;
+    serverReplyClear(out);
+    out.httpCode = code;
+    bool ok;
+    {
+        std::lock_guard<std::mutex> lock(serverReplyLock());
+        JsonDocument doc(serverReplyPool());
+        DeserializationError err = deserializeJson(
+            doc, input..., DeserializationOption::Filter(serverReplyFilter().as<JsonVariantConst>()),
+            DeserializationOption::NestingLimit(REPLY_NESTING));
+        ok = !err && serverReplyFromJson(doc.as<JsonVariantConst>(), out);
+    }
+    serverReplyCount(ok);
+    return ok;
+}
+
+// Giữ nguyên httpCode đã đặt trong out. false nếu không nhận ra phản hồi (out.kind = REPLY_INVALID).
+template <typename TInput>
+bool decodeServerReply(TInput&& input, ServerReply& out) {
+    return serverReplyDecode(out, input);
+}
+
+inline bool decodeServerReply(const char* json, size_t len, ServerReply& out) {
+    return serverReplyDecode(out, json, len);
+}
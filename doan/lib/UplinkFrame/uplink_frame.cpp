@@ -0,0 +1,76 @@
+#include "uplink_frame.h"
+#include <string.h>
+
+static void putU16(uint8_t* p, uint16_t v) {
+    p[0] = v;
+    p[1] = v >> 8;
+}
+
+static void putU32(uint8_t* p, uint32_t v) {
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+static uint16_t getU16(const uint8_t* p) {
+    return p[0] | (uint16_t)p[1] << 8;
+}
+
+static uint32_t getU32(const uint8_t* p) {
+    return p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+size_t uplinkEncodeHeader(const UplinkHeader& h, uint8_t* out, size_t size) {
+    if (h.count == 0 || h.count > UPLINK_MAX_PARTS) return 0;
+    size_t len = uplinkHeaderLen(h.count);
+    if (size < len) return 0;
+    putU32(out, UPLINK_MAGIC);
+    out[4] = UPLINK_VERSION;
+    out[5] = h.type;
+    out[6] = h.count;
+    out[7] = h.flags;
+    putU32(out + 8, h.requestId);
+    putU32(out + 12, h.timestamp);
+    putU16(out + 16, h.aligned);
+    putU16(out + 18, 0);
+    memset(out + 20, 0, UPLINK_ID_LEN);
+    memcpy(out + 20, h.employeeId, strnlen(h.employeeId, UPLINK_ID_LEN - 1));
+    for (uint8_t i = 0; i < h.count; i++) putU32(out + UPLINK_FIXED_LEN + 4 * i, h.lengths[i]);
+    return len;
+}
+
+bool uplinkDecodeHeader(const uint8_t* in, size_t len, UplinkHeader& h, size_t* headerLen) {
+    if (len < UPLINK_FIXED_LEN || getU32(in) != UPLINK_MAGIC || in[4] != UPLINK_VERSION) return false;
+    memset(&h, 0, sizeof(h));
+    h.type = in[5];
+    h.count = in[6];
+    h.flags = in[7];
+    if (h.count == 0 || h.count > UPLINK_MAX_PARTS || len < uplinkHeaderLen(h.count)) return false;
+    h.requestId = getU32(in + 8);
+    h.timestamp = getU32(in + 12);
+    h.aligned = getU16(in + 16);
+    memcpy(h.employeeId, in + 20, UPLINK_ID_LEN);
+    h.employeeId[UPLINK_ID_LEN - 1] = '\0';
+    uint64_t total = 0;
+    for (uint8_t i = 0; i < h.count; i++) {
+        h.lengths[i] = getU32(in + UPLINK_FIXED_LEN + 4 * i);
+        total += h.lengths[i];
+    }
+    if (uplinkHeaderLen(h.count) + total != len) return false;
+    if (headerLen) *headerLen = uplinkHeaderLen(h.count);
+    return true;
+}
+
+void uplinkEncodeReply(uint32_t requestId, uint8_t* out) {
+    putU32(out, UPLINK_REPLY_MAGIC);
+    putU32(out + 4, requestId);
+}
+
+bool uplinkDecodeReply(const uint8_t* in, size_t len, uint32_t* requestId, const char** json, size_t* jsonLen) {
+    if (len < UPLINK_REPLY_LEN || getU32(in) != UPLINK_REPLY_MAGIC) return false;
+    if (requestId) *requestId = getU32(in + 4);
+    if (json) *json = (const char*)in + UPLINK_REPLY_LEN;
+    if (jsonLen) *jsonLen = len - UPLINK_REPLY_LEN;
+    return true;
+}
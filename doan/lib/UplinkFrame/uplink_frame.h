@@ -0,0 +1,52 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// Khung nhị phân gửi ảnh lên server qua WebSocket /ws (thay 1 HTTP POST mỗi lượt chấm công).
+// Kiosk -> server, 1 message binary (little-endian):
+//   magic u32 "UPLK" | version u8 | type u8 | count u8 | flags u8 | request_id u32
+//   | timestamp u32 (giờ RTC, giây - như journal) | aligned u16 | reserved u16
+//   | employee_id char[32] | length u32 x count | các JPEG nối liền
+// Server -> kiosk, 1 message binary:
+//   magic u32 "UPRS" | request_id u32 | JSON giống phản hồi HTTP ({match,name,...})
+// Kết quả về bất đồng bộ, ghép với request bằng request_id -> nhiều request cùng bay được.
+// Thuần C++ (không phụ thuộc Arduino) -> build và đo tốc độ được trên Linux.
+
+#define UPLINK_MAGIC          0x4B4C5055u     // "UPLK"
+#define UPLINK_REPLY_MAGIC    0x53525055u     // "UPRS"
+#define UPLINK_VERSION        1
+#define UPLINK_FIXED_LEN      52              // header trước mảng length
+#define UPLINK_REPLY_LEN      8
+#define UPLINK_ID_LEN         32
+#define UPLINK_MAX_PARTS      8
+
+enum UplinkType : uint8_t {
+    UPLINK_RECOGNIZE = 1,     // burst / ảnh nhận diện -> 1 quyết định
+    UPLINK_ENROLL    = 2,     // 1 ảnh của 1 bước enroll
+};
+
+enum UplinkFlags : uint8_t {
+    UPLINK_FLAG_OFFLINE = 1,  // ảnh chụp lúc mất mạng (gửi bù)
+};
+
+struct UplinkHeader {
+    uint8_t type;
+    uint8_t count;
+    uint8_t flags;
+    uint32_t requestId;
+    uint32_t timestamp;
+    uint16_t aligned;                      // cạnh ảnh mặt đã căn (0 = cắt theo khung mặt)
+    char employeeId[UPLINK_ID_LEN];
+    uint32_t lengths[UPLINK_MAX_PARTS];
+};
+
+inline size_t uplinkHeaderLen(uint8_t count) { return UPLINK_FIXED_LEN + 4 * (size_t)count; }
+
+// Ghi header vào out (cần uplinkHeaderLen(h.count) byte). Trả về số byte, 0 nếu count sai.
+size_t uplinkEncodeHeader(const UplinkHeader& h, uint8_t* out, size_t size);
+// Đọc header của 1 message; kiểm tra tổng length khớp phần còn lại. headerLen: nơi JPEG đầu bắt đầu.
+bool uplinkDecodeHeader(const uint8_t* in, size_t len, UplinkHeader& h, size_t* headerLen);
+
+void uplinkEncodeReply(uint32_t requestId, uint8_t* out);
+// false nếu không phải phản hồi uplink; json/jsonLen trỏ vào phần JSON trong in
+bool uplinkDecodeReply(const uint8_t* in, size_t len, uint32_t* requestId, const char** json, size_t* jsonLen);
@@ -0,0 +1,67 @@
+#include "vec_kernels.h"
+
+int32_t vk_dot_s8_scalar(const int8_t* a, const int8_t* b, size_t n) {
+    int32_t acc0 = 0, acc1 = 0, acc2 = 0, acc3 = 0;
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        acc0 += a[i] * b[i];
+        acc1 += a[i + 1] * b[i + 1];
+        acc2 += a[i + 2] * b[i + 2];
+        acc3 += a[i + 3] * b[i + 3];
+    }
+    for (; i < n; i++) acc0 += a[i] * b[i];
+    return acc0 + acc1 + acc2 + acc3;
+}
+
+int32_t vk_dot_s8(const int8_t* a, const int8_t* b, size_t n) {
+#if VK_HAS_S3_SIMD
+    // Lệnh EE.VLD.128 bỏ qua 4 bit thấp của địa chỉ -> chỉ dùng khi cả 2 vector căn 16 byte
+    if ((((uintptr_t)a | (uintptr_t)b) & (VK_ALIGN - 1)) == 0) {
+        size_t body = n & ~(size_t)(VK_ALIGN - 1);
+        int32_t acc = body ? vk_dot_s8_esp32s3(a, b, body) : 0;
+        return acc + vk_dot_s8_scalar(a + body, b + body, n - body);
+    }
+#endif
+    return vk_dot_s8_scalar(a, b, n);
+}
+
+int32_t vk_ssd_s8(const int8_t* a, const int8_t* b, size_t n) {
+    int32_t acc0 = 0, acc1 = 0;
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        int d0 = a[i] - b[i], d1 = a[i + 1] - b[i + 1];
+        acc0 += d0 * d0;
+        acc1 += d1 * d1;
+    }
+    for (; i < n; i++) {
+        int d = a[i] - b[i];
+        acc0 += d * d;
+    }
+    return acc0 + acc1;
+}
+
+int32_t vk_ssd_s8_norms(const int8_t* a, int32_t aa, const int8_t* b, int32_t bb, size_t n) {
+    return aa + bb - 2 * vk_dot_s8(a, b, n);
+}
+
+int32_t vk_dot_s16_scalar(const int16_t* a, const int16_t* b, size_t n) {
+    int32_t acc0 = 0, acc1 = 0;
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        acc0 += a[i] * b[i];
+        acc1 += a[i + 1] * b[i + 1];
+    }
+    for (; i < n; i++) acc0 += a[i] * b[i];
+    return acc0 + acc1;
+}
+
+int32_t vk_dot_s16(const int16_t* a, const int16_t* b, size_t n) {
+#if VK_HAS_S3_SIMD
+    if ((((uintptr_t)a | (uintptr_t)b) & (VK_ALIGN - 1)) == 0) {
+        size_t body = n & ~(size_t)7;
+        int32_t acc = body ? vk_dot_s16_esp32s3(a, b, body) : 0;
+        return acc + vk_dot_s16_scalar(a + body, b + body, n - body);
+    }
+#endif
+    return vk_dot_s16_scalar(a, b, n);
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// Các kernel vector dùng chung, build được cả trên ESP32-S3 lẫn máy Linux.
+// Trên ESP32-S3 dùng lệnh SIMD 128-bit (PIE) cho phần dữ liệu căn 16 byte,
+// nơi khác dùng bản C thuần cho kết quả giống hệt.
+
+#define VK_ALIGN 16
+
+#if defined(ESP_PLATFORM)
+#include "sdkconfig.h"
+#endif
+
+// Định nghĩa VK_FORCE_SCALAR để tắt SIMD (so sánh kết quả / đo tốc độ)
+#if defined(CONFIG_IDF_TARGET_ESP32S3) && !defined(VK_FORCE_SCALAR)
+#define VK_HAS_S3_SIMD 1
+#else
+#define VK_HAS_S3_SIMD 0
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Tích vô hướng 2 vector int8 dài n
+int32_t vk_dot_s8(const int8_t* a, const int8_t* b, size_t n);
+int32_t vk_dot_s8_scalar(const int8_t* a, const int8_t* b, size_t n);
+// Tổng bình phương hiệu sum((a-b)^2), 1 lượt qua dữ liệu (C thuần: EE.VSUBS.S8 bão hoà,
+// trong khi a-b của int8 đủ dải tới ±255)
+int32_t vk_ssd_s8(const int8_t* a, const int8_t* b, size_t n);
+// Như vk_ssd_s8 khi đã có aa = sum(a^2), bb = sum(b^2) (tính sẵn lúc lấy mẫu):
+// aa + bb - 2 sum(ab), chỉ còn 1 lần vk_dot_s8 (SIMD trên ESP32-S3)
+int32_t vk_ssd_s8_norms(const int8_t* a, int32_t aa, const int8_t* b, int32_t bb, size_t n);
+// Tích vô hướng 2 vector int16 dài n (kết quả bão hoà 32 bit: giữ n * |a| * |b| < 2^31)
+int32_t vk_dot_s16(const int16_t* a, const int16_t* b, size_t n);
+int32_t vk_dot_s16_scalar(const int16_t* a, const int16_t* b, size_t n);
+
+#if VK_HAS_S3_SIMD
+// n là bội số của 16, a và b căn 16 byte (vec_kernels_esp32s3.S)
+int32_t vk_dot_s8_esp32s3(const int8_t* a, const int8_t* b, size_t n);
+// n là bội số của 8, a và b căn 16 byte
+int32_t vk_dot_s16_esp32s3(const int16_t* a, const int16_t* b, size_t n);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,50 @@
+#include "face_embedder.h"
+
+#if __has_include("face_recognition_112_v1_s8.hpp")
+#include "face_recognition_112_v1_s8.hpp"
+#include "face_recognition_tool.hpp"
+#define FACE_EMBED_HAS_MODEL 1
+#else
+#define FACE_EMBED_HAS_MODEL 0
+#warning "Không có face_recognition_112_v1_s8.hpp trong Arduino core: nhận diện offline (gallery) bị tắt"
+#endif
+
+bool faceEmbedHasModel() { return FACE_EMBED_HAS_MODEL; }
+
+#if FACE_EMBED_HAS_MODEL
+static FaceRecognition112V1S8* recognizer = nullptr;
+
+bool faceEmbedBegin() {
+    if (!recognizer) recognizer = new FaceRecognition112V1S8();
+    return recognizer != nullptr;
+}
+
+bool faceEmbedReady() { return recognizer != nullptr; }
+
+bool faceEmbed(camera_fb_t* fb, const eloq::face_t& f, float* out) {
+    if (!recognizer || !fb) return false;
+
+    // Thứ tự landmark giống kết quả detector của esp-dl:
+    // mắt trái, miệng trái, mũi, mắt phải, miệng phải
+    std::vector<int> landmarks = {
+        f.leftEye.x, f.leftEye.y, f.leftMouth.x, f.leftMouth.y, f.nose.x, f.nose.y,
+        f.rightEye.x, f.rightEye.y, f.rightMouth.x, f.rightMouth.y
+    };
+
+    dl::Tensor<uint16_t> image;
+    image.set_element((uint16_t*)fb->buf).set_shape({(int)fb->height, (int)fb->width, 3}).set_auto_free(false);
+
+    // Model chỉ trả embedding của id đã enroll -> enroll tạm vào RAM (không ghi flash) rồi xoá
+    int id = recognizer->enroll_id(image, landmarks, "", false);
+    if (id < 0) return false;
+    dl::Tensor<float>& emb = recognizer->get_face_emb(id);
+    bool ok = emb.get_size() == FACE_EMBED_DIM;
+    if (ok) memcpy(out, emb.element, FACE_EMBED_DIM * sizeof(float));
+    recognizer->delete_id(id, false);
+    return ok;
+}
+#else
+bool faceEmbedBegin() { return false; }
+bool faceEmbedReady() { return false; }
+bool faceEmbed(camera_fb_t*, const eloq::face_t&, float*) { return false; }
+#endif
@@ -0,0 +1,18 @@
+#pragma once
+#include <Arduino.h>
+#include <eloquent_esp32cam.h>
+#include <eloquent_esp32cam/face/detection.h>
+
+// Trích embedding khuôn mặt ngay trên ESP32-S3 bằng model nhận diện của esp-dl
+// (face_recognition_112_v1_s8: căn mặt theo 5 landmark -> vector 512 chiều).
+// Khi bản Arduino core không kèm model này, faceEmbedHasModel() / faceEmbedReady() luôn false
+// và kiosk quay về cách cũ: lưu ảnh offline để server nhận diện khi có mạng. Trường hợp này
+// có cảnh báo lúc build, log lúc khởi động và mục "offline_recog" trong get_metrics.
+
+#define FACE_EMBED_DIM 512
+
+bool faceEmbedHasModel();    // model được build vào firmware
+bool faceEmbedBegin();
+bool faceEmbedReady();
+// fb: frame RGB565 đang giữ, f: khuôn mặt detect được trên chính frame đó
+bool faceEmbed(camera_fb_t* fb, const eloq::face_t& f, float* out);
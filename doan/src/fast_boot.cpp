@@ -0,0 +1,179 @@
+#include "fast_boot.h"
+#include <WiFi.h>
+#include <esp_wifi.h>
+#include <esp_sleep.h>
+#include <esp_timer.h>
+#include <stddef.h>
+#include "logger.h"
+
+#define BOOT_NET_MAGIC  0x4E455431u      // "NET1"
+
+// Sống qua ngủ sâu (mất khi cắt điện / reset)
+struct BootNetCache {
+    uint32_t magic;
+    int32_t channel;
+    uint8_t bssid[6];
+    char serverIp[40];
+    uint32_t check;
+};
+RTC_DATA_ATTR static BootNetCache rtcNet;
+
+static const char* PHASE_NAMES[BOOT_PHASE_COUNT] = {"rtc", "sd", "tft", "camera", "wifi", "net", "preview"};
+
+struct PhaseTime {
+    uint32_t startMs, doneMs;     // 0 = chưa chạy / chưa xong
+};
+static PhaseTime phases[BOOT_PHASE_COUNT];
+static portMUX_TYPE bootMux = portMUX_INITIALIZER_UNLOCKED;
+static EventGroupHandle_t doneBits = nullptr;
+static EventBits_t spawnedBits = 0;
+static bool fastResume = false;
+static bool fastWifi = false;      // đã gọi WiFi.begin với kênh / BSSID trong cache
+
+struct SpawnArg {
+    BootPhase phase;
+    void (*step)();
+};
+static SpawnArg spawnArgs[BOOT_PHASE_COUNT];
+
+static uint32_t bootMs() {
+    // +1: 0 dành cho "chưa có"
+    return (uint32_t)(esp_timer_get_time() / 1000) + 1;
+}
+
+static uint32_t cacheCheck(const BootNetCache& c) {
+    // FNV-1a trên phần dữ liệu: RTC memory không được xoá khi nạp firmware mới
+    const uint8_t* p = (const uint8_t*)&c;
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < offsetof(BootNetCache, check); i++) h = (h ^ p[i]) * 16777619u;
+    return h;
+}
+
+void bootBegin() {
+    doneBits = xEventGroupCreate();
+    esp_sleep_wakeup_cause_t cause = esp_sleep_get_wakeup_cause();
+    bool woke = cause == ESP_SLEEP_WAKEUP_TIMER || cause == ESP_SLEEP_WAKEUP_EXT0;
+    bool valid = rtcNet.magic == BOOT_NET_MAGIC && rtcNet.check == cacheCheck(rtcNet) && rtcNet.serverIp[0];
+    fastResume = woke && valid;
+}
+
+bool bootFastResume() {
+    return fastResume;
+}
+
+void bootPhaseStart(BootPhase phase) {
+    portENTER_CRITICAL(&bootMux);
+    phases[phase].startMs = bootMs();
+    portEXIT_CRITICAL(&bootMux);
+}
+
+void bootPhaseDone(BootPhase phase) {
+    portENTER_CRITICAL(&bootMux);
+    if (!phases[phase].doneMs) phases[phase].doneMs = bootMs();
+    portEXIT_CRITICAL(&bootMux);
+}
+
+static void SpawnTask(void* pv) {
+    SpawnArg* arg = (SpawnArg*)pv;
+    bootPhaseStart(arg->phase);
+    arg->step();
+    bootPhaseDone(arg->phase);
+    xEventGroupSetBits(doneBits, 1 << arg->phase);
+    vTaskDelete(NULL);
+}
+
+void bootSpawn(BootPhase phase, void (*step)(), uint32_t stackBytes) {
+    spawnArgs[phase] = {phase, step};
+    spawnedBits |= 1 << phase;
+    if (xTaskCreate(SpawnTask, PHASE_NAMES[phase], stackBytes, &spawnArgs[phase], 2, NULL) != pdPASS) {
+        // Không tạo được task -> chạy ngay trên task gọi
+        SpawnTask(&spawnArgs[phase]);
+    }
+}
+
+bool bootJoin(uint32_t timeoutMs) {
+    if (!spawnedBits) return true;
+    EventBits_t bits = xEventGroupWaitBits(doneBits, spawnedBits, pdFALSE, pdTRUE, pdMS_TO_TICKS(timeoutMs));
+    return (bits & spawnedBits) == spawnedBits;
+}
+
+bool bootWifiStart() {
+    bootPhaseStart(BOOT_WIFI);
+    WiFi.mode(WIFI_STA);
+    if (!fastResume) return false;
+    // SSID / mật khẩu do WiFiManager lưu trong NVS của driver WiFi
+    wifi_config_t conf = {};
+    if (esp_wifi_get_config(WIFI_IF_STA, &conf) != ESP_OK || !conf.sta.ssid[0]) return false;
+    char ssid[33] = {}, pass[65] = {};
+    memcpy(ssid, conf.sta.ssid, sizeof(conf.sta.ssid));
+    memcpy(pass, conf.sta.password, sizeof(conf.sta.password));
+    WiFi.begin(ssid, pass[0] ? pass : nullptr, rtcNet.channel, rtcNet.bssid);
+    fastWifi = true;
+    return true;
+}
+
+bool bootWifiWait(uint32_t timeoutMs) {
+    if (!fastWifi) return false;
+    uint32_t t0 = millis();
+    while (WiFi.status() != WL_CONNECTED && millis() - t0 < timeoutMs) delay(20);
+    if (WiFi.status() == WL_CONNECTED) return true;
+    LOGW("⚠️ [BOOT] Không nối lại được AP kênh %ld trong %lu ms -> kết nối đầy đủ.", (long)rtcNet.channel,
+         (unsigned long)timeoutMs);
+    WiFi.disconnect();
+    rtcNet.magic = 0;
+    return false;
+}
+
+const char* bootCachedServerIp() {
+    return (rtcNet.magic == BOOT_NET_MAGIC) ? rtcNet.serverIp : "";
+}
+
+void bootSaveNet(const char* serverIp) {
+    if (WiFi.status() != WL_CONNECTED) return;
+    BootNetCache c = {};
+    c.magic = BOOT_NET_MAGIC;
+    c.channel = WiFi.channel();
+    memcpy(c.bssid, WiFi.BSSID(), sizeof(c.bssid));
+    strlcpy(c.serverIp, serverIp, sizeof(c.serverIp));
+    c.check = cacheCheck(c);
+    rtcNet = c;
+}
+
+void bootReport() {
+    portENTER_CRITICAL(&bootMux);
+    PhaseTime p[BOOT_PHASE_COUNT];
+    memcpy(p, phases, sizeof(p));
+    portEXIT_CRITICAL(&bootMux);
+
+    LOGI("⏱️ [BOOT] %s (ms tính từ lúc app chạy):", fastResume ? "Khởi động nhanh sau ngủ sâu" : "Khởi động đầy đủ");
+    for (int i = 0; i < BOOT_PHASE_COUNT; i++) {
+        if (!p[i].doneMs) {
+            LOGI("   %-8s chưa xong", PHASE_NAMES[i]);
+        } else if (p[i].startMs) {
+            LOGI("   %-8s %5lu -> %5lu (%lu ms)", PHASE_NAMES[i], (unsigned long)p[i].startMs - 1,
+                 (unsigned long)p[i].doneMs - 1, (unsigned long)(p[i].doneMs - p[i].startMs));
+        } else {
+            LOGI("   %-8s %5lu", PHASE_NAMES[i], (unsigned long)p[i].doneMs - 1);
+        }
+    }
+    uint32_t preview = p[BOOT_PREVIEW].doneMs;
+    if (preview && preview - 1 > BOOT_PREVIEW_TARGET_MS) {
+        LOGW("⚠️ [BOOT] Preview đầu tiên sau %lu ms (mục tiêu < %u ms).", (unsigned long)preview - 1,
+             BOOT_PREVIEW_TARGET_MS);
+    }
+}
+
+void bootToJson(JsonObject out) {
+    portENTER_CRITICAL(&bootMux);
+    PhaseTime p[BOOT_PHASE_COUNT];
+    memcpy(p, phases, sizeof(p));
+    portEXIT_CRITICAL(&bootMux);
+
+    out["fast"] = fastResume;
+    // [bắt đầu, xong] ms; -1 = không có
+    for (int i = 0; i < BOOT_PHASE_COUNT; i++) {
+        JsonArray a = out[PHASE_NAMES[i]].to<JsonArray>();
+        a.add(p[i].startMs ? (int32_t)p[i].startMs - 1 : -1);
+        a.add(p[i].doneMs ? (int32_t)p[i].doneMs - 1 : -1);
+    }
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+// Khởi động nhanh sau ngủ sâu:
+//   - RTC memory giữ kênh / BSSID của AP và IP server của lần kết nối trước -> thức dậy bằng
+//     timer / nút bấm thì nối thẳng AP đó (bỏ quét kênh), không qua WiFiManager / captive
+//     portal; không nối được trong BOOT_WIFI_FAST_MS thì quay về đường cũ
+//   - camera, thẻ SD, màn hình khởi tạo song song trong các task riêng (bootSpawn/bootJoin),
+//     WiFi kết nối nền cùng lúc; preview chạy trước khi chờ mạng
+//   - thời điểm bắt đầu / xong từng pha (tính từ lúc app chạy, chưa gồm bootloader) in ra log
+//     và gửi trong get_metrics ("boot"). Mục tiêu: preview đầu tiên < BOOT_PREVIEW_TARGET_MS.
+
+#define BOOT_WIFI_FAST_MS       3000
+#define BOOT_PREVIEW_TARGET_MS  2000
+
+enum BootPhase {
+    BOOT_RTC,
+    BOOT_SD,          // mount + journal + gallery offline
+    BOOT_TFT,
+    BOOT_CAMERA,
+    BOOT_WIFI,        // từ lúc bắt đầu kết nối tới khi có IP (gồm cả portal nếu phải mở)
+    BOOT_NET,         // HTTP / WebSocket / uploader
+    BOOT_PREVIEW,     // frame preview đầu tiên lên TFT (chỉ có thời điểm xong)
+    BOOT_PHASE_COUNT
+};
+
+// Gọi đầu setup(): đọc lý do thức dậy + cache mạng trong RTC memory
+void bootBegin();
+// Thức dậy từ ngủ sâu và cache mạng hợp lệ
+bool bootFastResume();
+
+void bootPhaseStart(BootPhase phase);
+void bootPhaseDone(BootPhase phase);
+// Chạy step trong 1 task riêng (tự đo thời gian pha). bootJoin() chờ mọi task đã spawn xong.
+void bootSpawn(BootPhase phase, void (*step)(), uint32_t stackBytes);
+bool bootJoin(uint32_t timeoutMs);
+
+// Bắt đầu nối WiFi bằng cache (không chặn). false: không có cache, dùng WiFiManager.
+bool bootWifiStart();
+// Chờ kết quả của bootWifiStart(); thất bại thì xoá cache
+bool bootWifiWait(uint32_t timeoutMs);
+// IP server trong cache (chuỗi rỗng nếu không có)
+const char* bootCachedServerIp();
+// Đã có IP: lưu kênh / BSSID hiện tại + IP server cho lần thức sau
+void bootSaveNet(const char* serverIp);
+
+void bootReport();
+void bootToJson(JsonObject out);
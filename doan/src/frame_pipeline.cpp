@@ -0,0 +1,206 @@
+#include "frame_pipeline.h"
+#include "metrics.h"
+#include "logger.h"
+
+static Frame slots[FRAME_SLOTS];
+static size_t slotBytes = 0;
+static QueueHandle_t renderQueue = nullptr;
+static QueueHandle_t detectQueue = nullptr;
+static FrameRenderer renderer = nullptr;
+static SemaphoreHandle_t driverMutex = nullptr;   // giữ trong lúc đang lấy frame từ driver
+static volatile bool active = true;
+static volatile bool idle = false;
+static TaskHandle_t captureTask = nullptr;
+static portMUX_TYPE refMux = portMUX_INITIALIZER_UNLOCKED;
+static PipelineStats stats = {};
+
+void frameRetain(Frame* frame) {
+    portENTER_CRITICAL(&refMux);
+    frame->refs++;
+    portEXIT_CRITICAL(&refMux);
+}
+
+void frameRelease(Frame* frame) {
+    if (!frame) return;
+    portENTER_CRITICAL(&refMux);
+    if (frame->refs) frame->refs--;
+    portEXIT_CRITICAL(&refMux);
+}
+
+static Frame* acquireSlot() {
+    Frame* out = nullptr;
+    portENTER_CRITICAL(&refMux);
+    for (int i = 0; i < FRAME_SLOTS; i++) {
+        if (slots[i].refs == 0) {
+            out = &slots[i];
+            out->refs = 1;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&refMux);
+    return out;
+}
+
+// Đưa frame vào hàng đợi 1 phần tử của 1 tầng; frame cũ chưa được lấy thì trả lại pool
+static void publish(QueueHandle_t q, Frame* frame, FrameStage stage) {
+    frameRetain(frame);
+    Frame* stale = nullptr;
+    if (xQueueReceive(q, &stale, 0) == pdTRUE) {
+        frameRelease(stale);
+        portENTER_CRITICAL(&refMux); stats.skipped[stage]++; portEXIT_CRITICAL(&refMux);
+    }
+    xQueueSend(q, &frame, 0);
+}
+
+static void count(FrameStage stage) {
+    portENTER_CRITICAL(&refMux);
+    stats.frames[stage]++;
+    portEXIT_CRITICAL(&refMux);
+}
+
+static void CaptureTask(void* pvParameters) {
+    static uint32_t seq = 0;
+    unsigned long lastFps = millis();
+    for (;;) {
+        if (!active) { vTaskDelay(pdMS_TO_TICKS(50)); continue; }
+
+        Frame* frame = acquireSlot();
+        if (!frame) {
+            portENTER_CRITICAL(&refMux); stats.noSlot++; portEXIT_CRITICAL(&refMux);
+            vTaskDelay(pdMS_TO_TICKS(5));
+            continue;
+        }
+
+        xSemaphoreTake(driverMutex, portMAX_DELAY);
+        uint32_t t0 = micros();
+        camera_fb_t* fb = active ? esp_camera_fb_get() : nullptr;
+        bool ok = fb && fb->len <= slotBytes;
+        if (ok) {
+            // Chép ra slot riêng rồi trả buffer ngay để driver DMA frame kế tiếp song song
+            uint8_t* buf = frame->fb.buf;
+            memcpy(buf, fb->buf, fb->len);
+            frame->fb = *fb;
+            frame->fb.buf = buf;
+        }
+        if (fb) esp_camera_fb_return(fb);
+        xSemaphoreGive(driverMutex);
+        if (ok) metricRecord(M_CAPTURE, micros() - t0);
+
+        if (!ok) {
+            frameRelease(frame);
+            vTaskDelay(pdMS_TO_TICKS(30));
+            continue;
+        }
+        frame->seq = ++seq;
+        frame->capturedAt = millis();
+        count(STAGE_CAPTURE);
+
+        publish(renderQueue, frame, STAGE_RENDER);
+        publish(detectQueue, frame, STAGE_DETECT);
+        frameRelease(frame);
+
+        if (millis() - lastFps > FRAME_FPS_PERIOD_MS) {
+            pipelinePrintFps();
+            lastFps = millis();
+        }
+        if (idle) {
+            // Chờ hết chu kỳ chế độ chờ; pipelineSetIdle(false) đánh thức sớm
+            uint32_t spent = millis() - frame->capturedAt;
+            if (spent < CAPTURE_IDLE_PERIOD_MS) ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(CAPTURE_IDLE_PERIOD_MS - spent));
+        } else {
+            vTaskDelay(1);
+        }
+    }
+}
+
+static void RenderTask(void* pvParameters) {
+    Frame* frame = nullptr;
+    for (;;) {
+        // Không có frame (camera dừng) vẫn gọi renderer định kỳ để vẽ thông điệp UI
+        if (xQueueReceive(renderQueue, &frame, pdMS_TO_TICKS(RENDER_IDLE_MS)) != pdTRUE) {
+            renderer(nullptr);
+            continue;
+        }
+        uint32_t t0 = micros();
+        if (renderer(frame)) {
+            metricRecord(M_TFT_PUSH, micros() - t0);
+            count(STAGE_RENDER);
+        }
+        frameRelease(frame);
+    }
+}
+
+bool pipelineBegin(uint16_t width, uint16_t height, FrameRenderer render) {
+    slotBytes = (size_t)width * height * 2;
+    for (int i = 0; i < FRAME_SLOTS; i++) {
+        slots[i] = {};
+        slots[i].fb.buf = (uint8_t*) ps_malloc(slotBytes);
+        if (!slots[i].fb.buf) return false;
+    }
+    renderer = render;
+    driverMutex = xSemaphoreCreateMutex();
+    renderQueue = xQueueCreate(1, sizeof(Frame*));
+    detectQueue = xQueueCreate(1, sizeof(Frame*));
+    TaskHandle_t render;
+    xTaskCreatePinnedToCore(CaptureTask, "CaptureTask", 4096, NULL, 2, &captureTask, 0);
+    xTaskCreatePinnedToCore(RenderTask, "RenderTask", 4096, NULL, 2, &render, 0);
+    metricsRegisterTask(captureTask);
+    metricsRegisterTask(render);
+    return true;
+}
+
+void pipelineSetActive(bool on) {
+    active = on;
+    if (!on && driverMutex) {
+        // Chờ CaptureTask nhả driver (esp_camera_deinit an toàn sau khi hàm trả về)
+        xSemaphoreTake(driverMutex, portMAX_DELAY);
+        xSemaphoreGive(driverMutex);
+    }
+}
+
+void pipelineSetIdle(bool on) {
+    bool wake = idle && !on;
+    idle = on;
+    if (wake && captureTask) xTaskNotifyGive(captureTask);
+}
+
+Frame* pipelineNextDetect(TickType_t wait) {
+    Frame* frame = nullptr;
+    if (!detectQueue || xQueueReceive(detectQueue, &frame, wait) != pdTRUE) return nullptr;
+    return frame;
+}
+
+void pipelineDetectDone(const Frame* frame) {
+    portENTER_CRITICAL(&refMux);
+    stats.frames[STAGE_DETECT]++;
+    stats.detectAgeMsTotal += millis() - frame->capturedAt;
+    portEXIT_CRITICAL(&refMux);
+}
+
+PipelineStats pipelineStats() {
+    portENTER_CRITICAL(&refMux);
+    PipelineStats s = stats;
+    portEXIT_CRITICAL(&refMux);
+    return s;
+}
+
+void pipelinePrintFps() {
+    static PipelineStats last = {};
+    static unsigned long lastAt = 0;
+    PipelineStats s = pipelineStats();
+    unsigned long now = millis();
+    float sec = (now - lastAt) / 1000.0f;
+    if (lastAt && sec > 0) {
+        uint32_t detected = s.frames[STAGE_DETECT] - last.frames[STAGE_DETECT];
+        LOGI("🎞️ [PIPELINE] FPS capture %.1f | render %.1f | detect %.1f | trễ detect %lu ms | bỏ %u/%u, hết slot %u",
+             (s.frames[STAGE_CAPTURE] - last.frames[STAGE_CAPTURE]) / sec,
+             (s.frames[STAGE_RENDER] - last.frames[STAGE_RENDER]) / sec,
+             detected / sec,
+             detected ? (unsigned long)(s.detectAgeMsTotal - last.detectAgeMsTotal) / detected : 0UL,
+             s.skipped[STAGE_RENDER] - last.skipped[STAGE_RENDER],
+             s.skipped[STAGE_DETECT] - last.skipped[STAGE_DETECT],
+             s.noSlot - last.noSlot);
+    }
+    last = s;
+    lastAt = now;
+}
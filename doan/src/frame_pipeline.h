@@ -0,0 +1,56 @@
+#pragma once
+#include <Arduino.h>
+#include "esp_camera.h"
+
+// Pipeline khung hình nhiều tầng chạy song song trên 2 core:
+//   CaptureTask (core 0) : lấy frame từ driver camera, chép vào 1 slot rảnh trong PSRAM
+//   RenderTask  (core 0) : đẩy frame mới nhất lên TFT (qua FrameRenderer, xem renderer.h)
+//   Tầng detect (core 1) : CameraAppTask lấy frame mới nhất bằng pipelineNextDetect()
+// Mỗi slot có bộ đếm tham chiếu: tầng nào giữ frame thì frame chưa bị ghi đè,
+// slot chỉ quay về pool khi tham chiếu cuối cùng được trả. Hàng đợi giữa các tầng
+// chỉ chứa 1 frame (luôn là frame mới nhất) nên tầng chậm không làm trễ tầng nhanh.
+
+#define FRAME_SLOTS          4       // capture + render + detect + 1 frame đang giữ (enroll)
+#define FRAME_FPS_PERIOD_MS  10000   // chu kỳ in FPS từng tầng
+#define RENDER_IDLE_MS       50      // RenderTask gọi renderer(nullptr) khi không có frame mới
+#define CAPTURE_IDLE_PERIOD_MS 200   // chế độ chờ (không ai trước máy): capture ~5 FPS
+
+struct Frame {
+    camera_fb_t fb;          // fb.buf trỏ vào slot PSRAM, dùng được như frame của driver
+    uint32_t seq;
+    unsigned long capturedAt;
+    uint8_t refs;            // chỉ đọc/ghi qua frameRetain/frameRelease
+};
+
+enum FrameStage { STAGE_CAPTURE, STAGE_RENDER, STAGE_DETECT, STAGE_COUNT };
+
+struct PipelineStats {
+    uint32_t frames[STAGE_COUNT];  // số frame mỗi tầng đã xử lý
+    uint32_t noSlot;               // capture phải chờ vì mọi slot đang bị giữ
+    uint32_t skipped[STAGE_COUNT]; // frame bị thay bằng frame mới hơn trước khi tầng đó kịp lấy
+    uint32_t detectAgeMsTotal;     // tổng độ trễ từ lúc chụp tới lúc detect xong
+};
+
+// Trả về false nếu frame không được vẽ (vd. đang giữ màn hình kết quả).
+// frame = nullptr khi không có frame mới trong RENDER_IDLE_MS.
+typedef bool (*FrameRenderer)(Frame* frame);
+
+// Cấp phát FRAME_SLOTS slot cho frame width x height RGB565 và khởi động CaptureTask + RenderTask
+bool pipelineBegin(uint16_t width, uint16_t height, FrameRenderer render);
+// false: CaptureTask dừng lấy frame (ngoài giờ làm / trước khi deinit camera).
+// Trả về khi CaptureTask đã nhả driver camera.
+void pipelineSetActive(bool active);
+// true: chế độ chờ, CaptureTask chỉ lấy 1 frame mỗi CAPTURE_IDLE_PERIOD_MS (tầng detect và
+// render chạy theo). false: đánh thức CaptureTask lấy frame kế tiếp ngay.
+void pipelineSetIdle(bool idle);
+
+// Frame mới nhất chưa detect; người gọi sở hữu 1 tham chiếu và phải frameRelease()
+Frame* pipelineNextDetect(TickType_t wait);
+// Tầng detect báo đã xong 1 frame (để tính FPS và độ trễ)
+void pipelineDetectDone(const Frame* frame);
+
+void frameRetain(Frame* frame);
+void frameRelease(Frame* frame);
+
+PipelineStats pipelineStats();
+void pipelinePrintFps();
@@ -0,0 +1,152 @@
+#include "http_session.h"
+#include "metrics.h"
+#include "logger.h"
+
+HttpSession gHttp;
+
+// Header phản hồi cần giữ: Transfer-Encoding cho body(), X-Image-Upload cho chế độ upload ảnh
+static const char* RESPONSE_HEADERS[] = {"Transfer-Encoding", "X-Image-Upload"};
+
+// Đọc dòng kích thước chunk kế tiếp (hex, bỏ phần mở rộng sau ';').
+// false khi gặp chunk 0 (hết body) hoặc socket hết giờ / đóng.
+bool ChunkedStream::nextChunk() {
+    if (_done) return false;
+    if (_started) _src.readStringUntil('\n');    // CRLF sau dữ liệu chunk trước
+    _started = true;
+    String line = _src.readStringUntil('\n');
+    char* end = nullptr;
+    unsigned long n = strtoul(line.c_str(), &end, 16);
+    if (end == line.c_str() || n == 0) {
+        if (n == 0 && end != line.c_str()) _src.readStringUntil('\n');   // dòng trống kết thúc body
+        _done = true;
+        return false;
+    }
+    _left = n;
+    return true;
+}
+
+int ChunkedStream::available() {
+    if (_done) return 0;
+    int n = _src.available();
+    return (_left && (size_t)n > _left) ? (int)_left : n;
+}
+
+int ChunkedStream::read() {
+    char c;
+    return readBytes(&c, 1) == 1 ? (uint8_t)c : -1;
+}
+
+int ChunkedStream::peek() {
+    if (_left == 0 && !nextChunk()) return -1;
+    return _src.peek();
+}
+
+size_t ChunkedStream::readBytes(char* buffer, size_t length) {
+    size_t out = 0;
+    while (out < length) {
+        if (_left == 0 && !nextChunk()) break;
+        size_t n = _src.readBytes(buffer + out, min(length - out, _left));
+        if (n == 0) {
+            _done = true;    // hết giờ giữa chunk
+            break;
+        }
+        out += n; _left -= n;
+    }
+    return out;
+}
+
+void HttpSession::begin(const char* host, uint16_t port) {
+    if (!_mutex) _mutex = xSemaphoreCreateMutex();
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    if (_host != host || _port != port) _client.stop();
+    _host = host;
+    _port = port;
+    _http.setReuse(true);
+    xSemaphoreGive(_mutex);
+}
+
+bool HttpSession::ensureConnected(uint32_t timeoutMs, bool& reused) {
+    if (_client.connected()) {
+        reused = true;
+        return true;
+    }
+    reused = false;
+    _client.stop();
+    unsigned long t0 = millis();
+    if (!_client.connect(_host.c_str(), _port, timeoutMs)) return false;
+    _stats.handshakes++;
+    _stats.handshakeMsTotal += millis() - t0;
+    return true;
+}
+
+// Chỉ gửi lại khi chắc chắn server chưa nhận request: gửi header/body lỗi, hoặc mất kết nối
+// khi chưa đọc được byte phản hồi nào. Hết giờ đọc (READ_TIMEOUT) thì server có thể đã xử lý
+// xong -> gửi lại sẽ ghi trùng log chấm công / ảnh enroll.
+bool HttpSession::canResend(int code) const {
+    if (code == HTTPC_ERROR_SEND_HEADER_FAILED || code == HTTPC_ERROR_SEND_PAYLOAD_FAILED) return true;
+    return code == HTTPC_ERROR_CONNECTION_LOST && _client.rx() == 0;
+}
+
+int HttpSession::request(const String& path, uint32_t timeoutMs, const std::function<int(HTTPClient&)>& send) {
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    MetricTimer timer(M_HTTP);
+    _stats.requests++;
+
+    bool reused = false;
+    if (!ensureConnected(timeoutMs, reused)) return HTTPC_ERROR_CONNECTION_REFUSED;
+    if (reused) _stats.reused++;
+
+    _http.setConnectTimeout(timeoutMs);
+    _http.setTimeout(timeoutMs);
+    _http.begin(_client, _host, _port, path);
+    _http.collectHeaders(RESPONSE_HEADERS, 2);
+    _client.resetRx();
+    int code = send(_http);
+
+    // Server đóng kết nối keep-alive đúng lúc ta gửi -> mở kết nối mới và gửi lại 1 lần
+    if (reused && canResend(code)) {
+        _stats.reconnects++;
+        _stats.reused--;
+        _http.end();
+        _client.stop();
+        if (!ensureConnected(timeoutMs, reused)) return HTTPC_ERROR_CONNECTION_REFUSED;
+        _http.begin(_client, _host, _port, path);
+        _http.collectHeaders(RESPONSE_HEADERS, 2);
+        _client.resetRx();
+        code = send(_http);
+    }
+    return code;
+}
+
+Stream& HttpSession::body() {
+    if (!_http.header("Transfer-Encoding").equalsIgnoreCase("chunked")) return _http.getStream();
+    _chunked.reset();
+    _chunkedOpen = true;
+    return _chunked;
+}
+
+void HttpSession::finish() {
+    // JSON kết thúc trước chunk 0: đọc nốt phần đuôi để kết nối keep-alive sạch cho request sau
+    if (_chunkedOpen) {
+        char tail[64];
+        while (_chunked.readBytes(tail, sizeof(tail)) > 0) {}
+        _chunkedOpen = false;
+    }
+    // end() chỉ xoá trạng thái request; socket được giữ lại nếu server cho phép keep-alive
+    _http.end();
+    xSemaphoreGive(_mutex);
+}
+
+void HttpSession::close() {
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    _http.end();
+    _client.stop();
+    xSemaphoreGive(_mutex);
+}
+
+void HttpSession::printStats() const {
+    uint32_t reusePct = _stats.requests ? _stats.reused * 100 / _stats.requests : 0;
+    uint32_t hsAvg = _stats.handshakes ? _stats.handshakeMsTotal / _stats.handshakes : 0;
+    LOGI("♻️ [HTTP] Tái sử dụng kết nối: %u/%u (%u%%) | Bắt tay TCP: %u lần, TB %u ms | Kết nối lại: %u",
+         _stats.reused, _stats.requests, reusePct, _stats.handshakes, hsAvg, _stats.reconnects);
+}
@@ -0,0 +1,96 @@
+#pragma once
+#include <Arduino.h>
+#include <WiFi.h>
+#include <HTTPClient.h>
+#include <functional>
+
+// WiFiClient đếm số byte phản hồi đã đọc: phân biệt request chết trước khi server trả lời
+// (gửi lại được) với request server đã nhận rồi mới đứt (không được gửi lại).
+class CountingClient : public WiFiClient {
+public:
+    int read() override {
+        int c = WiFiClient::read();
+        if (c >= 0) _rx++;
+        return c;
+    }
+    int read(uint8_t* buf, size_t size) override {
+        int n = WiFiClient::read(buf, size);
+        if (n > 0) _rx += n;
+        return n;
+    }
+    void resetRx() { _rx = 0; }
+    size_t rx() const { return _rx; }
+
+private:
+    size_t _rx = 0;
+};
+
+// Đọc body chunked (Transfer-Encoding: chunked) thẳng từ socket, bỏ các dòng kích thước chunk:
+// phản hồi không có Content-Length vẫn giải mã từ stream được, không phải getString() ghép lại.
+class ChunkedStream : public Stream {
+public:
+    explicit ChunkedStream(Stream& src) : _src(src) {}
+    void reset() { _left = 0; _started = false; _done = false; }
+
+    int available() override;
+    int read() override;
+    int peek() override;
+    size_t readBytes(char* buffer, size_t length) override;
+    size_t write(uint8_t) override { return 0; }
+    void flush() override {}
+
+private:
+    bool nextChunk();
+
+    Stream& _src;
+    size_t _left = 0;        // byte còn lại của chunk hiện tại
+    bool _started = false;
+    bool _done = false;      // gặp chunk 0 hoặc lỗi
+};
+
+// Phiên HTTP keep-alive dùng chung cho recognize / enroll / sync offline.
+// Giữ 1 kết nối TCP tới server qua nhiều request để bỏ bước bắt tay TCP
+// mỗi ảnh; tự kết nối lại khi server đã đóng socket. Có mutex bên trong vì
+// CameraAppTask và NetworkTask cùng gửi.
+class HttpSession {
+public:
+    struct Stats {
+        uint32_t requests;
+        uint32_t reused;          // request chạy trên kết nối có sẵn
+        uint32_t handshakes;      // số lần mở kết nối TCP mới
+        uint32_t handshakeMsTotal;
+        uint32_t reconnects;      // kết nối cũ chết giữa chừng -> gửi lại
+    };
+
+    void begin(const char* host, uint16_t port);
+
+    // Gửi 1 request tới path. send() nhận HTTPClient đã trỏ tới path và trả về HTTP code;
+    // nó có thể bị gọi lại 1 lần nếu kết nối keep-alive đã bị đóng trước khi server nhận request,
+    // nên phải gửi lại được từ đầu: body dạng Stream phải rewind() trước khi gửi, rewind lỗi thì
+    // trả HTTPC_ERROR_STREAM_WRITE (không gửi lại).
+    // Luôn gọi finish() sau request() (kể cả khi lỗi), sau khi đã đọc xong phản hồi qua http().
+    int request(const String& path, uint32_t timeoutMs, const std::function<int(HTTPClient&)>& send);
+    HTTPClient& http() { return _http; }
+    // Body phản hồi để giải mã thẳng từ socket (chunked hay có Content-Length đều được)
+    Stream& body();
+    void finish();
+
+    void close();
+    Stats stats() const { return _stats; }
+    void printStats() const;
+
+private:
+    bool ensureConnected(uint32_t timeoutMs, bool& reused);
+    bool canResend(int code) const;
+
+    CountingClient _client;
+    HTTPClient _http;
+    ChunkedStream _chunked{_client};
+    bool _chunkedOpen = false;
+    String _host;
+    uint16_t _port = 0;
+    SemaphoreHandle_t _mutex = nullptr;
+    Stats _stats = {};
+};
+
+extern HttpSession gHttp;
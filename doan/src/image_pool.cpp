@@ -0,0 +1,43 @@
+#include "image_pool.h"
+#include "logger.h"
+
+BufferPool gImagePool;
+BufferPool gUplinkPool;
+static uint32_t spills = 0;
+
+bool imagePoolBegin() {
+    bool ok = gImagePool.begin(IMAGE_BLOCK_BYTES, IMAGE_BLOCKS);
+    ok = gUplinkPool.begin(UPLINK_FRAME_BYTES, UPLINK_FRAMES) && ok;
+    if (ok) {
+        LOGI("🧱 [POOL] Ảnh %u x %u KB, khung gửi %u x %u KB (PSRAM).", IMAGE_BLOCKS,
+             IMAGE_BLOCK_BYTES / 1024, UPLINK_FRAMES, UPLINK_FRAME_BYTES / 1024);
+    } else {
+        LOGE("❌ [POOL] Không cấp được vùng nhớ ảnh -> dùng heap.");
+    }
+    return ok;
+}
+
+uint8_t* imageAcquire(size_t minLen, size_t* cap) {
+    uint8_t* p = gImagePool.acquire(minLen);
+    if (p) {
+        *cap = gImagePool.blockSize();
+        return p;
+    }
+    imageSpill();
+    *cap = minLen;
+    return (uint8_t*)ps_malloc(minLen);
+}
+
+void imageFree(void* p) {
+    if (!p) return;
+    if (gImagePool.owns(p)) gImagePool.release(p);
+    else free(p);
+}
+
+void imageSpill() {
+    __atomic_fetch_add(&spills, 1, __ATOMIC_RELAXED);
+}
+
+uint32_t imageSpills() {
+    return __atomic_load_n(&spills, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <Arduino.h>
+#include "buffer_pool.h"
+
+// Vùng nhớ ảnh cố định trong PSRAM, cấp 1 lần lúc khởi động (xem buffer_pool.h):
+//   - gImagePool  : ảnh mặt JPEG (cắt + nén trong CameraAppTask, UploaderTask / ws_uplink trả
+//                   sau khi gửi xong). Đủ cho burst đang giữ + hàng đợi upload + request WS đang bay.
+//   - gUplinkPool : khung nhị phân gửi ảnh qua WebSocket, 1 ScratchArena mỗi request.
+// Lượt nhận diện bình thường không malloc / free gì. Ảnh lớn hơn 1 block hoặc hết block thì lấy
+// heap như cũ và đếm vào "spills" để thấy trong get_metrics.
+
+#define IMAGE_BLOCK_BYTES   (16 * 1024)     // JPEG mặt lớn nhất thường gặp (ROI ~170x170 Q90)
+#define IMAGE_BLOCKS        24
+#define UPLINK_FRAME_BYTES  (3 * IMAGE_BLOCK_BYTES + 1024)   // burst 3 ảnh + header
+#define UPLINK_FRAMES       1               // chỉ UploaderTask gửi, mỗi lần 1 request
+
+extern BufferPool gImagePool;
+extern BufferPool gUplinkPool;
+
+bool imagePoolBegin();
+// Buffer ảnh ít nhất minLen byte: block của pool (*cap = cỡ block), không được thì ps_malloc.
+uint8_t* imageAcquire(size_t minLen, size_t* cap);
+// Trả buffer từ imageAcquire (block về pool, còn lại free()). Bỏ qua nullptr.
+void imageFree(void* p);
+// Ảnh phải nằm ngoài pool (không lấy được block / JPEG lớn hơn 1 block)
+void imageSpill();
+uint32_t imageSpills();
@@ -0,0 +1,132 @@
+#include "logger.h"
+#include <stdio.h>
+#include <sys/stat.h>
+#include "metrics.h"
+
+LogRing gLog;
+
+static TaskHandle_t logTask = nullptr;
+static volatile bool sdWanted = false;
+static volatile bool flushRequested = false;
+static volatile bool flushDone = false;
+
+static FILE* logFile = nullptr;
+static uint32_t logFileSize = 0;
+
+static const char LEVEL_CHAR[] = {' ', 'E', 'W', 'I', 'D'};
+
+static void logPath(char* out, size_t n, int index) {
+    snprintf(out, n, LOG_DIR "/log%d.txt", index);
+}
+
+static bool openLogFile() {
+    mkdir(LOG_DIR, 0775);
+    char path[32];
+    logPath(path, sizeof(path), 0);
+    logFile = fopen(path, "a");
+    if (!logFile) return false;
+    fseek(logFile, 0, SEEK_END);
+    logFileSize = ftell(logFile);
+    fprintf(logFile, "----- boot, uptime %lu ms -----\n", millis());
+    return true;
+}
+
+// log0 -> log1 -> ... -> log(LOG_FILES-1) bị xoá
+static void rotateLogFile() {
+    fclose(logFile);
+    logFile = nullptr;
+    char from[32], to[32];
+    logPath(to, sizeof(to), LOG_FILES - 1);
+    remove(to);
+    for (int i = LOG_FILES - 2; i >= 0; i--) {
+        logPath(from, sizeof(from), i);
+        logPath(to, sizeof(to), i + 1);
+        rename(from, to);
+    }
+    logFileSize = 0;
+    openLogFile();
+}
+
+static void writeLine(const char* line, uint8_t level, uint32_t timeMs) {
+    char prefix[24];
+    int n = snprintf(prefix, sizeof(prefix), "[%lu.%03lu] %c ", (unsigned long)(timeMs / 1000),
+                     (unsigned long)(timeMs % 1000), LEVEL_CHAR[level < sizeof(LEVEL_CHAR) ? level : 0]);
+    Serial.write((const uint8_t*)prefix, n);
+    Serial.println(line);
+    if (logFile) {
+        int w = fprintf(logFile, "%s%s\n", prefix, line);
+        if (w > 0) logFileSize += w;
+        if (logFileSize >= LOG_FILE_MAX) rotateLogFile();
+    }
+}
+
+static void LogTask(void* pvParameters) {
+    static char line[LOG_LINE_MAX];
+    uint32_t lastDropped = 0;
+    uint32_t lastFileFlush = millis();
+    bool dirty = false;
+    for (;;) {
+        if (sdWanted && !logFile) {
+            sdWanted = false;
+            if (!openLogFile()) Serial.println("❌ [LOG] Không mở được file log trên thẻ SD!");
+        }
+
+        uint8_t level;
+        uint32_t timeMs;
+        bool any = false;
+        while (gLog.pop(line, sizeof(line), &level, &timeMs)) {
+            writeLine(line, level, timeMs);
+            any = dirty = true;
+        }
+        uint32_t dropped = gLog.stats().dropped;
+        if (dropped != lastDropped) {
+            snprintf(line, sizeof(line), "⚠️ [LOG] Ring đầy, bỏ %lu dòng", (unsigned long)(dropped - lastDropped));
+            writeLine(line, LOG_LEVEL_WARN, millis());
+            lastDropped = dropped;
+        }
+
+        if (flushRequested) {
+            if (logFile) {
+                fclose(logFile);
+                logFile = nullptr;
+            }
+            dirty = false;
+            flushRequested = false;
+            flushDone = true;
+        } else if (logFile && dirty && millis() - lastFileFlush > 1000) {
+            // Chỉ fflush khi rảnh, tối đa 1 lần/giây: ghi thẻ SD theo khối lớn
+            fflush(logFile);
+            dirty = false;
+            lastFileFlush = millis();
+        }
+        if (!any) vTaskDelay(pdMS_TO_TICKS(10));
+    }
+}
+
+void loggerBegin() {
+    if (logTask) return;
+    xTaskCreatePinnedToCore(LogTask, "LogTask", 4096, NULL, 1, &logTask, 0);
+    metricsRegisterTask(logTask);
+}
+
+void loggerAttachSd() {
+    sdWanted = true;
+}
+
+void loggerFlush(uint32_t timeoutMs) {
+    if (!logTask) return;
+    uint32_t start = millis();
+    while (!gLog.empty() && millis() - start < timeoutMs) vTaskDelay(pdMS_TO_TICKS(5));
+    flushDone = false;
+    flushRequested = true;
+    while (!flushDone && millis() - start < timeoutMs) vTaskDelay(pdMS_TO_TICKS(5));
+    Serial.flush();
+}
+
+void loggerSetLevel(uint8_t level) {
+    gLog.setLevel(level);
+}
+
+LogStats loggerStats() {
+    return gLog.stats();
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <Arduino.h>
+#include "async_log.h"
+
+// Log của kiosk: LOGE/LOGW/LOGI/LOGD chỉ đẩy format + tham số vào ring không khoá (vài trăm
+// ns, không chạm UART), LogTask ưu tiên thấp trên core 0 định dạng rồi ghi ra Serial và,
+// khi đã gắn thẻ SD, vào /sd/logs/log0.txt (xoay vòng LOG_FILES file, mỗi file tối đa
+// LOG_FILE_MAX byte) để còn log xem lại sau sự cố.
+//
+// Lọc 2 tầng:
+//   - lúc biên dịch: LOG_LEVEL (build_flags -DLOG_LEVEL=4 để bật LOGD); dòng bị lọc không sinh
+//     code và không tính tham số
+//   - lúc chạy: loggerSetLevel()
+// Format phải là chuỗi hằng, không kèm '\n' (LogTask tự xuống dòng).
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+#define LOG_DIR       "/sd/logs"
+#define LOG_FILES     4
+#define LOG_FILE_MAX  (256UL * 1024)
+
+extern LogRing gLog;
+
+#define LOG_AT(level, fmt, ...) gLog.write(level, millis(), fmt, ##__VA_ARGS__)
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOGE(fmt, ...) LOG_AT(LOG_LEVEL_ERROR, fmt, ##__VA_ARGS__)
+#else
+#define LOGE(fmt, ...) do {} while (0)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOGW(fmt, ...) LOG_AT(LOG_LEVEL_WARN, fmt, ##__VA_ARGS__)
+#else
+#define LOGW(fmt, ...) do {} while (0)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOGI(fmt, ...) LOG_AT(LOG_LEVEL_INFO, fmt, ##__VA_ARGS__)
+#else
+#define LOGI(fmt, ...) do {} while (0)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOGD(fmt, ...) LOG_AT(LOG_LEVEL_DEBUG, fmt, ##__VA_ARGS__)
+#else
+#define LOGD(fmt, ...) do {} while (0)
+#endif
+
+// Tạo LogTask (gọi ngay sau Serial.begin; dòng log trước đó vẫn nằm trong ring)
+void loggerBegin();
+// Ghi thêm vào thẻ SD (gọi sau khi SD_MMC.begin thành công)
+void loggerAttachSd();
+// Đẩy hết ring ra UART/SD rồi đóng file log (gọi trước SD_MMC.end / ngủ sâu)
+void loggerFlush(uint32_t timeoutMs);
+void loggerSetLevel(uint8_t level);
+LogStats loggerStats();
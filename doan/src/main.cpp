@@ -4,7 +4,6 @@
 #include <TFT_eSPI.h>
 #include <WiFi.h>
 #include <HTTPClient.h> 
-#include <base64.h> 
 #include <FS.h>       
 #include <SPIFFS.h> 
 #include "esp_camera.h"
@@ -16,8 +15,28 @@
 #include <RTClib.h>   
 #include <SD_MMC.h>   
 #include <time.h>     
-#include "img_converters.h"
 #include <driver/rtc_io.h>
+#include "upload_stream.h"
+#include "http_session.h"
+#include "uploader.h"
+#include "server_reply.h"
+#include "ws_uplink.h"
+#include "face_embedder.h"
+#include "face_gallery.h"
+#include "offline_journal.h"
+#include "roi_jpeg.h"
+#include "frame_pipeline.h"
+#include "renderer.h"
+#include "link_control.h"
+#include "face_tracker.h"
+#include "liveness.h"
+#include "motion_gate.h"
+#include "frame_quality.h"
+#include "head_pose.h"
+#include "metrics.h"
+#include "logger.h"
+#include "fast_boot.h"
+#include "image_pool.h"
 // --- CẤU HÌNH PIN ---
 #define WIFI_RESET_BTN 14
 #define SDA_PIN 47
@@ -27,15 +46,14 @@
 Preferences preferences;
 char server_ip_buffer[40] = "192.168.137.1"; 
 int server_port = 5000;
+// Khoá chung với server (DEVICE_KEY trong .env backend), gửi qua X-Device-Key khi lấy gallery /
+// gửi embedding. Nhập ở cổng cấu hình WiFi, lưu trong Preferences.
+char device_key_buffer[65] = "";
 
 TFT_eSPI tft = TFT_eSPI();
 WebSocketsClient webSocket;
 RTC_DS3231 rtc;
 
-// --- FREERTOS HANDLES ---
-SemaphoreHandle_t tftMutex;
-SemaphoreHandle_t camMutex;
-
 using eloq::camera;
 using eloq::face_t;
 using eloq::face::detection;
@@ -46,14 +64,103 @@ String gEnrollName = "";
 unsigned long lastCaptureTime = 0;
 #define CAPTURE_INTERVAL 800 
 
-// Motion Liveness
-struct FaceLog { int x, y; };
-FaceLog lastFace = {0, 0};
-#define MOTION_THRESHOLD 5   
-#define MAX_MOTION 60        
+// Ảnh mặt gửi server: 0 = cắt theo khung mặt (+PAD); 112/160 = mặt căn theo 2 mắt về ảnh vuông
+// cố định (payload và thời gian nén gần như không đổi, server bỏ bước detect/resize)
+#define FACE_CROP_SIZE 0
+
+// Điều khiển upload theo RTT đo được (xem link_control.h). CameraAppTask đọc tham số nén,
+// UploaderTask báo kết quả từng request -> truy cập qua linkMux.
+#define LINK_QUALITY_MIN  60
+#define LINK_QUALITY_MAX  90
+#define LINK_CROP_MIN     112      // mạng chậm: mặt căn 112x112 (chỉ khi FACE_CROP_SIZE > 0)
+LinkController gLink;
+portMUX_TYPE linkMux = portMUX_INITIALIZER_UNLOCKED;
+
+LinkParams linkParams() {
+    portENTER_CRITICAL(&linkMux);
+    LinkParams p = gLink.params();
+    portEXIT_CRITICAL(&linkMux);
+    return p;
+}
+
+bool linkOfflineFirst() {
+    portENTER_CRITICAL(&linkMux);
+    bool off = gLink.offlineFirst(millis());
+    portEXIT_CRITICAL(&linkMux);
+    return off;
+}
+
+// Tham số cho request sắp gửi (có thể là lượt probe khi đang offline-first)
+LinkParams linkNext() {
+    portENTER_CRITICAL(&linkMux);
+    LinkParams p = gLink.next(millis());
+    portEXIT_CRITICAL(&linkMux);
+    return p;
+}
+
+// Lỗi 4xx là server từ chối ảnh, không phải lỗi đường mạng
+void linkReport(unsigned long rttMs, size_t bytes, int httpCode) {
+    bool ok = httpCode > 0 && httpCode < 500;
+    portENTER_CRITICAL(&linkMux);
+    bool wasOffline = gLink.params().offlineFirst;
+    gLink.report(millis(), rttMs, bytes, ok);
+    LinkParams p = gLink.params();
+    LinkStats st = gLink.stats();
+    portEXIT_CRITICAL(&linkMux);
+
+    LOGI("📶 [LINK] srtt %u±%u ms | %.1f KB/s | lỗi %.0f%% -> Q%u, crop %u, burst %u, timeout %u ms",
+         st.srttMs, st.rttVarMs, st.throughputKBs, st.errorRate * 100,
+         p.quality, p.cropSize, p.burst, p.timeoutMs);
+    if (p.offlineFirst != wasOffline) {
+        LOGI("%s", p.offlineFirst ? "📴 [LINK] Mạng kém -> ưu tiên offline (lưu/nhận diện tại máy)."
+                                  : "📶 [LINK] Mạng ổn định lại -> gửi server như bình thường.");
+    }
+}
+
+// Liveness nhiều frame tại máy (liveness.h). Ngưỡng mặc định, chỉnh lúc chạy bằng lệnh WS
+// {"type":"config_liveness",...} và lưu vào Preferences.
+#define MOTION_THRESHOLD 5
+#define MAX_MOTION 60
+LivenessEngine gLiveness;
+LivenessConfig gLiveCfg;                 // cấu hình mới từ NetworkTask, CameraAppTask áp dụng
+volatile bool gLiveCfgDirty = true;
+portMUX_TYPE liveMux = portMUX_INITIALIZER_UNLOCKED;
+
+// Chế độ chờ khi không ai trước máy (motion_gate.h): capture ~5 FPS, chỉ so chuyển động;
+// có chuyển động -> chạy detect đầy đủ ngay trên frame đó.
+MotionGate gMotion;
+MotionGateStats gMotionStats = {};       // bản chụp cho get_metrics (NetworkTask)
+portMUX_TYPE motionMux = portMUX_INITIALIZER_UNLOCKED;
 
 volatile bool gSystemIsWorking = true;
 
+// --- HÀNG ĐỢI OFFLINE (journal nhị phân trên thẻ SD) ---
+#define JOURNAL_DIR "/sd/journal"
+OfflineJournal gJournal;
+#define SYNC_BATCH_RECORDS  8              // số bản ghi mỗi request (tối đa JOURNAL_BATCH_MAX)
+#define SYNC_BATCH_BYTES    (256 * 1024)   // giới hạn body mỗi request
+#define SYNC_BATCH_GAP_MS   200            // nghỉ giữa 2 batch, nhường mạng cho nhận diện realtime
+#define SYNC_IDLE_MS        30000          // hết dữ liệu / lỗi -> 30s sau mới thử lại
+volatile bool gBulkIngest = true;          // server cũ không có /ingest_batch -> gửi từng bản ghi
+
+// --- GALLERY OFFLINE (nhận diện tại kiosk khi mất mạng) ---
+#define GALLERY_CAPACITY        2000       // 2000 x 512 byte int8 trong PSRAM
+#define GALLERY_STAGE_MAX       (2048 * 1024) // gói lớn nhất tải vào vùng tạm PSRAM (FULL 2000 người ~1.1 MB)
+#define GALLERY_PATH            "/sd/gallery.bin"
+#define GALLERY_SYNC_INTERVAL   600000     // 10 phút
+#define GALLERY_MATCH_THRESHOLD 0.55f      // cosine tối thiểu để chấp nhận kết quả offline
+#define THUMB_QUALITY           60         // ảnh lưu kèm quyết định offline chỉ để đối chiếu
+FaceGallery gGallery;
+SemaphoreHandle_t galleryMutex;
+float* gEmbQuery = nullptr;        // embedding khuôn mặt vừa chụp (CameraAppTask)
+float* gEnrollEmbSum = nullptr;    // cộng dồn embedding các bước enroll
+float* gEnrollPoseEmb = nullptr;   // embedding tại kiosk của từng tư thế enroll (ENROLL_STEPS x FACE_EMBED_DIM)
+float* gDeviceEmb = nullptr;       // embedding chờ NetworkTask gửi lên server
+char gDeviceEmbId[32];
+volatile bool gDeviceEmbPending = false;
+volatile bool gGallerySyncDue = true;
+bool gLocalRecogReady = false;     // có model embedding + đủ bộ nhớ
+
 struct TimeSlot {
     int startHour; int startMin; // Giờ mở máy
     int endHour;   int endMin;   // Giờ tắt máy
@@ -69,7 +176,25 @@ void saveTimeConfig() {
     preferences.begin("chamcong-config", false);
     preferences.putBytes("slots", activeSlots, sizeof(activeSlots));
     preferences.end();
-    Serial.println("💾 [CONFIG] Đã lưu cấu hình giờ mới!");
+    LOGI("💾 [CONFIG] Đã lưu cấu hình giờ mới!");
+}
+
+void saveLivenessConfig() {
+    preferences.begin("chamcong-config", false);
+    preferences.putBytes("liveness", &gLiveCfg, sizeof(gLiveCfg));
+    preferences.end();
+}
+
+void loadLivenessConfig() {
+    gLiveCfg.motionMin = MOTION_THRESHOLD;
+    gLiveCfg.motionMax = MAX_MOTION;
+    preferences.begin("chamcong-config", true);
+    if (preferences.getBytesLength("liveness") == sizeof(gLiveCfg)) {
+        preferences.getBytes("liveness", &gLiveCfg, sizeof(gLiveCfg));
+        LOGI("📂 [CONFIG] Đã tải ngưỡng liveness.");
+    }
+    preferences.end();
+    gLiveCfgDirty = true;
 }
 
 // Hàm tải cấu hình từ Flash
@@ -77,9 +202,9 @@ void loadTimeConfig() {
     preferences.begin("chamcong-config", true);
     if (preferences.isKey("slots")) {
         preferences.getBytes("slots", activeSlots, sizeof(activeSlots));
-        Serial.println("📂 [CONFIG] Đã tải cấu hình từ bộ nhớ.");
+        LOGI("📂 [CONFIG] Đã tải cấu hình từ bộ nhớ.");
     } else {
-        Serial.println("⚠️ [CONFIG] Chưa có cấu hình, dùng mặc định.");
+        LOGW("⚠️ [CONFIG] Chưa có cấu hình, dùng mặc định.");
     }
     preferences.end();
 }
@@ -94,8 +219,8 @@ long calculateSleepSeconds() {
         long endSec   = activeSlots[i].endHour * 3600 + activeSlots[i].endMin * 60;
 
         if (currentSec >= startSec && currentSec < endSec) {
-            Serial.printf("✅ Đang trong khung giờ hoạt động %d (%02d:%02d - %02d:%02d)\n", 
-                          i+1, activeSlots[i].startHour, activeSlots[i].startMin, activeSlots[i].endHour, activeSlots[i].endMin);
+            LOGI("✅ Đang trong khung giờ hoạt động %d (%02d:%02d - %02d:%02d)", 
+                 i+1, activeSlots[i].startHour, activeSlots[i].startMin, activeSlots[i].endHour, activeSlots[i].endMin);
             return 0; // KHÔNG NGỦ
         }
     }
@@ -105,8 +230,8 @@ long calculateSleepSeconds() {
         long startSec = activeSlots[i].startHour * 3600 + activeSlots[i].startMin * 60;
         if (startSec > currentSec) {
             long sleepTime = startSec - currentSec;
-            Serial.printf("💤 Ngủ đợi đến khung giờ tiếp theo: %02d:%02d (còn %ld giây)\n", 
-                          activeSlots[i].startHour, activeSlots[i].startMin, sleepTime);
+            LOGI("💤 Ngủ đợi đến khung giờ tiếp theo: %02d:%02d (còn %ld giây)", 
+                 activeSlots[i].startHour, activeSlots[i].startMin, sleepTime);
             return sleepTime;
         }
     }
@@ -114,8 +239,8 @@ long calculateSleepSeconds() {
     // 3. Nếu hết khung hôm nay -> Ngủ tới khung đầu tiên ngày mai
     long firstSlotTomorrow = activeSlots[0].startHour * 3600 + activeSlots[0].startMin * 60;
     long sleepUntilTomorrow = (dayEndSec - currentSec) + firstSlotTomorrow;
-    Serial.printf("💤 Hết giờ làm. Ngủ đợi đến sáng mai %02d:%02d (còn %ld giây)\n", 
-                  activeSlots[0].startHour, activeSlots[0].startMin, sleepUntilTomorrow);
+    LOGI("💤 Hết giờ làm. Ngủ đợi đến sáng mai %02d:%02d (còn %ld giây)", 
+         activeSlots[0].startHour, activeSlots[0].startMin, sleepUntilTomorrow);
     
     return sleepUntilTomorrow;
 }
@@ -123,19 +248,19 @@ long calculateSleepSeconds() {
 void enterDeepSleep(long seconds) {
     if (seconds <= 0) return;
 
-    Serial.printf("😴 Chuẩn bị ngủ sâu trong %ld giây (%ld phút)...\n", seconds, seconds/60);
+    LOGI("😴 Chuẩn bị ngủ sâu trong %ld giây (%ld phút)...", seconds, seconds/60);
+    pipelineSetActive(false);   // dừng lấy frame trước khi tắt camera
 
-    // Hiển thị thông báo trước khi tắt
-    if (xSemaphoreTake(tftMutex, portMAX_DELAY) == pdTRUE) {
-        tft.fillScreen(TFT_BLACK);
-        tft.setTextColor(TFT_DARKGREY, TFT_BLACK);  
-        xSemaphoreGive(tftMutex);
-        delay(100);
-    }
+    // Tắt màn hình (RenderTask vẫn chạy khi camera đã dừng)
+    uiShow(uiScreen(TFT_BLACK, 60000, false));
+    delay(100);
+    wsLock();
     webSocket.disconnect();
+    wsUnlock();
     WiFi.disconnect(true);  // Ngắt kết nối và xóa config
     WiFi.mode(WIFI_OFF);
     esp_camera_deinit();
+    loggerFlush(500);           // đẩy hết log ra UART / thẻ SD trước khi tắt thẻ
     SD_MMC.end();
 
     delay(120);
@@ -146,173 +271,313 @@ void enterDeepSleep(long seconds) {
     esp_sleep_enable_timer_wakeup(seconds * 1000000ULL); 
     esp_sleep_enable_ext0_wakeup((gpio_num_t)WIFI_RESET_BTN, 0); // 0 = LOW (nhấn nút)
 
-    Serial.println("👋 Good night!");
-    Serial.flush(); 
+    LOGI("👋 Good night!");
+    loggerFlush(200);
     esp_deep_sleep_start();
 }
 
 
-// Hàm tách chuỗi (Helper)
-String getValue(String data, char separator, int index) {
-    int found = 0;
-    int strIndex[] = {0, -1};
-    int maxIndex = data.length() - 1;
+// Chế độ upload ảnh: JSON + base64 (mặc định) hoặc JPEG nhị phân thô (ít hơn ~33% byte).
+// Server mới báo hỗ trợ qua header "X-Image-Upload: jpeg" trong phản hồi /api/ai/*
+// (HttpSession luôn giữ header này), nên thiết bị tự chuyển sang nhị phân sau lần gửi đầu tiên.
+volatile bool gBinaryUpload = false;
 
-    for (int i = 0; i <= maxIndex && found <= index; i++) {
-        if (data.charAt(i) == separator || i == maxIndex) {
-            found++;
-            strIndex[0] = strIndex[1] + 1;
-            strIndex[1] = (i == maxIndex) ? i + 1 : i;
+// Gửi ảnh qua WebSocket /ws khi server hỗ trợ (ws_uplink.h); 0 = luôn dùng HTTP POST
+#define WS_UPLINK_ENABLED 1
+
+// Phần đuôi JSON sau chuỗi base64 của ảnh: ","timestamp":"...",...}
+String imageJsonTail(const String& timestamp, bool isOffline, const String& type, const String& extraData,
+                     uint16_t aligned) {
+    String tail = "\",\"timestamp\":\"" + timestamp + "\"";
+    if (isOffline) tail += ",\"is_offline\":true";
+    else if (aligned) tail += ",\"aligned\":" + String(aligned);
+    if (extraData.length()) tail += ",\"employee_id\":\"" + extraData + "\"";
+    tail += "}";
+    return tail;
+}
+
+// Cập nhật chế độ upload theo phản hồi của server
+void updateUploadMode(HTTPClient& http, int httpCode) {
+    if (httpCode == 415 && gBinaryUpload) {
+        // Server không nhận JPEG thô nữa -> quay lại JSON cho các lần sau
+        LOGW("⚠️ [HTTP] Server từ chối JPEG nhị phân -> dùng lại JSON.");
+        gBinaryUpload = false;
+    } else if (httpCode > 0) {
+        bool binary = (http.header("X-Image-Upload") == "jpeg");
+        if (binary != gBinaryUpload) {
+            LOGI("🔀 [HTTP] Chế độ upload: %s", binary ? "JPEG nhị phân" : "JSON base64");
+            gBinaryUpload = binary;
         }
     }
-    return found > index ? data.substring(strIndex[0], strIndex[1]) : "";
 }
 
-// Hàm đồng bộ dữ liệu (Sync)
-void syncOfflineData() {
-    if (!SD_MMC.exists("/queue.txt")) return; // Không có gì để gửi
+// Gửi 1 ảnh (từ RAM hoặc từ journal SD) theo chế độ upload hiện tại. Trả về HTTP code.
+int postImage(HTTPClient& http, const uint8_t* jpgBuf, size_t jpgLen, ImageSource* imgSrc,
+              const String& timestamp, bool isOffline, const String& type, const String& extraData,
+              uint16_t aligned = 0) {
+    int httpCode;
+    if (gBinaryUpload) {
+        // Metadata nằm trong header, body là JPEG thô
+        http.addHeader("Content-Type", "image/jpeg");
+        http.addHeader("X-Timestamp", timestamp);
+        if (isOffline) http.addHeader("X-Offline", "1");
+        else if (aligned) http.addHeader("X-Face-Aligned", String(aligned));
+        if (extraData.length()) http.addHeader("X-Employee-Id", extraData);
+        if (imgSrc) {
+            // Có thể là lần gửi lại: nguồn đã bị lần trước đọc hết
+            if (!imgSrc->rewind()) return HTTPC_ERROR_STREAM_WRITE;
+            httpCode = http.sendRequest("POST", imgSrc, imgSrc->size());
+        }
+        else httpCode = http.sendRequest("POST", (uint8_t*)jpgBuf, jpgLen);
+    } else {
+        // Body JSON được sinh dần theo khối -> không giữ bản base64 trong heap
+        http.addHeader("Content-Type", "application/json");
+        Base64JsonStream body("{\"image\":\"", imageJsonTail(timestamp, isOffline, type, extraData, aligned));
+        if (imgSrc) {
+            if (!body.setSource(imgSrc)) return HTTPC_ERROR_STREAM_WRITE;
+        } else {
+            body.setSource(jpgBuf, jpgLen);
+        }
+        httpCode = http.sendRequest("POST", &body, body.totalLength());
+        if (body.failed()) LOGW("⚠️ [SYNC] Đọc ảnh từ thẻ SD bị thiếu -> huỷ request (%d).", httpCode);
+    }
 
-    Serial.println("🔄 [SYNC] Phát hiện dữ liệu Offline. Đang đồng bộ...");
+    updateUploadMode(http, httpCode);
+    return httpCode;
+}
 
-    // Đổi tên file để tránh xung đột khi đang đọc
-    SD_MMC.rename("/queue.txt", "/processing.txt");
+String isoTime(const DateTime& t);
+
+// Gửi 1 bản ghi cũ nhất qua /api/ai/recognize|enroll (server chưa có /ingest_batch).
+// true nếu đã xử lý xong bản ghi đó.
+bool syncOfflineRecord() {
+    JournalRecord rec;
+    if (!gJournal.peek(rec)) return false;
+    String type = (rec.type == JOURNAL_ENROLL) ? "enroll" : "recognize";
+    String timestamp = isoTime(DateTime(rec.timestamp));
+    String extraData = rec.employeeId;
+
+    // Timeout dài hơn chút; dùng lại kết nối keep-alive giữa các bản ghi
+    JournalImageSource img(gJournal, rec);
+    int httpCode = gHttp.request("/api/ai/" + type, 15000, [&](HTTPClient& http) {
+        return postImage(http, nullptr, 0, &img, timestamp, true, type, extraData, rec.aligned);
+    });
+    gHttp.finish();
 
-    fs::File procFile = SD_MMC.open("/processing.txt", FILE_READ);
-    if (!procFile) return;
+    if (httpCode > 0 && httpCode < 400) {
+        LOGI("✅ [SYNC] Đã gửi bù: %s %s", type.c_str(), timestamp.c_str());
+    } else if (httpCode >= 400 && httpCode < 500 && httpCode != 408 && httpCode != 429) {
+        // Server không bao giờ nhận bản ghi này -> bỏ để không chặn cả hàng đợi
+        LOGW("⚠️ [SYNC] Server từ chối (%d). Bỏ bản ghi %s.", httpCode, timestamp.c_str());
+    } else {
+        // Giữ nguyên cursor, lần sau gửi tiếp từ bản ghi này
+        LOGW("⚠️ [SYNC] Gửi lỗi (%d). Thử lại sau.", httpCode);
+        return false;
+    }
+    return gJournal.ack(rec);
+}
 
-    String newQueue = ""; // Lưu lại những dòng gửi thất bại (nếu có)
-    bool hasError = false;
+enum IngestStatus : uint8_t { INGEST_OK, INGEST_REJECT, INGEST_RETRY };
+
+// Đọc {"results":["ok"|"duplicate"|"reject"|"retry", ...]} của /ingest_batch thẳng từ stream,
+// filter chỉ giữ mảng results. Trả số trạng thái đọc được (tối đa max), -1 nếu không đọc được.
+int decodeIngestResults(Stream& in, IngestStatus* out, uint8_t max) {
+    JsonDocument filter;
+    filter["results"] = true;
+    JsonDocument doc;
+    if (deserializeJson(doc, in, DeserializationOption::Filter(filter),
+                        DeserializationOption::NestingLimit(3))) return -1;
+    JsonArrayConst results = doc["results"];
+    if (results.isNull()) return -1;
+    int n = 0;
+    for (JsonVariantConst v : results) {
+        if (n >= max) break;
+        const char* s = v | "retry";
+        out[n++] = strcmp(s, "retry") == 0 ? INGEST_RETRY : strcmp(s, "reject") == 0 ? INGEST_REJECT : INGEST_OK;
+    }
+    return n;
+}
 
-    while (procFile.available()) {
-        String line = procFile.readStringUntil('\n');
-        line.trim();
-        if (line.length() == 0) continue;
-
-        // Parse dữ liệu: TYPE|TIMESTAMP|EXTRA_DATA|IMG_PATH
-        String type = getValue(line, '|', 0);
-        String timestamp = getValue(line, '|', 1);
-        String extraData = getValue(line, '|', 2);
-        String imgPath = getValue(line, '|', 3);
-
-        // Đọc ảnh từ SD
-        fs::File imgFile = SD_MMC.open(imgPath, FILE_READ);
-        if (imgFile) {
-            size_t imgSize = imgFile.size();
-            uint8_t* imgBuf = (uint8_t*) ps_malloc(imgSize);
-            
-            if (imgBuf) {
-                imgFile.read(imgBuf, imgSize);
-                imgFile.close();
-
-                // Gửi lên Server (Logic giống sendImageToServer nhưng manual hơn)
-                HTTPClient http;
-                http.setTimeout(15000); // Timeout dài hơn chút
-                String url = "http://" + String(server_ip_buffer) + ":" + String(server_port) + "/api/ai/" + type;
-                http.begin(url);
-                http.addHeader("Content-Type", "application/json");
+// Gom tối đa SYNC_BATCH_RECORDS bản ghi thành 1 request /api/ai/ingest_batch.
+// Body là record journal thô stream thẳng từ thẻ SD; server trả trạng thái từng bản ghi,
+// bản ghi xong được ack ngay nên lỗi giữa chừng không làm gửi lại cả batch.
+// true nếu cả batch đã xử lý xong.
+bool syncOfflineBatch() {
+    JournalRecord rec;
+    if (!gJournal.peek(rec)) return false;
+    JournalBatchSource body(gJournal);
+    body.add(rec);
+    while (body.count() < SYNC_BATCH_RECORDS && gJournal.next(rec, rec)) {
+        if (body.size() + JOURNAL_HEADER_LEN + rec.length > SYNC_BATCH_BYTES) break;
+        body.add(rec);
+    }
 
-                String b64 = base64::encode(imgBuf, imgSize);
-                String payload = "{\"image\":\"" + b64 + "\",\"timestamp\":\"" + timestamp + "\",\"is_offline\":true";
-                if (type == "enroll") payload += ",\"employee_id\":\"" + extraData + "\"";
-                payload += "}";
+    unsigned long t0 = millis();
+    IngestStatus status[SYNC_BATCH_RECORDS];
+    int results = -1;
+    int httpCode = gHttp.request("/api/ai/ingest_batch", 30000, [&](HTTPClient& http) {
+        http.addHeader("Content-Type", "application/octet-stream");
+        if (!body.rewind()) return HTTPC_ERROR_STREAM_WRITE;
+        return http.sendRequest("POST", &body, body.size());
+    });
+    if (httpCode == 200) {
+        uint32_t tp = micros();
+        results = decodeIngestResults(gHttp.body(), status, body.count());
+        metricRecord(M_PARSE, micros() - tp);
+    }
+    gHttp.finish();
+    unsigned long ms = millis() - t0;
 
-                int httpCode = http.POST(payload);
-                http.end();
-                free(imgBuf);
+    if (httpCode == 404) {
+        LOGI("ℹ️ [SYNC] Server không có /ingest_batch -> gửi từng bản ghi.");
+        gBulkIngest = false;
+        return true;
+    }
+    if (results < 0) {
+        LOGW("⚠️ [SYNC] Gửi batch lỗi (%d). Thử lại sau.", httpCode);
+        return false;
+    }
 
-                if (httpCode > 0 && httpCode < 400) {
-                    Serial.printf("✅ [SYNC] Đã gửi bù: %s\n", imgPath.c_str());
-                    // Xóa ảnh gốc để giải phóng thẻ nhớ
-                    SD_MMC.remove(imgPath);
-                } else {
-                    Serial.printf("⚠️ [SYNC] Gửi lỗi (%d). Giữ lại dòng này.\n", httpCode);
-                    newQueue += line + "\n";
-                    hasError = true;
-                }
-            } else {
-                Serial.println("❌ [SYNC] RAM không đủ để đọc ảnh!");
-                newQueue += line + "\n"; // Giữ lại
-                imgFile.close();
-            }
-        } else {
-            // Ảnh không tồn tại -> Bỏ qua dòng này luôn
-            Serial.printf("⚠️ [SYNC] Không tìm thấy ảnh %s -> Bỏ qua.\n", imgPath.c_str());
+    uint8_t done = 0;
+    for (uint8_t i = 0; i < results; i++) {
+        if (status[i] == INGEST_RETRY) break;   // từ đây server chưa xử lý
+        if (status[i] == INGEST_REJECT) {
+            LOGW("⚠️ [SYNC] Server từ chối bản ghi %u -> bỏ.", i);
         }
+        if (!gJournal.ack(body.record(i))) break;
+        done++;
     }
-    procFile.close();
-    SD_MMC.remove("/processing.txt");
+    LOGI("📦 [SYNC] Batch %u/%u bản ghi, %u KB, %lu ms (%.1f KB/s), còn %u",
+         done, body.count(), body.size() / 1024, ms,
+         ms ? body.size() / 1.024f / ms : 0.0f, gJournal.pending());
+    return done == body.count();
+}
 
-    // Nếu có lỗi, ghi lại những dòng chưa gửi được vào queue.txt
-    if (newQueue.length() > 0) {
-        fs::File q = SD_MMC.open("/queue.txt", FILE_APPEND);
-        q.print(newQueue);
-        q.close();
-    } else {
-        Serial.println("🎉 [SYNC] Đồng bộ hoàn tất!");
+// Hàm đồng bộ dữ liệu (Sync). true nếu vừa gửi được và còn dữ liệu -> gọi tiếp ngay
+bool syncOfflineData() {
+    if (!gJournal.pending()) return false;
+    bool ok = gBulkIngest ? syncOfflineBatch() : syncOfflineRecord();
+    if (ok && !gJournal.pending()) LOGI("🎉 [SYNC] Đồng bộ hoàn tất!");
+    return ok && gJournal.pending() > 0;
+}
+
+// Chuyển hàng đợi kiểu cũ (queue.txt + /off_*.jpg) của firmware trước sang journal
+void migrateLegacyQueue() {
+    if (!SD_MMC.exists("/queue.txt")) return;
+    fs::File q = SD_MMC.open("/queue.txt", FILE_READ);
+    if (!q) return;
+    int moved = 0;
+    while (q.available()) {
+        // Format cũ: TYPE|TIMESTAMP|EXTRA_DATA|IMG_PATH
+        String line = q.readStringUntil('\n');
+        line.trim();
+        int p1 = line.indexOf('|'), p2 = line.indexOf('|', p1 + 1), p3 = line.indexOf('|', p2 + 1);
+        if (p1 < 0 || p2 < 0 || p3 < 0) continue;
+        String type = line.substring(0, p1);
+        String ts = line.substring(p1 + 1, p2);
+        String extra = line.substring(p2 + 1, p3);
+        String imgPath = line.substring(p3 + 1);
+
+        fs::File img = SD_MMC.open(imgPath, FILE_READ);
+        if (!img) continue;
+        size_t len = img.size(), cap;
+        uint8_t* buf = imageAcquire(len, &cap);
+        if (buf && img.read(buf, len) == len) {
+            DateTime t(ts.substring(0, 4).toInt(), ts.substring(5, 7).toInt(), ts.substring(8, 10).toInt(),
+                       ts.substring(11, 13).toInt(), ts.substring(14, 16).toInt(), ts.substring(17, 19).toInt());
+            uint8_t jtype = (type == "enroll") ? JOURNAL_ENROLL : JOURNAL_RECOGNIZE;
+            if (gJournal.append(jtype, t.unixtime(), extra.c_str(), buf, len)) moved++;
+        }
+        imageFree(buf);
+        img.close();
+        SD_MMC.remove(imgPath);
     }
+    q.close();
+    SD_MMC.remove("/queue.txt");
+    LOGI("📦 [OFFLINE] Đã chuyển %d bản ghi từ queue.txt sang journal.", moved);
 }
 // =========================================================
 // 1. HÀM XỬ LÝ ẢNH
 // =========================================================
 
-bool isLiveMotion(face_t f) {
-    int cx = f.x + f.width / 2;
-    int cy = f.y + f.height / 2;
-
-    if (lastFace.x == 0 && lastFace.y == 0) {
-        lastFace.x = cx; lastFace.y = cy;
-        return false;
+// Buffer JPEG: 1 block của gImagePool, JPEG lớn hơn block thì chuyển sang heap và nới dần
+struct JpegOut { uint8_t* buf; size_t len; size_t cap; };
+
+static bool jpegOutWrite(void* ctx, const uint8_t* data, size_t len) {
+    JpegOut* o = (JpegOut*)ctx;
+    if (o->len + len > o->cap) {
+        size_t cap = max(o->cap * 2, o->len + len);
+        uint8_t* nb;
+        if (gImagePool.owns(o->buf)) {
+            nb = (uint8_t*) ps_malloc(cap);
+            if (!nb) return false;
+            memcpy(nb, o->buf, o->len);
+            gImagePool.release(o->buf);
+            imageSpill();
+        } else {
+            nb = (uint8_t*) ps_realloc(o->buf, cap);
+            if (!nb) return false;
+        }
+        o->buf = nb;
+        o->cap = cap;
     }
-
-    int dx = abs(cx - lastFace.x);
-    int dy = abs(cy - lastFace.y);
-
-    float movement = sqrt(dx*dx + dy*dy); 
-
-    // --- THÊM ĐOẠN NÀY ĐỂ LẤY SỐ LIỆU ---
-    Serial.print("MOTION_DATA:"); // Từ khóa để lọc
-    Serial.println(movement);
-
-    lastFace.x = cx; lastFace.y = cy;
-
-    return ((dx > MOTION_THRESHOLD || dy > MOTION_THRESHOLD) && 
-            (dx < MAX_MOTION && dy < MAX_MOTION));
+    memcpy(o->buf + o->len, data, len);
+    o->len += len;
+    return true;
 }
 
-// Cắt ảnh từ RGB565 -> Nén JPEG (Chạy trên RAM ESP32)
-bool cropFaceFromRGB565(camera_fb_t* fb, face_t f, uint8_t** outBuf, size_t* outLen) {
-    const int PAD = 30; // Lấy rộng ra chút để Python dễ align
-    int x = max(0, f.x - PAD);
-    int y = max(0, f.y - PAD);
-    int w = min((int)(f.width + PAD * 2), (int)(fb->width - x));
-    int h = min((int)(f.height + PAD * 2), (int)(fb->height - y));
-
-    size_t cropSize = w * h * 2;
-    uint8_t* cropBuf = (uint8_t*) ps_malloc(cropSize);
-    if (!cropBuf) return false;
-
-    for (int j = 0; j < h; j++) {
-        uint8_t* srcPtr = fb->buf + ((y + j) * fb->width + x) * 2;
-        uint8_t* destPtr = cropBuf + (j * w) * 2;
-        memcpy(destPtr, srcPtr, w * 2);
+// Nén mặt từ frame RGB565 -> JPEG (Chạy trên RAM ESP32). Bộ mã hoá đọc thẳng ROI trong frame
+// theo stride, không chép vùng mặt ra buffer tạm. outBuf lấy từ imageAcquire, người gọi imageFree().
+// cropSize > 0: căn mặt về ảnh cropSize x cropSize; *aligned nhận cạnh ảnh thực tế (0 nếu phải
+// quay về cắt theo khung mặt).
+bool cropFaceFromRGB565(camera_fb_t* fb, face_t f, uint8_t** outBuf, size_t* outLen, uint8_t quality = 90,
+                        uint16_t cropSize = FACE_CROP_SIZE, uint16_t* aligned = nullptr) {
+    MetricTimer timer(M_ENCODE);
+    Rgb565Frame frame = {fb->buf, (uint16_t)fb->width, (uint16_t)fb->height};
+    JpegOut out = {};
+    bool ok = false;
+    if (aligned) *aligned = 0;
+    if (cropSize) {
+        // Mắt bên trái ảnh luôn là điểm có x nhỏ hơn
+        bool swap = f.leftEye.x > f.rightEye.x;
+        FaceEyes eyes = {
+            (float)(swap ? f.rightEye.x : f.leftEye.x), (float)(swap ? f.rightEye.y : f.leftEye.y),
+            (float)(swap ? f.leftEye.x : f.rightEye.x), (float)(swap ? f.leftEye.y : f.rightEye.y)
+        };
+        out.buf = imageAcquire(cropSize * cropSize / 2, &out.cap);
+        ok = out.buf && jpegEncodeAligned(frame, eyes, cropSize, quality, jpegOutWrite, &out);
+        if (ok && aligned) *aligned = cropSize;
     }
-
-    // Nén JPEG chất lượng 90 để gửi đi
-    bool ok = fmt2jpg(cropBuf, cropSize, w, h, PIXFORMAT_RGB565, 90, outBuf, outLen);
-    free(cropBuf); 
-    return ok;
+    if (!ok) {
+        // Không có landmark hợp lệ -> quay về cắt theo khung mặt
+        const int PAD = 30; // Lấy rộng ra chút để Python dễ align
+        int w = f.width + PAD * 2, h = f.height + PAD * 2;
+        out.len = 0;
+        if (!out.buf) out.buf = imageAcquire((size_t)w * h / 2, &out.cap);
+        ok = out.buf && jpegEncodeRoi(frame, f.x - PAD, f.y - PAD, w, h, quality, jpegOutWrite, &out);
+    }
+    if (!ok) {
+        imageFree(out.buf);
+        return false;
+    }
+    *outBuf = out.buf;
+    *outLen = out.len;
+    return true;
 }
 
 // =========================================================
 // 2. GIAO TIẾP SERVER
 // =========================================================
-String getIsoTime() {
-    DateTime now = rtc.now();
+String isoTime(const DateTime& t) {
     char buf[25];
-    sprintf(buf, "%04d-%02d-%02dT%02d:%02d:%02d", now.year(), now.month(), now.day(), now.hour(), now.minute(), now.second());
+    sprintf(buf, "%04d-%02d-%02dT%02d:%02d:%02d", t.year(), t.month(), t.day(), t.hour(), t.minute(), t.second());
     return String(buf);
 }
 
+String getIsoTime() {
+    return isoTime(rtc.now());
+}
+
 String getDateTimeString() {
     DateTime now = rtc.now();
     char buf[25];
@@ -320,92 +585,279 @@ String getDateTimeString() {
     return String(buf);
 }
 
-void saveOfflineData(uint8_t* jpgBuf, size_t jpgLen, String type, String extraData) {
+void saveOfflineData(uint8_t* jpgBuf, size_t jpgLen, String type, String extraData, uint16_t aligned = 0) {
     if (!SD_MMC.cardSize()) {
-        Serial.println("❌ [OFFLINE] Không tìm thấy thẻ SD!");
+        LOGE("❌ [OFFLINE] Không tìm thấy thẻ SD!");
         return;
     }
 
-    // 1. Tạo tên file ảnh dựa trên timestamp
-    String timestamp = getIsoTime();
-    // Thay thế ký tự đặc biệt để làm tên file (VD: 2023-10-25T10:00:00 -> 20231025_100000)
-    String safeTime = timestamp;
-    safeTime.replace("-", ""); safeTime.replace(":", ""); safeTime.replace("T", "_");
-    
-    String imgPath = "/off_" + safeTime + ".jpg";
-
-    // 2. Lưu ảnh JPEG
-    fs::File imgFile = SD_MMC.open(imgPath, FILE_WRITE);
-    if (imgFile) {
-        imgFile.write(jpgBuf, jpgLen);
-        imgFile.close();
-        Serial.printf("💾 [OFFLINE] Đã lưu ảnh: %s (%d bytes)\n", imgPath.c_str(), jpgLen);
-    } else {
-        Serial.println("❌ [OFFLINE] Lỗi ghi file ảnh!");
-        return;
-    }
-
-    // 3. Ghi metadata vào hàng đợi (queue.txt)
-    // Format: TYPE|TIMESTAMP|EXTRA_DATA|IMG_PATH
-    fs::File queueFile = SD_MMC.open("/queue.txt", FILE_APPEND);
-    if (queueFile) {
-        String line = type + "|" + timestamp + "|" + extraData + "|" + imgPath + "\n";
-        queueFile.print(line);
-        queueFile.close();
-        Serial.println("📝 [OFFLINE] Đã ghi vào hàng đợi.");
+    // 1 record = header (loại, giờ RTC, employee_id, cỡ căn mặt, CRC, độ dài) + JPEG, ghi nối vào journal
+    uint8_t jtype = (type == "enroll") ? JOURNAL_ENROLL : JOURNAL_RECOGNIZE;
+    uint32_t t0 = micros();
+    bool ok = gJournal.append(jtype, rtc.now().unixtime(), extraData.c_str(), jpgBuf, jpgLen, aligned);
+    metricRecord(M_SD_WRITE, micros() - t0);
+    if (ok) {
+        LOGI("💾 [OFFLINE] Đã ghi journal (%d bytes, %u bản ghi chờ gửi)", jpgLen, gJournal.pending());
     } else {
-        Serial.println("❌ [OFFLINE] Lỗi ghi file queue!");
+        LOGE("❌ [OFFLINE] Lỗi ghi journal!");
     }
 }
 
 
 void wsSendTxt(String msg) {
-    if (WiFi.status() == WL_CONNECTED) webSocket.sendTXT(msg);
+    if (WiFi.status() != WL_CONNECTED) return;
+    wsLock();
+    webSocket.sendTXT(msg);
+    wsUnlock();
 }
 
-// Gửi ảnh tổng quát (Dùng cho cả Enroll và Recognize)
-String sendImageToServer(uint8_t* jpgBuf, size_t jpgLen, String type, String extraData = "") {
-    unsigned long startNet = millis(); // Bắt đầu bấm giờ
-    if (WiFi.status() == WL_CONNECTED) {
-        HTTPClient http;
-        http.setTimeout(8000); // 8s timeout
-
-        String url = "http://" + String(server_ip_buffer) + ":" + String(server_port) + "/api/ai/" + type;
-        http.begin(url);
-        http.addHeader("Content-Type", "application/json");
+// Đọc phản hồi thẳng từ socket vào ServerReply (không getString): heap không đổi theo độ dài body.
+// Gọi trước gHttp.finish().
+ServerReply readServerReply(int httpCode) {
+    ServerReply reply;
+    serverReplyClear(reply);
+    reply.httpCode = httpCode;
+    if (httpCode <= 0) return reply;
+    uint32_t t0 = micros();
+    decodeServerReply(gHttp.body(), reply);
+    metricRecord(M_PARSE, micros() - t0);
+    if (reply.kind == REPLY_INVALID) LOGW("⚠️ [HTTP] Không đọc được phản hồi server (%d).", httpCode);
+    return reply;
+}
 
-        String b64 = base64::encode(jpgBuf, jpgLen);
-        String payload = "{\"image\":\"" + b64 + "\",\"timestamp\":\"" + getIsoTime() + "\"";
-        if (type == "enroll") payload += ",\"employee_id\":\"" + extraData + "\"";
-        payload += "}";
+ServerReply offlineReply() {
+    ServerReply reply;
+    serverReplyClear(reply, REPLY_OFFLINE);
+    return reply;
+}
 
-        int httpCode = http.POST(payload);
-        String res = (httpCode > 0) ? http.getString() : "error";
-        http.end();
+// Gửi ảnh tổng quát (Dùng cho cả Enroll và Recognize)
+ServerReply sendImageToServer(uint8_t* jpgBuf, size_t jpgLen, String type, String extraData = "", uint16_t aligned = 0) {
+    unsigned long startNet = millis(); // Bắt đầu bấm giờ
+    LinkParams link = linkNext();
+    if (WiFi.status() == WL_CONNECTED && !link.offlineFirst) {
+        // Timeout theo RTT đo được; kết nối TCP được giữ lại giữa các ảnh
+        String timestamp = getIsoTime();
+        int httpCode = gHttp.request("/api/ai/" + type, link.timeoutMs, [&](HTTPClient& http) {
+            return postImage(http, jpgBuf, jpgLen, nullptr, timestamp, false, type, extraData, aligned);
+        });
+        ServerReply res = readServerReply(httpCode);
+        gHttp.finish();
         unsigned long netDuration = millis() - startNet;
-        Serial.printf("⏱️ [LATENCY] Network Round-trip: %lu ms\n", netDuration);
+        LOGI("⏱️ [LATENCY] Network Round-trip: %lu ms", netDuration);
+        gHttp.printStats();
+        linkReport(netDuration, jpgLen, httpCode);
 
         // Nếu gửi thành công -> Trả về kết quả server
         if (httpCode > 0 && httpCode < 400) {
             return res;
         }
-        Serial.printf("⚠️ [HTTP] Gửi lỗi (Code: %d). Chuyển sang lưu ngoại tuyến.\n", httpCode);
+        LOGW("⚠️ [HTTP] Gửi lỗi (Code: %d). Chuyển sang lưu ngoại tuyến.", httpCode);
+    } else if (link.offlineFirst) {
+        LOGI("📴 [LINK] Mạng kém -> lưu ngoại tuyến ngay.");
     } else {
-        Serial.println("⚠️ [WIFI] Mất kết nối. Chuyển sang lưu ngoại tuyến.");
+        LOGW("⚠️ [WIFI] Mất kết nối. Chuyển sang lưu ngoại tuyến.");
     }
 
     // 2. Nếu mất mạng hoặc gửi lỗi -> Lưu Offline
     // Chỉ lưu nhận diện (recognize) hoặc enroll, không lưu linh tinh
-    saveOfflineData(jpgBuf, jpgLen, type, extraData);
+    saveOfflineData(jpgBuf, jpgLen, type, extraData, aligned);
     
-    return "offline_saved";
+    return offlineReply();
+}
+
+// Gửi cả burst (nhiều frame) trong 1 request tới /api/ai/recognize_batch -> nhận 1 quyết định
+ServerReply sendBurstToServer(uint8_t* const* jpgs, const size_t* lens, uint8_t count, uint16_t aligned) {
+    unsigned long startNet = millis();
+    LinkParams link = linkNext();
+    if (WiFi.status() == WL_CONNECTED && !link.offlineFirst) {
+        String timestamp = getIsoTime();
+        int httpCode = gHttp.request("/api/ai/recognize_batch", link.timeoutMs, [&](HTTPClient& http) {
+            int code;
+            if (gBinaryUpload) {
+                // Các JPEG nối liền, độ dài từng ảnh trong X-Image-Lengths
+                MultiBufferStream body;
+                String lengths = "";
+                for (uint8_t i = 0; i < count; i++) {
+                    body.add(jpgs[i], lens[i]);
+                    if (i) lengths += ",";
+                    lengths += String(lens[i]);
+                }
+                http.addHeader("Content-Type", "application/octet-stream");
+                http.addHeader("X-Timestamp", timestamp);
+                http.addHeader("X-Image-Lengths", lengths);
+                if (aligned) http.addHeader("X-Face-Aligned", String(aligned));
+                code = http.sendRequest("POST", &body, body.totalLength());
+            } else {
+                String tail = "\"],\"timestamp\":\"" + timestamp + "\"";
+                if (aligned) tail += ",\"aligned\":" + String(aligned);
+                Base64JsonStream body("{\"images\":[\"", tail + "}");
+                body.setSource(jpgs[0], lens[0]);
+                for (uint8_t i = 1; i < count; i++) body.addSource(jpgs[i], lens[i]);
+                http.addHeader("Content-Type", "application/json");
+                code = http.sendRequest("POST", &body, body.totalLength());
+            }
+            updateUploadMode(http, code);
+            return code;
+        });
+        ServerReply res = readServerReply(httpCode);
+        gHttp.finish();
+        unsigned long netDuration = millis() - startNet;
+        LOGI("⏱️ [LATENCY] Burst %d ảnh, Round-trip: %lu ms", count, netDuration);
+        gHttp.printStats();
+        size_t bytes = 0;
+        for (uint8_t i = 0; i < count; i++) bytes += lens[i];
+        linkReport(netDuration, bytes, httpCode);
+
+        if (httpCode > 0 && httpCode < 400) return res;
+        LOGW("⚠️ [HTTP] Gửi burst lỗi (Code: %d). Chuyển sang lưu ngoại tuyến.", httpCode);
+    } else if (link.offlineFirst) {
+        LOGI("📴 [LINK] Mạng kém -> lưu ngoại tuyến ngay.");
+    } else {
+        LOGW("⚠️ [WIFI] Mất kết nối. Chuyển sang lưu ngoại tuyến.");
+    }
+
+    // Offline chỉ cần 1 ảnh để server nhận diện khi đồng bộ
+    saveOfflineData(jpgs[0], lens[0], "recognize", "", aligned);
+    return offlineReply();
+}
+
+// Kết quả (hoặc hết giờ) của 1 request qua WebSocket, chạy trong NetworkTask
+void wsUplinkDone(const UploadJob& job, ServerReply& reply, bool ok, uint32_t rttMs, size_t bytes) {
+    LOGI("⏱️ [LATENCY] WS request %lu (%d ảnh): %lu ms", (unsigned long)job.id, job.count, (unsigned long)rttMs);
+    linkReport(rttMs, bytes, ok ? 200 : (reply.httpCode >= 400 ? reply.httpCode : -1));
+    if (ok) return;
+    // Như HTTP lỗi: lưu offline, burst chỉ cần 1 ảnh
+    saveOfflineData(job.jpg[0], job.len[0], job.type, job.count > 1 ? "" : job.extra, job.aligned);
+    serverReplyClear(reply, REPLY_OFFLINE);
+}
+
+// Hàm gửi của UploaderTask: burst nhiều frame hoặc 1 ảnh đơn.
+// Qua WebSocket thì trả REPLY_PENDING ngay, kết quả về sau qua wsUplinkDone.
+ServerReply sendUploadJob(const UploadJob& job) {
+    if (wsUplinkReady() && !linkOfflineFirst() &&
+        wsUplinkSend(job, rtc.now().unixtime(), linkParams().timeoutMs)) {
+        ServerReply pending;
+        serverReplyClear(pending, REPLY_PENDING);
+        return pending;
+    }
+    if (job.count > 1) return sendBurstToServer(job.jpg, job.len, job.count, job.aligned);
+    return sendImageToServer(job.jpg[0], job.len[0], job.type, job.extra, job.aligned);
+}
+
+static size_t galleryStreamRead(void* ctx, uint8_t* dst, size_t len) {
+    return ((Stream*)ctx)->readBytes((char*)dst, len);
+}
+
+struct GalleryStage {
+    const uint8_t* p;
+    size_t left;
+};
+
+static size_t galleryStageRead(void* ctx, uint8_t* dst, size_t len) {
+    GalleryStage* st = (GalleryStage*)ctx;
+    if (len > st->left) len = st->left;
+    memcpy(dst, st->p, len);
+    st->p += len;
+    st->left -= len;
+    return len;
+}
+
+// Kéo phần thay đổi của gallery từ server (delta theo version) và lưu lại vào thẻ SD.
+// Số nhân viên lệch với server (có người bị xoá) -> xin lại gói FULL.
+// Gói được tải hết vào vùng tạm PSRAM trước, không giữ galleryMutex: nhận diện offline
+// (CameraAppTask) không phải chờ mạng, khoá chỉ giữ lúc áp dụng từ RAM.
+void syncGallery() {
+    if (!gGallery.capacity()) return;
+
+    uint64_t since = (gGallery.size() == gGallery.serverTotal()) ? gGallery.version() : 0;
+    char path[80];
+    snprintf(path, sizeof(path), "/api/ai/gallery?since=%llu&dim=%u", since, FACE_EMBED_DIM);
+
+    unsigned long t0 = millis();
+    bool ok = false, changed = false;
+    int httpCode = gHttp.request(path, 15000, [](HTTPClient& http) {
+        http.addHeader("X-Device-Key", device_key_buffer);
+        return http.GET();
+    });
+    if (httpCode == 200) {
+        int size = gHttp.http().getSize();
+        uint8_t* stage = (size > 0 && size <= GALLERY_STAGE_MAX) ? (uint8_t*)ps_malloc(size) : nullptr;
+        uint64_t before;
+        if (stage) {
+            size_t got = gHttp.http().getStreamPtr()->readBytes((char*)stage, size);
+            GalleryStage st = {stage, got};
+            xSemaphoreTake(galleryMutex, portMAX_DELAY);
+            before = gGallery.version();
+            ok = got == (size_t)size && gGallery.apply(galleryStageRead, &st);
+        } else {
+            // Không rõ độ dài / quá lớn / hết PSRAM -> áp dụng thẳng từ stream (giữ khoá suốt lúc tải)
+            xSemaphoreTake(galleryMutex, portMAX_DELAY);
+            before = gGallery.version();
+            ok = gGallery.apply(galleryStreamRead, gHttp.http().getStreamPtr());
+        }
+        changed = ok && gGallery.version() != before;
+        if (!ok) gGallery.setVersion(0); // gói hỏng/đứt giữa chừng -> lần sau lấy FULL
+        xSemaphoreGive(galleryMutex);
+        free(stage);
+    }
+    gHttp.finish();
+
+    if (!ok) {
+        LOGW("⚠️ [GALLERY] Đồng bộ lỗi (Code: %d)", httpCode);
+        return;
+    }
+    LOGI("🗂️ [GALLERY] %u người (server: %u), %lu ms",
+         gGallery.size(), gGallery.serverTotal(), millis() - t0);
+    if (gGallery.dropped()) {
+        LOGW("⚠️ [GALLERY] Đầy! Bỏ qua %u người (GALLERY_CAPACITY=%d)", gGallery.dropped(), GALLERY_CAPACITY);
+    }
+    if (changed) {
+        xSemaphoreTake(galleryMutex, portMAX_DELAY);
+        if (!gGallery.save(GALLERY_PATH)) LOGE("❌ [GALLERY] Lỗi lưu gallery vào thẻ SD!");
+        xSemaphoreGive(galleryMutex);
+    }
+}
+
+// Gửi embedding do model trên kiosk tính lúc enroll -> server đưa vào gallery của mọi kiosk
+void uploadDeviceEmbedding() {
+    String body;
+    body.reserve(FACE_EMBED_DIM * 10 + 64);
+    body = "{\"employee_id\":\"" + String(gDeviceEmbId) + "\",\"embedding\":[";
+    for (int i = 0; i < FACE_EMBED_DIM; i++) {
+        if (i) body += ",";
+        body += String(gDeviceEmb[i], 5);
+    }
+    body += "]}";
+
+    int httpCode = gHttp.request("/api/ai/device_embedding", 8000, [&](HTTPClient& http) {
+        http.addHeader("Content-Type", "application/json");
+        http.addHeader("X-Device-Key", device_key_buffer);
+        return http.POST(body);
+    });
+    gHttp.finish();
+
+    if (httpCode == 200) {
+        LOGI("🧬 [GALLERY] Đã gửi embedding enroll của %s", gDeviceEmbId);
+        gDeviceEmbPending = false;
+        gGallerySyncDue = true;   // kéo ngay về gallery
+    } else {
+        LOGW("⚠️ [GALLERY] Gửi embedding lỗi (Code: %d), thử lại sau.", httpCode);
+    }
 }
 // =========================================================
 // 3. TASKS
 // =========================================================
 void webSocketEvent(WStype_t type, uint8_t * payload, size_t length) {
     switch(type) {
-        case WStype_DISCONNECTED: break;
+        case WStype_DISCONNECTED:
+            // Server mới sẽ báo lại "uplink" sau khi kết nối; request đang chờ -> lưu offline
+            wsUplinkSetSupported(false);
+            wsUplinkAbort();
+            break;
+        case WStype_BIN:
+            wsUplinkOnBinary(payload, length);
+            break;
         case WStype_CONNECTED: webSocket.sendTXT("role:device"); break;
         case WStype_TEXT:
             String text = (char*) payload;
@@ -436,17 +888,96 @@ void webSocketEvent(WStype_t type, uint8_t * payload, size_t length) {
                             // Phản hồi lại Web
                             webSocket.sendTXT("{\"type\":\"config_success\"}");
                             
-                            // Vẽ thông báo lên màn hình
-                            if (xSemaphoreTake(tftMutex, 100) == pdTRUE) {
-                                tft.fillScreen(TFT_BLACK);
-                                tft.setTextColor(TFT_GREEN, TFT_BLACK);
-                                tft.drawCentreString("CAP NHAT", tft.width()/2, 100, 4);
-                                tft.drawCentreString("THANH CONG", tft.width()/2, 140, 4);
-                                xSemaphoreGive(tftMutex);
-                                delay(2000);
-                            }
+                            // Vẽ thông báo lên màn hình (preview tạm dừng trong lúc giữ)
+                            UiScreen ui = uiScreen(TFT_BLACK, 2000, true);
+                            uiAddLine(ui, "CAP NHAT", TFT_GREEN, 100, 4);
+                            uiAddLine(ui, "THANH CONG", TFT_GREEN, 140, 4);
+                            uiShow(ui);
                         }
                     }
+                    // Chỉnh ngưỡng liveness tại máy; trường nào không gửi thì giữ nguyên
+                    else if (strcmp(cmdType, "config_liveness") == 0) {
+                        LivenessConfig c = gLiveCfg;
+                        c.motionMin  = doc["motion_min"]  | c.motionMin;
+                        c.motionMax  = doc["motion_max"]  | c.motionMax;
+                        c.microFloor = doc["micro_floor"] | c.microFloor;
+                        c.microRef   = doc["micro_ref"]   | c.microRef;
+                        c.geomRef    = doc["geom_ref"]    | c.geomRef;
+                        c.threshold  = doc["threshold"]   | c.threshold;
+                        c.minFrames  = doc["min_frames"]  | c.minFrames;
+                        portENTER_CRITICAL(&liveMux);
+                        gLiveCfg = c;
+                        gLiveCfgDirty = true;
+                        portEXIT_CRITICAL(&liveMux);
+                        saveLivenessConfig();
+                        LOGI("💾 [CONFIG] Liveness: motion %.0f..%.0f px, ngưỡng %.2f",
+                             gLiveCfg.motionMin, gLiveCfg.motionMax, gLiveCfg.threshold);
+                        webSocket.sendTXT("{\"type\":\"config_success\"}");
+                    }
+                    // Server báo nhận ảnh qua WebSocket (khung nhị phân uplink_frame.h)
+                    else if (strcmp(cmdType, "uplink") == 0) {
+                        wsUplinkSetSupported(WS_UPLINK_ENABLED && (doc["version"] | 0) == UPLINK_VERSION);
+                    }
+                    // Snapshot đo đạc: độ trễ từng tầng, stack/heap/PSRAM, hàng đợi
+                    else if (strcmp(cmdType, "get_metrics") == 0) {
+                        JsonDocument out;
+                        out["type"] = "metrics";
+                        metricsToJson(out);
+                        JsonObject q = out["queue"].to<JsonObject>();
+                        q["offline"] = gJournal.pending();
+                        q["upload"] = uploaderPending();
+                        PipelineStats ps = pipelineStats();
+                        JsonArray frames = out["frames"].to<JsonArray>();   // capture, render, detect
+                        for (int i = 0; i < STAGE_COUNT; i++) frames.add(ps.frames[i]);
+                        LogStats ls = loggerStats();
+                        JsonArray log = out["log"].to<JsonArray>();         // đã ghi, bị bỏ, ô ring cao nhất
+                        log.add(ls.written);
+                        log.add(ls.dropped);
+                        log.add(ls.highWater);
+                        ReplyPoolStats rs = serverReplyStats();
+                        JsonArray reply = out["reply"].to<JsonArray>();     // đã giải mã, lỗi, byte vùng nhớ cao nhất
+                        reply.add(rs.decoded);
+                        reply.add(rs.failed);
+                        reply.add(rs.peakBytes);
+                        portENTER_CRITICAL(&motionMux);
+                        MotionGateStats mg = gMotionStats;
+                        portEXIT_CRITICAL(&motionMux);
+                        JsonObject duty = out["duty"].to<JsonObject>();     // chế độ chờ / hoạt động
+                        duty["idle_ms"] = mg.idleMs;
+                        duty["active_ms"] = mg.activeMs;
+                        duty["active_pct"] = (mg.idleMs + mg.activeMs) ? 100.0f * mg.activeMs / (mg.idleMs + mg.activeMs) : 0.0f;
+                        duty["wakeups"] = mg.wakeups;
+                        duty["idle_frames"] = mg.idleFrames;
+                        duty["active_frames"] = mg.activeFrames;
+                        JsonObject recog = out["offline_recog"].to<JsonObject>();   // nhận diện offline bằng gallery
+                        recog["model"] = faceEmbedHasModel();
+                        recog["ready"] = gLocalRecogReady;
+                        recog["gallery"] = gGallery.size();
+                        bootToJson(out["boot"].to<JsonObject>());          // [bắt đầu, xong] ms từng pha khởi động
+                        WsUplinkStats ws = wsUplinkStats();
+                        JsonArray wsArr = out["ws"].to<JsonArray>();        // đã gửi, có kết quả, hết giờ, đang bay cao nhất, server lỗi
+                        wsArr.add(ws.sent);
+                        wsArr.add(ws.replied);
+                        wsArr.add(ws.timeouts);
+                        wsArr.add(ws.maxInFlight);
+                        wsArr.add(ws.failed);
+                        BufferPoolStats ip = gImagePool.stats();
+                        BufferPoolStats up = gUplinkPool.stats();
+                        JsonObject pool = out["pool"].to<JsonObject>();     // vùng nhớ ảnh cố định
+                        JsonArray img = pool["image"].to<JsonArray>();      // đang dùng, cao nhất, số block, hết block
+                        img.add(ip.inUse);
+                        img.add(ip.highWater);
+                        img.add(ip.blocks);
+                        img.add(ip.exhausted);
+                        JsonArray upl = pool["uplink"].to<JsonArray>();     // đang dùng, cao nhất, không vừa -> HTTP
+                        upl.add(up.inUse);
+                        upl.add(up.highWater);
+                        upl.add(ws.noBuffer);
+                        pool["spills"] = imageSpills();                     // ảnh phải lấy heap
+                        String msg;
+                        serializeJson(out, msg);
+                        webSocket.sendTXT(msg);
+                    }
                 }
             }
             break;
@@ -455,24 +986,38 @@ void webSocketEvent(WStype_t type, uint8_t * payload, size_t length) {
 
 void NetworkTask(void *pvParameters) {
     static unsigned long lastSyncTime = 0;
+    static bool syncDraining = false;
+    static unsigned long lastGallerySync = 0;
+    static unsigned long lastEmbUpload = 0;
     static unsigned long lastSleepCheck = 0;
     static bool lastWorkingState = true;
     for (;;) {
+        wsLock();
         webSocket.loop();
+        wsUnlock();
+        wsUplinkPoll();
         
         if (WiFi.status() != WL_CONNECTED) {
-            Serial.println("⚠️ WiFi Lost. Reconnecting...");
+            LOGW("⚠️ WiFi Lost. Reconnecting...");
             WiFi.reconnect();
             vTaskDelay(pdMS_TO_TICKS(5000));
         } else {
-            // Nếu có mạng -> Kiểm tra và đồng bộ mỗi 30 giây
-            if (millis() - lastSyncTime > 30000) {
-                if (!gEnrollingInProgress && xSemaphoreTake(camMutex, (TickType_t)100) == pdTRUE) {
-                    syncOfflineData();
-                    xSemaphoreGive(camMutex);
-                }
+            // Nếu có mạng -> Kiểm tra mỗi 30 giây; đang xả hàng đợi thì gửi batch liên tục.
+            // Journal tự khoá bên trong nên camera vẫn chạy khi đồng bộ.
+            if (millis() - lastSyncTime > (syncDraining ? SYNC_BATCH_GAP_MS : SYNC_IDLE_MS)) {
+                syncDraining = !gEnrollingInProgress && syncOfflineData();
                 lastSyncTime = millis();
             }
+
+            if (gDeviceEmbPending && millis() - lastEmbUpload > 5000) {
+                uploadDeviceEmbedding();
+                lastEmbUpload = millis();
+            }
+            if (gGallerySyncDue || millis() - lastGallerySync > GALLERY_SYNC_INTERVAL) {
+                syncGallery();
+                gGallerySyncDue = false;
+                lastGallerySync = millis();
+            }
         }
 
         if (millis() - lastSleepCheck > 60000) { 
@@ -482,14 +1027,11 @@ void NetworkTask(void *pvParameters) {
             gSystemIsWorking = isWorking;
             if (isWorking && !lastWorkingState) {
                 // VỪA MỚI VÀO GIỜ LÀM (Chuyển từ Nghỉ -> Làm)
-                Serial.println("🔔 Đã vào khung giờ làm việc! Bật màn hình...");
-                if (xSemaphoreTake(tftMutex, (TickType_t)200) == pdTRUE) {
-                    // Vẽ lại màn hình chào mừng hoặc clear đen để CameraTask vẽ đè lên
-                    tft.fillScreen(TFT_BLACK);
-                    tft.setTextColor(TFT_GREEN, TFT_BLACK);
-                    tft.drawCentreString("SYSTEM READY", tft.width()/2, 120, 4);
-                    xSemaphoreGive(tftMutex);
-                }
+                LOGI("🔔 Đã vào khung giờ làm việc! Bật màn hình...");
+                // Vẽ lại màn hình chào mừng, hết giờ giữ thì preview vẽ đè lên
+                UiScreen ui = uiScreen(TFT_BLACK, 1000, true);
+                uiAddLine(ui, "SYSTEM READY", TFT_GREEN, 120, 4);
+                uiShow(ui);
             }
             if (!isWorking) {
                 // Nếu đang không enroll và không giữ nút -> NGỦ
@@ -498,7 +1040,7 @@ void NetworkTask(void *pvParameters) {
                         enterDeepSleep(sleepSecs); // Hàm này sẽ reset ESP khi dậy
                     }
                     else if (millis() < 60000) {
-                        Serial.println("⏳ Vừa khởi động, bỏ qua chế độ ngủ để chờ kết nối...");
+                        LOGI("⏳ Vừa khởi động, bỏ qua chế độ ngủ để chờ kết nối...");
                     }
                 }
             }
@@ -524,329 +1066,783 @@ void TimeSyncTask(void *pvParameters) {
 }
 
 
-const char* enrollSteps[] = {
+#define ENROLL_STEPS 5
+const char* enrollSteps[ENROLL_STEPS] = {
     "1. NHIN THANG",
     "2. QUAY TRAI NHE",
     "3. QUAY PHAI NHE",
     "4. NGUNG DAU LEN",
     "5. CUI DAU XUONG"
 };
-// --- TASK CHÍNH: CAMERA & LOGIC ---
-void CameraAppTask(void *pvParameters) {    
-    for (;;) {
-        if (!gSystemIsWorking && !gEnrollingInProgress) {
-            vTaskDelay(1000);
-            continue;
+// Tư thế đầu cần đạt ở từng bước (kiểm tra bằng landmark trước khi chụp, xem head_pose.h)
+const PoseTarget enrollPoses[ENROLL_STEPS] = { POSE_FRONT, POSE_LEFT, POSE_RIGHT, POSE_UP, POSE_DOWN };
+// =========================================================
+// 4. HIỂN THỊ KẾT QUẢ & BURST (KHÔNG CHẶN)
+// =========================================================
+// Màn hình kết quả được RenderTask giữ (uiShow + holdMs) thay cho vTaskDelay, vòng lặp camera vẫn chạy.
+// Mọi thao tác vẽ đi qua renderer: uiShow() cho màn hình trạng thái, uiSetOverlay() cho lớp phủ preview.
+
+// Khung mặt đã cắt theo biên frame (toạ độ âm / tràn phải-dưới)
+void overlayBox(PreviewOverlay& ov, const camera_fb_t* fb, const face_t& f, uint16_t color) {
+    int bX = f.x; int bY = f.y; int bW = f.width; int bH = f.height;
+    if (bX < 0) { bW += bX; bX = 0; }
+    if (bY < 0) { bH += bY; bY = 0; }
+    if (bX + bW > fb->width)  bW = fb->width - bX;
+    if (bY + bH > fb->height) bH = fb->height - bY;
+    if (bW <= 0 || bH <= 0) return;
+    ov.boxX = bX; ov.boxY = bY; ov.boxW = bW; ov.boxH = bH;
+    ov.boxColor = color;
+}
+
+// Detect trên 1 frame của pipeline (detector của eloquent đọc camera.frame)
+bool detectFace(Frame* frame) {
+    uint32_t t0 = micros();
+    camera.frame = &frame->fb;
+    bool found = detection.run().isOk();
+    camera.frame = nullptr;
+    metricRecord(M_DETECT, micros() - t0);
+    pipelineDetectDone(frame);
+    return found;
+}
+
+// Detect-then-track cho luồng nhận diện: detector chạy mỗi TrackerConfig::detectEvery frame
+// hoặc khi mất dấu, các frame giữa bám mặt bằng template (rẻ hơn nhiều so với detect).
+FaceTracker gTracker;
+face_t gTrackFace;       // kết quả detect gần nhất của track chính, landmark dời theo track
+bool faceArmed = false;  // mặt đã đủ điều kiện chụp, chờ frame có detect để bắt đầu
+
+// Tìm mặt trên frame. fresh = true khi f lấy từ detector ngay trên frame này (landmark chính xác);
+// false khi chỉ dời theo tracker (khung và landmark xấp xỉ, score là của lần detect trước).
+bool locateFace(Frame* frame, bool forceDetect, face_t& f, bool& fresh, uint32_t& trackId) {
+    Rgb565Frame img = {frame->fb.buf, (uint16_t)frame->fb.width, (uint16_t)frame->fb.height};
+    fresh = forceDetect || gTracker.needsDetection();
+    if (fresh) {
+        if (!detectFace(frame)) {
+            gTracker.correct(img, nullptr, nullptr, 0);
+            return false;
         }
-        if (gEnrollingInProgress) {
-            Serial.println("--- ENROLL MODE STARTED ---");
-            xSemaphoreTake(tftMutex, portMAX_DELAY);
-            tft.fillScreen(TFT_BLACK);
-            tft.setTextColor(TFT_CYAN, TFT_BLACK);
-            tft.drawCentreString("CHE DO DANG KY", tft.width()/2, 10, 4); 
-            tft.setTextColor(TFT_WHITE, TFT_BLACK);
-            tft.drawCentreString("Chuan bi...", tft.width()/2, 50, 2);
-            tft.setTextColor(TFT_YELLOW, TFT_BLACK);
-            tft.drawCentreString("NHIN THANG CAMERA", tft.width()/2, 110, 2);
-
-            xSemaphoreGive(tftMutex);
-            vTaskDelay(3000);
-
-            int currentStep = 0;
-            
-            while (currentStep < 5) {
-                // 1. Chụp ảnh Preview
-                xSemaphoreTake(camMutex, portMAX_DELAY);
-                if (!camera.capture().isOk()) { 
-                    xSemaphoreGive(camMutex); 
-                    Serial.println("❌ [ENROLL] Capture Failed!");
-                    vTaskDelay(50); continue; 
-                }
-                camera_fb_t* fb = camera.frame;
-                xSemaphoreGive(camMutex);
+        gTrackFace = detection.first;
+        TrackBox box = {(int16_t)gTrackFace.x, (int16_t)gTrackFace.y,
+                        (int16_t)gTrackFace.width, (int16_t)gTrackFace.height};
+        float score = gTrackFace.score;
+        gTracker.correct(img, &box, &score, 1);
+    } else {
+        uint32_t t0 = micros();
+        gTracker.track(img);
+        metricRecord(M_TRACK, micros() - t0);
+        pipelineDetectDone(frame);
+    }
 
-                int xPos = (tft.width() - fb->width) / 2;
-                
-                // 2. Hiển thị Preview
-                xSemaphoreTake(tftMutex, portMAX_DELAY);
-                tft.pushImage(xPos, 0, fb->width, fb->height, (uint16_t*)fb->buf); 
-                tft.setTextColor(TFT_YELLOW, TFT_BLACK); 
-                tft.drawString(enrollSteps[currentStep], 5, 10, 4);
-                xSemaphoreGive(tftMutex);
-
-                // 3. Detect & Kiểm tra khoảng cách
-                if (detection.run().isOk()) {
-                    face_t f = detection.first;
-
-                    // [LOGIC MỚI] KIỂM TRA KHOẢNG CÁCH CHO ENROLL
-                    if (f.width < 55) {
-                        xSemaphoreTake(tftMutex, portMAX_DELAY);
-                        tft.setTextColor(TFT_ORANGE, TFT_BLACK); // Màu cam cảnh báo
-                        tft.drawCentreString("LAI GAN HON", tft.width()/2, 195, 4);
-                        xSemaphoreGive(tftMutex);
-                    }
-                    else if (f.width > 110) {
-                        xSemaphoreTake(tftMutex, portMAX_DELAY);
-                        tft.setTextColor(TFT_ORANGE, TFT_BLACK);
-                        tft.drawCentreString("XA RA CHUT", tft.width()/2, 195, 4);
-                        xSemaphoreGive(tftMutex);
-                    }
-                    else {
-                        if (f.score > 0.85) {
-                            xSemaphoreTake(tftMutex, portMAX_DELAY);
-                            // Vẽ khung xanh xác nhận
-                            tft.drawRect(xPos + f.x, f.y, f.width, f.height, TFT_GREEN);
-                            xSemaphoreGive(tftMutex);
-
-                            // Chờ 1 chút cho người dùng ổn định tư thế
-                            vTaskDelay(1000); 
-
-                            // Chụp ảnh thật để gửi
-                            xSemaphoreTake(camMutex, portMAX_DELAY); 
-                            camera.capture(); 
-                            fb = camera.frame; 
-                            xSemaphoreGive(camMutex);
-
-                            uint8_t* faceBuf = nullptr; size_t faceLen = 0;
-                            if(cropFaceFromRGB565(fb, f, &faceBuf, &faceLen)) {
-                                xSemaphoreTake(tftMutex, portMAX_DELAY);
-                                Serial.printf("📤 [ENROLL] Đang gửi ảnh %d (%d bytes)...\n", currentStep+1, faceLen);
-                                tft.fillCircle(tft.width()-20, 20, 8, TFT_BLUE); 
-                                xSemaphoreGive(tftMutex);
-
-                                String res = sendImageToServer(faceBuf, faceLen, "enroll", gEnrollName);
-                                free(faceBuf);
-                                
-                                if (res.indexOf("collecting") > 0 || res.indexOf("success") > 0) {
-                                    Serial.printf("✅ [ENROLL] Hoàn thành bước %d!\n", currentStep+1);
-                                    
-                                    xSemaphoreTake(tftMutex, portMAX_DELAY);
-                                    tft.fillScreen(TFT_GREEN);
-                                    tft.setTextColor(TFT_BLACK, TFT_GREEN);
-                                    String doneMsg = "XONG BUOC " + String(currentStep + 1);
-                                    tft.drawCentreString(doneMsg, tft.width()/2, 100, 4);
-                                    
-                                    // Nhắc chuyển sang bước sau
-                                    if (currentStep < 4) {
-                                       tft.drawCentreString("Tiep tuc...", tft.width()/2, 140, 2);
-                                    }
-                                    xSemaphoreGive(tftMutex);
-                                    vTaskDelay(2000);
-                                    
-                                    xSemaphoreTake(tftMutex, portMAX_DELAY);
-                                    tft.fillScreen(TFT_BLACK);
-                                    xSemaphoreGive(tftMutex);
-                                    currentStep++;
-                                }
-                                else{
-                                    Serial.printf("⚠️ [ENROLL] Server từ chối bước %d. Thử lại.\n", currentStep+1);
-                                    // Hiện thông báo lỗi nếu cần
-                                }
-                            }
-                        }
-                    }
-                }
-                vTaskDelay(100);
+    const Track* t = gTracker.primary();
+    if (!t) return false;
+    if (!fresh) {
+        int dx = t->box.x - gTrackFace.x, dy = t->box.y - gTrackFace.y;
+        gTrackFace.x += dx;            gTrackFace.y += dy;
+        gTrackFace.leftEye.x += dx;    gTrackFace.leftEye.y += dy;
+        gTrackFace.rightEye.x += dx;   gTrackFace.rightEye.y += dy;
+        gTrackFace.nose.x += dx;       gTrackFace.nose.y += dy;
+        gTrackFace.leftMouth.x += dx;  gTrackFace.leftMouth.y += dy;
+        gTrackFace.rightMouth.x += dx; gTrackFace.rightMouth.y += dy;
+    }
+    f = gTrackFace;
+    trackId = t->id;
+    return true;
+}
+
+PoseLandmarks poseLandmarks(const face_t& f) {
+    return {
+        (float)f.leftEye.x, (float)f.leftEye.y, (float)f.rightEye.x, (float)f.rightEye.y,
+        (float)f.nose.x, (float)f.nose.y,
+        (float)f.leftMouth.x, (float)f.leftMouth.y, (float)f.rightMouth.x, (float)f.rightMouth.y
+    };
+}
+
+LiveLandmarks faceLandmarks(const face_t& f) {
+    return {
+        (float)f.leftEye.x, (float)f.leftEye.y, (float)f.rightEye.x, (float)f.rightEye.y,
+        (float)f.nose.x, (float)f.nose.y
+    };
+}
+
+// Thêm frame vào lịch sử liveness của track. Landmark chỉ dùng khi frame có detect.
+LivenessResult checkLiveness(Frame* frame, const face_t& f, bool fresh, uint32_t trackId) {
+    MetricTimer timer(M_LIVENESS);
+    if (gLiveCfgDirty) {
+        portENTER_CRITICAL(&liveMux);
+        gLiveness.setConfig(gLiveCfg);
+        gLiveCfgDirty = false;
+        portEXIT_CRITICAL(&liveMux);
+    }
+    Rgb565Frame img = {frame->fb.buf, (uint16_t)frame->fb.width, (uint16_t)frame->fb.height};
+    TrackBox box = {(int16_t)f.x, (int16_t)f.y, (int16_t)f.width, (int16_t)f.height};
+    LiveLandmarks lm = faceLandmarks(f);
+    return gLiveness.update(trackId, img, box, fresh ? &lm : nullptr);
+}
+
+// Burst: chấm điểm chất lượng BURST_CANDIDATES frame liên tiếp (frame_quality.h), chỉ cắt + nén
+// các frame lọt top, rồi gửi burst.target frame tốt nhất trong 1 request (1 RTT / lượt chấm công).
+// target (<= BURST_FRAMES) do gLink chọn lúc bắt đầu burst, mạng chậm thì gửi ít frame hơn.
+#define BURST_FRAMES         3
+#define BURST_CANDIDATES     5
+#define BURST_FRAME_INTERVAL 100     // ms giữa 2 frame, để server còn đo được biến thiên (liveness)
+#define BURST_MIN_QUALITY    0.3f    // frame tốt nhất vẫn dưới mức này -> không gửi, chụp lại sau
+#define BURST_RESULT_TIMEOUT 12000
+struct BurstState {
+    bool active;
+    uint8_t candidates;              // số frame đã chấm điểm
+    uint8_t frames;                  // số frame đã cắt + nén (đang giữ)
+    uint8_t target;                  // số frame gửi đi (<= BURST_FRAMES)
+    float score[BURST_FRAMES];
+    uint8_t seq[BURST_FRAMES];       // thứ tự chụp (số ứng viên) của frame ở từng ô
+    uint8_t quality;                 // chất lượng JPEG và cỡ ảnh mặt giữ cố định trong 1 burst
+    uint16_t cropSize;
+    uint16_t aligned;                // 0 nếu có frame phải cắt theo khung mặt
+    uint8_t* jpg[BURST_FRAMES];
+    size_t len[BURST_FRAMES];
+    unsigned long lastFrameAt;
+    uint32_t awaitingId;             // 0 = chưa gửi / không chờ kết quả
+    unsigned long sentAt;
+    unsigned long startedAt;         // lúc bắt đầu burst, để đo cả lượt chấm công
+};
+BurstState burst = {};
+
+void endBurst() {
+    // Frame chưa gửi vẫn thuộc về CameraAppTask
+    if (!burst.awaitingId) {
+        for (uint8_t i = 0; i < burst.frames; i++) imageFree(burst.jpg[i]);
+    }
+    burst = {};
+}
+
+// Cắt + nén mặt rồi đưa vào hàng đợi upload. Trả về id job (0 nếu lỗi hoặc hàng đợi đầy)
+uint32_t submitFace(camera_fb_t* fb, face_t f, const char* type, const char* extra) {
+    uint8_t* faceBuf = nullptr; size_t faceLen = 0;
+    uint16_t aligned = 0;
+    LinkParams link = linkParams();
+    if (!cropFaceFromRGB565(fb, f, &faceBuf, &faceLen, link.quality, link.cropSize, &aligned)) return 0;
+    uint32_t id = uploaderSubmit(&faceBuf, &faceLen, 1, type, extra, UPLOAD_REJECT_NEW, aligned);
+    if (!id) {
+        imageFree(faceBuf);
+        LOGW("⚠️ [UPLOAD] Hàng đợi đầy -> bỏ ảnh, thử lại ở frame sau.");
+    }
+    return id;
+}
+
+// Bắt đầu burst mới với tham số nén/số frame hiện tại của gLink
+void startBurst() {
+    LinkParams link = linkParams();
+    burst.active = true;
+    burst.startedAt = millis();
+    burst.target = link.burst < BURST_FRAMES ? link.burst : BURST_FRAMES;
+    burst.quality = link.quality;
+    burst.cropSize = link.cropSize;
+    burst.aligned = link.cropSize;
+    LOGI("🚀 Bắt đầu burst: chấm %d frame, gửi %d frame tốt nhất (Q%u)...",
+         BURST_CANDIDATES, burst.target, burst.quality);
+}
+
+FaceQuality faceQuality(camera_fb_t* fb, const face_t& f) {
+    MetricTimer timer(M_QUALITY);
+    Rgb565Frame img = {fb->buf, (uint16_t)fb->width, (uint16_t)fb->height};
+    TrackBox box = {(int16_t)f.x, (int16_t)f.y, (int16_t)f.width, (int16_t)f.height};
+    LiveLandmarks lm = faceLandmarks(f);
+    return scoreFaceQuality(img, box, &lm);
+}
+
+// Frame thay vào ô của frame kém nhất làm lệch thứ tự -> xếp lại theo lúc chụp trước khi gửi:
+// server (liveness, chọn ảnh) đọc các ảnh trong burst như một chuỗi theo thời gian.
+void sortBurstByCapture() {
+    for (uint8_t i = 1; i < burst.frames; i++) {
+        for (uint8_t j = i; j > 0 && burst.seq[j - 1] > burst.seq[j]; j--) {
+            std::swap(burst.jpg[j - 1], burst.jpg[j]);
+            std::swap(burst.len[j - 1], burst.len[j]);
+            std::swap(burst.score[j - 1], burst.score[j]);
+            std::swap(burst.seq[j - 1], burst.seq[j]);
+        }
+    }
+}
+
+// Chấm điểm 1 frame ứng viên; frame lọt top burst.target mới được cắt + nén (thay frame kém nhất).
+// Đủ BURST_CANDIDATES frame thì đưa cả lô vào hàng đợi upload.
+void collectBurstFrame(camera_fb_t* fb, face_t f) {
+    if (burst.candidates < BURST_CANDIDATES) {
+        if (millis() - burst.lastFrameAt < BURST_FRAME_INTERVAL) return;
+        burst.lastFrameAt = millis();
+        burst.candidates++;
+
+        FaceQuality q = faceQuality(fb, f);
+        int slot = -1;
+        if (burst.frames < burst.target) {
+            slot = burst.frames;
+        } else {
+            int worst = 0;
+            for (uint8_t i = 1; i < burst.frames; i++) if (burst.score[i] < burst.score[worst]) worst = i;
+            if (q.score > burst.score[worst]) slot = worst;
+        }
+        LOGD("📸 Ứng viên %d/%d: nét %.0f | sáng %.0f | yaw %.2f -> %.2f%s",
+             burst.candidates, BURST_CANDIDATES, q.sharpness, q.brightness, q.yaw, q.score,
+             slot < 0 ? " (bỏ)" : "");
+        if (slot >= 0) {
+            uint8_t* jpg = nullptr; size_t len = 0;
+            uint16_t aligned = 0;
+            if (cropFaceFromRGB565(fb, f, &jpg, &len, burst.quality, burst.cropSize, &aligned)) {
+                if (slot < burst.frames) imageFree(burst.jpg[slot]);
+                else burst.frames++;
+                burst.jpg[slot] = jpg;
+                burst.len[slot] = len;
+                burst.score[slot] = q.score;
+                burst.seq[slot] = burst.candidates;
+                if (aligned != burst.cropSize) burst.aligned = 0;
             }
-            Serial.println("🎉 --- ENROLL FINISHED ---");
-            gEnrollingInProgress = false;
-            wsSendTxt("enroll_done");
-            
-            xSemaphoreTake(tftMutex, portMAX_DELAY);
-            tft.fillScreen(TFT_BLUE);
-            tft.setTextColor(TFT_WHITE, TFT_BLUE);
-            tft.drawCentreString("HOAN TAT!", tft.width()/2, 100, 4);
-            xSemaphoreGive(tftMutex);
-            vTaskDelay(3000);
+        }
+    }
+    if (burst.candidates == BURST_CANDIDATES) {
+        float best = 0;
+        for (uint8_t i = 0; i < burst.frames; i++) if (burst.score[i] > best) best = burst.score[i];
+        if (burst.frames == 0 || best < BURST_MIN_QUALITY) {
+            // Mờ / ngược sáng / quay mặt: không tốn 1 lượt server, chụp lại ở lượt sau
+            LOGW("⚠️ Ảnh kém (tốt nhất %.2f) -> Hủy Burst, không gửi.", best);
+            lastCaptureTime = millis();
+            endBurst();
+            return;
+        }
+        if (burst.frames < burst.target) burst.target = burst.frames;
+        sortBurstByCapture();
+        // Hàng đợi đầy -> giữ nguyên các frame, thử lại ở vòng sau
+        uint32_t id = uploaderSubmit(burst.jpg, burst.len, burst.target, "recognize", "", UPLOAD_REJECT_NEW,
+                                     burst.aligned);
+        if (id) {
+            burst.awaitingId = id;
+            burst.sentAt = millis();
+            LOGI("📡 Gửi burst %d ảnh trong 1 request...", burst.target);
+        }
+    }
+}
 
-            xSemaphoreTake(tftMutex, portMAX_DELAY);
-            tft.fillScreen(TFT_BLACK); 
-            xSemaphoreGive(tftMutex);
+void handleRecognizeResult(const UploadResult& r) {
+    if (!burst.active || r.id != burst.awaitingId) return; // kết quả của burst đã huỷ
+    const ServerReply& res = r.reply;
+    LOGI("⏱️ [LATENCY] Burst: %lu ms (hàng đợi + mạng)", r.latencyMs);
+    metricRecord(M_CHECKIN, (millis() - burst.startedAt) * 1000);
+
+    if (r.offline) {
+        UiScreen ui = uiBanner(1000, false);
+        uiAddLine(ui, "DA LUU OFFLINE", TFT_ORANGE, 200, 2, 120);
+        uiShow(ui);
+        endBurst();
+    }
+    else if (res.kind == REPLY_MATCH) {
+        LOGI("✅ MATCHED: %s (%s)", res.name, res.employeeId);
 
-            continue;
+        UiScreen ui = uiScreen(TFT_GREEN, 2000, true);
+        uiAddLine(ui, "XIN CHAO", TFT_BLACK, 100, 2);
+        uiAddLine(ui, res.name, TFT_BLACK, 130, 4);
+        uiShow(ui);
+
+        lastCaptureTime = millis();
+        endBurst();
+    }
+    else if (res.kind == REPLY_NO_MATCH) {
+        LOGI("❌ NGUOI LA (%s) %s", res.name, res.message);
+        UiScreen ui = uiBanner(1000, true);
+        uiAddLine(ui, "NGUOI LA", TFT_RED, 200, 2);
+        uiShow(ui);
+
+        lastCaptureTime = millis();
+        endBurst();
+    }
+    else {
+        endBurst();
+    }
+}
+
+// Mất mạng: nhận diện ngay tại kiosk bằng gallery, chỉ lưu quyết định + 1 thumbnail nhỏ.
+// false nếu không có model/gallery hoặc không đủ chắc chắn -> đi đường burst như cũ (lưu offline).
+bool recognizeLocally(camera_fb_t* fb, face_t f) {
+    if (!gLocalRecogReady || gGallery.size() == 0) return false;
+
+    unsigned long t0 = millis();
+    if (!faceEmbed(fb, f, gEmbQuery)) return false;
+    xSemaphoreTake(galleryMutex, portMAX_DELAY);
+    GalleryMatch m = gGallery.match(gEmbQuery);
+    String id = (m.index >= 0) ? gGallery.idAt(m.index) : "";
+    String name = (m.index >= 0) ? gGallery.nameAt(m.index) : "";
+    xSemaphoreGive(galleryMutex);
+    LOGI("🧠 [LOCAL] %s | Score: %.3f | %lu ms (%u người)",
+         id.c_str(), m.score, millis() - t0, gGallery.size());
+    if (m.index < 0 || m.score < GALLERY_MATCH_THRESHOLD) return false;
+
+    // Server vẫn nhận diện lại ảnh này khi đồng bộ; employee_id chỉ để đối chiếu
+    uint8_t* thumb = nullptr; size_t thumbLen = 0;
+    if (cropFaceFromRGB565(fb, f, &thumb, &thumbLen, THUMB_QUALITY)) {
+        saveOfflineData(thumb, thumbLen, "recognize", id);
+        imageFree(thumb);
+    }
+
+    UiScreen ui = uiScreen(TFT_GREEN, 2000, true);
+    uiAddLine(ui, "XIN CHAO", TFT_BLACK, 100, 2);
+    uiAddLine(ui, name, TFT_BLACK, 130, 4);
+    uiAddLine(ui, "(OFFLINE)", TFT_BLACK, 170, 2);
+    uiShow(ui);
+    metricRecord(M_CHECKIN, (millis() - t0) * 1000);
+    return true;
+}
+
+// Cổng chuyển động cho frame mới. false: đang ở chế độ chờ, frame chỉ dùng để so chuyển động.
+bool motionGateAllows(Frame* frame) {
+    Rgb565Frame img = {frame->fb.buf, (uint16_t)frame->fb.width, (uint16_t)frame->fb.height};
+    uint32_t now = millis();
+    if (burst.active) gMotion.hold(now);
+    MotionTier before = gMotion.tier();
+    MotionTier tier;
+    {
+        MetricTimer timer(M_MOTION);
+        tier = gMotion.update(img, now);
+    }
+    portENTER_CRITICAL(&motionMux);
+    gMotionStats = gMotion.stats();
+    portEXIT_CRITICAL(&motionMux);
+
+    if (tier != before) {
+        pipelineSetIdle(tier == MOTION_IDLE);
+        if (tier == MOTION_IDLE) {
+            LOGI("💤 [MOTION] Không có ai trước máy -> chế độ chờ.");
+            gTracker.reset();
+            faceArmed = false;
+        } else {
+            LOGI("👀 [MOTION] Có chuyển động (sai khác %.0f) -> chạy nhận diện.", gMotionStats.lastScore);
         }
+    }
+    return tier == MOTION_ACTIVE;
+}
 
-        camera_fb_t* fb = nullptr;
-        xSemaphoreTake(camMutex, portMAX_DELAY);
-        if (camera.capture().isOk()) fb = camera.frame;
-        xSemaphoreGive(camMutex);
-        if (!fb) { vTaskDelay(30); continue; }
+// --- ENROLL NHIỀU TƯ THẾ, UPLOAD NỀN ---
+// Mỗi ảnh tư thế đạt yêu cầu được xếp hàng upload (uploader / ws_uplink) và người dùng chuyển
+// ngay sang tư thế kế tiếp; kết quả server về bất đồng bộ, ghép theo upload id.
+// Ảnh không gửi được (mất WiFi, hết giờ) đã được sendUploadJob / wsUplinkDone ghi vào journal
+// offline -> coi như đã lưu, journal tự gửi lên server khi có mạng.
+// Server chỉ gom ảnh ("collecting") rồi kết luận một lần cho cả bộ khi đủ ENROLL_STEPS ảnh,
+// nên không biết được tư thế nào hỏng: có ảnh lỗi hoặc không nhận được kết luận thì báo server
+// bỏ phiên (enroll_reset) và chụp lại cả bộ. Chỉ báo HOAN TAT khi server trả thành công.
+#define ENROLL_SETTLE_MS       400      // giữ yên trước khi chụp
+#define ENROLL_RESULT_TIMEOUT  30000    // chờ kết quả tối đa (uploader luôn trả kết quả, đây chỉ là chốt an toàn)
+#define ENROLL_MAX_ROUNDS      3        // số lượt chụp lại tối đa
+#define ENROLL_POSE_HOLD       2        // số frame detect liên tiếp đúng tư thế trước khi chụp
+#define ENROLL_POSE_MIRRORED   0        // 1 nếu camera đặt set_hmirror (ảnh kiểu gương)
+
+enum PoseState : uint8_t { POSE_TODO, POSE_SENT, POSE_COLLECTED, POSE_SAVED, POSE_FAILED };
+enum EnrollOutcome : uint8_t { ENROLL_OK, ENROLL_PENDING_SYNC, ENROLL_FAILED };
+
+struct EnrollPose {
+    PoseState state;
+    uint32_t uploadId;
+    bool embOk;            // đã có embedding tại kiosk trong gEnrollPoseEmb
+};
 
-        int xPos = (tft.width() - fb->width) / 2;
+// Ghép kết quả upload vào tư thế; verdictOk = server đã kết luận thành công cho cả bộ ảnh
+void enrollApplyResult(EnrollPose* poses, const UploadResult& r, bool& verdictOk) {
+    int i = 0;
+    while (i < ENROLL_STEPS && !(poses[i].state == POSE_SENT && poses[i].uploadId == r.id)) i++;
+    if (i == ENROLL_STEPS) return;
+
+    switch (r.reply.kind) {
+        case REPLY_DONE:
+            verdictOk = true;
+            // fall through
+        case REPLY_COLLECTING:
+            poses[i].state = POSE_COLLECTED;
+            LOGI("✅ [ENROLL] Server nhận tư thế %d (%s).", i + 1, serverReplyKindName(r.reply.kind));
+            break;
+        case REPLY_OFFLINE:
+            poses[i].state = POSE_SAVED;
+            LOGI("💾 [ENROLL] Tư thế %d đã lưu journal, gửi lại khi có mạng.", i + 1);
+            break;
+        default:
+            // REPLY_FAILED là kết luận cho cả bộ ảnh, không riêng tư thế này
+            poses[i].state = POSE_FAILED;
+            LOGW("⚠️ [ENROLL] Lỗi ở tư thế %d (%s: %s).", i + 1,
+                 serverReplyKindName(r.reply.kind), r.reply.message);
+            break;
+    }
+}
 
-        xSemaphoreTake(tftMutex, portMAX_DELAY);
-        tft.pushImage(xPos, 0, fb->width, fb->height, (uint16_t*)fb->buf); 
-        tft.setTextColor(TFT_GREEN, TFT_BLACK);
-        tft.setTextDatum(TL_DATUM);
-        tft.drawString(getDateTimeString(), 5, 220, 2);
-        xSemaphoreGive(tftMutex);
+// Gợi ý trên màn hình (chuỗi hằng: overlay giữ con trỏ)
+const char* poseHintText(PoseHint h) {
+    switch (h) {
+        case POSE_HINT_TURN_LEFT:  return "QUAY SANG TRAI";
+        case POSE_HINT_TURN_RIGHT: return "QUAY SANG PHAI";
+        case POSE_HINT_LOOK_UP:    return "NGANG DAU LEN";
+        case POSE_HINT_LOOK_DOWN:  return "CUI DAU XUONG";
+        case POSE_HINT_LEVEL_HEAD: return "GIU THANG DAU";
+        case POSE_HINT_NO_FACE:    return "NHIN VAO CAMERA";
+        default:                   return nullptr;
+    }
+}
 
-        if (detection.run().isOk()) {
-            face_t f = detection.first;
-            Serial.printf("📏 [METRICS] Width: %d px | Confidence: %.2f\n", f.width, f.score);
-            int bX = f.x; int bY = f.y; int bW = f.width; int bH = f.height;
-            // Xử lý tọa độ âm
-            if (bX < 0) { bW += bX; bX = 0; }
-            if (bY < 0) { bH += bY; bY = 0; }
-            // Xử lý tràn phải/dưới (fb->width thường là 240)
-            if (bX + bW > fb->width)  bW = fb->width - bX;
-            if (bY + bH > fb->height) bH = fb->height - bY;
-
-            // Chỉ vẽ nếu kích thước > 0
-            if (bW > 0 && bH > 0) {
-                xSemaphoreTake(tftMutex, portMAX_DELAY);
-                tft.drawRect(xPos + bX, bY, bW, bH, TFT_CYAN); 
-                xSemaphoreGive(tftMutex);
-            }
+void runEnrollment() {
+    LOGI("--- ENROLL MODE STARTED ---");
+    // Enroll luôn chạy đủ tốc độ; xong enroll đếm lại thời gian yên tĩnh từ đầu
+    pipelineSetIdle(false);
+    gMotion.reset(MOTION_ACTIVE, millis());
+    endBurst();
+    gTracker.reset();
+    faceArmed = false;
+    uiSetOverlay({});
+    UiScreen intro = uiScreen(TFT_BLACK, 3000, true);
+    uiAddLine(intro, "CHE DO DANG KY", TFT_CYAN, 10, 4);
+    uiAddLine(intro, "Chuan bi...", TFT_WHITE, 50, 2);
+    uiAddLine(intro, "NHIN THANG CAMERA", TFT_YELLOW, 110, 2);
+    // Không chặn task: vòng lặp bên dưới chờ màn giới thiệu qua uiHeld() như với "DA CHUP n/5"
+    // (vẫn nhận kết quả upload, frame mới nhất lấy lại khi màn hình nhả)
+    uiShow(intro);
+
+    EnrollPose poses[ENROLL_STEPS] = {};
+    // Tư thế trung tính mặc định tới khi chụp xong ảnh nhìn thẳng của người này
+    PoseConfig poseCfg;
+    poseCfg.mirrored = ENROLL_POSE_MIRRORED;
+    bool neutralSet = false;
+    int poseHold = 0, holdStep = -1;
+    uint8_t round = 1;
+    unsigned long startedAt = millis(), lastSubmitAt = 0;
+    bool verdictOk = false;
+    EnrollOutcome outcome = ENROLL_FAILED;
 
-            // [LOGIC KHOẢNG CÁCH CHO RECOGNIZE]
-            if (f.width < 55) {
-                xSemaphoreTake(tftMutex, portMAX_DELAY);
-                tft.setTextColor(TFT_ORANGE, TFT_BLACK);
-                tft.drawCentreString("LAI GAN HON", tft.width()/2, 195, 4);
-                xSemaphoreGive(tftMutex);
+    for (;;) {
+        // 0. Kết quả upload các tư thế đã gửi (không chặn)
+        UploadResult r;
+        while (uploaderPollResult(r)) enrollApplyResult(poses, r, verdictOk);
+
+        int next = -1, sent = 0, failedPoses = 0, saved = 0;
+        for (int i = 0; i < ENROLL_STEPS; i++) {
+            if (poses[i].state == POSE_TODO && next < 0) next = i;
+            sent += poses[i].state == POSE_SENT;
+            failedPoses += poses[i].state == POSE_FAILED;
+            saved += poses[i].state == POSE_SAVED;
+        }
+
+        if (next < 0) {
+            PreviewOverlay ov = {};
+            if (sent) {
+                // Đã chụp hết, chờ server xác nhận các ảnh còn đang gửi
+                if (millis() - lastSubmitAt > ENROLL_RESULT_TIMEOUT) {
+                    LOGW("⚠️ [ENROLL] Quá thời gian chờ %d kết quả -> chụp lại.", sent);
+                    for (int i = 0; i < ENROLL_STEPS; i++) {
+                        if (poses[i].state == POSE_SENT) poses[i].state = POSE_FAILED;
+                    }
+                    continue;
+                }
+                ov.title = "DANG XAC NHAN...";
+                ov.busy = true;
+                uiSetOverlay(ov);
+                vTaskDelay(20);
+                continue;
             }
-            else if (f.width > 110) {
-                xSemaphoreTake(tftMutex, portMAX_DELAY);
-                tft.setTextColor(TFT_ORANGE, TFT_BLACK);
-                tft.drawCentreString("XA RA CHUT", tft.width()/2, 195, 4);
-                xSemaphoreGive(tftMutex);
+            if (verdictOk) {
+                outcome = ENROLL_OK;
+                break;
             }
-            else {
-                // KHOẢNG CÁCH OK -> BURST MODE
-                if(f.score > 0.80 && isLiveMotion(f) && (millis() - lastCaptureTime > 1000)) {
-                
-                    Serial.println("🚀 Bắt đầu gửi chuỗi 3 ảnh (Burst Mode)...");
-                    
-                    bool detectionDone = false; 
-                    int attempts = 0;           
+            // Không lỗi, phần còn thiếu nằm trong journal -> server kết luận khi journal đồng bộ xong
+            if (!failedPoses && saved) {
+                outcome = ENROLL_PENDING_SYNC;
+                break;
+            }
+            // Có ảnh lỗi, hoặc server nhận đủ bộ mà không trả kết luận -> chụp lại cả bộ
+            if (++round > ENROLL_MAX_ROUNDS) break;
+            if (uiHeld()) { vTaskDelay(20); continue; }
+            LOGW("🔁 [ENROLL] Chụp lại cả bộ ảnh (%d lỗi, lượt %u).", failedPoses, round);
+            wsSendTxt("enroll_reset:" + gEnrollName);
+            for (int i = 0; i < ENROLL_STEPS; i++) poses[i] = {};
+            UiScreen ui = uiScreen(TFT_ORANGE, 1500, true);
+            uiAddLine(ui, "CHUP LAI", TFT_BLACK, 90, 4);
+            uiAddLine(ui, String(ENROLL_STEPS) + " TU THE", TFT_BLACK, 140, 2);
+            uiShow(ui);
+            continue;
+        }
+        if (uiHeld()) { vTaskDelay(20); continue; }
 
-                    while (!detectionDone && attempts < 3) {
-                        attempts++;
+        // 1. Lấy frame mới nhất (preview do RenderTask vẽ)
+        PreviewOverlay ov = {};
+        ov.title = enrollSteps[next];
+        ov.busy = sent > 0;      // chấm xanh: còn ảnh đang gửi nền
+        Frame* frame = pipelineNextDetect(pdMS_TO_TICKS(200));
+        if (!frame) { uiSetOverlay(ov); continue; }
 
-                        if (attempts > 1) {
-                            xSemaphoreTake(camMutex, portMAX_DELAY);
-                            camera.capture(); 
-                            fb = camera.frame;
-                            xSemaphoreGive(camMutex);
+        // 2. Detect & Kiểm tra khoảng cách
+        if (detectFace(frame)) {
+            face_t f = detection.first;
 
-                            xSemaphoreTake(tftMutex, portMAX_DELAY);
-                            tft.pushImage(xPos, 0, fb->width, fb->height, (uint16_t*)fb->buf);
-                            xSemaphoreGive(tftMutex);
-                            
-                            if (!detection.run().isOk()) {
-                                Serial.println("⚠️ Mất dấu khuôn mặt -> Hủy Burst");
-                                break; 
-                            }
-                            f = detection.first; 
+            PoseHint hint = POSE_HINT_NO_FACE;
+            if (next != holdStep) { holdStep = next; poseHold = 0; }
+
+            if (f.width < 55) ov.hint = "LAI GAN HON";
+            else if (f.width > 110) ov.hint = "XA RA CHUT";
+            else if (f.score > 0.85 &&
+                     (hint = checkPose(estimateHeadPose(poseLandmarks(f), poseCfg), enrollPoses[next], poseCfg)) != POSE_HINT_OK) {
+                ov.hint = poseHintText(hint);
+                poseHold = 0;
+            }
+            else if (f.score > 0.85 && ++poseHold < ENROLL_POSE_HOLD) {
+                overlayBox(ov, &frame->fb, f, TFT_YELLOW);
+            }
+            else if (f.score > 0.85) {
+                poseHold = 0;
+                // Vẽ khung xanh xác nhận
+                overlayBox(ov, &frame->fb, f, TFT_GREEN);
+                uiSetOverlay(ov);
+                frameRelease(frame);
+
+                // Chờ 1 chút cho người dùng ổn định tư thế
+                vTaskDelay(ENROLL_SETTLE_MS);
+
+                // Lấy frame mới nhất để gửi; landmark/crop phải lấy trên chính frame này
+                frame = pipelineNextDetect(pdMS_TO_TICKS(500));
+                if (frame) {
+                    // Không thấy mặt trên frame này -> box/landmark cũ thuộc frame đã trả, không dùng được
+                    if (!detectFace(frame)) {
+                        LOGW("⚠️ [ENROLL] Mất khuôn mặt sau khi chờ ở tư thế %d -> bỏ ảnh.", next + 1);
+                        frameRelease(frame);
+                        continue;
+                    }
+                    f = detection.first;
+                    // Người dùng có thể đã đổi tư thế trong lúc chờ -> kiểm tra lại trên frame sẽ gửi
+                    HeadPose pose = estimateHeadPose(poseLandmarks(f), poseCfg);
+                    if (checkPose(pose, enrollPoses[next], poseCfg) != POSE_HINT_OK) {
+                        LOGW("⚠️ [ENROLL] Tư thế %d lệch sau khi chờ (yaw %.2f, pitch %.2f) -> bỏ ảnh.",
+                             next + 1, pose.yaw, pose.pitch);
+                        frameRelease(frame);
+                        continue;
+                    }
+                    // Xếp hàng upload nền rồi sang tư thế kế tiếp ngay
+                    uint32_t id = submitFace(&frame->fb, f, "enroll", gEnrollName.c_str());
+                    if (id) {
+                        float* emb = gEnrollPoseEmb ? gEnrollPoseEmb + next * FACE_EMBED_DIM : nullptr;
+                        poses[next].state = POSE_SENT;
+                        poses[next].uploadId = id;
+                        poses[next].embOk = emb && gLocalRecogReady && faceEmbed(&frame->fb, f, emb);
+                        lastSubmitAt = millis();
+                        // Các bước quay / ngẩng đo so với tư thế nhìn thẳng của chính người này
+                        if (enrollPoses[next] == POSE_FRONT && !neutralSet) {
+                            poseSetNeutral(poseCfg, pose);
+                            neutralSet = true;
                         }
+                        LOGI("📤 [ENROLL] Đã xếp hàng tư thế %d (upload #%lu, yaw %.2f, pitch %.2f).",
+                             next + 1, (unsigned long)id, pose.yaw, pose.pitch);
 
-                        uint8_t* faceBuf = nullptr; size_t faceLen = 0;
-                        
-                        if (cropFaceFromRGB565(fb, f, &faceBuf, &faceLen)) {
-                            unsigned long startTick = millis();
-                            Serial.printf("📡 Gửi ảnh thứ %d/3...\n", attempts);
-                            
-                            String res = sendImageToServer(faceBuf, faceLen, "recognize");
-                            unsigned long duration = millis() - startTick;
-                            free(faceBuf); 
-
-                            if (res == "offline_saved") {
-                                xSemaphoreTake(tftMutex, portMAX_DELAY);
-                                tft.setTextColor(TFT_ORANGE, TFT_BLACK);
-                                tft.drawCentreString("DA LUU OFFLINE", 120, 200, 2);
-                                xSemaphoreGive(tftMutex);
-                                vTaskDelay(1000);
-                                detectionDone = true;
-                            }
-                            else if (res.indexOf("collecting") > 0) {
-                                vTaskDelay(50);
-                                continue; 
-                            }
-                            else if (res.indexOf("match\":true") > 0) {
-                                int n1 = res.indexOf("name\":\"") + 7;
-                                int n2 = res.indexOf("\"", n1);
-                                String name = res.substring(n1, n2);
-                                Serial.printf("✅ MATCHED: %s\n", name.c_str());
-                                
-                                xSemaphoreTake(tftMutex, portMAX_DELAY);
-                                tft.fillScreen(TFT_GREEN); 
-                                tft.setTextColor(TFT_BLACK, TFT_GREEN);
-                                tft.drawCentreString("XIN CHAO", tft.width()/2, 100, 2);
-                                tft.drawCentreString(name, tft.width()/2, 130, 4);
-                                xSemaphoreGive(tftMutex);
-                                vTaskDelay(2000); 
-
-                                xSemaphoreTake(tftMutex, portMAX_DELAY);
-                                tft.fillScreen(TFT_BLACK); 
-                                xSemaphoreGive(tftMutex);
-
-                                lastCaptureTime = millis();
-                                detectionDone = true;      
-                            }
-                            else if (res.indexOf("match\":false") > 0) {
-                                Serial.println("❌ NGUOI LA");
-                                xSemaphoreTake(tftMutex, portMAX_DELAY);
-                                tft.setTextColor(TFT_RED, TFT_BLACK); 
-                                tft.drawCentreString("NGUOI LA", tft.width()/2, 200, 2);
-                                xSemaphoreGive(tftMutex);
-                                vTaskDelay(1000);
-                                
-                                xSemaphoreTake(tftMutex, portMAX_DELAY); 
-                                tft.fillScreen(TFT_BLACK); 
-                                xSemaphoreGive(tftMutex);
-
-                                lastCaptureTime = millis();
-                                detectionDone = true; 
-                            }
-                        } 
-                    } 
+                        UiScreen ui = uiScreen(TFT_GREEN, 600, true);
+                        uiAddLine(ui, "DA CHUP " + String(next + 1) + "/" + String(ENROLL_STEPS), TFT_BLACK, 100, 4);
+                        uiShow(ui);
+                    }
                 }
             }
+        } else {
+            poseHold = 0;
+        }
+        uiSetOverlay(ov);
+        frameRelease(frame);
+        vTaskDelay(1);
+    }
+    while (uiHeld()) vTaskDelay(20);
+
+    bool failed = outcome == ENROLL_FAILED;
+    int collected = 0, saved = 0, embCount = 0;
+    if (gEnrollEmbSum) memset(gEnrollEmbSum, 0, FACE_EMBED_DIM * sizeof(float));
+    for (int i = 0; i < ENROLL_STEPS; i++) {
+        collected += poses[i].state == POSE_COLLECTED;
+        saved += poses[i].state == POSE_SAVED;
+        if (failed || !poses[i].embOk || (poses[i].state != POSE_COLLECTED && poses[i].state != POSE_SAVED)) continue;
+        const float* emb = gEnrollPoseEmb + i * FACE_EMBED_DIM;
+        float norm = 0;
+        for (int k = 0; k < FACE_EMBED_DIM; k++) norm += emb[k] * emb[k];
+        norm = sqrtf(norm);
+        if (norm > 0) {
+            for (int k = 0; k < FACE_EMBED_DIM; k++) gEnrollEmbSum[k] += emb[k] / norm;
+            embCount++;
         }
-        vTaskDelay(20);
     }
+    LOGI("🎉 --- ENROLL FINISHED --- %s | %d nhận, %d lưu offline | %u lượt | %lu ms",
+         failed ? "THẤT BẠI" : outcome == ENROLL_OK ? "OK" : "CHỜ ĐỒNG BỘ",
+         collected, saved, failed ? ENROLL_MAX_ROUNDS : round, millis() - startedAt);
+    if (embCount > 0) {
+        // Trung bình các tư thế -> NetworkTask gửi lên server cho gallery offline
+        for (int i = 0; i < FACE_EMBED_DIM; i++) gDeviceEmb[i] = gEnrollEmbSum[i] / embCount;
+        strlcpy(gDeviceEmbId, gEnrollName.c_str(), sizeof(gDeviceEmbId));
+        gDeviceEmbPending = true;
+    }
+    gEnrollingInProgress = false;
+    wsSendTxt("enroll_done");
+    uiSetOverlay({});
+    
+    UiScreen done = uiScreen(failed ? TFT_RED : outcome == ENROLL_OK ? TFT_BLUE : TFT_ORANGE, 3000, true);
+    uiAddLine(done, failed ? "THAT BAI" : outcome == ENROLL_OK ? "HOAN TAT!" : "DA LUU ANH", TFT_WHITE, 100, 4);
+    if (outcome == ENROLL_PENDING_SYNC) uiAddLine(done, "SE DONG BO KHI CO MANG", TFT_WHITE, 150, 2);
+    uiShow(done);
 }
 
-void setup() {
-    Serial.begin(115200);
+// --- TASK CHÍNH: TẦNG DETECT & LOGIC (core 1) ---
+// Capture và preview chạy ở CaptureTask/RenderTask trên core 0 (frame_pipeline),
+// task này chỉ lấy frame mới nhất để detect rồi cập nhật lớp phủ.
+void CameraAppTask(void *pvParameters) {    
+    for (;;) {
+        if (!gSystemIsWorking && !gEnrollingInProgress) {
+            pipelineSetActive(false);
+            pipelineSetIdle(false);
+            gMotion.reset(MOTION_ACTIVE, millis());
+            vTaskDelay(1000);
+            continue;
+        }
+        pipelineSetActive(true);
+        if (uiHeld()) { vTaskDelay(20); continue; }
 
-    loadTimeConfig();
+        if (gEnrollingInProgress) {
+            runEnrollment();
+            continue;
+        }
 
-    esp_sleep_wakeup_cause_t wakeup_reason = esp_sleep_get_wakeup_cause();
-    if (wakeup_reason == ESP_SLEEP_WAKEUP_EXT0) {
-        Serial.println("🔔 Đã thức dậy thủ công bằng nút bấm!");
-    } else if (wakeup_reason == ESP_SLEEP_WAKEUP_TIMER) {
-        Serial.println("⏰ Đã thức dậy theo lịch trình!");
-    }
+        // 1. Kết quả nhận diện từ UploaderTask (không chặn)
+        UploadResult r;
+        while (uploaderPollResult(r)) handleRecognizeResult(r);
+        if (uiHeld()) { vTaskDelay(20); continue; }
+
+        // 2. Frame mới nhất từ CaptureTask (frame cũ hơn đã được bỏ qua)
+        Frame* frame = pipelineNextDetect(pdMS_TO_TICKS(100));
+        if (!frame) continue;
+        camera_fb_t* fb = &frame->fb;
+
+        PreviewOverlay ov = {};
+        strlcpy(ov.clock, getDateTimeString().c_str(), sizeof(ov.clock));
+        if (!motionGateAllows(frame)) {
+            uiSetOverlay(ov);
+            frameRelease(frame);
+            continue;
+        }
+        // Đang gom frame burst -> detect mọi frame để crop/landmark chính xác
+        face_t f;
+        bool fresh = false;
+        uint32_t trackId = 0;
+        bool found = locateFace(frame, burst.active && !burst.awaitingId, f, fresh, trackId);
+        LivenessResult live = {};
+        if (found) {
+            gMotion.hold(millis());
+            live = checkLiveness(frame, f, fresh, trackId);
+            if (fresh) LOGD("📏 [METRICS] Track #%u | Width: %d px | Confidence: %.2f", trackId, f.width, f.score);
+            overlayBox(ov, fb, f, TFT_CYAN);
+        } else {
+            faceArmed = false;
+        }
 
-    Wire.begin(SDA_PIN, SCL_PIN);
-    rtc.begin();
-    if (! rtc.begin()) {
-        Serial.println("LOI: Khong tim thay module RTC DS3231!");
+        if (burst.active) {
+            // BURST ĐANG CHẠY: gom đủ frame rồi chờ kết quả
+            if (burst.awaitingId) {
+                if (millis() - burst.sentAt > BURST_RESULT_TIMEOUT) {
+                    LOGW("⚠️ Quá thời gian chờ kết quả -> Hủy Burst");
+                    endBurst();
+                } else {
+                    ov.busy = true;
+                }
+            }
+            else if (!found) {
+                LOGW("⚠️ Mất dấu khuôn mặt -> Hủy Burst");
+                endBurst();
+            }
+            else {
+                collectBurstFrame(fb, f);
+            }
+        }
+        else if (found) {
+            // [LOGIC KHOẢNG CÁCH CHO RECOGNIZE]
+            if (f.width < 55) ov.hint = "LAI GAN HON";
+            else if (f.width > 110) ov.hint = "XA RA CHUT";
+            else {
+                // KHOẢNG CÁCH OK -> BURST MODE
+                if (!faceArmed && f.score > 0.80 && live.live && (millis() - lastCaptureTime > 1000)) {
+                    LOGI("🫀 [LIVE] Track #%u | score %.2f (vi chuyển động %.3f, landmark %.3f, cử động %.2f)",
+                         trackId, live.score, live.micro, live.geom, live.move);
+                    faceArmed = true;
+                }
+                // Crop/embedding cần landmark thật -> frame chỉ có tracker thì xin detect ở frame sau
+                if (faceArmed && !fresh) gTracker.requestDetection();
+                else if (faceArmed) {
+                    faceArmed = false;
+                    // Mất mạng hoặc mạng đang kém -> nhận diện tại máy, không chờ timeout
+                    if (f.score <= 0.80) {
+                        // score thật trên frame này chưa đủ -> chờ lượt sau
+                    } else if ((WiFi.status() != WL_CONNECTED || linkOfflineFirst()) && recognizeLocally(fb, f)) {
+                        lastCaptureTime = millis();
+                    } else {
+                        startBurst();
+                        collectBurstFrame(fb, f);
+                    }
+                }
+            }
+        }
+        uiSetOverlay(ov);
+        frameRelease(frame);
+        vTaskDelay(1);
     }
+}
+
+// --- CÁC BƯỚC KHỞI ĐỘNG CHẠY SONG SONG (fast_boot.h) ---
+// Thẻ SD: mount, journal offline, gallery. Sau ngủ sâu bỏ quét dung lượng đã dùng (usedBytes
+// duyệt cả bảng FAT, chậm với thẻ lớn).
+volatile bool gSdReady = false;
+void bootSdStep() {
     SD_MMC.setPins(39, 38, 40); 
     if(!SD_MMC.begin("/sd", true)){ 
-        Serial.println("❌ LOI: Khong the khoi tao SD Card!");
+        LOGE("❌ LOI: Khong the khoi tao SD Card!");
     } else {
-        Serial.println("✅ SD Card OK.");
-        
-        uint64_t cardSize = SD_MMC.cardSize() / (1024 * 1024);
-        uint64_t totalBytes = SD_MMC.totalBytes() / (1024 * 1024);
-        uint64_t usedBytes = SD_MMC.usedBytes() / (1024 * 1024);
+        LOGI("✅ SD Card OK.");
+        loggerAttachSd();
+        gSdReady = true;
         
-        Serial.println("📊 --- SD CARD INFO ---");
-        Serial.printf("   💾 Dung luong The: %llu MB\n", cardSize);
-        Serial.printf("   💾 Tong vung luu tru: %llu MB\n", totalBytes);
-        Serial.printf("   💾 Da su dung: %llu MB\n", usedBytes);
-        Serial.printf("   💾 Con trong:  %llu MB\n", totalBytes - usedBytes);
-        Serial.println("-----------------------");
+        if (!bootFastResume()) {
+            uint64_t cardSize = SD_MMC.cardSize() / (1024 * 1024);
+            uint64_t totalBytes = SD_MMC.totalBytes() / (1024 * 1024);
+            uint64_t usedBytes = SD_MMC.usedBytes() / (1024 * 1024);
+            
+            LOGI("📊 --- SD CARD INFO ---");
+            LOGI("   💾 Dung luong The: %llu MB", cardSize);
+            LOGI("   💾 Tong vung luu tru: %llu MB", totalBytes);
+            LOGI("   💾 Da su dung: %llu MB", usedBytes);
+            LOGI("   💾 Con trong:  %llu MB", totalBytes - usedBytes);
+            LOGI("-----------------------");
+        }
+
+        if (gJournal.begin(JOURNAL_DIR)) {
+            JournalStats js = gJournal.stats();
+            LOGI("📒 [OFFLINE] Journal: %u bản ghi chờ gửi (segment %u..%u)",
+                 js.pending, js.firstSegment, js.writeSegment);
+            if (js.recovered) LOGI("🩹 [OFFLINE] Đã khôi phục journal sau khi mất điện.");
+            migrateLegacyQueue();
+        } else {
+            LOGE("❌ [OFFLINE] Không mở được journal!");
+        }
     }
 
-    tft.init(); tft.setRotation(3); tft.fillScreen(TFT_BLACK);
+    // Gallery offline: chỉ dùng được khi có model embedding trên thiết bị
+    float* embBuf = faceEmbedBegin() ? (float*) ps_malloc((3 + ENROLL_STEPS) * FACE_EMBED_DIM * sizeof(float)) : nullptr;
+    if (embBuf && gGallery.begin(FACE_EMBED_DIM, GALLERY_CAPACITY)) {
+        gEmbQuery = embBuf;
+        gEnrollEmbSum = embBuf + FACE_EMBED_DIM;
+        gDeviceEmb = embBuf + 2 * FACE_EMBED_DIM;
+        gEnrollPoseEmb = embBuf + 3 * FACE_EMBED_DIM;
+        gLocalRecogReady = true;
+        if (gSdReady && gGallery.load(GALLERY_PATH)) {
+            LOGI("🗂️ [GALLERY] Nạp %u người từ thẻ SD", gGallery.size());
+        }
+    } else {
+        LOGW("⚠️ [GALLERY] Nhận diện offline KHÔNG khả dụng (%s) -> mất mạng chỉ lưu ảnh chờ server.",
+             !faceEmbedHasModel() ? "firmware build không có model embedding"
+             : !embBuf ? "hết PSRAM" : "không cấp được gallery");
+        free(embBuf);
+    }
+}
 
-    pinMode(WIFI_RESET_BTN, INPUT_PULLUP);
+void bootTftStep() {
+    tft.init(); tft.setRotation(3); tft.fillScreen(TFT_BLACK);
+}
 
+volatile bool gCameraReady = false;
+void bootCameraStep() {
     camera.pinout.freenove_s3();
     camera.xclk.slow();
     camera.brownout.disable();
@@ -856,12 +1852,7 @@ void setup() {
     detection.accurate();
     detection.confidence(0.70);
 
-    
-    
-    if (!camera.begin().isOk()) { 
-        tft.drawString("Cam Err", 0, 0); 
-        while(1) delay(100); 
-    }
+    if (!camera.begin().isOk()) return;
     // ====== BASIC ======
     camera.sensor.setBrightness(1);     // +1 là hợp lý
     camera.sensor.setSaturation(1);     // ❗ KHÔNG để 0
@@ -876,46 +1867,126 @@ void setup() {
             s->set_lenc(s, 1);              // Lens correction (Sáng 4 góc)
             s->set_dcw(s, 1);               // Khử sai màu
     });
+    gCameraReady = true;
+}
 
-    
+// Preview đầu tiên lên TFT đánh dấu mốc khởi động
+bool drawPreview(Frame* frame) {
+    bool drawn = rendererDrawFrame(frame);
+    if (drawn && frame) bootPhaseDone(BOOT_PREVIEW);
+    return drawn;
+}
 
-    preferences.begin("kiosk-config", false);
-    strcpy(server_ip_buffer, "192.168.137.1"); 
-    preferences.putString("server_ip", server_ip_buffer);
+void setup() {
+    Serial.begin(115200);
+    loggerBegin();
+    bootBegin();
+
+    loadTimeConfig();
+    loadLivenessConfig();
+
+    esp_sleep_wakeup_cause_t wakeup_reason = esp_sleep_get_wakeup_cause();
+    if (wakeup_reason == ESP_SLEEP_WAKEUP_EXT0) {
+        LOGI("🔔 Đã thức dậy thủ công bằng nút bấm!");
+    } else if (wakeup_reason == ESP_SLEEP_WAKEUP_TIMER) {
+        LOGI("⏰ Đã thức dậy theo lịch trình!");
+    }
+
+    // WiFi nối nền bằng kênh / BSSID đã lưu trong lúc camera, thẻ SD, màn hình khởi tạo
+    bool fastWifi = bootWifiStart();
+
+    bootPhaseStart(BOOT_RTC);
+    Wire.begin(SDA_PIN, SCL_PIN);
+    if (! rtc.begin()) {
+        LOGE("LOI: Khong tim thay module RTC DS3231!");
+    }
+    bootPhaseDone(BOOT_RTC);
 
-    WiFiManager wm;
+    galleryMutex = xSemaphoreCreateMutex();
+    // Trước các bước khởi tạo song song: bootSdStep đã có thể chuyển ảnh queue.txt cũ qua pool
+    imagePoolBegin();
     pinMode(WIFI_RESET_BTN, INPUT_PULLUP);
-    
-    WiFiManagerParameter custom_ip("server", "IP Server", server_ip_buffer, 40);
-    wm.addParameter(&custom_ip);
-    if (!wm.autoConnect("ChamCong", "12345678")) ESP.restart();
-    
-    if (String(custom_ip.getValue()).length() > 0) {
-        strcpy(server_ip_buffer, custom_ip.getValue());
+    bootSpawn(BOOT_CAMERA, bootCameraStep, 8192);
+    bootSpawn(BOOT_SD, bootSdStep, 8192);
+    bootSpawn(BOOT_TFT, bootTftStep, 4096);
+    bootJoin(portMAX_DELAY);
+
+    if (!gCameraReady) { 
+        tft.drawString("Cam Err", 0, 0); 
+        while(1) delay(100); 
+    }
+
+    // Preview chạy ngay, không chờ mạng
+    if (!rendererBegin(tft, 240)) {
+        LOGE("❌ [TFT] Không đủ RAM cho sprite dải!");
+    }
+    if (!pipelineBegin(240, 240, drawPreview)) {
+        LOGE("❌ [PIPELINE] Không đủ PSRAM cho frame buffer!");
+    }
+
+    preferences.begin("kiosk-config", false);
+    preferences.getString("device_key", "").toCharArray(device_key_buffer, sizeof(device_key_buffer));
+    if (fastWifi && bootWifiWait(BOOT_WIFI_FAST_MS)) {
+        // Thức dậy từ ngủ sâu, AP cũ vẫn nhận: không qua WiFiManager / captive portal
+        strlcpy(server_ip_buffer, bootCachedServerIp(), sizeof(server_ip_buffer));
+        LOGI("⚡ [BOOT] Nối lại WiFi kênh %d sau %lu ms.", WiFi.channel(), millis());
+    } else {
+        strcpy(server_ip_buffer, "192.168.137.1"); 
         preferences.putString("server_ip", server_ip_buffer);
+
+        WiFiManager wm;
+        
+        WiFiManagerParameter custom_ip("server", "IP Server", server_ip_buffer, 40);
+        WiFiManagerParameter custom_key("device_key", "Khoa thiet bi", device_key_buffer, 64);
+        wm.addParameter(&custom_ip);
+        wm.addParameter(&custom_key);
+        if (!wm.autoConnect("ChamCong", "12345678")) ESP.restart();
+        
+        if (String(custom_ip.getValue()).length() > 0) {
+            strcpy(server_ip_buffer, custom_ip.getValue());
+            preferences.putString("server_ip", server_ip_buffer);
+        }
+        if (String(custom_key.getValue()).length() > 0) {
+            strlcpy(device_key_buffer, custom_key.getValue(), sizeof(device_key_buffer));
+            preferences.putString("device_key", device_key_buffer);
+        }
     }
+    bootPhaseDone(BOOT_WIFI);
+    bootSaveNet(server_ip_buffer);
 
+    bootPhaseStart(BOOT_NET);
+    gHttp.begin(server_ip_buffer, server_port);
+    wsUplinkBegin(&webSocket, wsUplinkDone);
     webSocket.begin(server_ip_buffer, server_port, "/ws");
     webSocket.onEvent(webSocketEvent);
     webSocket.setReconnectInterval(5000);
 
-    tftMutex = xSemaphoreCreateMutex();
-    camMutex = xSemaphoreCreateMutex();
-
-    xTaskCreatePinnedToCore(NetworkTask, "NetTask", 10240, NULL, 3, NULL, 0);
-    xTaskCreatePinnedToCore(TimeSyncTask, "TimeTask", 2048, NULL, 1, NULL, 1);
-    xTaskCreatePinnedToCore(CameraAppTask, "AppTask", 16384, NULL, 2, NULL, 1);
-
-    Serial.println("System Ready!");
-
-    Serial.println("⚙️ --- SYSTEM STATUS ---");
-    Serial.printf("   🔹 Chip Model: %s (Rev %d)\n", ESP.getChipModel(), ESP.getChipRevision());
-    Serial.printf("   🔹 CPU Freq: %d MHz\n", ESP.getCpuFreqMHz());
-    Serial.printf("   🔹 Free RAM (Heap): %d bytes\n", ESP.getFreeHeap());
-    if (xSemaphoreTake(tftMutex, (TickType_t)100) == pdTRUE) {
-        tft.fillScreen(TFT_BLACK);
-        xSemaphoreGive(tftMutex);
-    }
+    LinkControlConfig lc;
+    lc.qualityMin = LINK_QUALITY_MIN;
+    lc.qualityMax = LINK_QUALITY_MAX;
+    lc.cropMax = FACE_CROP_SIZE;
+    lc.cropMin = (FACE_CROP_SIZE && FACE_CROP_SIZE > LINK_CROP_MIN) ? LINK_CROP_MIN : FACE_CROP_SIZE;
+    lc.burstMax = BURST_FRAMES;
+    gLink = LinkController(lc);
+    uploaderBegin(sendUploadJob);
+
+    TaskHandle_t net, timeSync, app;
+    xTaskCreatePinnedToCore(NetworkTask, "NetTask", 10240, NULL, 3, &net, 0);
+    xTaskCreatePinnedToCore(TimeSyncTask, "TimeTask", 2048, NULL, 1, &timeSync, 1);
+    xTaskCreatePinnedToCore(CameraAppTask, "AppTask", 16384, NULL, 2, &app, 1);
+    metricsRegisterTask(net);
+    metricsRegisterTask(timeSync);
+    metricsRegisterTask(app);
+    bootPhaseDone(BOOT_NET);
+
+    LOGI("System Ready!");
+    bootReport();
+
+    LOGI("⚙️ --- SYSTEM STATUS ---");
+    LOGI("   🔹 Chip Model: %s (Rev %d)", ESP.getChipModel(), ESP.getChipRevision());
+    LOGI("   🔹 CPU Freq: %d MHz", ESP.getCpuFreqMHz());
+    LOGI("   🔹 Free RAM (Heap): %d bytes", ESP.getFreeHeap());
+    uiShow(uiScreen(TFT_BLACK, 0, false));
 }
 
 void loop() {
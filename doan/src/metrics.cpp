@@ -0,0 +1,99 @@
+#include "metrics.h"
+#include <esp_heap_caps.h>
+
+struct StageHist {
+    uint32_t bucket[METRIC_BUCKETS];
+    uint32_t count;
+    uint32_t maxUs;
+};
+
+// [core][stage]: mỗi core chỉ ghi vào mảng của mình
+static StageHist hist[portNUM_PROCESSORS][M_STAGE_COUNT];
+static TaskHandle_t tasks[METRIC_MAX_TASKS];
+static uint8_t taskCount = 0;
+static portMUX_TYPE taskMux = portMUX_INITIALIZER_UNLOCKED;
+
+static const char* STAGE_NAMES[M_STAGE_COUNT] = {
+    "capture", "motion", "detect", "track", "liveness", "quality", "encode", "http", "parse", "ws", "sd_write", "tft_push", "checkin"
+};
+
+// Bucket i chứa [2^(i/2), 2^((i+1)/2)) us
+static uint8_t bucketOf(uint32_t us) {
+    if (us < 2) return 0;
+    uint8_t msb = 31 - __builtin_clz(us);
+    // Nửa trên của quãng tám: us >= 2^msb * sqrt(2)
+    bool upper = (uint64_t)us * us >= (uint64_t)2 << (2 * msb);
+    uint8_t b = msb * 2 + (upper ? 1 : 0);
+    return b < METRIC_BUCKETS ? b : METRIC_BUCKETS - 1;
+}
+
+static uint32_t bucketUpperUs(uint8_t b) {
+    // 2^((b+1)/2)
+    uint32_t base = 1u << ((b + 1) / 2);
+    return (b & 1) ? base : (uint32_t)(base * 1.41421356f);
+}
+
+void metricRecord(MetricStage stage, uint32_t us) {
+    StageHist& h = hist[xPortGetCoreID()][stage];
+    // Task cùng core có thể chen ngang -> cộng nguyên tử, không cần khoá
+    __atomic_fetch_add(&h.bucket[bucketOf(us)], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&h.count, 1, __ATOMIC_RELAXED);
+    if (us > h.maxUs) h.maxUs = us;     // mất 1 lần cập nhật max khi bị chen ngang cũng không sao
+}
+
+void metricsRegisterTask(TaskHandle_t task) {
+    portENTER_CRITICAL(&taskMux);
+    if (taskCount < METRIC_MAX_TASKS) tasks[taskCount++] = task;
+    portEXIT_CRITICAL(&taskMux);
+}
+
+static uint32_t percentile(const uint32_t* buckets, uint32_t count, float p) {
+    uint32_t target = (uint32_t)(count * p + 0.5f);
+    if (target == 0) target = 1;
+    uint32_t seen = 0;
+    for (uint8_t b = 0; b < METRIC_BUCKETS; b++) {
+        seen += buckets[b];
+        if (seen >= target) return bucketUpperUs(b);
+    }
+    return bucketUpperUs(METRIC_BUCKETS - 1);
+}
+
+void metricsToJson(JsonDocument& doc) {
+    doc["uptime"] = millis() / 1000;
+
+    // "stages": {"detect": [count, p50_us, p99_us, max_us], ...}
+    JsonObject stages = doc["stages"].to<JsonObject>();
+    for (int s = 0; s < M_STAGE_COUNT; s++) {
+        uint32_t merged[METRIC_BUCKETS] = {};
+        uint32_t count = 0, maxUs = 0;
+        for (int c = 0; c < portNUM_PROCESSORS; c++) {
+            const StageHist& h = hist[c][s];
+            for (int b = 0; b < METRIC_BUCKETS; b++) merged[b] += h.bucket[b];
+            count += h.count;
+            if (h.maxUs > maxUs) maxUs = h.maxUs;
+        }
+        if (!count) continue;
+        JsonArray a = stages[STAGE_NAMES[s]].to<JsonArray>();
+        a.add(count);
+        a.add(percentile(merged, count, 0.50f));
+        a.add(percentile(merged, count, 0.99f));
+        a.add(maxUs);
+    }
+
+    // "tasks": {"AppTask": byte stack chưa từng dùng, ...}
+    JsonObject t = doc["tasks"].to<JsonObject>();
+    for (uint8_t i = 0; i < taskCount; i++) {
+        t[pcTaskGetName(tasks[i])] = uxTaskGetStackHighWaterMark(tasks[i]);
+    }
+
+    JsonArray heap = doc["heap"].to<JsonArray>();     // [còn trống, thấp nhất] byte
+    heap.add(heap_caps_get_free_size(MALLOC_CAP_INTERNAL));
+    heap.add(heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL));
+    JsonArray psram = doc["psram"].to<JsonArray>();
+    psram.add(heap_caps_get_free_size(MALLOC_CAP_SPIRAM));
+    psram.add(heap_caps_get_minimum_free_size(MALLOC_CAP_SPIRAM));
+}
+
+void metricsReset() {
+    memset(hist, 0, sizeof(hist));
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+// Đo thời gian từng tầng xử lý, gom vào histogram theo core (mỗi core ghi mảng riêng bằng
+// phép cộng nguyên tử -> không khoá, không tranh chấp giữa 2 core). Bucket theo nửa quãng
+// tám (2^(i/2) us) nên p50/p99 sai số tối đa ~41%, đủ để so sánh giữa các kiosk.
+// Snapshot gồm: count/p50/p99/max từng tầng, stack còn trống thấp nhất của các task đã đăng
+// ký, heap nội / PSRAM còn trống (hiện tại + thấp nhất). Gửi qua WS khi nhận {"type":"get_metrics"}.
+
+enum MetricStage {
+    M_CAPTURE,      // esp_camera_fb_get + chép vào slot pipeline
+    M_MOTION,       // cổng chuyển động: lấy ảnh độ sáng nhỏ + so với frame trước
+    M_DETECT,       // detector khuôn mặt
+    M_TRACK,        // bám template giữa 2 lần detect
+    M_LIVENESS,
+    M_QUALITY,      // chấm điểm frame burst
+    M_ENCODE,       // cắt + nén JPEG vùng mặt
+    M_HTTP,         // 1 request tới server (gồm cả base64 nếu upload JSON)
+    M_PARSE,        // giải mã phản hồi JSON từ stream (gồm cả chờ phần body còn lại)
+    M_WS,           // 1 request qua WebSocket: gửi frame tới khi có kết quả
+    M_SD_WRITE,     // ghi journal offline
+    M_TFT_PUSH,     // vẽ 1 frame preview
+    M_CHECKIN,      // từ lúc bắt đầu burst tới khi có kết quả
+    M_STAGE_COUNT
+};
+
+#define METRIC_BUCKETS     48      // bucket cuối gom mọi giá trị >= 2^23.5 us (~11.9 s)
+#define METRIC_MAX_TASKS   8
+
+void metricRecord(MetricStage stage, uint32_t us);
+// Đăng ký task (lúc tạo) để snapshot báo stack high-water mark
+void metricsRegisterTask(TaskHandle_t task);
+// Ghi snapshot vào doc: "stages", "tasks", "heap", "psram", "uptime"
+void metricsToJson(JsonDocument& doc);
+void metricsReset();
+
+// Đo thời gian của 1 khối lệnh: { MetricTimer t(M_DETECT); ... }
+class MetricTimer {
+public:
+    explicit MetricTimer(MetricStage stage) : _stage(stage), _t0(micros()) {}
+    ~MetricTimer() { metricRecord(_stage, micros() - _t0); }
+private:
+    MetricStage _stage;
+    uint32_t _t0;
+};
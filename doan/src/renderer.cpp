@@ -0,0 +1,186 @@
+#include "renderer.h"
+#include "logger.h"
+
+struct Rect { int16_t x, y, w, h; };
+
+static TFT_eSPI* tft = nullptr;
+static TFT_eSprite* band[2] = {};
+static bool dma = false;
+static QueueHandle_t screenQueue = nullptr;
+static QueueHandle_t overlayBox = nullptr;        // hộp thư 1 phần tử, luôn là lớp phủ mới nhất
+static volatile unsigned long holdUntil = 0;      // do uiShow() đặt, người gọi thấy ngay
+
+// Chỉ RenderTask dùng
+static bool screenActive = false;
+static unsigned long screenUntil = 0;
+static bool screenClearAfter = false;
+static bool marginsDirty = true;
+static PreviewOverlay lastMargin = {};
+static Rect lastRects[3];
+static uint8_t lastRectCount = 0;
+
+UiScreen uiScreen(uint16_t bg, uint16_t holdMs, bool clearAfter) {
+    UiScreen s = {};
+    s.fill = true;
+    s.bg = bg;
+    s.holdMs = holdMs;
+    s.clearAfter = clearAfter;
+    return s;
+}
+
+UiScreen uiBanner(uint16_t holdMs, bool clearAfter) {
+    UiScreen s = uiScreen(TFT_BLACK, holdMs, clearAfter);
+    s.fill = false;
+    return s;
+}
+
+void uiAddLine(UiScreen& s, const String& text, uint16_t color, int16_t y, uint8_t font, int16_t x) {
+    if (s.lines >= UI_MAX_LINES) return;
+    UiLine& l = s.line[s.lines++];
+    strlcpy(l.text, text.c_str(), sizeof(l.text));
+    l.color = color;
+    l.x = x;
+    l.y = y;
+    l.font = font;
+}
+
+void uiShow(const UiScreen& s) {
+    unsigned long until = millis() + s.holdMs;
+    holdUntil = until ? until : 1;
+    if (screenQueue) xQueueSend(screenQueue, &s, 0);
+}
+
+void uiSetOverlay(const PreviewOverlay& ov) {
+    if (overlayBox) xQueueOverwrite(overlayBox, &ov);
+}
+
+bool uiHeld() {
+    unsigned long until = holdUntil;
+    return until && (long)(millis() - until) < 0;
+}
+
+bool rendererBegin(TFT_eSPI& display, uint16_t frameWidth) {
+    tft = &display;
+    screenQueue = xQueueCreate(UI_QUEUE_DEPTH, sizeof(UiScreen));
+    overlayBox = xQueueCreate(1, sizeof(PreviewOverlay));
+    for (int i = 0; i < 2; i++) {
+        // Dải phải nằm ở RAM trong để SPI DMA đọc được
+        band[i] = new TFT_eSprite(tft);
+        band[i]->setColorDepth(16);
+        band[i]->setAttribute(PSRAM_ENABLE, false);
+        if (!band[i]->createSprite(frameWidth, RENDER_BAND_LINES)) return false;
+    }
+    dma = tft->initDMA();
+    if (!dma) LOGW("⚠️ [TFT] Không bật được DMA -> đẩy dải bằng CPU.");
+    return true;
+}
+
+static void drawScreen(const UiScreen& s) {
+    if (s.fill) tft->fillScreen(s.bg);
+    for (uint8_t i = 0; i < s.lines; i++) {
+        const UiLine& l = s.line[i];
+        tft->setTextColor(l.color, s.bg);
+        tft->drawCentreString(l.text, l.x < 0 ? tft->width() / 2 : l.x, l.y, l.font);
+    }
+}
+
+static void serviceScreens() {
+    UiScreen s;
+    while (xQueueReceive(screenQueue, &s, 0) == pdTRUE) {
+        drawScreen(s);
+        screenActive = true;
+        screenUntil = millis() + s.holdMs;
+        screenClearAfter = s.clearAfter;
+        marginsDirty = true;
+    }
+    if (screenActive && (long)(millis() - screenUntil) >= 0) {
+        screenActive = false;
+        if (screenClearAfter) tft->fillScreen(TFT_BLACK);
+    }
+}
+
+// Vẽ lớp phủ lên g (TFT hoặc sprite dải) với gốc toạ độ màn hình dời (ox, oy).
+// bandY/bandH giới hạn các phần tử cần vẽ theo hàng.
+static void drawOverlay(TFT_eSPI& g, const PreviewOverlay& ov, int xPos, int ox, int oy, int bandY, int bandH) {
+    int w = tft->width();
+    auto hit = [&](int y, int h) { return y < bandY + bandH && y + h > bandY; };
+    g.setTextDatum(TL_DATUM);
+    if (ov.boxW && hit(ov.boxY, ov.boxH)) {
+        g.drawRect(xPos + ov.boxX + ox, ov.boxY + oy, ov.boxW, ov.boxH, ov.boxColor);
+    }
+    if (ov.title && hit(10, 26)) {
+        g.setTextColor(TFT_YELLOW, TFT_BLACK);
+        g.drawString(ov.title, 5 + ox, 10 + oy, 4);
+    }
+    if (ov.hint && hit(195, 26)) {
+        g.setTextColor(TFT_ORANGE, TFT_BLACK);
+        g.drawCentreString(ov.hint, w / 2 + ox, 195 + oy, 4);
+    }
+    if (ov.busy && hit(12, 17)) g.fillCircle(w - 20 + ox, 20 + oy, 8, TFT_BLUE);
+    if (ov.clock[0] && hit(220, 16)) {
+        g.setTextColor(TFT_GREEN, TFT_BLACK);
+        g.drawString(ov.clock, 5 + ox, 220 + oy, 2);
+    }
+}
+
+// Vùng chiếm bởi các phần tử có thể tràn ra lề (tiêu đề, chấm bận, đồng hồ)
+static uint8_t marginRects(const PreviewOverlay& ov, Rect* out) {
+    uint8_t n = 0;
+    if (ov.title) out[n++] = {5, 10, (int16_t)tft->textWidth(ov.title, 4), (int16_t)tft->fontHeight(4)};
+    if (ov.busy) out[n++] = {(int16_t)(tft->width() - 28), 12, 17, 17};
+    if (ov.clock[0]) out[n++] = {5, 220, (int16_t)tft->textWidth(ov.clock, 2), (int16_t)tft->fontHeight(2)};
+    return n;
+}
+
+// Lề ngoài vùng video: xoá vùng cũ rồi vẽ lại chỉ khi lớp phủ ở lề đổi
+static void updateMargins(const PreviewOverlay& ov, int xPos, int frameW, int frameH) {
+    bool same = !marginsDirty && ov.title == lastMargin.title && ov.busy == lastMargin.busy &&
+                strcmp(ov.clock, lastMargin.clock) == 0;
+    if (same) return;
+
+    Rect now[3];
+    uint8_t count = marginRects(ov, now);
+    int edges[2][2] = {{0, xPos}, {xPos + frameW, tft->width() - xPos - frameW}};
+    for (auto& e : edges) {
+        if (e[1] <= 0) continue;
+        tft->setViewport(e[0], 0, e[1], frameH, false);
+        for (uint8_t i = 0; i < lastRectCount; i++) {
+            const Rect& r = lastRects[i];
+            tft->fillRect(r.x, r.y, r.w, r.h, TFT_BLACK);
+        }
+        drawOverlay(*tft, ov, xPos, 0, 0, 0, frameH);
+        tft->resetViewport();
+    }
+    memcpy(lastRects, now, sizeof(now));
+    lastRectCount = count;
+    lastMargin = ov;
+    marginsDirty = false;
+}
+
+bool rendererDrawFrame(Frame* frame) {
+    serviceScreens();
+    if (!frame || screenActive || uiHeld()) return false;
+
+    PreviewOverlay ov = {};
+    xQueuePeek(overlayBox, &ov, 0);
+
+    camera_fb_t* fb = &frame->fb;
+    int xPos = (tft->width() - fb->width) / 2;
+    size_t stride = fb->width * 2;
+
+    tft->startWrite();
+    for (int y = 0, i = 0; y < fb->height; y += RENDER_BAND_LINES, i ^= 1) {
+        int h = min(RENDER_BAND_LINES, (int)fb->height - y);
+        TFT_eSprite* s = band[i];
+        // Dải này đã được DMA đẩy xong từ 2 lượt trước (pushImageDMA chờ lượt trước đó)
+        uint8_t* dst = (uint8_t*)s->getPointer();
+        memcpy(dst, fb->buf + y * stride, h * stride);
+        drawOverlay(*s, ov, xPos, -xPos, -y, y, h);
+        if (dma) tft->pushImageDMA(xPos, y, fb->width, h, (uint16_t*)dst);
+        else tft->pushImage(xPos, y, fb->width, h, (uint16_t*)dst);
+    }
+    if (dma) tft->dmaWait();
+    updateMargins(ov, xPos, fb->width, fb->height);
+    tft->endWrite();
+    return true;
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include <Arduino.h>
+#include <TFT_eSPI.h>
+#include "frame_pipeline.h"
+
+// Renderer TFT: chỉ RenderTask (core 0) được vẽ lên màn hình, các task khác gửi
+// thông điệp UI (uiShow / uiSetOverlay) thay vì giữ mutex TFT.
+//  - Preview được ghép theo dải (RENDER_BAND_LINES dòng) trong 2 sprite ở RAM trong:
+//    chép dòng từ frame PSRAM + vẽ lớp phủ vào dải, đẩy bằng DMA (pushImageDMA)
+//    trong lúc chuẩn bị dải kế tiếp -> lớp phủ không nhấp nháy, CPU không chờ SPI.
+//  - Phần lớp phủ nằm ngoài vùng video (lề trái/phải) chỉ vẽ lại khi thay đổi,
+//    xoá đúng vùng cũ (dirty rect) thay cho fillScreen.
+//  - Màn hình trạng thái/kết quả (UiScreen) được giữ holdMs, preview tạm dừng trong lúc đó.
+
+#define RENDER_BAND_LINES  24
+#define UI_MAX_LINES       3
+#define UI_TEXT_LEN        32
+#define UI_QUEUE_DEPTH     4
+
+// Lớp phủ trên preview. title/hint phải là chuỗi hằng (chỉ lưu con trỏ).
+struct PreviewOverlay {
+    int16_t boxX, boxY, boxW, boxH;   // toạ độ trong frame; boxW = 0: không có khung mặt
+    uint16_t boxColor;
+    const char* title;                // tên bước enroll (góc trên)
+    const char* hint;                 // "LAI GAN HON" / "XA RA CHUT"
+    bool busy;                        // chấm xanh: đang chờ server
+    char clock[24];                   // rỗng: không hiện giờ
+};
+
+struct UiLine {
+    char text[UI_TEXT_LEN];
+    uint16_t color;
+    int16_t x;                        // tâm chữ; < 0: giữa màn hình
+    int16_t y;
+    uint8_t font;
+};
+
+struct UiScreen {
+    bool fill;                        // false: chỉ vẽ chữ đè lên preview đang dừng
+    uint16_t bg;
+    uint8_t lines;
+    UiLine line[UI_MAX_LINES];
+    uint16_t holdMs;
+    bool clearAfter;                  // hết giờ giữ thì xoá màn hình về đen
+};
+
+bool rendererBegin(TFT_eSPI& display, uint16_t frameWidth);
+// FrameRenderer của pipeline. frame = nullptr: chỉ xử lý thông điệp UI.
+bool rendererDrawFrame(Frame* frame);
+
+UiScreen uiScreen(uint16_t bg, uint16_t holdMs, bool clearAfter);
+UiScreen uiBanner(uint16_t holdMs, bool clearAfter);
+void uiAddLine(UiScreen& s, const String& text, uint16_t color, int16_t y, uint8_t font, int16_t x = -1);
+
+// Không chặn; màn hình được coi là đang giữ ngay từ lúc gọi
+void uiShow(const UiScreen& s);
+void uiSetOverlay(const PreviewOverlay& ov);
+// true trong lúc 1 màn hình kết quả/trạng thái đang được giữ
+bool uiHeld();
@@ -0,0 +1,262 @@
+#include "upload_stream.h"
+
+static const char B64_TABLE[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static size_t encodeBase64(const uint8_t* src, size_t len, char* out) {
+    size_t o = 0;
+    size_t i = 0;
+    for (; i + 3 <= len; i += 3) {
+        uint32_t v = (src[i] << 16) | (src[i + 1] << 8) | src[i + 2];
+        out[o++] = B64_TABLE[(v >> 18) & 0x3F];
+        out[o++] = B64_TABLE[(v >> 12) & 0x3F];
+        out[o++] = B64_TABLE[(v >> 6) & 0x3F];
+        out[o++] = B64_TABLE[v & 0x3F];
+    }
+    if (i < len) {
+        uint32_t v = src[i] << 16;
+        if (i + 1 < len) v |= src[i + 1] << 8;
+        out[o++] = B64_TABLE[(v >> 18) & 0x3F];
+        out[o++] = B64_TABLE[(v >> 12) & 0x3F];
+        out[o++] = (i + 1 < len) ? B64_TABLE[(v >> 6) & 0x3F] : '=';
+        out[o++] = '=';
+    }
+    return o;
+}
+
+int JournalImageSource::read() {
+    char c;
+    return readBytes(&c, 1) == 1 ? (uint8_t)c : -1;
+}
+
+int JournalImageSource::peek() {
+    uint8_t c;
+    return _journal.read(_rec, _pos, &c, 1) == 1 ? c : -1;
+}
+
+size_t JournalImageSource::readBytes(char* buffer, size_t length) {
+    size_t n = _journal.read(_rec, _pos, (uint8_t*)buffer, length);
+    _pos += n;
+    return n;
+}
+
+bool JournalBatchSource::add(const JournalRecord& rec) {
+    if (_count >= JOURNAL_BATCH_MAX) return false;
+    _recs[_count++] = rec;
+    _total += JOURNAL_HEADER_LEN + rec.length;
+    return true;
+}
+
+int JournalBatchSource::read() {
+    char c;
+    return readBytes(&c, 1) == 1 ? (uint8_t)c : -1;
+}
+
+int JournalBatchSource::peek() {
+    uint8_t idx = _idx; uint32_t pos = _pos;
+    while (idx < _count && pos >= JOURNAL_HEADER_LEN + _recs[idx].length) { idx++; pos = 0; }
+    uint8_t c;
+    return (idx < _count && _journal.readRecord(_recs[idx], pos, &c, 1) == 1) ? c : -1;
+}
+
+size_t JournalBatchSource::readBytes(char* buffer, size_t length) {
+    size_t out = 0;
+    while (out < length && _idx < _count) {
+        size_t n = _journal.readRecord(_recs[_idx], _pos, (uint8_t*)buffer + out, length - out);
+        if (n == 0) {
+            if (_pos < JOURNAL_HEADER_LEN + _recs[_idx].length) break; // lỗi đọc thẻ SD
+            _idx++; _pos = 0;
+            continue;
+        }
+        out += n; _pos += n;
+    }
+    _sent += out;
+    return out;
+}
+
+const char Base64JsonStream::SEPARATOR[] = "\",\"";
+
+Base64JsonStream::Base64JsonStream(const String& prefix, const String& suffix)
+    : _prefix(prefix), _suffix(suffix) {}
+
+void Base64JsonStream::setSource(const uint8_t* buf, size_t len) {
+    _src = nullptr;
+    _parts = 1;
+    _mem[0] = buf; _memLen[0] = len;
+    rewind();
+}
+
+bool Base64JsonStream::setSource(ImageSource* src) {
+    _src = src;
+    _parts = 1;
+    _mem[0] = nullptr; _memLen[0] = src ? src->size() : 0;
+    return rewind();
+}
+
+bool Base64JsonStream::addSource(const uint8_t* buf, size_t len) {
+    if (_src || _parts >= UPLOAD_MAX_PARTS) return false;
+    _mem[_parts] = buf; _memLen[_parts] = len;
+    _parts++;
+    rewind();
+    return true;
+}
+
+size_t Base64JsonStream::totalLength() const {
+    size_t total = _prefix.length() + _suffix.length();
+    for (uint8_t i = 0; i < _parts; i++) total += (_memLen[i] + 2) / 3 * 4;
+    if (_parts > 1) total += (_parts - 1) * (sizeof(SEPARATOR) - 1);
+    return total;
+}
+
+bool Base64JsonStream::rewind() {
+    _seg = 0; _segPos = 0; _sent = 0;
+    _part = 0;
+    _rawLen = _parts ? _memLen[0] : 0;
+    _rawPos = 0;
+    _chunkLen = 0; _chunkPos = 0;
+    _error = false;
+    if (_src) return _src->rewind();
+    return true;
+}
+
+size_t Base64JsonStream::readRaw(uint8_t* dst, size_t len) {
+    if (len > _rawLen - _rawPos) len = _rawLen - _rawPos;
+    if (len == 0) return 0;
+    size_t n = 0;
+    if (_src) {
+        n = _src->readBytes((char*)dst, len);
+    } else if (_mem[_part]) {
+        memcpy(dst, _mem[_part] + _rawPos, len);
+        n = len;
+    }
+    _rawPos += n;
+    return n;
+}
+
+// Đọc tiếp RAW_CHUNK byte ảnh và mã hoá sang base64 vào _chunk.
+// Nguồn SD/journal có thể trả thiếu (ranh giới cluster, hết giờ) -> đọc tiếp tới đủ RAW_CHUNK
+// hoặc hết phần ảnh: khối giữa ảnh luôn là bội số của 3 nên '=' chỉ có thể nằm ở cuối ảnh.
+// Nguồn hết trước _rawLen -> đánh dấu lỗi, request bị huỷ thay vì gửi body thiếu/hỏng.
+bool Base64JsonStream::fillChunk() {
+    if (_error) return false;
+    uint8_t raw[RAW_CHUNK];
+    size_t n = 0;
+    while (n < RAW_CHUNK && _rawPos < _rawLen) {
+        size_t got = readRaw(raw + n, RAW_CHUNK - n);
+        if (got == 0) {
+            _error = true;
+            return false;
+        }
+        n += got;
+    }
+    if (n == 0) return false;
+    _chunkLen = encodeBase64(raw, n, _chunk);
+    _chunkPos = 0;
+    return true;
+}
+
+int Base64JsonStream::available() {
+    if (_error) return -1;    // HTTPClient dừng gửi và báo SEND_PAYLOAD_FAILED (thiếu Content-Length)
+    size_t left = totalLength() - _sent;
+    return left > 0x7FFFFFFF ? 0x7FFFFFFF : (int)left;
+}
+
+int Base64JsonStream::read() {
+    char c;
+    return readBytes(&c, 1) == 1 ? (uint8_t)c : -1;
+}
+
+// Không đọc nguồn ảnh: ký tự base64 đầu của khối kế tiếp chỉ phụ thuộc byte thô đầu tiên
+int Base64JsonStream::peek() {
+    if (_error) return -1;
+    if (_seg == 0 && _segPos < _prefix.length()) return (uint8_t)_prefix[_segPos];
+    if (_seg == 3) return (uint8_t)SEPARATOR[_segPos];
+    if (_seg == 2) return (_segPos < _suffix.length()) ? (uint8_t)_suffix[_segPos] : -1;
+    if (_chunkPos < _chunkLen) return (uint8_t)_chunk[_chunkPos];
+    if (_rawPos < _rawLen) {
+        int b = _src ? _src->peek() : (_mem[_part] ? _mem[_part][_rawPos] : -1);
+        return b < 0 ? -1 : (uint8_t)B64_TABLE[(b >> 2) & 0x3F];
+    }
+    if (_part + 1 < _parts) return (uint8_t)SEPARATOR[0];
+    return _suffix.length() > 0 ? (uint8_t)_suffix[0] : -1;
+}
+
+size_t Base64JsonStream::readBytes(char* buffer, size_t length) {
+    size_t out = 0;
+    while (out < length) {
+        if (_seg == 0) {
+            size_t n = min(length - out, _prefix.length() - _segPos);
+            memcpy(buffer + out, _prefix.c_str() + _segPos, n);
+            out += n; _segPos += n;
+            if (_segPos >= _prefix.length()) { _seg = 1; _segPos = 0; }
+        } else if (_seg == 1) {
+            if (_chunkPos >= _chunkLen && !fillChunk()) {
+                if (_error) break;
+                // Hết ảnh hiện tại -> dấu phân cách nếu còn ảnh, không thì sang phần đuôi
+                _seg = (_part + 1 < _parts) ? 3 : 2;
+                _segPos = 0;
+                continue;
+            }
+            size_t n = min(length - out, _chunkLen - _chunkPos);
+            memcpy(buffer + out, _chunk + _chunkPos, n);
+            out += n; _chunkPos += n;
+        } else if (_seg == 3) {
+            size_t n = min(length - out, sizeof(SEPARATOR) - 1 - _segPos);
+            memcpy(buffer + out, SEPARATOR + _segPos, n);
+            out += n; _segPos += n;
+            if (_segPos >= sizeof(SEPARATOR) - 1) {
+                _part++;
+                _rawLen = _memLen[_part];
+                _rawPos = 0;
+                _seg = 1; _segPos = 0;
+            }
+        } else {
+            size_t n = min(length - out, _suffix.length() - _segPos);
+            if (n == 0) break;
+            memcpy(buffer + out, _suffix.c_str() + _segPos, n);
+            out += n; _segPos += n;
+        }
+    }
+    _sent += out;
+    return out;
+}
+
+bool MultiBufferStream::add(const uint8_t* buf, size_t len) {
+    if (_count >= UPLOAD_MAX_PARTS) return false;
+    _buf[_count] = buf; _len[_count] = len;
+    _count++;
+    return true;
+}
+
+size_t MultiBufferStream::totalLength() const {
+    size_t total = 0;
+    for (uint8_t i = 0; i < _count; i++) total += _len[i];
+    return total;
+}
+
+int MultiBufferStream::available() {
+    return (int)(totalLength() - _sent);
+}
+
+int MultiBufferStream::read() {
+    char c;
+    return readBytes(&c, 1) == 1 ? (uint8_t)c : -1;
+}
+
+int MultiBufferStream::peek() {
+    uint8_t i = _idx; size_t pos = _pos;
+    while (i < _count && pos >= _len[i]) { i++; pos = 0; }
+    return i < _count ? _buf[i][pos] : -1;
+}
+
+size_t MultiBufferStream::readBytes(char* buffer, size_t length) {
+    size_t out = 0;
+    while (out < length && _idx < _count) {
+        size_t n = min(length - out, _len[_idx] - _pos);
+        memcpy(buffer + out, _buf[_idx] + _pos, n);
+        out += n; _pos += n;
+        if (_pos >= _len[_idx]) { _idx++; _pos = 0; }
+    }
+    _sent += out;
+    return out;
+}
@@ -0,0 +1,139 @@
+#pragma once
+#include <Arduino.h>
+#include "offline_journal.h"
+
+#define UPLOAD_MAX_PARTS 5
+
+// Nguồn ảnh đọc tuần tự và quay lại đầu được (HttpSession có thể phải gửi lại request)
+class ImageSource : public Stream {
+public:
+    virtual size_t size() = 0;
+    virtual bool rewind() = 0;
+    size_t write(uint8_t) override { return 0; }
+    void flush() override {}
+};
+
+// Ảnh của 1 record trong journal offline, đọc thẳng từ thẻ SD theo từng khối
+class JournalImageSource : public ImageSource {
+public:
+    JournalImageSource(OfflineJournal& journal, const JournalRecord& rec) : _journal(journal), _rec(rec) {}
+
+    size_t size() override { return _rec.length; }
+    bool rewind() override { _pos = 0; return true; }
+    int available() override { return _rec.length - _pos; }
+    int read() override;
+    int peek() override;
+    size_t readBytes(char* buffer, size_t length) override;
+
+private:
+    OfflineJournal& _journal;
+    JournalRecord _rec;
+    uint32_t _pos = 0;
+};
+
+#define JOURNAL_BATCH_MAX 16
+
+// Body của /api/ai/ingest_batch: nhiều record journal (header + JPEG) nối liền,
+// đọc thẳng từ thẻ SD theo từng khối nên RAM không phụ thuộc kích thước batch
+class JournalBatchSource : public ImageSource {
+public:
+    explicit JournalBatchSource(OfflineJournal& journal) : _journal(journal) {}
+
+    bool add(const JournalRecord& rec);
+    uint8_t count() const { return _count; }
+    const JournalRecord& record(uint8_t i) const { return _recs[i]; }
+
+    size_t size() override { return _total; }
+    bool rewind() override { _idx = 0; _pos = 0; _sent = 0; return true; }
+    int available() override { return _total - _sent; }
+    int read() override;
+    int peek() override;
+    size_t readBytes(char* buffer, size_t length) override;
+
+private:
+    OfflineJournal& _journal;
+    JournalRecord _recs[JOURNAL_BATCH_MAX];
+    uint8_t _count = 0;
+    uint8_t _idx = 0;        // record đang đọc
+    uint32_t _pos = 0;       // vị trí trong record đó (tính cả header)
+    size_t _total = 0;
+    size_t _sent = 0;
+};
+
+// Stream chỉ-đọc sinh body JSON dạng: <prefix><base64 ảnh 1>","<base64 ảnh 2>...<suffix>
+// Ảnh được mã hoá base64 theo từng khối nhỏ ngay khi HTTPClient đọc,
+// nên không bao giờ giữ bản base64 hay payload đầy đủ trong heap.
+// Nguồn ảnh có thể là buffer trong RAM (tối đa UPLOAD_MAX_PARTS ảnh) hoặc 1 ImageSource (journal SD).
+class Base64JsonStream : public Stream {
+public:
+    static const size_t RAW_CHUNK = 384;                 // bội số của 3
+    static const size_t B64_CHUNK = RAW_CHUNK / 3 * 4;   // 512 ký tự
+
+    Base64JsonStream(const String& prefix, const String& suffix);
+
+    void setSource(const uint8_t* buf, size_t len);
+    bool setSource(ImageSource* src);     // false nếu không quay lại đầu nguồn được
+    // Thêm ảnh tiếp theo (phân cách bằng "," trong mảng JSON)
+    bool addSource(const uint8_t* buf, size_t len);
+
+    // Tổng số byte của body (dùng làm Content-Length)
+    size_t totalLength() const;
+    // Quay về đầu stream để gửi lại (khi kết nối bị đóng giữa chừng)
+    bool rewind();
+    // Nguồn ảnh hết trước độ dài đã khai báo: body không gửi đủ, available() trả -1
+    bool failed() const { return _error; }
+
+    int available() override;
+    int read() override;
+    int peek() override;
+    size_t readBytes(char* buffer, size_t length) override;
+    size_t write(uint8_t) override { return 0; }
+    void flush() override {}
+
+private:
+    bool fillChunk();
+    size_t readRaw(uint8_t* dst, size_t len);
+
+    static const char SEPARATOR[];
+
+    String _prefix, _suffix;
+    const uint8_t* _mem[UPLOAD_MAX_PARTS] = {};
+    size_t _memLen[UPLOAD_MAX_PARTS] = {};
+    uint8_t _parts = 0;
+    uint8_t _part = 0;
+    ImageSource* _src = nullptr;
+    size_t _rawLen = 0;      // độ dài phần ảnh hiện tại
+    size_t _rawPos = 0;
+
+    uint8_t _seg = 0;        // 0 = prefix, 1 = base64, 2 = suffix, 3 = dấu phân cách
+    size_t _segPos = 0;
+    size_t _sent = 0;
+    bool _error = false;
+
+    char _chunk[B64_CHUNK];
+    size_t _chunkLen = 0;
+    size_t _chunkPos = 0;
+};
+
+// Stream chỉ-đọc nối nhiều buffer JPEG liền nhau (upload batch ở chế độ nhị phân)
+class MultiBufferStream : public Stream {
+public:
+    bool add(const uint8_t* buf, size_t len);
+    size_t totalLength() const;
+    void rewind() { _idx = 0; _pos = 0; _sent = 0; }
+
+    int available() override;
+    int read() override;
+    int peek() override;
+    size_t readBytes(char* buffer, size_t length) override;
+    size_t write(uint8_t) override { return 0; }
+    void flush() override {}
+
+private:
+    const uint8_t* _buf[UPLOAD_MAX_PARTS] = {};
+    size_t _len[UPLOAD_MAX_PARTS] = {};
+    uint8_t _count = 0;
+    uint8_t _idx = 0;
+    size_t _pos = 0;
+    size_t _sent = 0;
+};
@@ -0,0 +1,130 @@
+#include "uploader.h"
+#include "metrics.h"
+#include "image_pool.h"
+
+static QueueHandle_t uploadQueue = nullptr;
+static QueueHandle_t resultQueue = nullptr;
+static UploadSender uploadSender = nullptr;
+static portMUX_TYPE statsMux = portMUX_INITIALIZER_UNLOCKED;
+static UploaderStats stats = {};
+static uint32_t nextJobId = 1;
+static volatile uint32_t inFlight = 0;
+static volatile uint32_t awaiting = 0;     // đã gửi qua WebSocket, chờ kết quả
+
+static void freeJob(UploadJob& job) {
+    for (uint8_t i = 0; i < job.count; i++) imageFree(job.jpg[i]);
+}
+
+static void queueResult(const UploadJob& job, const ServerReply& reply) {
+    UploadResult r = {};
+    r.id = job.id;
+    strlcpy(r.type, job.type, sizeof(r.type));
+    r.offline = (reply.kind == REPLY_OFFLINE);
+    r.latencyMs = millis() - job.queuedAt;
+    r.reply = reply;
+
+    // Hàng đợi kết quả đầy -> bỏ kết quả cũ nhất, kết quả mới luôn quan trọng hơn
+    if (xQueueSend(resultQueue, &r, 0) != pdTRUE) {
+        UploadResult old;
+        xQueueReceive(resultQueue, &old, 0);
+        xQueueSend(resultQueue, &r, 0);
+        portENTER_CRITICAL(&statsMux); stats.resultsLost++; portEXIT_CRITICAL(&statsMux);
+    }
+}
+
+static void pushResult(const UploadJob& job, const ServerReply& reply) {
+    queueResult(job, reply);
+    portENTER_CRITICAL(&statsMux); stats.completed++; portEXIT_CRITICAL(&statsMux);
+}
+
+static void UploaderTask(void* pvParameters) {
+    UploadJob job;
+    for (;;) {
+        if (xQueueReceive(uploadQueue, &job, portMAX_DELAY) != pdTRUE) continue;
+        inFlight = 1;
+
+        ServerReply reply = uploadSender(job);
+        if (reply.kind == REPLY_PENDING) {
+            // Ảnh thuộc về đường WebSocket tới khi uploaderComplete(); nhận job kế tiếp ngay
+            portENTER_CRITICAL(&statsMux); awaiting++; portEXIT_CRITICAL(&statsMux);
+        } else {
+            freeJob(job);
+            pushResult(job, reply);
+        }
+        inFlight = 0;
+    }
+}
+
+void uploaderComplete(UploadJob& job, const ServerReply& reply) {
+    freeJob(job);
+    pushResult(job, reply);
+    portENTER_CRITICAL(&statsMux); if (awaiting) awaiting--; portEXIT_CRITICAL(&statsMux);
+}
+
+void uploaderBegin(UploadSender sender) {
+    uploadSender = sender;
+    uploadQueue = xQueueCreate(UPLOAD_QUEUE_DEPTH, sizeof(UploadJob));
+    resultQueue = xQueueCreate(RESULT_QUEUE_DEPTH, sizeof(UploadResult));
+    TaskHandle_t task;
+    xTaskCreatePinnedToCore(UploaderTask, "UploadTask", 8192, NULL, 2, &task, 0);
+    metricsRegisterTask(task);
+}
+
+uint32_t uploaderSubmit(uint8_t* const* jpgs, const size_t* lens, uint8_t count,
+                        const char* type, const char* extra, UploadPolicy policy,
+                        uint16_t aligned) {
+    if (count == 0 || count > UPLOAD_MAX_PARTS) return 0;
+    UploadJob job = {};
+    for (uint8_t i = 0; i < count; i++) {
+        job.jpg[i] = jpgs[i];
+        job.len[i] = lens[i];
+    }
+    job.count = count;
+    strlcpy(job.type, type, sizeof(job.type));
+    strlcpy(job.extra, extra ? extra : "", sizeof(job.extra));
+    job.aligned = aligned;
+    job.queuedAt = millis();
+
+    portENTER_CRITICAL(&statsMux);
+    job.id = nextJobId++;
+    portEXIT_CRITICAL(&statsMux);
+
+    if (xQueueSend(uploadQueue, &job, 0) == pdTRUE) {
+        portENTER_CRITICAL(&statsMux); stats.submitted++; portEXIT_CRITICAL(&statsMux);
+        return job.id;
+    }
+
+    if (policy == UPLOAD_DROP_OLDEST) {
+        UploadJob old;
+        if (xQueueReceive(uploadQueue, &old, 0) == pdTRUE) {
+            freeJob(old);
+            // Báo kết quả cho job bị bỏ, nếu không ai chờ id đó sẽ treo tới hết giờ
+            ServerReply reply;
+            serverReplyClear(reply, REPLY_DROPPED);
+            queueResult(old, reply);
+            portENTER_CRITICAL(&statsMux); stats.dropped++; portEXIT_CRITICAL(&statsMux);
+        }
+        if (xQueueSend(uploadQueue, &job, 0) == pdTRUE) {
+            portENTER_CRITICAL(&statsMux); stats.submitted++; portEXIT_CRITICAL(&statsMux);
+            return job.id;
+        }
+    }
+
+    portENTER_CRITICAL(&statsMux); stats.rejected++; portEXIT_CRITICAL(&statsMux);
+    return 0;
+}
+
+bool uploaderPollResult(UploadResult& out, TickType_t wait) {
+    return resultQueue && xQueueReceive(resultQueue, &out, wait) == pdTRUE;
+}
+
+uint32_t uploaderPending() {
+    return uploadQueue ? uxQueueMessagesWaiting(uploadQueue) + inFlight + awaiting : 0;
+}
+
+UploaderStats uploaderStats() {
+    portENTER_CRITICAL(&statsMux);
+    UploaderStats s = stats;
+    portEXIT_CRITICAL(&statsMux);
+    return s;
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include <Arduino.h>
+#include "upload_stream.h"
+#include "server_reply.h"
+
+// Pipeline upload bất đồng bộ: CameraAppTask (core 1) đẩy ảnh đã nén vào hàng đợi
+// có giới hạn, UploaderTask (core 0) gửi lên server rồi trả kết quả qua hàng đợi
+// kết quả. Camera/UI không bao giờ phải chờ mạng.
+
+#define UPLOAD_QUEUE_DEPTH   3
+#define RESULT_QUEUE_DEPTH   4
+
+// Khi hàng đợi đầy:
+//  - UPLOAD_REJECT_NEW  : từ chối job mới (người gọi vẫn giữ và tự imageFree ảnh)
+//  - UPLOAD_DROP_OLDEST : bỏ job cũ nhất đang chờ để nhường chỗ (ảnh cũ bị free, job đó vẫn
+//                         có kết quả REPLY_DROPPED trong hàng đợi kết quả -> người chờ không treo)
+enum UploadPolicy { UPLOAD_REJECT_NEW, UPLOAD_DROP_OLDEST };
+
+struct UploadJob {
+    uint32_t id;
+    uint8_t* jpg[UPLOAD_MAX_PARTS];   // lấy bằng imageAcquire (image_pool.h), UploaderTask sẽ imageFree()
+    size_t len[UPLOAD_MAX_PARTS];
+    uint8_t count;         // > 1: cả burst gửi trong 1 request
+    char type[12];         // "recognize" | "enroll"
+    char extra[32];        // employee_id khi enroll
+    uint16_t aligned;      // cạnh ảnh mặt đã căn theo 2 mắt (0 = cắt theo khung mặt)
+    unsigned long queuedAt;
+};
+
+struct UploadResult {
+    uint32_t id;
+    char type[12];
+    bool offline;          // không gửi được -> đã lưu offline
+    unsigned long latencyMs;   // từ lúc xếp hàng tới khi có kết quả
+    ServerReply reply;         // phản hồi đã giải mã (kind = REPLY_OFFLINE khi lưu offline)
+};
+
+struct UploaderStats {
+    uint32_t submitted;
+    uint32_t rejected;     // bị từ chối vì hàng đợi đầy
+    uint32_t dropped;      // job cũ bị bỏ theo UPLOAD_DROP_OLDEST
+    uint32_t completed;
+    uint32_t resultsLost;  // hàng đợi kết quả đầy
+};
+
+// Trả về REPLY_PENDING nghĩa là job đã gửi bất đồng bộ (WebSocket): ảnh chưa bị free,
+// người gửi gọi uploaderComplete() khi có kết quả / hết giờ.
+typedef ServerReply (*UploadSender)(const UploadJob& job);
+
+void uploaderBegin(UploadSender sender);
+// Không chặn. Trả về id của job (>0) hoặc 0 nếu bị từ chối (khi đó người gọi vẫn sở hữu các ảnh).
+uint32_t uploaderSubmit(uint8_t* const* jpgs, const size_t* lens, uint8_t count,
+                        const char* type, const char* extra, UploadPolicy policy,
+                        uint16_t aligned = 0);
+bool uploaderPollResult(UploadResult& out, TickType_t wait = 0);
+// Kết thúc job đã trả REPLY_PENDING: free ảnh và đưa kết quả vào hàng đợi kết quả
+void uploaderComplete(UploadJob& job, const ServerReply& reply);
+uint32_t uploaderPending();
+UploaderStats uploaderStats();
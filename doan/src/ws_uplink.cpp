@@ -0,0 +1,222 @@
+#include "ws_uplink.h"
+#include "metrics.h"
+#include "logger.h"
+#include "image_pool.h"
+
+struct Pending {
+    bool used;
+    bool sending;          // UploaderTask đang gửi: abort / hết giờ không được đụng tới (job vẫn của người gửi)
+    UploadJob job;
+    uint32_t sentAt;
+    uint32_t timeoutMs;
+    size_t bytes;
+};
+
+static WebSocketsClient* wsClient = nullptr;
+static WsUplinkDone doneCallback = nullptr;
+static SemaphoreHandle_t wsMutex = nullptr;
+static volatile bool serverSupported = false;
+
+static Pending pending[WS_UPLINK_INFLIGHT];
+static portMUX_TYPE pendingMux = portMUX_INITIALIZER_UNLOCKED;
+static WsUplinkStats stats = {};
+
+void wsUplinkBegin(WebSocketsClient* ws, WsUplinkDone done) {
+    wsClient = ws;
+    doneCallback = done;
+    if (!wsMutex) wsMutex = xSemaphoreCreateRecursiveMutex();
+}
+
+void wsLock() {
+    xSemaphoreTakeRecursive(wsMutex, portMAX_DELAY);
+}
+
+void wsUnlock() {
+    xSemaphoreGiveRecursive(wsMutex);
+}
+
+void wsUplinkSetSupported(bool supported) {
+    if (supported != serverSupported) {
+        LOGI("%s", supported ? "🔌 [WS] Server nhận ảnh qua WebSocket -> bỏ HTTP POST."
+                             : "🔌 [WS] Gửi ảnh qua HTTP.");
+    }
+    serverSupported = supported;
+}
+
+static int inFlightLocked() {
+    int n = 0;
+    for (int i = 0; i < WS_UPLINK_INFLIGHT; i++) n += pending[i].used;
+    return n;
+}
+
+bool wsUplinkReady() {
+    if (!serverSupported || !wsClient || !wsClient->isConnected()) return false;
+    portENTER_CRITICAL(&pendingMux);
+    bool room = inFlightLocked() < WS_UPLINK_INFLIGHT;
+    portEXIT_CRITICAL(&pendingMux);
+    return room;
+}
+
+// Lấy request ra khỏi bảng (id = 0: lấy bất kỳ ô nào đang dùng). false nếu không có.
+static bool takePending(uint32_t id, Pending& out) {
+    bool found = false;
+    portENTER_CRITICAL(&pendingMux);
+    for (int i = 0; i < WS_UPLINK_INFLIGHT && !found; i++) {
+        if (!pending[i].used || pending[i].sending || (id && pending[i].job.id != id)) continue;
+        out = pending[i];
+        pending[i].used = false;
+        found = true;
+    }
+    portEXIT_CRITICAL(&pendingMux);
+    return found;
+}
+
+static void finish(Pending& p, ServerReply& reply, bool ok) {
+    uint32_t rtt = millis() - p.sentAt;
+    if (ok) metricRecord(M_WS, rtt * 1000);
+    if (doneCallback) doneCallback(p.job, reply, ok, rtt, p.bytes);
+    uploaderComplete(p.job, reply);
+}
+
+bool wsUplinkSend(const UploadJob& job, uint32_t timestamp, uint32_t timeoutMs) {
+    if (!wsUplinkReady()) return false;
+
+    UplinkHeader h = {};
+    h.type = (strcmp(job.type, "enroll") == 0) ? UPLINK_ENROLL : UPLINK_RECOGNIZE;
+    h.count = job.count;
+    h.requestId = job.id;
+    h.timestamp = timestamp;
+    h.aligned = job.aligned;
+    strlcpy(h.employeeId, job.extra, sizeof(h.employeeId));
+    size_t bytes = 0;
+    for (uint8_t i = 0; i < job.count; i++) {
+        h.lengths[i] = job.len[i];
+        bytes += job.len[i];
+    }
+
+    // Chừa WEBSOCKETS_MAX_HEADER_SIZE byte đầu để thư viện ghi header WS + mask tại chỗ (không chép lại).
+    // Khung dựng trong arena của request (block của gUplinkPool), trả lại khi ra khỏi hàm.
+    size_t headerLen = uplinkHeaderLen(job.count);
+    ScratchArena arena(gUplinkPool);
+    uint8_t* frame = (uint8_t*)arena.alloc(WEBSOCKETS_MAX_HEADER_SIZE + headerLen + bytes, 1);
+    if (!frame) {
+        // Burst quá lớn / không có block -> gửi HTTP (stream thẳng từ ảnh, không cần khung)
+        portENTER_CRITICAL(&pendingMux); stats.noBuffer++; portEXIT_CRITICAL(&pendingMux);
+        return false;
+    }
+    uint8_t* p = frame + WEBSOCKETS_MAX_HEADER_SIZE;
+    p += uplinkEncodeHeader(h, p, headerLen);
+    for (uint8_t i = 0; i < job.count; i++) {
+        memcpy(p, job.jpg[i], job.len[i]);
+        p += job.len[i];
+    }
+
+    // Giữ khoá WS từ lúc kiểm tra kết nối tới khi gửi xong: NetworkTask không thể xử lý
+    // DISCONNECTED (wsUplinkAbort) xen vào giữa lúc ghi bảng và lúc gửi.
+    wsLock();
+    if (!wsClient->isConnected()) {
+        wsUnlock();
+        return false;
+    }
+    // Ghi vào bảng trước khi gửi: kết quả có thể về ngay khi NetworkTask lấy lại khoá
+    int slot = -1;
+    portENTER_CRITICAL(&pendingMux);
+    for (int i = 0; i < WS_UPLINK_INFLIGHT && slot < 0; i++) {
+        if (pending[i].used) continue;
+        slot = i;
+        pending[i].used = true;
+        pending[i].sending = true;
+        pending[i].job = job;
+        pending[i].sentAt = millis();
+        pending[i].timeoutMs = timeoutMs;
+        pending[i].bytes = headerLen + bytes;
+    }
+    uint32_t n = inFlightLocked();
+    if (n > stats.maxInFlight) stats.maxInFlight = n;
+    portEXIT_CRITICAL(&pendingMux);
+    if (slot < 0) {
+        wsUnlock();
+        return false;
+    }
+
+    // sendBIN lỗi thì thư viện gọi luôn DISCONNECTED ngay trong task này (khoá đệ quy) ->
+    // wsUplinkAbort bỏ qua ô đang "sending", job vẫn thuộc về UploaderTask
+    bool ok = wsClient->sendBIN(frame, headerLen + bytes, true);
+    portENTER_CRITICAL(&pendingMux);
+    pending[slot].sending = false;
+    if (ok) stats.sent++;
+    else pending[slot].used = false;     // chưa gửi được -> trả job cho UploaderTask đi đường HTTP
+    portEXIT_CRITICAL(&pendingMux);
+    wsUnlock();
+    return ok;
+}
+
+bool wsUplinkOnBinary(const uint8_t* payload, size_t length) {
+    uint32_t id;
+    const char* json;
+    size_t jsonLen;
+    if (!uplinkDecodeReply(payload, length, &id, &json, &jsonLen)) return false;
+
+    Pending p;
+    if (!takePending(id, p)) {
+        portENTER_CRITICAL(&pendingMux); stats.late++; portEXIT_CRITICAL(&pendingMux);
+        return true;
+    }
+    ServerReply reply;
+    serverReplyClear(reply);
+    reply.httpCode = 200;
+    bool decoded;
+    {
+        MetricTimer timer(M_PARSE);
+        decoded = decodeServerReply(json, jsonLen, reply);
+    }
+    // Server lỗi ({"error"}, code >= 400) hoặc không có kết quả: như HTTP lỗi -> lưu offline
+    bool ok = decoded && reply.httpCode < 400;
+    if (!ok) {
+        LOGW("⚠️ [WS] Request %lu lỗi phía server (%d: %s).", (unsigned long)id, reply.httpCode, reply.message);
+    }
+    portENTER_CRITICAL(&pendingMux); stats.replied++; if (!ok) stats.failed++; portEXIT_CRITICAL(&pendingMux);
+    finish(p, reply, ok);
+    return true;
+}
+
+static void failPending(Pending& p) {
+    ServerReply reply;
+    serverReplyClear(reply);
+    reply.httpCode = -1;
+    portENTER_CRITICAL(&pendingMux); stats.timeouts++; portEXIT_CRITICAL(&pendingMux);
+    finish(p, reply, false);
+}
+
+void wsUplinkPoll() {
+    for (int i = 0; i < WS_UPLINK_INFLIGHT; i++) {
+        Pending p;
+        bool expired = false;
+        portENTER_CRITICAL(&pendingMux);
+        if (pending[i].used && !pending[i].sending && millis() - pending[i].sentAt > pending[i].timeoutMs) {
+            p = pending[i];
+            pending[i].used = false;
+            expired = true;
+        }
+        portEXIT_CRITICAL(&pendingMux);
+        if (expired) {
+            LOGW("⚠️ [WS] Request %lu hết giờ (%lu ms).", (unsigned long)p.job.id, (unsigned long)p.timeoutMs);
+            failPending(p);
+        }
+    }
+}
+
+void wsUplinkAbort() {
+    Pending p;
+    while (takePending(0, p)) {
+        LOGW("⚠️ [WS] Mất kết nối khi request %lu đang chờ.", (unsigned long)p.job.id);
+        failPending(p);
+    }
+}
+
+WsUplinkStats wsUplinkStats() {
+    portENTER_CRITICAL(&pendingMux);
+    WsUplinkStats s = stats;
+    portEXIT_CRITICAL(&pendingMux);
+    return s;
+}
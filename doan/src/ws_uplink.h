@@ -0,0 +1,49 @@
+#pragma once
+#include <Arduino.h>
+#include <WebSocketsClient.h>
+#include "uploader.h"
+#include "uplink_frame.h"
+
+// Gửi ảnh nhận diện / enroll qua kết nối WebSocket /ws đang mở sẵn (khung nhị phân, xem
+// uplink_frame.h) thay vì 1 HTTP POST mỗi lượt. UploaderTask gửi xong là nhận job kế tiếp,
+// kết quả về trong webSocketEvent (NetworkTask) và được ghép lại theo request id -> tối đa
+// WS_UPLINK_INFLIGHT request cùng bay. Ảnh của request đang bay được giữ lại tới khi có kết
+// quả để còn lưu offline nếu hết giờ / mất kết nối.
+// Chỉ dùng khi server đã báo hỗ trợ ({"type":"uplink","version":1} sau "role:device");
+// còn lại (chưa báo, bảng đầy, mất kết nối) thì gửi HTTP như cũ.
+
+#define WS_UPLINK_INFLIGHT   4
+
+static_assert(UPLOAD_MAX_PARTS <= UPLINK_MAX_PARTS, "UPLINK_MAX_PARTS phải chứa được cả burst");
+
+struct WsUplinkStats {
+    uint32_t sent;
+    uint32_t replied;
+    uint32_t timeouts;       // hết giờ hoặc mất kết nối khi đang chờ
+    uint32_t failed;         // server trả lỗi / phản hồi không giải mã được -> đã lưu offline
+    uint32_t late;           // kết quả về sau khi đã hết giờ (bị bỏ)
+    uint32_t maxInFlight;
+    uint32_t noBuffer;       // không có / không vừa khung gửi trong gUplinkPool -> đi HTTP
+};
+
+// Gọi trong NetworkTask trước uploaderComplete(): ok = có kết quả từ server. Khi !ok người
+// gọi lưu offline và đặt reply.kind = REPLY_OFFLINE.
+typedef void (*WsUplinkDone)(const UploadJob& job, ServerReply& reply, bool ok, uint32_t rttMs, size_t bytes);
+
+void wsUplinkBegin(WebSocketsClient* ws, WsUplinkDone done);
+// Mọi thao tác trên WebSocketsClient đi qua khoá này (loop ở NetworkTask, gửi ở UploaderTask)
+void wsLock();
+void wsUnlock();
+
+void wsUplinkSetSupported(bool supported);
+bool wsUplinkReady();
+// UploaderTask. true: đã gửi, ảnh của job thuộc về uplink tới khi có kết quả. false: chưa gửi,
+// job vẫn hoàn toàn của người gọi (kể cả khi mất kết nối giữa lúc gửi) -> đi HTTP / lưu offline.
+bool wsUplinkSend(const UploadJob& job, uint32_t timestamp, uint32_t timeoutMs);
+// webSocketEvent (WStype_BIN). false nếu không phải phản hồi uplink.
+bool wsUplinkOnBinary(const uint8_t* payload, size_t length);
+// NetworkTask: xử lý request hết giờ
+void wsUplinkPoll();
+// Mất kết nối WS: mọi request đang bay coi như lỗi
+void wsUplinkAbort();
+WsUplinkStats wsUplinkStats();
@@ -0,0 +1,113 @@
+// buffer_pool: hết block, quá cỡ, RAII, arena, và nhiều luồng lấy / trả cùng lúc (mỗi luồng
+// ghi dấu vào block rồi kiểm tra lại trước khi trả -> 2 luồng giữ cùng 1 block sẽ bị phát hiện).
+//   pio test -e native -f test_buffer_pool
+#include <unity.h>
+#include <string.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "buffer_pool.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// Block làm tròn lên bội 16, hết block thì trả nullptr và đếm exhausted
+static void test_exhaustion(void) {
+    BufferPool pool;
+    TEST_ASSERT_TRUE(pool.begin(1000, 4));
+    TEST_ASSERT_EQUAL_UINT32(1008, pool.blockSize());
+    uint8_t* b[4];
+    for (int i = 0; i < 4; i++) {
+        b[i] = pool.acquire(1000);
+        TEST_ASSERT_NOT_NULL(b[i]);
+        for (int j = 0; j < i; j++) TEST_ASSERT_TRUE(b[i] != b[j]);
+    }
+    TEST_ASSERT_NULL(pool.acquire(1000));
+    TEST_ASSERT_NULL(pool.acquire(1));
+    TEST_ASSERT_EQUAL_UINT32(2, pool.stats().exhausted);
+    pool.release(b[2] + 17);                     // con trỏ giữa block vẫn trả đúng block
+    TEST_ASSERT_EQUAL_PTR(b[2], pool.acquire(1008));
+    for (int i = 0; i < 4; i++) pool.release(b[i]);
+    BufferPoolStats st = pool.stats();
+    TEST_ASSERT_EQUAL_UINT32(0, st.inUse);
+    TEST_ASSERT_EQUAL_UINT32(4, st.highWater);
+}
+
+static void test_oversize(void) {
+    BufferPool pool;
+    TEST_ASSERT_TRUE(pool.begin(1000, 4));
+    TEST_ASSERT_NULL(pool.acquire(1009));
+    TEST_ASSERT_EQUAL_UINT32(1, pool.stats().oversize);
+    TEST_ASSERT_EQUAL_UINT32(0, pool.stats().inUse);
+}
+
+// PoolBuffer: move chuyển quyền sở hữu, detach giữ block sau reset
+static void test_raii(void) {
+    BufferPool pool;
+    TEST_ASSERT_TRUE(pool.begin(1000, 4));
+    {
+        PoolBuffer x(pool, 10), y(pool, 10);
+        PoolBuffer z = std::move(x);
+        TEST_ASSERT_FALSE(x);
+        TEST_ASSERT_TRUE(z);
+        TEST_ASSERT_TRUE(y);
+        TEST_ASSERT_EQUAL_UINT32(2, pool.stats().inUse);
+        TEST_ASSERT_EQUAL_UINT32(1008, z.capacity());
+        uint8_t* kept = y.detach();
+        y.reset();
+        TEST_ASSERT_EQUAL_UINT32(2, pool.stats().inUse);
+        pool.release(kept);
+    }
+    TEST_ASSERT_EQUAL_UINT32(0, pool.stats().inUse);
+}
+
+// ScratchArena: căn lề, tràn block thì trả nullptr và đếm overflows, trả block khi hết scope
+static void test_arena(void) {
+    BufferPool pool;
+    TEST_ASSERT_TRUE(pool.begin(1000, 4));
+    {
+        ScratchArena a(pool);
+        uint8_t* p1 = (uint8_t*)a.alloc(3, 1);
+        uint8_t* p2 = (uint8_t*)a.alloc(8, 8);
+        TEST_ASSERT_NOT_NULL(p1);
+        TEST_ASSERT_NOT_NULL(p2);
+        TEST_ASSERT_EQUAL_UINT32(0, (uintptr_t)p2 & 7);
+        TEST_ASSERT_NULL(a.alloc(1000));
+        TEST_ASSERT_EQUAL_UINT32(1, a.overflows());
+        TEST_ASSERT_EQUAL_UINT32(16, a.used());
+    }
+    TEST_ASSERT_EQUAL_UINT32(0, pool.stats().inUse);
+}
+
+static void test_threads(void) {
+    BufferPool shared;
+    TEST_ASSERT_TRUE(shared.begin(256, 8));
+    std::atomic<int> corrupt{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([&, t] {
+            for (int i = 0; i < 50000; i++) {
+                PoolBuffer buf(shared, 256);
+                if (!buf) continue;
+                memset(buf.data(), t + 1, 256);
+                for (int k = 0; k < 256; k += 31) if (buf.data()[k] != t + 1) corrupt++;
+            }
+        });
+    }
+    for (std::thread& th : threads) th.join();
+    BufferPoolStats st = shared.stats();
+    TEST_ASSERT_EQUAL_INT(0, corrupt.load());
+    TEST_ASSERT_EQUAL_UINT32(0, st.inUse);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(4, st.highWater);
+    TEST_ASSERT_EQUAL_UINT32(200000, st.acquired + st.exhausted);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_exhaustion);
+    RUN_TEST(test_oversize);
+    RUN_TEST(test_raii);
+    RUN_TEST(test_arena);
+    RUN_TEST(test_threads);
+    return UNITY_END();
+}
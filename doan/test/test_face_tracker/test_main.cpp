@@ -0,0 +1,151 @@
+// face_tracker trên chuỗi mặt tổng hợp di chuyển: "detector" trả khung thật mỗi detectEvery
+// frame, các frame giữa chỉ bám template.
+//   pio test -e native -f test_face_tracker
+#include <unity.h>
+#include <math.h>
+#include <stdio.h>
+#include <vector>
+#include "face_tracker.h"
+
+static const int W = 240, H = 240, FRAMES = 300;
+
+// Mặt elip có vân da gắn theo toạ độ mặt + 2 mắt, nền ô cờ, nhiễu cảm biến ±4; mặt đi theo
+// đường sin như chuỗi tổng hợp của bench (shim_camera). empty: chỉ có nền.
+struct SyntheticFrames {
+    std::vector<uint8_t> buf = std::vector<uint8_t>(W * H * 2);
+
+    static void putPixel(uint8_t* p, int r, int g, int b) {
+        r = r < 0 ? 0 : r > 255 ? 255 : r;
+        g = g < 0 ? 0 : g > 255 ? 255 : g;
+        b = b < 0 ? 0 : b > 255 ? 255 : b;
+        uint16_t v = (uint16_t)(((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3));
+        p[0] = v >> 8;
+        p[1] = v & 0xFF;
+    }
+
+    Rgb565Frame render(uint32_t i, bool empty, TrackBox& truth) {
+        const float cx = W * 0.5f + W * 0.10f * sinf(i * 0.07f);
+        const float cy = H * 0.48f + H * 0.03f * sinf(i * 0.05f);
+        const float fw = W * 0.38f, fh = H * 0.44f;
+        const float eyeY = -fh * 0.12f, eyeDx = fw * 0.2f;
+        uint32_t seed = i * 2654435761u + 1;
+        uint8_t* p = buf.data();
+        for (int y = 0; y < H; y++) {
+            for (int x = 0; x < W; x++, p += 2) {
+                seed = seed * 1664525u + 1013904223u;
+                int noise = (int)(seed >> 29) - 4;
+                float lx = x - cx, ly = y - cy;
+                float ex = lx / (fw * 0.5f), ey = ly / (fh * 0.5f);
+                if (empty || ex * ex + ey * ey >= 1) {
+                    int v = 70 + ((x / 12 + y / 12) & 1) * 20 + noise;
+                    putPixel(p, v, v, v + 10);
+                    continue;
+                }
+                int v = 165 + (int)(18 * sinf(lx * 0.35f) * cosf(ly * 0.28f)) + noise;
+                if (fabsf(ly - eyeY) < 4.5f && (fabsf(lx + eyeDx) < 7 || fabsf(lx - eyeDx) < 7)) v = 35;
+                putPixel(p, v + 25, v, v - 20);
+            }
+        }
+        truth = {(int16_t)(cx - fw * 0.5f), (int16_t)(cy - fh * 0.5f), (int16_t)fw, (int16_t)fh};
+        return {buf.data(), (uint16_t)W, (uint16_t)H};
+    }
+};
+
+static SyntheticFrames frames;
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// Sai số tâm khung lúc chỉ bám nhỏ, id giữ nguyên, detect đúng nhịp detectEvery
+static void test_tracks_between_detections(void) {
+    FaceTracker tracker;
+    const TrackerConfig cfg;
+    TrackBox truth;
+    int tracked = 0;
+    double errSum = 0, errMax = 0;
+    uint32_t id = 0;
+    for (int i = 0; i < FRAMES; i++) {
+        Rgb565Frame frame = frames.render(i, false, truth);
+        if (tracker.needsDetection()) {
+            tracker.correct(frame, &truth, nullptr, 1);
+        } else {
+            TEST_ASSERT_EQUAL_INT(1, tracker.track(frame));
+            const TrackBox& b = tracker.at(0).box;
+            double ex = b.x + b.w / 2.0 - (truth.x + truth.w / 2.0);
+            double ey = b.y + b.h / 2.0 - (truth.y + truth.h / 2.0);
+            double err = sqrt(ex * ex + ey * ey);
+            errSum += err;
+            if (err > errMax) errMax = err;
+            tracked++;
+        }
+        const Track* t = tracker.primary();
+        TEST_ASSERT_NOT_NULL(t);
+        if (!id) id = t->id;
+        TEST_ASSERT_EQUAL_UINT32(id, t->id);
+        TEST_ASSERT_LESS_OR_EQUAL_UINT32(cfg.detectEvery, t->sinceDetect);
+    }
+    char msg[96];
+    snprintf(msg, sizeof(msg), "sai số tâm TB %.2f px, max %.2f px (%d frame bám)", errSum / tracked, errMax, tracked);
+    TEST_MESSAGE(msg);
+    TEST_ASSERT_GREATER_OR_EQUAL_INT(FRAMES / 2, tracked);
+    TEST_ASSERT_TRUE_MESSAGE(errSum / tracked <= 2.0, msg);
+    TEST_ASSERT_TRUE_MESSAGE(errMax <= 5.0, msg);
+    TrackerStats st = tracker.stats();
+    TEST_ASSERT_EQUAL_UINT32(1, st.created);
+    TEST_ASSERT_EQUAL_UINT32(0, st.lost);
+}
+
+// Detect lệch 6 px 1 lần rồi detect đúng: khung về lại đúng khung thật, vẫn cùng id
+static void test_detection_corrects_drift(void) {
+    FaceTracker tracker;
+    const TrackerConfig cfg;
+    TrackBox truth;
+    const int SKEWED = 150;
+    int skewedAt = -1;
+    uint32_t id = 0;
+    for (int i = 0; i < FRAMES; i++) {
+        Rgb565Frame frame = frames.render(i, false, truth);
+        if (tracker.needsDetection()) {
+            TrackBox box = truth;
+            if (i >= SKEWED && skewedAt < 0) {
+                box.x += 6;
+                skewedAt = i;
+            }
+            tracker.correct(frame, &box, nullptr, 1);
+            const Track* t = tracker.primary();
+            TEST_ASSERT_NOT_NULL(t);
+            if (!id) id = t->id;
+            TEST_ASSERT_EQUAL_UINT32(id, t->id);
+            if (skewedAt >= 0 && i > skewedAt) {
+                TEST_ASSERT_EQUAL_INT(truth.x, t->box.x);
+                TEST_ASSERT_EQUAL_INT(truth.y, t->box.y);
+                return;
+            }
+        } else {
+            TEST_ASSERT_EQUAL_INT(1, tracker.track(frame));
+        }
+    }
+    TEST_ASSERT_TRUE_MESSAGE(false, "không có lần detect nào sau lần lệch");
+}
+
+// Người rời khung (chỉ còn nền): template không còn khớp -> xoá track, frame sau phải detect
+static void test_lost_face_forces_detection(void) {
+    FaceTracker tracker;
+    TrackBox truth;
+    Rgb565Frame frame = frames.render(0, false, truth);
+    tracker.correct(frame, &truth, nullptr, 1);
+    TEST_ASSERT_FALSE(tracker.needsDetection());
+
+    frame = frames.render(1, true, truth);
+    TEST_ASSERT_EQUAL_INT(0, tracker.track(frame));
+    TEST_ASSERT_TRUE(tracker.needsDetection());
+    TEST_ASSERT_EQUAL_UINT32(1, tracker.stats().lost);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_tracks_between_detections);
+    RUN_TEST(test_detection_corrects_drift);
+    RUN_TEST(test_lost_face_forces_detection);
+    return UNITY_END();
+}
@@ -0,0 +1,106 @@
+// head_pose trên bộ landmark có nhãn: mô hình mặt 3D (mm, gốc giữa 2 mắt, z hướng về camera)
+// xoay yaw / pitch / roll đã biết rồi chiếu phối cảnh, khoảng cách 2 mắt ~40 px như mặt rộng
+// ~80 px trên kiosk, lệch ngẫu nhiên dưới 1 px rồi làm tròn như toạ độ nguyên của detector.
+//   pio test -e native -f test_head_pose
+#include <unity.h>
+#include <math.h>
+#include <stdio.h>
+#include "head_pose.h"
+
+static PoseLandmarks projectPose(float yawDeg, float pitchDeg, float rollDeg, bool mirrored, uint32_t& seed) {
+    static const float model[5][3] = {{-31, 0, 0}, {31, 0, 0}, {0, 38, 28}, {-25, 72, 8}, {25, 72, 8}};
+    const float k = 3.14159265f / 180;
+    float cy = cosf(yawDeg * k), sy = sinf(yawDeg * k), cp = cosf(pitchDeg * k), sp = sinf(pitchDeg * k);
+    float cr = cosf(rollDeg * k), sr = sinf(rollDeg * k);
+    float out[5][2];
+    for (int i = 0; i < 5; i++) {
+        // Người quay sang trái của họ = bên phải ảnh (x tăng); ngẩng lên = mũi đi lên (y giảm)
+        float x = model[i][0], y = model[i][1] - 36, z = model[i][2];
+        float x1 = x * cy + z * sy, z1 = -x * sy + z * cy;
+        float y2 = y * cp - z1 * sp, z2 = y * sp + z1 * cp;
+        float x3 = x1 * cr - y2 * sr, y3 = x1 * sr + y2 * cr;
+        float s = 600.0f / (600 - z2) * 0.65f;
+        seed = seed * 1664525u + 1013904223u;
+        float jx = ((seed >> 16) & 255) / 256.0f - 0.5f, jy = ((seed >> 24) & 255) / 256.0f - 0.5f;
+        out[i][0] = roundf(120 + (mirrored ? -x3 : x3) * s + jx);
+        out[i][1] = roundf(110 + y3 * s + jy);
+    }
+    return {out[0][0], out[0][1], out[1][0], out[1][1], out[2][0], out[2][1],
+            out[3][0], out[3][1], out[4][0], out[4][1]};
+}
+
+struct Label { PoseTarget target; float yawLo, yawHi, pitchLo, pitchHi; PoseHint fromFront; };
+static const Label labels[] = {
+    {POSE_FRONT, -5, 5, -5, 5, POSE_HINT_OK},
+    {POSE_LEFT, 22, 35, -5, 5, POSE_HINT_TURN_LEFT},
+    {POSE_RIGHT, -35, -22, -5, 5, POSE_HINT_TURN_RIGHT},
+    {POSE_UP, -5, 5, 18, 30, POSE_HINT_LOOK_UP},
+    {POSE_DOWN, -5, 5, -30, -18, POSE_HINT_LOOK_DOWN},
+};
+
+// Hiệu chỉnh trung tính như kiosk: từ ảnh nhìn thẳng của chính "người" này
+static PoseConfig calibrated(bool mirrored, uint32_t& seed) {
+    PoseConfig cfg;
+    cfg.mirrored = mirrored;
+    poseSetNeutral(cfg, estimateHeadPose(projectPose(0, 0, 0, mirrored, seed), cfg));
+    return cfg;
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// Mỗi mẫu phải khớp đúng bước enroll của nó và bị các bước khác từ chối
+static void checkLabels(bool mirrored) {
+    uint32_t seed = 777;
+    PoseConfig cfg = calibrated(mirrored, seed);
+    char msg[128];
+    for (const Label& l : labels) {
+        for (int i = 0; i < 40; i++) {
+            float t = (i % 8) / 7.0f, u = (i / 8) / 4.0f;
+            float yaw = l.yawLo + (l.yawHi - l.yawLo) * t, pitch = l.pitchLo + (l.pitchHi - l.pitchLo) * u;
+            float roll = (i % 5) * 4.0f - 8;
+            HeadPose p = estimateHeadPose(projectPose(yaw, pitch, roll, mirrored, seed), cfg);
+            snprintf(msg, sizeof(msg), "target %d yaw %.0f pitch %.0f roll %.0f -> yaw %.3f pitch %.3f",
+                     l.target, yaw, pitch, roll, p.yaw, p.pitch);
+            TEST_ASSERT_TRUE_MESSAGE(checkPose(p, l.target, cfg) == POSE_HINT_OK, msg);
+            for (int other = 0; other < POSE_TARGET_COUNT; other++) {
+                if (other == l.target) continue;
+                TEST_ASSERT_TRUE_MESSAGE(checkPose(p, (PoseTarget)other, cfg) != POSE_HINT_OK, msg);
+            }
+        }
+    }
+}
+
+static void test_labels_match_only_their_step(void) { checkLabels(false); }
+static void test_labels_match_only_their_step_mirrored(void) { checkLabels(true); }
+
+// Đang nhìn thẳng ở từng bước -> gợi ý đúng hướng, cả khi ảnh lật gương
+static void test_front_gives_step_hint(void) {
+    for (int mirrored = 0; mirrored < 2; mirrored++) {
+        uint32_t seed = 777;
+        PoseConfig cfg = calibrated(mirrored, seed);
+        for (const Label& l : labels) {
+            HeadPose front = estimateHeadPose(projectPose(0, 0, 0, mirrored, seed), cfg);
+            TEST_ASSERT_EQUAL_INT(l.fromFront, checkPose(front, l.target, cfg));
+        }
+    }
+}
+
+// Đầu nghiêng quá mức / landmark hỏng
+static void test_roll_and_broken_landmarks(void) {
+    uint32_t seed = 777;
+    PoseConfig cfg;
+    TEST_ASSERT_EQUAL_INT(POSE_HINT_LEVEL_HEAD,
+                          checkPose(estimateHeadPose(projectPose(0, 0, 30, false, seed), cfg), POSE_FRONT, cfg));
+    PoseLandmarks broken = {100, 100, 101, 100, 100, 110, 95, 90, 105, 90};
+    TEST_ASSERT_EQUAL_INT(POSE_HINT_NO_FACE, checkPose(estimateHeadPose(broken, cfg), POSE_FRONT, cfg));
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_labels_match_only_their_step);
+    RUN_TEST(test_labels_match_only_their_step_mirrored);
+    RUN_TEST(test_front_gives_step_hint);
+    RUN_TEST(test_roll_and_broken_landmarks);
+    return UNITY_END();
+}
@@ -0,0 +1,201 @@
+// offline_journal trong thư mục tạm: nhiều segment, gửi một phần, đuôi segment đang ghi bị cắt
+// (mất điện giữa lúc ghi) rồi mở lại, header hỏng trong segment đang ghi. Mỗi bước kiểm tra
+// thứ tự peek / next / ack, payload, cursor sau khi mở lại và stats().pending.
+//   pio test -e native -f test_offline_journal
+#include <unity.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <unistd.h>
+#include "offline_journal.h"
+
+static const uint32_t SEGMENT = 64 * 1024;
+static char dir[32];
+
+static uint32_t recordLen(uint32_t i) { return 40 + (i * 37) % 160; }
+static uint8_t recordByte(uint32_t i, uint32_t k) { return (uint8_t)(i * 7 + k); }
+
+static bool appendRecord(OfflineJournal& j, uint32_t i) {
+    uint8_t data[256];
+    char id[JOURNAL_ID_LEN];
+    for (uint32_t k = 0; k < recordLen(i); k++) data[k] = recordByte(i, k);
+    snprintf(id, sizeof(id), "R%06u", i);
+    return j.append(JOURNAL_RECOGNIZE, i, id, data, recordLen(i));
+}
+
+static void appendRange(OfflineJournal& j, uint32_t first, uint32_t count) {
+    for (uint32_t i = first; i < first + count; i++) TEST_ASSERT_TRUE(appendRecord(j, i));
+}
+
+// Record đúng là số i (timestamp, id, độ dài, payload)
+static void assertRecord(OfflineJournal& j, const JournalRecord& r, uint32_t i) {
+    char id[JOURNAL_ID_LEN];
+    snprintf(id, sizeof(id), "R%06u", i);
+    TEST_ASSERT_EQUAL_UINT32(i, r.timestamp);
+    TEST_ASSERT_EQUAL_UINT32(recordLen(i), r.length);
+    TEST_ASSERT_EQUAL_STRING(id, r.employeeId);
+    uint8_t data[256];
+    TEST_ASSERT_EQUAL_UINT32(r.length, j.read(r, 0, data, sizeof(data)));
+    for (uint32_t k = 0; k < r.length; k++) TEST_ASSERT_EQUAL_INT(recordByte(i, k), data[k]);
+}
+
+// Gửi + ack count record từ vị trí cursor, mong đợi số thứ tự first, first+1...
+static void drain(OfflineJournal& j, uint32_t first, uint32_t count) {
+    JournalRecord r;
+    for (uint32_t i = first; i < first + count; i++) {
+        TEST_ASSERT_TRUE(j.peek(r));
+        assertRecord(j, r, i);
+        TEST_ASSERT_TRUE(j.ack(r));
+    }
+}
+
+static void segPath(char* out, size_t n, uint32_t seg) {
+    snprintf(out, n, "%s/seg_%08lu.log", dir, (unsigned long)seg);
+}
+
+void setUp(void) {
+    strcpy(dir, "/tmp/jrnl_XXXXXX");
+    TEST_ASSERT_NOT_NULL(mkdtemp(dir));
+}
+
+// Xoá thư mục journal tạm (chỉ có file, không có thư mục con)
+void tearDown(void) {
+    DIR* d = opendir(dir);
+    if (d) {
+        char path[300];
+        struct dirent* e;
+        while ((e = readdir(d)) != nullptr) {
+            if (e->d_name[0] == '.') continue;
+            snprintf(path, sizeof(path), "%s/%s", dir, e->d_name);
+            ::remove(path);
+        }
+        closedir(d);
+    }
+    rmdir(dir);
+}
+
+// 20k record qua nhiều segment; next() gom batch không dời cursor, ack phải đúng thứ tự
+static void test_append_batch_ack_in_order(void) {
+    const uint32_t N = 20000, SENT = 7000;
+    OfflineJournal j;
+    TEST_ASSERT_TRUE(j.begin(dir, SEGMENT));
+    appendRange(j, 0, N);
+    JournalStats st = j.stats();
+    TEST_ASSERT_EQUAL_UINT32(N, st.pending);
+    TEST_ASSERT_EQUAL_UINT32(N, st.appended);
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(40, st.writeSegment);
+
+    JournalRecord r, n;
+    TEST_ASSERT_TRUE(j.peek(r));
+    assertRecord(j, r, 0);
+    for (uint32_t i = 1; i < 8; i++) {
+        TEST_ASSERT_TRUE(j.next(r, n));
+        assertRecord(j, n, i);
+        r = n;
+    }
+    TEST_ASSERT_EQUAL_UINT32(N, j.pending());
+
+    drain(j, 0, SENT);
+    TEST_ASSERT_TRUE(j.peek(r));
+    TEST_ASSERT_TRUE(j.next(r, n));
+    TEST_ASSERT_FALSE(j.ack(n));       // ack sai thứ tự bị từ chối
+    st = j.stats();
+    TEST_ASSERT_EQUAL_UINT32(N - SENT, st.pending);
+    TEST_ASSERT_EQUAL_UINT32(SENT, st.acked);
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(2, st.firstSegment);
+}
+
+// Mất điện giữa lúc ghi record cuối: đuôi segment đang ghi bị cắt 10 byte, mở lại giữ cursor
+// và không đếm record ghi dở
+static void test_truncated_tail_recovers(void) {
+    const uint32_t N = 3000, SENT = 1000;
+    uint32_t writeSeg;
+    {
+        OfflineJournal j;
+        TEST_ASSERT_TRUE(j.begin(dir, SEGMENT));
+        appendRange(j, 0, N);
+        drain(j, 0, SENT);
+        writeSeg = j.stats().writeSegment;
+    }
+    char path[300];
+    struct stat fs;
+    segPath(path, sizeof(path), writeSeg);
+    TEST_ASSERT_EQUAL_INT(0, stat(path, &fs));
+    TEST_ASSERT_EQUAL_INT(0, truncate(path, fs.st_size - 10));
+
+    OfflineJournal j;
+    TEST_ASSERT_TRUE(j.begin(dir, SEGMENT));
+    JournalStats st = j.stats();
+    TEST_ASSERT_EQUAL_UINT32(1, st.recovered);
+    TEST_ASSERT_EQUAL_UINT32(N - SENT - 1, st.pending);
+    // Ghi tiếp sang segment mới; gửi hết thì bỏ qua record ghi dở
+    appendRange(j, N, 10);
+    drain(j, SENT, N - 1 - SENT);
+    drain(j, N, 10);
+    JournalRecord r;
+    TEST_ASSERT_FALSE(j.peek(r));
+    TEST_ASSERT_EQUAL_UINT32(0, j.pending());
+}
+
+// Header hỏng giữa segment đang ghi: dừng ở đó, phần sau không còn chờ gửi; record mới vẫn gửi được
+static void test_corrupt_header_skips_rest_of_segment(void) {
+    OfflineJournal j;
+    TEST_ASSERT_TRUE(j.begin(dir, SEGMENT));
+    appendRange(j, 0, 50);
+    uint32_t off = 0;
+    for (uint32_t i = 0; i < 20; i++) off += JOURNAL_HEADER_LEN + recordLen(i);
+    char path[300];
+    segPath(path, sizeof(path), j.stats().writeSegment);
+    FILE* f = fopen(path, "r+b");
+    TEST_ASSERT_NOT_NULL(f);
+    TEST_ASSERT_EQUAL_INT(0, fseek(f, off, SEEK_SET));
+    TEST_ASSERT_TRUE(fputc('X', f) != EOF);
+    fclose(f);
+
+    drain(j, 0, 20);
+    JournalRecord r;
+    TEST_ASSERT_FALSE(j.peek(r));
+    JournalStats st = j.stats();
+    TEST_ASSERT_EQUAL_UINT32(0, st.pending);
+    TEST_ASSERT_EQUAL_UINT32(1, st.corrupt);
+
+    TEST_ASSERT_TRUE(appendRecord(j, 50));
+    TEST_ASSERT_EQUAL_UINT32(1, j.pending());
+    drain(j, 50, 1);
+    TEST_ASSERT_EQUAL_UINT32(0, j.pending());
+    TEST_ASSERT_FALSE(j.peek(r));
+}
+
+// Mở lại sau khi đã gửi hết: không còn gì chờ, segment cũ đã xoá
+static void test_reopen_after_drain(void) {
+    uint32_t writeSeg;
+    {
+        OfflineJournal j;
+        TEST_ASSERT_TRUE(j.begin(dir, SEGMENT));
+        appendRange(j, 0, 2000);
+        drain(j, 0, 2000);
+        writeSeg = j.stats().writeSegment;
+    }
+    OfflineJournal j;
+    TEST_ASSERT_TRUE(j.begin(dir, SEGMENT));
+    JournalRecord r;
+    JournalStats st = j.stats();
+    TEST_ASSERT_EQUAL_UINT32(0, st.pending);
+    TEST_ASSERT_FALSE(j.peek(r));
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(writeSeg, st.firstSegment);
+    char path[300];
+    struct stat fs;
+    segPath(path, sizeof(path), 1);
+    TEST_ASSERT_TRUE(stat(path, &fs) != 0);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_append_batch_ack_in_order);
+    RUN_TEST(test_truncated_tail_recovers);
+    RUN_TEST(test_corrupt_header_skips_rest_of_segment);
+    RUN_TEST(test_reopen_after_drain);
+    return UNITY_END();
+}